@@ -125,6 +125,35 @@ block_append(ByteBlock* blk, const void* data, size_t size) {
   return -1;
 }
 
+/**
+ * Appends to a block whose allocation holds *capacity bytes.  The allocation
+ * doubles when it is full, so that many small appends copy each byte only a
+ * few times instead of once per append.
+ *
+ * @return bytes appended or -1 on error
+ */
+ssize_t
+block_extend(ByteBlock* blk, size_t* capacity, const void* data, size_t size) {
+  size_t n = block_SIZE(blk), cap = blk->start ? MAX(*capacity, n) : 0;
+
+  if(n + size > cap) {
+    uint8_t* alloc;
+
+    cap = MAX(MAX(cap * 2, n + size), 64);
+
+    if(!(alloc = realloc(block_ALLOC(blk), LWS_PRE + cap)))
+      return -1;
+
+    blk->start = alloc + LWS_PRE;
+  }
+
+  memcpy(blk->start + n, data, size);
+  blk->end = blk->start + n + size;
+  *capacity = cap;
+
+  return size;
+}
+
 uint8_t*
 buffer_alloc(ByteBuffer* buf, size_t size) {
   uint8_t* ret;
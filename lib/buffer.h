@@ -35,6 +35,7 @@ JSValue block_toarraybuffer(ByteBlock*, JSContext* ctx);
 JSValue block_tostring(ByteBlock*, JSContext* ctx);
 JSValue block_tojson(ByteBlock* blk, JSContext* ctx);
 ssize_t block_append(ByteBlock*, const void* data, size_t size);
+ssize_t block_extend(ByteBlock*, size_t* capacity, const void* data, size_t size);
 
 static inline ByteBlock
 block_move(ByteBlock* blk) {
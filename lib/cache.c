@@ -0,0 +1,879 @@
+/**
+ * @file cache.c
+ */
+#define _GNU_SOURCE
+#include "cache.h"
+#include "utils.h"
+#include <libwebsockets.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC "qjsnetc1"
+
+/* Header of a file in the on-disk tier, followed by key, vary, selected,
+ * status text, serialized headers and body */
+struct cache_record {
+  char magic[8];
+  int64_t stored, expires;
+  int32_t status;
+  uint32_t keylen, varylen, selectedlen, textlen, headerslen;
+  uint64_t bodylen;
+};
+
+/* Response headers a 304 carries over into the stored entry */
+static const char* const cache_updated[] = {
+    "cache-control",
+    "etag",
+    "expires",
+    "last-modified",
+    "date",
+};
+
+static char*
+cache_key(const char* method, const char* url) {
+  size_t mlen = strlen(method), ulen = strlen(url);
+  char* key;
+
+  if((key = malloc(mlen + 1 + ulen + 1))) {
+    memcpy(key, method, mlen);
+    key[mlen] = ' ';
+    memcpy(&key[mlen + 1], url, ulen + 1);
+  }
+
+  return key;
+}
+
+static uint32_t
+cache_hash(const char* key) {
+  return headers_hash(key, strlen(key));
+}
+
+static char*
+cache_strndup(const char* s, size_t n) {
+  char* r;
+
+  if(!s)
+    return 0;
+
+  if((r = malloc(n + 1))) {
+    memcpy(r, s, n);
+    r[n] = '\0';
+  }
+
+  return r;
+}
+
+static char*
+cache_header(Headers* h, const char* name) {
+  size_t len;
+  char* value;
+
+  return (value = headers_getlen(h, &len, name, "\r\n", ":")) ? cache_strndup(value, len) : 0;
+}
+
+/* Calls 'fn' for each comma-separated item of 'list', trimmed */
+static BOOL
+cache_tokens(const char* list, size_t len, BOOL (*fn)(const char*, size_t, void*), void* opaque) {
+  size_t pos = 0;
+
+  while(pos < len) {
+    size_t end = pos + byte_chr(&list[pos], len - pos, ','), start = pos, stop = end;
+
+    while(start < stop && isspace(list[start]))
+      ++start;
+    while(stop > start && isspace(list[stop - 1]))
+      --stop;
+
+    if(stop > start && !fn(&list[start], stop - start, opaque))
+      return FALSE;
+
+    pos = end + 1;
+  }
+
+  return TRUE;
+}
+
+typedef struct {
+  BOOL no_store, no_cache;
+  int64_t max_age;
+} CacheControl;
+
+static BOOL
+cache_directive(const char* s, size_t n, void* opaque) {
+  CacheControl* cc = opaque;
+
+  if(n == 8 && !strncasecmp(s, "no-store", 8))
+    cc->no_store = TRUE;
+  else if(n >= 8 && !strncasecmp(s, "no-cache", 8))
+    cc->no_cache = TRUE;
+  else if(n > 8 && !strncasecmp(s, "max-age=", 8)) {
+    int64_t v = 0;
+
+    for(size_t i = 8; i < n && isdigit(s[i]); i++)
+      v = v * 10 + (s[i] - '0');
+
+    cc->max_age = v;
+  }
+
+  return TRUE;
+}
+
+static CacheControl
+cache_control(Headers* h) {
+  CacheControl cc = {FALSE, FALSE, -1};
+  const char* value;
+  size_t len;
+
+  if((value = headers_getlen(h, &len, "cache-control", "\r\n", ":")))
+    cache_tokens(value, len, cache_directive, &cc);
+
+  /* HTTP/1.0 servers */
+  if((value = headers_getlen(h, &len, "pragma", "\r\n", ":")) && len >= 8 && !strncasecmp(value, "no-cache", 8))
+    cc.no_cache = TRUE;
+
+  return cc;
+}
+
+static BOOL
+cache_date(Headers* h, const char* name, time_t* t) {
+  const char* value;
+  size_t len;
+  char buf[64];
+
+  if(!(value = headers_getlen(h, &len, name, "\r\n", ":")) || len >= sizeof(buf))
+    return FALSE;
+
+  memcpy(buf, value, len);
+  buf[len] = '\0';
+
+  return !lws_http_date_parse_unix(buf, len, t);
+}
+
+/* Expiry time of a response received at 'now', 'now' when it must be revalidated */
+static time_t
+cache_expires(Headers* h, time_t now) {
+  CacheControl cc = cache_control(h);
+  time_t expires, date;
+  const char* value;
+  size_t len;
+  int64_t age = 0;
+
+  if(cc.no_cache)
+    return now;
+
+  if((value = headers_getlen(h, &len, "age", "\r\n", ":")))
+    for(size_t i = 0; i < len && isdigit(value[i]); i++)
+      age = age * 10 + (value[i] - '0');
+
+  if(cc.max_age >= 0)
+    return cc.max_age > age ? now + (cc.max_age - age) : now;
+
+  /* Expires relative to the server clock */
+  if(cache_date(h, "expires", &expires)) {
+    if(!cache_date(h, "date", &date))
+      date = now;
+
+    return expires > date ? now + (expires - date) : now;
+  }
+
+  return now;
+}
+
+typedef struct {
+  Headers* request;
+  ByteBuffer* out;
+} CacheSelect;
+
+static BOOL
+cache_select_header(const char* name, size_t namelen, void* opaque) {
+  CacheSelect* sel = opaque;
+  const char* value = 0;
+  size_t valuelen = 0;
+  ssize_t i;
+
+  if((i = headers_findb(sel->request, name, namelen, "\r\n")) >= 0) {
+    HeaderEntry* e = &sel->request->entries[i];
+
+    value = headers_entry_value(sel->request, e);
+    valuelen = e->valuelen;
+  }
+
+  for(size_t j = 0; j < namelen; j++) {
+    char c = tolower(name[j]);
+
+    if(buffer_append(sel->out, &c, 1) == -1)
+      return FALSE;
+  }
+
+  return buffer_append(sel->out, ": ", 2) != -1 && buffer_append(sel->out, value ? value : "", valuelen) != -1 && buffer_append(sel->out, "\n", 1) != -1;
+}
+
+/* The request header values a response varies on */
+static char*
+cache_select(const char* vary, Headers* request) {
+  ByteBuffer out = BUFFER_0();
+  CacheSelect sel = {request, &out};
+  char* ret;
+
+  if(!vary)
+    return 0;
+
+  if(!cache_tokens(vary, strlen(vary), cache_select_header, &sel)) {
+    buffer_free(&out);
+    return 0;
+  }
+
+  ret = out.start ? cache_strndup((const char*)out.start, buffer_HEAD(&out)) : cache_strndup("", 0);
+  buffer_free(&out);
+  return ret;
+}
+
+static BOOL
+cache_matches(CacheEntry* entry, uint32_t hash, const char* key, Headers* request) {
+  BOOL ret;
+  char* selected;
+
+  if(entry->hash != hash || strcmp(entry->key, key))
+    return FALSE;
+
+  if(!entry->vary)
+    return TRUE;
+
+  selected = cache_select(entry->vary, request);
+  ret = selected && entry->selected && !strcmp(selected, entry->selected);
+  free(selected);
+  return ret;
+}
+
+static CacheEntry*
+cache_entry_new(void) {
+  CacheEntry* entry;
+
+  if((entry = calloc(1, sizeof(CacheEntry)))) {
+    entry->ref_count = 1;
+    init_list_head(&entry->link);
+  }
+
+  return entry;
+}
+
+static uint64_t
+cache_fnv(uint64_t h, const char* s) {
+  for(; *s; s++) {
+    h ^= (uint8_t)*s;
+    h *= 1099511628211ull;
+  }
+
+  return h;
+}
+
+/* File of a stored response.  A response that varies is stored per variant,
+ * named by the vary index of its key and the request headers it selected */
+static char*
+cache_path(Cache* cache, const char* key, const char* index, const char* selected, const char* suffix) {
+  /* FNV-1a 64, the 32-bit key hash collides too easily for file names */
+  uint64_t h = cache_fnv(14695981039346656037ull, key);
+  char* path;
+
+  if(index)
+    h = cache_fnv(cache_fnv(h, "\n"), index);
+  if(selected)
+    h = cache_fnv(cache_fnv(h, "\n"), selected);
+
+  if(asprintf(&path, "%s/%016" PRIx64 "%s", cache->dir, h, suffix) == -1)
+    return 0;
+
+  return path;
+}
+
+static BOOL
+cache_writeall(int fd, const void* data, size_t len) {
+  const uint8_t* x = data;
+
+  while(len > 0) {
+    ssize_t r = write(fd, x, len);
+
+    if(r == -1) {
+      if(errno == EINTR)
+        continue;
+
+      return FALSE;
+    }
+
+    x += r;
+    len -= r;
+  }
+
+  return TRUE;
+}
+
+static BOOL
+cache_readall(int fd, void* data, size_t len) {
+  uint8_t* x = data;
+
+  while(len > 0) {
+    ssize_t r = read(fd, x, len);
+
+    if(r <= 0) {
+      if(r == -1 && errno == EINTR)
+        continue;
+
+      return FALSE;
+    }
+
+    x += r;
+    len -= r;
+  }
+
+  return TRUE;
+}
+
+/* Writes 'len' bytes to a temporary file and renames it over 'path' */
+static BOOL
+cache_replace(const char* path, const void* data, size_t len) {
+  char* tmp;
+  int fd;
+  BOOL ok;
+
+  if(asprintf(&tmp, "%s.tmp", path) == -1)
+    return FALSE;
+
+  if((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) == -1) {
+    free(tmp);
+    return FALSE;
+  }
+
+  ok = cache_writeall(fd, data, len);
+
+  if(close(fd) == -1)
+    ok = FALSE;
+
+  if(!ok || rename(tmp, path) == -1) {
+    unlink(tmp);
+    ok = FALSE;
+  }
+
+  free(tmp);
+  return ok;
+}
+
+/**
+ * The vary index of a key: a nonce and the Vary header of the stored
+ * responses.  A new nonce after each invalidation leaves the variants
+ * stored before unreachable.
+ */
+static char*
+cache_index_read(Cache* cache, const char* key) {
+  struct stat st;
+  char *path, *index = 0;
+  int fd;
+
+  if(!(path = cache_path(cache, key, 0, 0, ".vary")))
+    return 0;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  free(path);
+
+  if(fd == -1)
+    return 0;
+
+  if(fstat(fd, &st) == -1 || st.st_size < 18 || st.st_size > 65536 || !(index = malloc(st.st_size + 1)) || !cache_readall(fd, index, st.st_size) ||
+     index[16] != ' ') {
+    free(index);
+    index = 0;
+  } else {
+    index[st.st_size] = '\0';
+  }
+
+  close(fd);
+  return index;
+}
+
+/* The index for the Vary of an entry, the current one while the Vary is the same */
+static char*
+cache_index_write(Cache* cache, CacheEntry* entry) {
+  static uint32_t counter;
+  char *index, *path;
+
+  if((index = cache_index_read(cache, entry->key)) && !strcmp(&index[17], entry->vary))
+    return index;
+
+  free(index);
+
+  if(asprintf(&index, "%08" PRIx32 "%08" PRIx32 " %s", (uint32_t)entry->stored, (uint32_t)getpid() ^ ++counter, entry->vary) == -1)
+    return 0;
+
+  if(!(path = cache_path(cache, entry->key, 0, 0, ".vary")) || !cache_replace(path, index, strlen(index))) {
+    free(index);
+    index = 0;
+  }
+
+  free(path);
+  return index;
+}
+
+/* Writes the entry to a temporary file and renames it over the record */
+static void
+cache_save(Cache* cache, CacheEntry* entry) {
+  struct cache_record rec;
+  char *path, *tmp, *index = 0;
+  int fd;
+  BOOL ok;
+
+  if(!cache->dir)
+    return;
+
+  if(entry->vary) {
+    if(!(index = cache_index_write(cache, entry)))
+      return;
+  } else if((path = cache_path(cache, entry->key, 0, 0, ".vary"))) {
+    /* no longer varies */
+    unlink(path);
+    free(path);
+  }
+
+  path = cache_path(cache, entry->key, index, index ? entry->selected : 0, "");
+  free(index);
+
+  if(!path)
+    return;
+
+  if(asprintf(&tmp, "%s.tmp", path) == -1) {
+    free(path);
+    return;
+  }
+
+  memset(&rec, 0, sizeof(rec));
+  memcpy(rec.magic, CACHE_MAGIC, sizeof(rec.magic));
+  rec.stored = entry->stored;
+  rec.expires = entry->expires;
+  rec.status = entry->status;
+  rec.keylen = strlen(entry->key);
+  rec.varylen = entry->vary ? strlen(entry->vary) : 0;
+  rec.selectedlen = entry->selected ? strlen(entry->selected) : 0;
+  rec.textlen = entry->status_text ? strlen(entry->status_text) : 0;
+  rec.headerslen = buffer_HEAD(&entry->headers.buffer);
+  rec.bodylen = block_SIZE(&entry->body);
+
+  if((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) == -1) {
+    lwsl_warn("cache: cannot write '%s': %s\n", tmp, strerror(errno));
+    free(tmp);
+    free(path);
+    return;
+  }
+
+  ok = cache_writeall(fd, &rec, sizeof(rec)) && cache_writeall(fd, entry->key, rec.keylen) && cache_writeall(fd, entry->vary, rec.varylen) &&
+       cache_writeall(fd, entry->selected, rec.selectedlen) && cache_writeall(fd, entry->status_text, rec.textlen) &&
+       cache_writeall(fd, entry->headers.buffer.start, rec.headerslen) && cache_writeall(fd, entry->body.start, rec.bodylen);
+
+  if(close(fd) == -1)
+    ok = FALSE;
+
+  if(!ok || rename(tmp, path) == -1) {
+    lwsl_warn("cache: cannot write '%s': %s\n", path, strerror(errno));
+    unlink(tmp);
+  }
+
+  free(tmp);
+  free(path);
+}
+
+static BOOL
+cache_readstr(int fd, uint32_t len, char** strp) {
+  if(!(*strp = malloc(len + 1)))
+    return FALSE;
+
+  (*strp)[len] = '\0';
+  return cache_readall(fd, *strp, len);
+}
+
+/* Reads the record for 'key' and the headers of 'request' from the on-disk tier */
+static CacheEntry*
+cache_load(Cache* cache, const char* key, Headers* request) {
+  struct cache_record rec;
+  struct stat st;
+  CacheEntry* entry = 0;
+  char *path, *index, *selected = 0;
+  int fd;
+
+  if(!cache->dir)
+    return 0;
+
+  if((index = cache_index_read(cache, key)) && !(selected = cache_select(&index[17], request))) {
+    free(index);
+    return 0;
+  }
+
+  path = cache_path(cache, key, index, selected, "");
+  free(selected);
+  free(index);
+
+  if(!path)
+    return 0;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  free(path);
+
+  if(fd == -1)
+    return 0;
+
+  if(fstat(fd, &st) == -1 || !cache_readall(fd, &rec, sizeof(rec)) || memcmp(rec.magic, CACHE_MAGIC, sizeof(rec.magic)) ||
+     (uint64_t)st.st_size != sizeof(rec) + (uint64_t)rec.keylen + rec.varylen + rec.selectedlen + rec.textlen + rec.headerslen + rec.bodylen)
+    goto fail;
+
+  if(!(entry = cache_entry_new()))
+    goto fail;
+
+  entry->stored = rec.stored;
+  entry->expires = rec.expires;
+  entry->status = rec.status;
+
+  if(!cache_readstr(fd, rec.keylen, &entry->key) || strcmp(entry->key, key))
+    goto fail;
+
+  if(rec.varylen && !cache_readstr(fd, rec.varylen, &entry->vary))
+    goto fail;
+
+  if((rec.varylen || rec.selectedlen) && !cache_readstr(fd, rec.selectedlen, &entry->selected))
+    goto fail;
+
+  if(rec.textlen && !cache_readstr(fd, rec.textlen, &entry->status_text))
+    goto fail;
+
+  if(rec.headerslen) {
+    if(!buffer_alloc(&entry->headers.buffer, rec.headerslen + 1) || !cache_readall(fd, entry->headers.buffer.start, rec.headerslen))
+      goto fail;
+
+    entry->headers.buffer.write += rec.headerslen;
+    *entry->headers.buffer.write = '\0';
+    headers_invalidate(&entry->headers);
+  }
+
+  if(rec.bodylen && (!block_alloc(&entry->body, rec.bodylen) || !cache_readall(fd, entry->body.start, rec.bodylen)))
+    goto fail;
+
+  entry->hash = cache_hash(entry->key);
+  close(fd);
+  return entry;
+
+fail:
+  if(entry)
+    cache_entry_free(entry);
+
+  close(fd);
+  return 0;
+}
+
+static void
+cache_unlink(Cache* cache, CacheEntry* entry) {
+  if(entry->linked) {
+    list_del(&entry->link);
+    init_list_head(&entry->link);
+    entry->linked = FALSE;
+    cache->bytes -= cache_entry_size(entry);
+    cache_entry_free(entry);
+  }
+}
+
+/* Inserts at the front, evicting the least recently used entries from memory */
+static void
+cache_link(Cache* cache, CacheEntry* entry) {
+  size_t size = cache_entry_size(entry);
+
+  /* too large for memory, it may still be on disk */
+  if(size > cache->max_bytes)
+    return;
+
+  while(cache->bytes + size > cache->max_bytes && !list_empty(&cache->entries))
+    cache_unlink(cache, list_entry(cache->entries.prev, CacheEntry, link));
+
+  list_add(&entry->link, &cache->entries);
+  entry->linked = TRUE;
+  cache->bytes += size;
+  cache_entry_dup(entry);
+}
+
+/**
+ * \defgroup cache cache
+ *
+ * Private HTTP response cache (RFC 9111) for the client
+ * @{
+ */
+void
+cache_init(Cache* cache, size_t max_bytes, const char* dir) {
+  init_list_head(&cache->entries);
+  cache->bytes = 0;
+  cache->max_bytes = max_bytes ? max_bytes : CACHE_MAX_SIZE;
+  cache->dir = dir ? strdup(dir) : 0;
+  cache->hits = cache->misses = cache->stale = cache->revalidated = cache->stores = 0;
+
+  if(cache->dir && mkdir(cache->dir, 0755) == -1 && errno != EEXIST)
+    lwsl_warn("cache: cannot create '%s': %s\n", cache->dir, strerror(errno));
+}
+
+/* Drops the memory tier, the on-disk tier is kept */
+void
+cache_clear(Cache* cache) {
+  while(!list_empty(&cache->entries))
+    cache_unlink(cache, list_entry(cache->entries.next, CacheEntry, link));
+
+  if(cache->dir) {
+    free(cache->dir);
+    cache->dir = 0;
+  }
+}
+
+CacheEntry*
+cache_entry_dup(CacheEntry* entry) {
+  ++entry->ref_count;
+  return entry;
+}
+
+void
+cache_entry_free(CacheEntry* entry) {
+  if(--entry->ref_count == 0) {
+    free(entry->key);
+    free(entry->vary);
+    free(entry->selected);
+    free(entry->status_text);
+    headers_free(&entry->headers);
+    block_free(&entry->body);
+    free(entry);
+  }
+}
+
+/**
+ * Finds the stored response for a request, in memory first, then on disk.
+ *
+ * @return a new reference or 0
+ */
+CacheEntry*
+cache_lookup(Cache* cache, const char* method, const char* url, Headers* request) {
+  struct list_head* el;
+  CacheEntry* entry;
+  uint32_t hash;
+  char* key;
+
+  if(!(key = cache_key(method, url)))
+    return 0;
+
+  hash = cache_hash(key);
+
+  list_for_each(el, &cache->entries) {
+    entry = list_entry(el, CacheEntry, link);
+
+    if(cache_matches(entry, hash, key, request)) {
+      /* most recently used first */
+      list_del(&entry->link);
+      list_add(&entry->link, &cache->entries);
+      free(key);
+      return cache_entry_dup(entry);
+    }
+  }
+
+  if((entry = cache_load(cache, key, request))) {
+    if(cache_matches(entry, hash, key, request)) {
+      cache_link(cache, entry);
+      free(key);
+      return entry;
+    }
+
+    cache_entry_free(entry);
+  }
+
+  free(key);
+  cache->misses++;
+  return 0;
+}
+
+BOOL
+cache_fresh(const CacheEntry* entry, time_t now) {
+  return now < entry->expires;
+}
+
+/* Whether a response may be stored: a cacheable status, no no-store and
+ * either an explicit lifetime or a validator to revalidate it with */
+BOOL
+cache_storable(Headers* response, int status) {
+  CacheControl cc;
+  const char* vary;
+  size_t len;
+
+  switch(status) {
+    case 200:
+    case 203:
+    case 204:
+    case 300:
+    case 301:
+    case 404:
+    case 410: break;
+    default: return FALSE;
+  }
+
+  cc = cache_control(response);
+
+  if(cc.no_store)
+    return FALSE;
+
+  if((vary = headers_getlen(response, &len, "vary", "\r\n", ":")) && byte_chr(vary, len, '*') < len)
+    return FALSE;
+
+  return cc.max_age >= 0 || headers_find(response, "expires", "\r\n") >= 0 || headers_find(response, "etag", "\r\n") >= 0 ||
+         headers_find(response, "last-modified", "\r\n") >= 0;
+}
+
+/* A request that neither uses nor fills the cache */
+BOOL
+cache_bypass(Headers* request) {
+  return cache_control(request).no_store;
+}
+
+/**
+ * Makes a request conditional on the stored response.
+ *
+ * @return the number of validators added
+ */
+int
+cache_validators(const CacheEntry* entry, Headers* request) {
+  Headers* h = (Headers*)&entry->headers;
+  const char* value;
+  size_t len;
+  int n = 0;
+
+  if((value = headers_getlen(h, &len, "etag", "\r\n", ":"))) {
+    headers_unsetb(request, "if-none-match", 13, "\r\n");
+    if(headers_add(request, "If-None-Match", 13, value, len, "\r\n", HEADERS_TOKEN_UNKNOWN) >= 0)
+      ++n;
+  }
+
+  if((value = headers_getlen(h, &len, "last-modified", "\r\n", ":"))) {
+    headers_unsetb(request, "if-modified-since", 17, "\r\n");
+    if(headers_add(request, "If-Modified-Since", 17, value, len, "\r\n", HEADERS_TOKEN_UNKNOWN) >= 0)
+      ++n;
+  }
+
+  return n;
+}
+
+/**
+ * Stores a complete response, replacing the one with the same key and
+ * selecting headers.
+ *
+ * @return the entry (a new reference) or 0 if it could not be stored
+ */
+CacheEntry*
+cache_store(Cache* cache, const char* method, const char* url, Headers* request, int status, const char* status_text, Headers* response, const void* body, size_t len) {
+  struct list_head *el, *next;
+  CacheEntry* entry;
+  time_t now = time(0);
+
+  if(!(entry = cache_entry_new()))
+    return 0;
+
+  entry->key = cache_key(method, url);
+  entry->vary = cache_header(response, "vary");
+  entry->selected = cache_select(entry->vary, request);
+  entry->status = status;
+  entry->status_text = status_text ? strdup(status_text) : 0;
+  entry->stored = now;
+  entry->expires = cache_expires(response, now);
+
+  if(!entry->key || (entry->vary && !entry->selected) || !headers_clone(&entry->headers, response) || (len && !block_alloc(&entry->body, len))) {
+    cache_entry_free(entry);
+    return 0;
+  }
+
+  headers_detach(&entry->headers, FALSE);
+
+  if(len)
+    memcpy(entry->body.start, body, len);
+
+  entry->hash = cache_hash(entry->key);
+
+  list_for_each_safe(el, next, &cache->entries) {
+    CacheEntry* other = list_entry(el, CacheEntry, link);
+
+    if(other->hash == entry->hash && !strcmp(other->key, entry->key) &&
+       (other->selected == entry->selected || (other->selected && entry->selected && !strcmp(other->selected, entry->selected))))
+      cache_unlink(cache, other);
+  }
+
+  cache_link(cache, entry);
+  cache_save(cache, entry);
+  cache->stores++;
+
+  return entry;
+}
+
+/* Updates a stored response from the 304 that revalidated it */
+void
+cache_refresh(Cache* cache, CacheEntry* entry, Headers* response) {
+  size_t size = cache_entry_size(entry);
+  time_t now = time(0);
+
+  for(size_t i = 0; i < countof(cache_updated); i++) {
+    size_t namelen = strlen(cache_updated[i]), len;
+    const char* value;
+
+    if((value = headers_getlen(response, &len, cache_updated[i], "\r\n", ":"))) {
+      headers_unsetb(&entry->headers, cache_updated[i], namelen, "\r\n");
+      headers_add(&entry->headers, cache_updated[i], namelen, value, len, "\r\n", HEADERS_TOKEN_UNKNOWN);
+    }
+  }
+
+  if(entry->linked)
+    cache->bytes += cache_entry_size(entry) - size;
+
+  entry->stored = now;
+  entry->expires = cache_expires(&entry->headers, now);
+  cache->revalidated++;
+
+  cache_save(cache, entry);
+}
+
+/* Drops every stored response for 'url' after an unsafe request to it */
+void
+cache_invalidate(Cache* cache, const char* url) {
+  struct list_head *el, *next;
+
+  list_for_each_safe(el, next, &cache->entries) {
+    CacheEntry* entry = list_entry(el, CacheEntry, link);
+    const char* target = entry->key + byte_chr(entry->key, strlen(entry->key), ' ') + 1;
+
+    if(!strcmp(target, url))
+      cache_unlink(cache, entry);
+  }
+
+  if(cache->dir) {
+    static const char* const methods[] = {"GET", "HEAD"};
+
+    for(size_t i = 0; i < countof(methods); i++) {
+      char *key, *path;
+
+      if(!(key = cache_key(methods[i], url)))
+        continue;
+
+      if((path = cache_path(cache, key, 0, 0, "")))
+        unlink(path);
+      free(path);
+
+      /* the variants go with their index */
+      if((path = cache_path(cache, key, 0, 0, ".vary")))
+        unlink(path);
+      free(path);
+
+      free(key);
+    }
+  }
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,56 @@
+/**
+ * @file cache.h
+ */
+#ifndef QJSNET_LIB_CACHE_H
+#define QJSNET_LIB_CACHE_H
+
+#include <list.h>
+#include <time.h>
+#include "buffer.h"
+#include "headers.h"
+
+#define CACHE_MAX_SIZE (16 * 1024 * 1024)
+
+/* A stored response.  Entries are reference counted, a request revalidating
+ * one keeps it alive while it is evicted */
+typedef struct cache_entry {
+  int ref_count;
+  struct list_head link; /* most recently used first */
+  uint32_t hash;         /* of 'key' */
+  char* key;             /* "METHOD url" */
+  char* vary;            /* Vary response header, 0 when there was none */
+  char* selected;        /* "name: value\n" for each request header named by 'vary' */
+  int status;
+  char* status_text;
+  Headers headers;
+  ByteBlock body;
+  time_t stored, expires; /* expires == stored: must be revalidated before use */
+  BOOL linked;
+} CacheEntry;
+
+typedef struct cache {
+  struct list_head entries;
+  size_t bytes, max_bytes;
+  char* dir; /* on-disk tier, 0 for memory only */
+  uint64_t hits, misses, stale, revalidated, stores; /* stale: found, but had to be revalidated or fetched again */
+} Cache;
+
+void cache_init(Cache*, size_t max_bytes, const char* dir);
+void cache_clear(Cache*);
+CacheEntry* cache_entry_dup(CacheEntry*);
+void cache_entry_free(CacheEntry*);
+CacheEntry* cache_lookup(Cache*, const char* method, const char* url, Headers* request);
+BOOL cache_fresh(const CacheEntry*, time_t now);
+BOOL cache_storable(Headers* response, int status);
+BOOL cache_bypass(Headers* request);
+int cache_validators(const CacheEntry*, Headers* request);
+CacheEntry* cache_store(Cache*, const char* method, const char* url, Headers* request, int status, const char* status_text, Headers* response, const void* body, size_t len);
+void cache_refresh(Cache*, CacheEntry*, Headers* response);
+void cache_invalidate(Cache*, const char* url);
+
+static inline size_t
+cache_entry_size(const CacheEntry* entry) {
+  return block_SIZE(&entry->body) + buffer_HEAD(&entry->headers.buffer);
+}
+
+#endif /* QJSNET_LIB_CACHE_H */
@@ -0,0 +1,297 @@
+/**
+ * @file compress.c
+ */
+#include "compress.h"
+#include "utils.h"
+#include <ctype.h>
+#include <strings.h>
+#include <zlib.h>
+#if defined(LWS_WITH_HTTP_BROTLI)
+#include <brotli/encode.h>
+#endif
+
+const char* const compress_names[COMPRESS_COUNT] = {
+    "br",
+    "gzip",
+    "deflate",
+};
+
+/* Formats that do not get smaller */
+static const char* const compressed_types[] = {
+    "image/",
+    "audio/",
+    "video/",
+    "font/woff",
+    "application/zip",
+    "application/gzip",
+    "application/x-gzip",
+    "application/x-bzip2",
+    "application/x-xz",
+    "application/x-7z-compressed",
+    "application/x-rar-compressed",
+    "application/zstd",
+    "application/pdf",
+};
+
+static const char* const compressible_images[] = {
+    "image/svg+xml",
+    "image/bmp",
+    "image/x-icon",
+    "image/vnd.microsoft.icon",
+};
+
+static BOOL
+token_equal(const char* s, size_t n, const char* token) {
+  return strlen(token) == n && !strncasecmp(s, token, n);
+}
+
+static BOOL
+token_prefix(const char* s, size_t n, const char* prefix) {
+  size_t len = strlen(prefix);
+
+  return len <= n && !strncasecmp(s, prefix, len);
+}
+
+static size_t
+trim(const char* s, size_t n, size_t* startp) {
+  size_t start = 0;
+
+  while(start < n && isspace(s[start]))
+    ++start;
+
+  while(n > start && isspace(s[n - 1]))
+    --n;
+
+  *startp = start;
+  return n - start;
+}
+
+/* Parses the q parameter of an Accept-Encoding entry, in thousandths */
+static int
+parse_q(const char* s, size_t n) {
+  size_t i = 0, start, len;
+  int q = 0, scale = 1000;
+
+  while(i < n) {
+    size_t end = i + byte_chr(&s[i], n - i, ';');
+
+    len = trim(&s[i], end - i, &start);
+
+    if(len > 2 && (s[i + start] == 'q' || s[i + start] == 'Q') && s[i + start + 1] == '=') {
+      const char* x = &s[i + start + 2];
+      size_t k;
+
+      len -= 2;
+
+      for(k = 0; k < len && x[k] != '.'; k++)
+        if(isdigit(x[k]))
+          q = q * 10 + (x[k] - '0');
+
+      q *= 1000;
+
+      for(++k; k < len && scale > 1; k++) {
+        if(isdigit(x[k])) {
+          scale /= 10;
+          q += (x[k] - '0') * scale;
+        }
+      }
+
+      return q > 1000 ? 1000 : q;
+    }
+
+    i = end + 1;
+  }
+
+  return 1000;
+}
+
+/**
+ * \defgroup compress compress
+ *
+ * Response compression
+ * @{
+ */
+void
+compress_options_init(CompressOptions* opts) {
+  opts->enabled = TRUE;
+  opts->min_size = COMPRESS_MIN_SIZE;
+  opts->level = -1;
+  opts->types = 0;
+}
+
+void
+compress_options_clear(CompressOptions* opts, JSContext* ctx) {
+  if(opts->types) {
+    for(char** t = opts->types; *t; t++)
+      js_free(ctx, *t);
+
+    js_free(ctx, opts->types);
+    opts->types = 0;
+  }
+}
+
+/**
+ * Picks an encoding from an Accept-Encoding header.  The highest q-value
+ * wins, ties go to br, then gzip, then deflate.
+ *
+ * @param streaming  only encodings libwebsockets can apply on the fly
+ *
+ * @return the encoding or COMPRESS_NONE
+ */
+CompressEncoding
+compress_negotiate(const char* accept, size_t len, BOOL streaming) {
+  int q[COMPRESS_COUNT] = {-1, -1, -1}, star = -1, best_q = 0;
+  CompressEncoding best = COMPRESS_NONE;
+  size_t pos = 0;
+
+  while(pos < len) {
+    size_t end = pos + byte_chr(&accept[pos], len - pos, ',');
+    size_t namelen = byte_chr(&accept[pos], end - pos, ';'), start;
+    int value;
+
+    namelen = trim(&accept[pos], namelen, &start);
+    value = parse_q(&accept[pos + start + namelen], end - (pos + start + namelen));
+
+    if(token_equal(&accept[pos + start], namelen, "*"))
+      star = value;
+    else if(token_equal(&accept[pos + start], namelen, "x-gzip"))
+      q[COMPRESS_GZIP] = value;
+    else
+      for(int i = 0; i < COMPRESS_COUNT; i++)
+        if(token_equal(&accept[pos + start], namelen, compress_names[i]))
+          q[i] = value;
+
+    pos = end + 1;
+  }
+
+  for(int i = 0; i < COMPRESS_COUNT; i++) {
+    int value = q[i] >= 0 ? q[i] : star;
+
+#if !defined(LWS_WITH_HTTP_BROTLI)
+    if(i == COMPRESS_BR)
+      continue;
+#endif
+
+    /* libwebsockets has stream compressors for br and deflate only */
+    if(streaming && i == COMPRESS_GZIP)
+      continue;
+
+    if(value > best_q) {
+      best = i;
+      best_q = value;
+    }
+  }
+
+  return best;
+}
+
+/**
+ * Checks a Content-Type against the allowlist, or against the list of
+ * already compressed formats when there is none.
+ */
+BOOL
+compress_type(const CompressOptions* opts, const char* type, size_t len) {
+  size_t start;
+
+  if(!type)
+    return opts->types == 0;
+
+  len = trim(type, byte_chr(type, len, ';'), &start);
+  type += start;
+
+  if(opts->types) {
+    for(char** t = opts->types; *t; t++) {
+      size_t n = strlen(*t);
+
+      if(n >= 2 && !strcmp(&(*t)[n - 2], "/*")) {
+        if(n - 1 <= len && !strncasecmp(type, *t, n - 1))
+          return TRUE;
+      } else if(token_equal(type, len, *t)) {
+        return TRUE;
+      }
+    }
+
+    return FALSE;
+  }
+
+  for(size_t i = 0; i < countof(compressible_images); i++)
+    if(token_equal(type, len, compressible_images[i]))
+      return TRUE;
+
+  for(size_t i = 0; i < countof(compressed_types); i++)
+    if(token_prefix(type, len, compressed_types[i]))
+      return FALSE;
+
+  return TRUE;
+}
+
+/**
+ * Compresses a complete body.
+ *
+ * @return TRUE on success, 'out' then holds the encoded data
+ */
+BOOL
+compress_block(CompressEncoding enc, int level, const void* data, size_t len, ByteBlock* out) {
+  switch(enc) {
+#if defined(LWS_WITH_HTTP_BROTLI)
+    case COMPRESS_BR: {
+      size_t n = BrotliEncoderMaxCompressedSize(len);
+      int quality = level < 0 ? COMPRESS_BROTLI_QUALITY : MIN(level, BROTLI_MAX_QUALITY);
+
+      if(!n || !block_alloc(out, n))
+        return FALSE;
+
+      if(!BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC, len, data, &n, out->start)) {
+        block_free(out);
+        return FALSE;
+      }
+
+      out->end = out->start + n;
+      return TRUE;
+    }
+#endif
+
+    case COMPRESS_GZIP:
+    case COMPRESS_DEFLATE: {
+      z_stream zs;
+      int ret;
+
+      memset(&zs, 0, sizeof(zs));
+
+      /* gzip wrapper for gzip, zlib wrapper for deflate (RFC 9110 8.4.1.2) */
+      if(deflateInit2(&zs, level < 0 ? Z_DEFAULT_COMPRESSION : MIN(level, 9), Z_DEFLATED, enc == COMPRESS_GZIP ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return FALSE;
+
+      if(!block_alloc(out, deflateBound(&zs, len))) {
+        deflateEnd(&zs);
+        return FALSE;
+      }
+
+      zs.next_in = (Bytef*)data;
+      zs.avail_in = len;
+      zs.next_out = out->start;
+      zs.avail_out = block_SIZE(out);
+
+      ret = deflate(&zs, Z_FINISH);
+      deflateEnd(&zs);
+
+      if(ret != Z_STREAM_END) {
+        block_free(out);
+        return FALSE;
+      }
+
+      out->end = out->start + zs.total_out;
+      return TRUE;
+    }
+
+    default: {
+      break;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+ * @}
+ */
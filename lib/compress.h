@@ -0,0 +1,39 @@
+/**
+ * @file compress.h
+ */
+#ifndef QJSNET_LIB_COMPRESS_H
+#define QJSNET_LIB_COMPRESS_H
+
+#include <quickjs.h>
+#include <libwebsockets.h>
+#include "buffer.h"
+
+/* In order of preference */
+typedef enum {
+  COMPRESS_NONE = -1,
+  COMPRESS_BR = 0,
+  COMPRESS_GZIP,
+  COMPRESS_DEFLATE,
+  COMPRESS_COUNT,
+} CompressEncoding;
+
+#define COMPRESS_MIN_SIZE 1024
+#define COMPRESS_BROTLI_QUALITY 5
+
+/* Response compression settings of a server */
+typedef struct compress_options {
+  BOOL enabled;
+  uint32_t min_size; /* smaller bodies are sent as they are */
+  int level;         /* 1-9 (1-11 for brotli), -1 for the default */
+  char** types;      /* content types to compress, "text/\*" matches a prefix; 0 for all but compressed formats */
+} CompressOptions;
+
+extern const char* const compress_names[COMPRESS_COUNT];
+
+void compress_options_init(CompressOptions*);
+void compress_options_clear(CompressOptions*, JSContext* ctx);
+CompressEncoding compress_negotiate(const char* accept, size_t len, BOOL streaming);
+BOOL compress_type(const CompressOptions*, const char* type, size_t len);
+BOOL compress_block(CompressEncoding, int level, const void* data, size_t len, ByteBlock* out);
+
+#endif /* QJSNET_LIB_COMPRESS_H */
@@ -0,0 +1,530 @@
+/**
+ * @file dns.c
+ */
+#define _GNU_SOURCE
+#include "dns.h"
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_CNAME 5
+#define DNS_TYPE_SOA 6
+#define DNS_CLASS_IN 1
+
+#define DNS_FLAG_QR 0x8000
+#define DNS_FLAG_TC 0x0200
+#define DNS_FLAG_RD 0x0100
+#define DNS_RCODE_NXDOMAIN 3
+
+static inline uint16_t
+get16(const uint8_t* p) {
+  return (p[0] << 8) | p[1];
+}
+
+static inline uint32_t
+get32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/* FNV-1a over the lowercased name */
+static uint32_t
+dns_hash(const char* name) {
+  uint32_t h = 2166136261u;
+
+  while(*name) {
+    h ^= (uint8_t)tolower(*name++);
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+/* Length of 'name' without a trailing dot */
+static size_t
+dns_namelen(const char* name) {
+  size_t len = strlen(name);
+
+  return len > 0 && name[len - 1] == '.' ? len - 1 : len;
+}
+
+/* Offset after the (possibly compressed) name at 'pos', -1 when it runs past 'len' */
+static int
+dns_skip_name(const uint8_t* buf, size_t len, size_t pos) {
+  while(pos < len) {
+    uint8_t c = buf[pos];
+
+    if(c == 0)
+      return pos + 1;
+
+    if((c & 0xc0) == 0xc0)
+      return pos + 2 <= len ? (int)(pos + 2) : -1;
+
+    if(c & 0xc0)
+      return -1;
+
+    pos += 1 + c;
+  }
+
+  return -1;
+}
+
+/* Compares the name at 'pos' to 'name', following compression pointers */
+static BOOL
+dns_name_equal(const uint8_t* buf, size_t len, size_t pos, const char* name) {
+  size_t i = 0, n = dns_namelen(name);
+  int jumps = 0;
+
+  while(pos < len) {
+    uint8_t c = buf[pos];
+
+    if(c == 0)
+      return i == n;
+
+    if((c & 0xc0) == 0xc0) {
+      if(pos + 2 > len || ++jumps > 16)
+        return FALSE;
+
+      pos = ((c & 0x3f) << 8) | buf[pos + 1];
+      continue;
+    }
+
+    if(c & 0xc0 || pos + 1 + c > len)
+      return FALSE;
+
+    if(i > 0) {
+      if(i >= n || name[i] != '.')
+        return FALSE;
+      ++i;
+    }
+
+    if(i + c > n || strncasecmp(name + i, (const char*)&buf[pos + 1], c))
+      return FALSE;
+
+    i += c;
+    pos += 1 + c;
+  }
+
+  return FALSE;
+}
+
+/* Decodes the name at 'pos' into 'out' without the trailing dot, "" for the root */
+static BOOL
+dns_name_read(const uint8_t* buf, size_t len, size_t pos, char* out, size_t size) {
+  size_t i = 0;
+  int jumps = 0;
+
+  while(pos < len) {
+    uint8_t c = buf[pos];
+
+    if(c == 0) {
+      out[i] = '\0';
+      return TRUE;
+    }
+
+    if((c & 0xc0) == 0xc0) {
+      if(pos + 2 > len || ++jumps > 16)
+        return FALSE;
+
+      pos = ((c & 0x3f) << 8) | buf[pos + 1];
+      continue;
+    }
+
+    if(c & 0xc0 || pos + 1 + c > len || i + (i > 0) + c >= size)
+      return FALSE;
+
+    if(i > 0)
+      out[i++] = '.';
+
+    memcpy(&out[i], &buf[pos + 1], c);
+    i += c;
+    pos += 1 + c;
+  }
+
+  return FALSE;
+}
+
+/* TRUE when 'zone' is 'name' or one of its parent domains */
+static BOOL
+dns_name_within(const char* name, const char* zone) {
+  size_t n = dns_namelen(name), z = dns_namelen(zone);
+
+  if(z == 0)
+    return TRUE;
+
+  if(z > n || strncasecmp(name + n - z, zone, z))
+    return FALSE;
+
+  return z == n || name[n - z - 1] == '.';
+}
+
+static void
+dns_entry_free(DnsEntry* entry) {
+  free(entry->name);
+  free(entry);
+}
+
+/**
+ * \defgroup dns dns
+ *
+ * Host name resolution over UDP with a TTL cache
+ * @{
+ */
+void
+dns_cache_init(DnsCache* cache, size_t max_entries) {
+  memset(cache, 0, sizeof(DnsCache));
+  init_list_head(&cache->entries);
+  cache->max_entries = max_entries ? max_entries : DNS_MAX_ENTRIES;
+  cache->max_ttl = 86400;
+  cache->negative_ttl = DNS_NEGATIVE_TTL;
+}
+
+void
+dns_cache_clear(DnsCache* cache) {
+  struct list_head *el, *next;
+
+  list_for_each_safe(el, next, &cache->entries) {
+    DnsEntry* entry = list_entry(el, DnsEntry, link);
+
+    list_del(&entry->link);
+    dns_entry_free(entry);
+  }
+
+  cache->count = 0;
+}
+
+/**
+ * Looks up a name.  Expired entries are dropped on the way.
+ *
+ * @return the entry, which has no addresses for a cached failure, or 0
+ */
+DnsEntry*
+dns_cache_find(DnsCache* cache, const char* name, time_t now) {
+  struct list_head* el;
+  uint32_t hash = dns_hash(name);
+
+  list_for_each(el, &cache->entries) {
+    DnsEntry* entry = list_entry(el, DnsEntry, link);
+
+    if(entry->hash != hash || strcasecmp(entry->name, name))
+      continue;
+
+    list_del(&entry->link);
+
+    if(entry->expires <= now) {
+      dns_entry_free(entry);
+      cache->count--;
+      cache->expired++;
+      break;
+    }
+
+    list_add(&entry->link, &cache->entries);
+    cache->hits++;
+    return entry;
+  }
+
+  cache->misses++;
+  return 0;
+}
+
+/**
+ * Picks the next address of an entry, round robin.
+ *
+ * @return FALSE for a cached failure
+ */
+BOOL
+dns_cache_next(DnsEntry* entry, struct in_addr* addr) {
+  if(!entry->count)
+    return FALSE;
+
+  *addr = entry->addrs[entry->next % entry->count];
+  entry->next = (entry->next + 1) % entry->count;
+  return TRUE;
+}
+
+/**
+ * Stores the addresses of a name, or a failure when 'count' is 0.  The TTL
+ * is clamped to the cache limits, a failure without one is kept for
+ * 'negative_ttl'.
+ *
+ * @return the entry, 0 when the TTL does not allow caching
+ */
+DnsEntry*
+dns_cache_store(DnsCache* cache, const char* name, const struct in_addr* addrs, size_t count, uint32_t ttl, time_t now) {
+  struct list_head* el;
+  DnsEntry* entry = 0;
+  uint32_t hash = dns_hash(name);
+
+  if(count) {
+    ttl = MAX(ttl, cache->min_ttl);
+    ttl = MIN(ttl, cache->max_ttl);
+  } else {
+    ttl = ttl ? MIN(ttl, cache->negative_ttl) : cache->negative_ttl;
+  }
+
+  list_for_each(el, &cache->entries) {
+    DnsEntry* e = list_entry(el, DnsEntry, link);
+
+    if(e->hash == hash && !strcasecmp(e->name, name)) {
+      entry = e;
+      list_del(&entry->link);
+      cache->count--;
+      break;
+    }
+  }
+
+  if(!ttl) {
+    if(entry)
+      dns_entry_free(entry);
+    return 0;
+  }
+
+  if(!entry) {
+    if(!(entry = calloc(1, sizeof(DnsEntry))))
+      return 0;
+
+    if(!(entry->name = strdup(name))) {
+      free(entry);
+      return 0;
+    }
+
+    entry->hash = hash;
+  }
+
+  entry->count = MIN(count, DNS_MAX_ADDRS);
+  entry->next = 0;
+  entry->expires = now + ttl;
+
+  if(entry->count)
+    memcpy(entry->addrs, addrs, entry->count * sizeof(struct in_addr));
+
+  while(cache->count >= cache->max_entries && !list_empty(&cache->entries)) {
+    DnsEntry* last = list_entry(cache->entries.prev, DnsEntry, link);
+
+    list_del(&last->link);
+    dns_entry_free(last);
+    cache->count--;
+  }
+
+  list_add(&entry->link, &cache->entries);
+  cache->count++;
+  return entry;
+}
+
+/**
+ * Encodes a recursive query for the A records of 'name'.
+ *
+ * @return length of the query, -1 when the name is invalid or 'size' too small
+ */
+int
+dns_query_build(uint8_t* buf, size_t size, uint16_t id, const char* name) {
+  size_t pos = 12, n = dns_namelen(name);
+  const char* end = name + n;
+
+  if(n == 0 || n > 253 || size < 12 + n + 2 + 4)
+    return -1;
+
+  memset(buf, 0, 12);
+  buf[0] = id >> 8;
+  buf[1] = id & 0xff;
+  buf[2] = DNS_FLAG_RD >> 8;
+  buf[5] = 1; /* QDCOUNT */
+
+  while(name < end) {
+    size_t label = byte_chr(name, end - name, '.');
+
+    if(label == 0 || label > 63)
+      return -1;
+
+    buf[pos++] = label;
+    memcpy(&buf[pos], name, label);
+    pos += label;
+    name += label + 1;
+  }
+
+  buf[pos++] = 0;
+  buf[pos++] = 0;
+  buf[pos++] = DNS_TYPE_A;
+  buf[pos++] = 0;
+  buf[pos++] = DNS_CLASS_IN;
+
+  return pos;
+}
+
+/**
+ * Decodes the answer to a query built by dns_query_build().  Only records
+ * owned by the query name are taken, CNAME chains are followed from there
+ * in any order, the TTL is the smallest one on the way.  For a name without
+ * addresses the TTL comes from the SOA record of a zone enclosing it
+ * (RFC 2308), 0 when there is none.
+ *
+ * @return number of addresses, 0 when the name has none, -1 when 'buf' is
+ *         not the answer to this query, -2 for a failed query
+ */
+int
+dns_answer_parse(const uint8_t* buf, size_t len, uint16_t id, const char* name, struct in_addr* addrs, size_t max, uint32_t* ttl) {
+  uint16_t flags, qdcount, ancount, nscount;
+  size_t count = 0;
+  uint32_t min_ttl = UINT32_MAX, chain_ttl = UINT32_MAX;
+  char target[256], owner[256];
+  int pos, answers, hops = 0;
+  BOOL restart;
+
+  if(len < 12 || get16(buf) != id)
+    return -1;
+
+  flags = get16(&buf[2]);
+  qdcount = get16(&buf[4]);
+  ancount = get16(&buf[6]);
+  nscount = get16(&buf[8]);
+
+  if(!(flags & DNS_FLAG_QR) || qdcount != 1 || !dns_name_equal(buf, len, 12, name))
+    return -1;
+
+  /* truncated answers would need TCP */
+  if(flags & DNS_FLAG_TC)
+    return -2;
+
+  if((flags & 0xf) != 0 && (flags & 0xf) != DNS_RCODE_NXDOMAIN)
+    return -2;
+
+  if((answers = dns_skip_name(buf, len, 12)) == -1 || (answers += 4) > (int)len)
+    return -2;
+
+  if(!dns_name_read(buf, len, 12, target, sizeof(target)))
+    return -2;
+
+  /* the addresses of the end of the chain, rescanned when a CNAME moves it */
+  do {
+    restart = FALSE;
+    count = 0;
+    min_ttl = chain_ttl;
+    pos = answers;
+
+    for(uint32_t i = 0; i < (uint32_t)ancount + nscount; i++) {
+      uint16_t type, class, rdlen;
+      uint32_t rrttl;
+      int start = pos;
+
+      if((pos = dns_skip_name(buf, len, pos)) == -1 || pos + 10 > (int)len)
+        return -2;
+
+      type = get16(&buf[pos]);
+      class = get16(&buf[pos + 2]);
+      rrttl = get32(&buf[pos + 4]);
+      rdlen = get16(&buf[pos + 8]);
+      pos += 10;
+
+      if(pos + rdlen > (int)len)
+        return -2;
+
+      if(class == DNS_CLASS_IN) {
+        if(i < ancount) {
+          /* records for other names are not part of the answer */
+          if(dns_name_equal(buf, len, start, target)) {
+            if(type == DNS_TYPE_A && rdlen == 4) {
+              if(count < max)
+                memcpy(&addrs[count++], &buf[pos], 4);
+
+              min_ttl = MIN(min_ttl, rrttl);
+            } else if(type == DNS_TYPE_CNAME) {
+              if(++hops > 16 || !dns_name_read(buf, len, pos, target, sizeof(target)))
+                return -2;
+
+              chain_ttl = MIN(chain_ttl, rrttl);
+              restart = TRUE;
+              break;
+            }
+          }
+        } else if(type == DNS_TYPE_SOA && !count && rdlen >= 20) {
+          /* the MINIMUM field ends the SOA record */
+          if(dns_name_read(buf, len, start, owner, sizeof(owner)) && dns_name_within(target, owner))
+            min_ttl = MIN(min_ttl, MIN(rrttl, get32(&buf[pos + rdlen - 4])));
+        }
+      }
+
+      pos += rdlen;
+    }
+  } while(restart);
+
+  *ttl = min_ttl == UINT32_MAX ? 0 : min_ttl;
+  return count;
+}
+
+/**
+ * Looks up a name in a hosts(5) file, IPv4 addresses only.
+ */
+BOOL
+dns_hosts_lookup(const char* path, const char* name, struct in_addr* addr) {
+  char line[1024];
+  BOOL found = FALSE;
+  FILE* fp;
+
+  if(!(fp = fopen(path, "r")))
+    return FALSE;
+
+  while(!found && fgets(line, sizeof(line), fp)) {
+    char *s, *save = 0, *token;
+    struct in_addr a;
+
+    if((s = strchr(line, '#')))
+      *s = '\0';
+
+    if(!(token = strtok_r(line, " \t\r\n", &save)) || inet_pton(AF_INET, token, &a) != 1)
+      continue;
+
+    while((token = strtok_r(0, " \t\r\n", &save))) {
+      if(!strcasecmp(token, name)) {
+        *addr = a;
+        found = TRUE;
+        break;
+      }
+    }
+  }
+
+  fclose(fp);
+  return found;
+}
+
+/**
+ * Reads the first IPv4 nameserver from a resolv.conf(5) file.
+ */
+BOOL
+dns_nameserver(const char* path, struct in_addr* addr) {
+  char line[256];
+  BOOL found = FALSE;
+  FILE* fp;
+
+  if(!(fp = fopen(path, "r")))
+    return FALSE;
+
+  while(!found && fgets(line, sizeof(line), fp)) {
+    char *save = 0, *token;
+
+    if(!(token = strtok_r(line, " \t\r\n", &save)) || strcmp(token, "nameserver"))
+      continue;
+
+    if((token = strtok_r(0, " \t\r\n", &save)) && inet_pton(AF_INET, token, addr) == 1)
+      found = TRUE;
+  }
+
+  fclose(fp);
+  return found;
+}
+
+/**
+ * Checks whether a host is an address rather than a name.
+ */
+BOOL
+dns_literal(const char* name) {
+  struct in_addr a;
+
+  return strchr(name, ':') != 0 || inet_pton(AF_INET, name, &a) == 1;
+}
+
+/**
+ * @}
+ */
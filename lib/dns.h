@@ -0,0 +1,47 @@
+/**
+ * @file dns.h
+ */
+#ifndef QJSNET_LIB_DNS_H
+#define QJSNET_LIB_DNS_H
+
+#include <list.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <time.h>
+#include "utils.h"
+
+#define DNS_PORT 53
+#define DNS_MAX_ADDRS 8
+#define DNS_MAX_ENTRIES 256
+#define DNS_PACKET_SIZE 512
+#define DNS_NEGATIVE_TTL 30
+
+/* Addresses of a host name.  An entry without addresses is a cached failure */
+typedef struct dns_entry {
+  struct list_head link; /* most recently used first */
+  uint32_t hash;
+  char* name;
+  struct in_addr addrs[DNS_MAX_ADDRS];
+  uint8_t count, next; /* 'next' rotates through 'addrs' */
+  time_t expires;
+} DnsEntry;
+
+typedef struct dns_cache {
+  struct list_head entries;
+  size_t count, max_entries;
+  uint32_t min_ttl, max_ttl, negative_ttl;
+  uint64_t hits, misses, queries, failures, expired;
+} DnsCache;
+
+void dns_cache_init(DnsCache*, size_t max_entries);
+void dns_cache_clear(DnsCache*);
+DnsEntry* dns_cache_find(DnsCache*, const char* name, time_t now);
+BOOL dns_cache_next(DnsEntry*, struct in_addr* addr);
+DnsEntry* dns_cache_store(DnsCache*, const char* name, const struct in_addr* addrs, size_t count, uint32_t ttl, time_t now);
+int dns_query_build(uint8_t* buf, size_t size, uint16_t id, const char* name);
+int dns_answer_parse(const uint8_t* buf, size_t len, uint16_t id, const char* name, struct in_addr* addrs, size_t max, uint32_t* ttl);
+BOOL dns_hosts_lookup(const char* path, const char* name, struct in_addr* addr);
+BOOL dns_nameserver(const char* path, struct in_addr* addr);
+BOOL dns_literal(const char* name);
+
+#endif /* QJSNET_LIB_DNS_H */
@@ -5,6 +5,164 @@
 #include "js-utils.h"
 #include "utils.h"
 #include "ws.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool
+sink_flush(FormSink* sink) {
+  size_t pos = 0;
+
+  while(pos < sink->buflen) {
+    ssize_t r = write(sink->fd, sink->buf + pos, sink->buflen - pos);
+
+    if(r < 0) {
+      if(errno == EINTR)
+        continue;
+
+      sink->error = errno;
+      return false;
+    }
+
+    pos += r;
+  }
+
+  sink->buflen = 0;
+  return true;
+}
+
+static bool
+sink_open(FormSink* sink) {
+  size_t dirlen = strlen(sink->directory);
+
+  free(sink->path);
+
+  if(!(sink->path = malloc(dirlen + sizeof("/upload-XXXXXX"))))
+    return false;
+
+  memcpy(sink->path, sink->directory, dirlen);
+  strcpy(&sink->path[dirlen], "/upload-XXXXXX");
+
+  if(!sink->buf && !(sink->buf = malloc(sink->buffer_size)))
+    return false;
+
+  /* never derive the name from the client supplied filename */
+  if((sink->fd = mkstemp(sink->path)) == -1) {
+    sink->error = errno;
+    return false;
+  }
+
+  sink->size = 0;
+  sink->buflen = 0;
+  sink->error = 0;
+  sink->digest[0] = '\0';
+
+  /* a part whose hash fails to initialize has no digest, the next one tries again */
+  sink->hashing = sink->hash_type >= 0 && !lws_genhash_init(&sink->hash, sink->hash_type);
+
+  return true;
+}
+
+static int
+sink_write(FormSink* sink, const void* data, size_t len) {
+  if(sink->error)
+    return -1;
+
+  if(sink->max_size && sink->size + len > sink->max_size) {
+    sink->error = EFBIG;
+    return -1;
+  }
+
+  if(sink->hashing)
+    lws_genhash_update(&sink->hash, data, len);
+
+  sink->size += len;
+
+  if(sink->buflen + len > sink->buffer_size && !sink_flush(sink))
+    return -1;
+
+  /* chunks as large as the buffer bypass it */
+  if(len >= sink->buffer_size) {
+    while(len > 0) {
+      ssize_t r = write(sink->fd, data, len);
+
+      if(r < 0) {
+        if(errno == EINTR)
+          continue;
+
+        sink->error = errno;
+        return -1;
+      }
+
+      data = (const uint8_t*)data + r;
+      len -= r;
+    }
+
+    return 0;
+  }
+
+  memcpy(sink->buf + sink->buflen, data, len);
+  sink->buflen += len;
+  return 0;
+}
+
+/* Closes the current file, it is removed unless it was received completely */
+static void
+sink_close(FormSink* sink, bool complete) {
+  if(sink->fd == -1)
+    return;
+
+  if(!sink->error)
+    sink_flush(sink);
+
+  close(sink->fd);
+  sink->fd = -1;
+
+  if(sink->hashing) {
+    uint8_t digest[LWS_GENHASH_LARGEST];
+
+    if(sink->error || !complete) {
+      lws_genhash_destroy(&sink->hash, 0);
+    } else if(!lws_genhash_destroy(&sink->hash, digest)) {
+      static const char hexdigits[] = "0123456789abcdef";
+      size_t i, n = lws_genhash_size(sink->hash_type);
+
+      for(i = 0; i < n; i++) {
+        sink->digest[i * 2] = hexdigits[digest[i] >> 4];
+        sink->digest[i * 2 + 1] = hexdigits[digest[i] & 0xf];
+      }
+
+      sink->digest[n * 2] = '\0';
+    }
+
+    sink->hashing = false;
+  }
+
+  if(sink->error || !complete) {
+    unlink(sink->path);
+    free(sink->path);
+    sink->path = 0;
+  }
+}
+
+static JSValue
+sink_object(FormParser* fp, JSContext* ctx) {
+  FormSink* sink = &fp->sink;
+  JSValue obj = JS_NewObject(ctx);
+
+  JS_SetPropertyStr(ctx, obj, "name", JS_DupValue(ctx, fp->name));
+  JS_SetPropertyStr(ctx, obj, "filename", JS_DupValue(ctx, fp->file));
+  JS_SetPropertyStr(ctx, obj, "path", sink->path ? JS_NewString(ctx, sink->path) : JS_NULL);
+  JS_SetPropertyStr(ctx, obj, "size", JS_NewInt64(ctx, sink->size));
+  JS_SetPropertyStr(ctx, obj, "digest", sink->digest[0] ? JS_NewString(ctx, sink->digest) : JS_NULL);
+
+  if(sink->error)
+    JS_SetPropertyStr(ctx, obj, "error", JS_NewString(ctx, strerror(sink->error)));
+
+  return obj;
+}
 
 static int
 formparser_callback(void* data, const char* name, const char* filename, char* buf, int len, enum lws_spa_fileupload_states state) {
@@ -15,6 +173,16 @@ formparser_callback(void* data, const char* name, const char* filename, char* bu
   switch(state) {
     case LWS_UFS_CONTENT:
     case LWS_UFS_FINAL_CONTENT: {
+      if(fp->sink.fd != -1 || fp->sink.error) {
+        if(fp->sink.error || (len > 0 && sink_write(&fp->sink, buf, len) == -1)) {
+          /* drop the partial file right away, the parser stops here */
+          sink_close(&fp->sink, false);
+          return -1;
+        }
+
+        break;
+      }
+
       cb = &fp->cb.content;
 
       if(cb->ctx)
@@ -27,6 +195,18 @@ formparser_callback(void* data, const char* name, const char* filename, char* bu
     case LWS_UFS_OPEN: {
       cb = &fp->cb.open;
 
+      if(fp->sink.fd != -1) {
+        sink_close(&fp->sink, true);
+
+        if(fp->cb.close.ctx) {
+          args[1] = sink_object(fp, fp->cb.close.ctx);
+          JSValue ret = callback_emit(&fp->cb.close, 2, args);
+          JS_FreeValue(fp->cb.close.ctx, ret);
+          JS_FreeValue(fp->cb.close.ctx, args[1]);
+          args[1] = JS_NULL;
+        }
+      }
+
       if(cb->ctx) {
         if(!JS_IsUndefined(fp->file)) {
           if(fp->cb.close.ctx) {
@@ -53,18 +233,28 @@ formparser_callback(void* data, const char* name, const char* filename, char* bu
           fp->name = JS_NewString(cb->ctx, name);
       }
 
+      if(filename && fp->sink.directory && !sink_open(&fp->sink))
+        return -1;
+
       break;
     }
 
     case LWS_UFS_CLOSE: {
       cb = &fp->cb.close;
 
-      if(cb->ctx) {
+      if(fp->sink.fd != -1 || fp->sink.error) {
+        sink_close(&fp->sink, true);
+
+        if(cb->ctx)
+          args[1] = sink_object(fp, cb->ctx);
+      } else if(cb->ctx) {
         // args[0] = JS_DupValue(cb->ctx, fp->name);
 
         if(!JS_IsUndefined(fp->file))
           args[1] = JS_DupValue(cb->ctx, fp->file);
+      }
 
+      if(cb->ctx) {
         JS_FreeValue(cb->ctx, fp->file);
         fp->file = JS_UNDEFINED;
       }
@@ -117,6 +307,8 @@ formparser_alloc(JSContext* ctx) {
 
   ret = js_mallocz(ctx, sizeof(FormParser));
   ret->ref_count = 1;
+  ret->sink.fd = -1;
+  ret->sink.hash_type = -1;
   return ret;
 }
 
@@ -135,6 +327,15 @@ formparser_clear(FormParser* fp, JSRuntime* rt) {
   FREECB_RT(fp->cb.content);
   FREECB_RT(fp->cb.open);
   FREECB_RT(fp->cb.close);
+
+  /* a part still open here was not received completely */
+  sink_close(&fp->sink, false);
+  free(fp->sink.path);
+  free(fp->sink.buf);
+  free(fp->sink.directory);
+  memset(&fp->sink, 0, sizeof(FormSink));
+  fp->sink.fd = -1;
+  fp->sink.hash_type = -1;
 }
 
 void
@@ -192,3 +393,14 @@ formparser_process(FormParser* fp, const void* data, size_t len) {
 
   return retval;
 }
+
+bool
+formparser_sink(FormParser* fp, const char* directory, uint64_t max_size, int hash_type, size_t buffer_size) {
+  if(!(fp->sink.directory = strdup(directory)))
+    return false;
+
+  fp->sink.max_size = max_size;
+  fp->sink.hash_type = hash_type;
+  fp->sink.buffer_size = buffer_size ? buffer_size : FORMPARSER_WRITE_BUFFER;
+  return true;
+}
@@ -6,8 +6,27 @@
 
 #include <libwebsockets.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "callback.h"
 
+#define FORMPARSER_WRITE_BUFFER 65536
+
+/* File parts written to disk from C instead of passing the content to JS */
+typedef struct form_sink {
+  char* directory; /* 0 when file parts go to the content callback */
+  uint64_t max_size;
+  int hash_type; /* LWS_GENHASH_TYPE_*, -1 for none */
+  bool hashing;  /* the digest of the current part is being computed */
+  size_t buffer_size;
+  int fd, error;
+  char* path;
+  uint64_t size;
+  uint8_t* buf;
+  size_t buflen;
+  struct lws_genhash_ctx hash;
+  char digest[LWS_GENHASH_LARGEST * 2 + 1];
+} FormSink;
+
 typedef struct form_parser {
   int ref_count;
   struct lws_spa_create_info spa_create_info;
@@ -20,6 +39,7 @@ typedef struct form_parser {
   JSValue exception;
   JSValue name, file;
   size_t read;
+  FormSink sink;
 } FormParser;
 
 void formparser_init(FormParser*, struct socket* ws, int nparams, const char* const* param_names, size_t chunk_size);
@@ -32,5 +52,6 @@ size_t formparser_param_count(FormParser*);
 int formparser_param_index(FormParser*, const char* name);
 bool formparser_param_exists(FormParser*, const char* name);
 int formparser_process(FormParser*, const void* data, size_t len);
+bool formparser_sink(FormParser*, const char* directory, uint64_t max_size, int hash_type, size_t buffer_size);
 
 #endif /* QJSNET_LIB_FORM_PARSER_H */
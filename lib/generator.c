@@ -63,6 +63,7 @@ enqueue_block(Generator* gen, ByteBlock blk, JSValueConst callback) {
       if(ret > gen->chunk_size) {
         size_t pos = 0, end;
         item->block = block_slice(&blk, pos, pos + gen->chunk_size);
+        item->capacity = 0;
 
         pos += gen->chunk_size;
 
@@ -276,6 +277,9 @@ generator_next(Generator* gen, JSValueConst arg) {
 
   int n = gen->q ? generator_update(gen) : 0;
 
+  if(gen->drain_fn)
+    gen->drain_fn(gen, gen->drain_opaque);
+
   if(n == 0) {
     if(gen->closing || gen->closed) {
       if(asynciterator_stop(&gen->iterator, JS_UNDEFINED, gen->ctx)) {
@@ -29,6 +29,8 @@ typedef struct generator {
   uint32_t chunk_size;
   BOOL started, buffering;
   JSValue (*block_fn)(ByteBlock*, JSContext*);
+  void (*drain_fn)(struct generator*, void*); /* called when next() has consumed queued data */
+  void* drain_opaque;
 } Generator;
 
 void generator_free(Generator*);
@@ -3,6 +3,7 @@
  */
 #include "utils.h"
 #include "headers.h"
+#include "lws-utils.h"
 #include <libwebsockets.h>
 #include <strings.h>
 
@@ -30,37 +31,362 @@ headers_object(JSContext* ctx, const void* start, const void* e) {
   return ret;
 }
 
+#define HEADERS_MINSLOTS 16
+
+/* FNV-1a over the lowercased name */
+uint32_t
+headers_hash(const char* name, size_t namelen) {
+  uint32_t h = 2166136261u;
+
+  for(size_t i = 0; i < namelen; i++) {
+    h ^= (uint8_t)tolower((unsigned char)name[i]);
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+static BOOL
+headers_reserve(Headers* h, uint32_t n) {
+  if(n > h->capacity) {
+    uint32_t capacity = h->capacity ? h->capacity : 8;
+    HeaderEntry* entries;
+
+    while(capacity < n)
+      capacity <<= 1;
+
+    if(!(entries = realloc(h->entries, capacity * sizeof(HeaderEntry))))
+      return FALSE;
+
+    h->entries = entries;
+    h->capacity = capacity;
+  }
+
+  return TRUE;
+}
+
+static void
+headers_slot_insert(Headers* h, uint32_t index) {
+  uint32_t mask = h->nslots - 1, i = h->entries[index].hash & mask;
+
+  while(h->slots[i] != -1)
+    i = (i + 1) & mask;
+
+  h->slots[i] = index;
+}
+
+static BOOL
+headers_rehash(Headers* h) {
+  uint32_t i, nslots = HEADERS_MINSLOTS;
+
+  while(nslots < h->count * 2)
+    nslots <<= 1;
+
+  if(nslots != h->nslots) {
+    int32_t* slots;
+
+    if(!(slots = realloc(h->slots, nslots * sizeof(int32_t))))
+      return FALSE;
+
+    h->slots = slots;
+    h->nslots = nslots;
+  }
+
+  memset(h->slots, 0xff, nslots * sizeof(int32_t));
+
+  for(i = 0; i < h->count; i++)
+    headers_slot_insert(h, i);
+
+  return TRUE;
+}
+
+/* Adds the index entry for the line of length 'len' at 'offset' */
+static ssize_t
+headers_scan(Headers* h, size_t offset, size_t len, int32_t token) {
+  const char* x = (const char*)h->buffer.start + offset;
+  size_t n, v;
+  HeaderEntry* e;
+
+  /* HTTP/2 pseudo-headers start with a colon */
+  n = (len && x[0] == ':') ? 1 + byte_chr(x + 1, len - 1, ':') : byte_chr(x, len, ':');
+
+  if(n == 0 || n >= len)
+    return -1;
+
+  if(!headers_reserve(h, h->count + 1))
+    return -1;
+
+  for(v = n + 1; v < len && (x[v] == ' ' || x[v] == '\t'); v++) {}
+
+  while(len > v && (x[len - 1] == '\r' || x[len - 1] == '\n'))
+    len--;
+
+  e = &h->entries[h->count];
+  e->offset = offset;
+  e->namelen = n;
+  e->value = offset + v;
+  e->valuelen = len - v;
+  e->hash = headers_hash(x, n);
+  e->token = token;
+
+  return h->count++;
+}
+
+/* Rebuilds the index after the buffer was written to directly */
+static void
+headers_update(Headers* h) {
+  const uint8_t *base, *x, *end;
+
+  if(!h->stale)
+    return;
+
+  h->count = 0;
+  h->stale = FALSE;
+
+  for(base = x = h->buffer.start, end = h->buffer.write; x < end;) {
+    size_t len = byte_chr(x, end - x, '\n');
+
+    headers_scan(h, x - base, len, -1);
+    x += len < (size_t)(end - x) ? len + 1 : len;
+  }
+
+  headers_rehash(h);
+}
+
+static THREAD_LOCAL uint32_t token_hashes[WSI_TOKEN_COUNT];
+static THREAD_LOCAL uint8_t token_namelens[WSI_TOKEN_COUNT];
+
+static size_t
+headers_tokenname(int tok, const char** nameptr) {
+  const char* name;
+
+  if(tok < WSI_TOKEN_HOST || tok == WSI_TOKEN_HTTP || tok == WSI_TOKEN_HTTP_URI_ARGS)
+    return 0;
+
+  if(!(name = (const char*)lws_token_to_string(tok)))
+    return 0;
+
+  *nameptr = name;
+  return 1 + byte_chr(name + 1, strlen(name + 1), ':');
+}
+
+/* Maps a header name to its lws token index */
+static int32_t
+headers_tokenof(const char* name, size_t namelen) {
+  uint32_t hash = headers_hash(name, namelen);
+  const char* str;
+  int tok;
+
+  if(!token_namelens[WSI_TOKEN_HOST])
+    for(tok = WSI_TOKEN_HOST; tok < WSI_TOKEN_COUNT; tok++)
+      if((token_namelens[tok] = headers_tokenname(tok, &str)))
+        token_hashes[tok] = headers_hash(str, token_namelens[tok]);
+
+  for(tok = WSI_TOKEN_HOST; tok < WSI_TOKEN_COUNT; tok++)
+    if(token_hashes[tok] == hash && token_namelens[tok] == namelen)
+      if(!strncasecmp((const char*)lws_token_to_string(tok), name, namelen))
+        return tok;
+
+  return -1;
+}
+
+/* Copies a header from the lws header table, at most once per token */
+static ssize_t
+headers_fetch(Headers* h, int32_t tok) {
+  const char* name;
+  size_t namelen;
+  int len;
+
+  if(!h->wsi || tok < 0 || tok >= WSI_TOKEN_COUNT || (h->fetched[tok >> 3] & (1 << (tok & 7))))
+    return -1;
+
+  h->fetched[tok >> 3] |= 1 << (tok & 7);
+
+  if(!(namelen = headers_tokenname(tok, &name)))
+    return -1;
+
+  if((len = lws_hdr_total_length(h->wsi, tok)) > 0) {
+    char hdr[len + 1];
+
+    if(lws_hdr_copy(h->wsi, hdr, len + 1, tok) < 0)
+      return -1;
+
+    if(headers_add(h, name, namelen, hdr, len, "\n", tok) > 0)
+      return h->count - 1;
+  }
+
+  return -1;
+}
+
+static void
+headers_fetchall(Headers* h) {
+  int tok;
+
+  if(h->wsi)
+    for(tok = WSI_TOKEN_HOST; tok < WSI_TOKEN_COUNT; tok++)
+      headers_fetch(h, tok);
+}
+
+/* Brings the index up to date, pulling every header not yet copied from lws */
+void
+headers_index(Headers* h) {
+  headers_update(h);
+  headers_fetchall(h);
+}
+
+void
+headers_attach(Headers* h, struct lws* wsi) {
+  h->wsi = wsi;
+  memset(h->fetched, 0, sizeof(h->fetched));
+}
+
+/* Called before the lws header table goes away. With 'copy' set the headers
+ * not looked up so far are copied, for requests that are still referenced */
+void
+headers_detach(Headers* h, BOOL copy) {
+  if(copy)
+    headers_fetchall(h);
+
+  h->wsi = 0;
+}
+
+/* Removes 'size' bytes of entry 'index' and shifts the offsets behind it */
+static void
+headers_remove(Headers* h, uint32_t index, size_t size) {
+  ByteBuffer* b = &h->buffer;
+  uint8_t *x = b->start + h->entries[index].offset, *y = x + size;
+  uint32_t i;
+
+  if(b->write > y)
+    memmove(x, y, b->write - y);
+  b->write -= size;
+
+  if(b->write < b->end)
+    memset(b->write, 0, b->end - b->write);
+
+  for(i = index + 1; i < h->count; i++) {
+    h->entries[i].offset -= size;
+    h->entries[i].value -= size;
+  }
+
+  if(index + 1 < h->count)
+    memmove(&h->entries[index], &h->entries[index + 1], (h->count - index - 1) * sizeof(HeaderEntry));
+
+  h->count--;
+}
+
+/* Length of the line of entry 'e' including its line delimiter */
+static size_t
+headers_linelen(Headers* h, const HeaderEntry* e) {
+  const uint8_t *x = h->buffer.start + e->value + e->valuelen, *end = h->buffer.write;
+
+  if(x < end && *x == '\r')
+    ++x;
+  if(x < end && *x == '\n')
+    ++x;
+
+  return x - (h->buffer.start + e->offset);
+}
+
+ssize_t
+headers_add(Headers* h, const char* name, size_t namelen, const char* value, size_t valuelen, const char* itemdelim, int32_t token) {
+  ByteBuffer* b = &h->buffer;
+  size_t offset, delimlen = strlen(itemdelim), n = namelen + 2 + valuelen + delimlen;
+  HeaderEntry* e;
+
+  headers_update(h);
+
+  if(!headers_reserve(h, h->count + 1))
+    return -1;
+
+  /* grow geometrically, buffer_append() would reallocate for every header */
+  if((size_t)buffer_AVAIL(b) < n + 1) {
+    size_t size = buffer_SIZE(b) * 2;
+
+    if(size < buffer_HEAD(b) + n + 1)
+      size = buffer_HEAD(b) + n + 1;
+    if(size < 256)
+      size = 256;
+
+    if(!buffer_realloc(b, size))
+      return -1;
+  }
+
+  offset = buffer_HEAD(b);
+
+  buffer_write(b, name, namelen);
+  buffer_write(b, ": ", 2);
+  buffer_write(b, value, valuelen);
+  buffer_write(b, itemdelim, delimlen);
+  *b->write = '\0';
+
+  e = &h->entries[h->count];
+  e->offset = offset;
+  e->namelen = namelen;
+  e->value = offset + namelen + 2;
+  e->valuelen = valuelen;
+  e->hash = headers_hash(name, namelen);
+  e->token = token;
+
+  if(++h->count * 2 > h->nslots)
+    headers_rehash(h);
+  else
+    headers_slot_insert(h, h->count - 1);
+
+  return n;
+}
+
+/* lws token of an entry, looked up once for headers that were added by name */
+int32_t
+headers_entry_token(Headers* h, HeaderEntry* e) {
+  if(e->token == HEADERS_TOKEN_UNKNOWN) {
+    int32_t tok = headers_tokenof(headers_entry_name(h, e), e->namelen);
+
+    e->token = tok >= 0 ? tok : HEADERS_TOKEN_NONE;
+  }
+
+  return e->token;
+}
+
+/* Adds one header to the lws output straight from the stored slices */
+int
+headers_emit(Headers* h, HeaderEntry* e, struct lws* wsi, uint8_t** in, uint8_t* end) {
+  const uint8_t* value = (const uint8_t*)headers_entry_value(h, e);
+  int32_t tok;
+
+  if((tok = headers_entry_token(h, e)) >= 0)
+    return lws_add_http_header_by_token(wsi, tok, value, e->valuelen, in, end);
+
+  char name[e->namelen + 2];
+  const char* x = headers_entry_name(h, e);
+  BOOL lower = wsi_http2(wsi);
+
+  /* h2 wants lowercase names, h1 expects the colon to be part of the name */
+  for(uint32_t i = 0; i < e->namelen; i++)
+    name[i] = lower ? tolower((unsigned char)x[i]) : x[i];
+
+  name[e->namelen] = ':';
+  name[e->namelen + 1] = '\0';
+
+  return lws_add_http_header_by_name(wsi, (const uint8_t*)name, value, e->valuelen, in, end);
+}
+
 size_t
-headers_write(ByteBuffer* buffer, struct lws* wsi, uint8_t** in, uint8_t* end) {
-  int ret;
-  uint8_t *p = buffer->read, *q = buffer->write, *start = *in;
-
-  while(p < q) {
-    size_t next = scan_nextline(p, q - p);
-    size_t m, namelen = byte_chr(p, next, ':');
-    uint8_t* name = p;
-
-    m = namelen + 1;
-    while(p[m] && p[m] == ' ')
-      ++m;
-    p += m;
-    next -= m;
-
-    uint8_t tmp = name[namelen + 1];
-    name[namelen + 1] = '\0';
-    ret = lws_add_http_header_by_name(wsi, name, p, scan_eol(p, next), in, end);
-    name[namelen + 1] = tmp;
-    p += next;
-
-    if(ret)
+headers_write(Headers* h, struct lws* wsi, uint8_t** in, uint8_t* end) {
+  uint8_t* start = *in;
+  uint32_t i;
+
+  headers_index(h);
+
+  for(i = 0; i < h->count; i++)
+    if(headers_emit(h, &h->entries[i], wsi, in, end))
       break;
-  }
 
   return *in - start;
 }
 
 int
-headers_fromobj(ByteBuffer* buffer, JSValueConst obj, const char* itemdelim, const char* keydelim, JSContext* ctx) {
+headers_fromobj(Headers* h, JSValueConst obj, const char* itemdelim, const char* keydelim, JSContext* ctx) {
   JSPropertyEnum* tab;
   uint32_t tab_len, i;
 
@@ -76,207 +402,235 @@ headers_fromobj(ByteBuffer* buffer, JSValueConst obj, const char* itemdelim, con
     JS_FreeValue(ctx, jsval);
 
     prop = JS_AtomToCString(ctx, tab[i].atom);
-    prop_len = strlen(prop);
+    prop_len = prop ? strlen(prop) : 0;
 
-    buffer_grow(buffer, prop_len + 2 + value_len + 2);
-
-    buffer_write(buffer, prop, prop_len);
-    buffer_write(buffer, keydelim, strlen(keydelim));
-    buffer_write(buffer, value, value_len);
-    buffer_write(buffer, itemdelim, strlen(itemdelim));
+    if(prop && value)
+      headers_add(h, prop, prop_len, value, value_len, itemdelim, -1);
 
     JS_FreeCString(ctx, prop);
     JS_FreeCString(ctx, value);
   }
 
+  for(i = 0; i < tab_len; i++)
+    JS_FreeAtom(ctx, tab[i].atom);
   js_free(ctx, tab);
   return i;
 }
 
 ssize_t
-headers_findb(ByteBuffer* b, const char* name, size_t namelen, const char* itemdelim) {
-  uint8_t *y, *x;
-  ssize_t ret = 0;
+headers_findb(Headers* h, const char* name, size_t namelen, const char* itemdelim) {
+  uint32_t mask, i, hash;
+
+  headers_update(h);
 
-  for(x = b->start; x < b->write;) {
-    size_t c = headers_next(x, b->write, itemdelim);
+  if(h->wsi)
+    headers_fetch(h, headers_tokenof(name, namelen));
 
-    size_t n = headers_namelen(x, (y = x + c));
+  if(!h->count || !h->nslots)
+    return -1;
 
-    // printf("%s %.*s\n", __func__, (int)c, (char*)x);
+  hash = headers_hash(name, namelen);
+  mask = h->nslots - 1;
 
-    if(n == namelen)
-      if(!strncasecmp((const char*)x, name, namelen))
-        return ret;
+  for(i = hash & mask; h->slots[i] != -1; i = (i + 1) & mask) {
+    HeaderEntry* e = &h->entries[h->slots[i]];
 
-    x += c;
-    ++ret;
+    if(e->hash == hash && e->namelen == namelen && !strncasecmp(headers_entry_name(h, e), name, namelen))
+      return h->slots[i];
   }
 
   return -1;
 }
 
+ssize_t
+headers_findtoken(Headers* h, enum lws_token_indexes tok) {
+  const char* name;
+  uint32_t i;
+
+  headers_update(h);
+  headers_fetch(h, tok);
+
+  for(i = 0; i < h->count; i++)
+    if(h->entries[i].token == (int32_t)tok)
+      return i;
+
+  /* not recorded from lws, look it up by name */
+  if((name = (const char*)lws_token_to_string(tok)))
+    return headers_findb(h, name, 1 + byte_chr(name + 1, strlen(name + 1), ':'), "\n");
+
+  return -1;
+}
+
 char*
-headers_at(ByteBuffer* b, size_t* lenptr, size_t index, const char* itemdelim) {
-  uint8_t* x;
-  size_t i = 0;
+headers_at(Headers* h, size_t* lenptr, size_t index, const char* itemdelim) {
+  HeaderEntry* e;
 
-  for(x = b->start; x < b->write;) {
-    size_t c = headers_next(x, b->write, itemdelim);
+  if(!(e = headers_entry(h, index)))
+    return 0;
 
-    if(i == index) {
-      if(lenptr)
-        *lenptr = headers_length(x, x + c, itemdelim);
-      return (char*)x;
-    }
-    x += c;
-    ++i;
-  }
+  if(lenptr)
+    *lenptr = e->value + e->valuelen - e->offset;
 
-  return 0;
+  return (char*)headers_entry_name(h, e);
 }
 
 char*
-headers_getlen(ByteBuffer* b, size_t* lenptr, const char* name, const char* itemdelim, const char* keydelim) {
+headers_getlen(Headers* h, size_t* lenptr, const char* name, const char* itemdelim, const char* keydelim) {
   ssize_t i;
 
-  if((i = headers_find(b, name, itemdelim)) != -1) {
-    size_t l, n;
-    char* x = headers_at(b, &l, i, itemdelim);
-    n = headers_value(x, b->write, keydelim);
-    x += n;
-    l -= n;
+  if((i = headers_find(h, name, itemdelim)) != -1) {
+    HeaderEntry* e = &h->entries[i];
+
     if(lenptr)
-      *lenptr = l;
-    return x;
+      *lenptr = e->valuelen;
+
+    return (char*)headers_entry_value(h, e);
   }
 
   return 0;
 }
 
 char*
-headers_get(ByteBuffer* buffer, const char* name, const char* itemdelim, const char* keydelim, JSContext* ctx) {
+headers_get(Headers* h, const char* name, const char* itemdelim, const char* keydelim, JSContext* ctx) {
   size_t len;
   char* str;
 
-  if((str = headers_getlen(buffer, &len, name, itemdelim, keydelim)))
+  if((str = headers_getlen(h, &len, name, itemdelim, keydelim)))
     return js_strndup(ctx, str, len);
   return 0;
 }
 
 ssize_t
-headers_find(ByteBuffer* buffer, const char* name, const char* itemdelim) {
-  return headers_findb(buffer, name, strlen(name), itemdelim);
+headers_find(Headers* h, const char* name, const char* itemdelim) {
+  return headers_findb(h, name, strlen(name), itemdelim);
 }
 
+/* Copies every header from lws right away */
 int
-headers_tobuffer(JSContext* ctx, ByteBuffer* headers, struct lws* wsi) {
-  int tok, len, count = 0;
-
-  if(!headers->start)
-    buffer_alloc(headers, 1024);
-
-  for(tok = WSI_TOKEN_HOST; tok < WSI_TOKEN_COUNT; tok++) {
-    if(tok == WSI_TOKEN_HTTP || tok == WSI_TOKEN_HTTP_URI_ARGS)
-      continue;
+headers_tobuffer(JSContext* ctx, Headers* headers, struct lws* wsi) {
+  uint32_t count;
 
-    if((len = lws_hdr_total_length(wsi, tok)) > 0) {
-      char hdr[len + 1];
-      const char* name;
+  headers_update(headers);
+  count = headers->count;
 
-      if((name = (const char*)lws_token_to_string(tok))) {
-        int namelen = 1 + byte_chr(name + 1, strlen(name + 1), ':');
-        lws_hdr_copy(wsi, hdr, len + 1, tok);
-        hdr[len] = '\0';
+  headers_attach(headers, wsi);
+  headers_detach(headers, TRUE);
 
-        // printf("headers %i %.*s '%s'\n", tok, namelen, name, hdr);
-
-        if(!headers->alloc)
-          buffer_alloc(headers, 1024);
-
-        while(!buffer_printf(headers, "%.*s: %s\n", namelen, name, hdr)) {
-          buffer_grow(headers, 1024);
-        }
-        ++count;
-      }
-    }
-  }
-
-  return count;
+  return headers->count - count;
 }
 
 ssize_t
-headers_unsetb(ByteBuffer* b, const char* name, size_t namelen, const char* itemdelim) {
-  ssize_t i;
+headers_unsetb(Headers* h, const char* name, size_t namelen, const char* itemdelim) {
+  ssize_t i, ret;
 
-  if((i = headers_findb(b, name, namelen, itemdelim)) >= 0) {
-    uint8_t *y, *x = b->start + i;
-    size_t c = headers_next(x, b->write, itemdelim);
-    y = x + c;
-    if(b->write > y)
-      memcpy(x, y, b->write - y);
-    b->write -= c;
+  /* remove every occurrence, the entries behind it keep their order */
+  for(ret = i = headers_findb(h, name, namelen, itemdelim); i >= 0; i = headers_findb(h, name, namelen, itemdelim)) {
+    headers_remove(h, i, headers_linelen(h, &h->entries[i]));
 
-    if(b->write < b->end)
-      memset(b->write, 0, b->end - b->write);
+    if(!headers_rehash(h))
+      break;
   }
 
-  return i;
+  return ret;
 }
 
 ssize_t
-headers_set(ByteBuffer* b, const char* name, const char* value, const char* itemdelim) {
+headers_set(Headers* h, const char* name, const char* value, const char* itemdelim) {
   size_t namelen = strlen(name), valuelen = strlen(value);
-  size_t c = namelen + 2 + valuelen + 2;
+  ssize_t i;
 
-  if(buffer_SIZE(b))
-    headers_unsetb(b, name, namelen, itemdelim);
+  /* same length value: overwrite in place, index stays valid */
+  if((i = headers_findb(h, name, namelen, itemdelim)) >= 0 && h->entries[i].valuelen == valuelen) {
+    memcpy(h->buffer.start + h->entries[i].value, value, valuelen);
+    return namelen + 2 + valuelen + strlen(itemdelim);
+  }
 
-  buffer_grow(b, c);
-  buffer_write(b, name, namelen);
-  buffer_write(b, ": ", 2);
-  buffer_write(b, value, valuelen);
-  buffer_write(b, itemdelim, strlen(itemdelim));
+  if(i >= 0)
+    headers_unsetb(h, name, namelen, itemdelim);
 
-  return c;
+  return headers_add(h, name, namelen, value, valuelen, itemdelim, -1);
 }
 
 ssize_t
-headers_appendb(ByteBuffer* b, const char* name, size_t namelen, const char* value, size_t valuelen, const char* itemdelim) {
+headers_appendb(Headers* h, const char* name, size_t namelen, const char* value, size_t valuelen, const char* itemdelim) {
+  ByteBuffer* b = &h->buffer;
   ssize_t i;
+  uint32_t j;
+
+  if((i = headers_findb(h, name, namelen, itemdelim)) >= 0) {
+    HeaderEntry* e = &h->entries[i];
+    size_t n = valuelen + 2, pos = e->value + e->valuelen;
+    uint8_t* x;
 
-  buffer_grow(b, valuelen + 2);
+    if((size_t)buffer_AVAIL(b) < n + 1)
+      if(!buffer_realloc(b, buffer_HEAD(b) + n + 1))
+        return -1;
 
-  if((i = headers_findb(b, name, namelen, itemdelim)) >= 0) {
-    uint8_t *y, *x = buffer_BEGIN(b) + i;
-    size_t len = headers_next(x, b->write, itemdelim);
+    x = b->start + pos;
+    memmove(x + n, x, b->write - x);
+    memcpy(x, ", ", 2);
+    memcpy(x + 2, value, valuelen);
+    b->write += n;
+    *b->write = '\0';
 
-    y = x + len;
+    e->valuelen += n;
 
-    if((b->write - y) > 0 && valuelen > 0) {
-      memmove(y + 2 + valuelen, y, b->write - y);
+    for(j = i + 1; j < h->count; j++) {
+      h->entries[j].offset += n;
+      h->entries[j].value += n;
     }
-    memcpy(y, ", ", 2);
+  }
 
-    if(valuelen > 0)
-      memcpy(y + 2, value, valuelen);
+  return i;
+}
 
-    b->write += valuelen + 2;
+size_t
+headers_size(Headers* h, const char* itemdelim) {
+  headers_index(h);
+  return h->count;
+}
 
-    if(b->write < b->end)
-      memset(b->write, 0, b->end - b->write);
+BOOL
+headers_clone(Headers* h, Headers* other) {
+  headers_zero(h);
+  headers_index(other);
+
+  if(!other->buffer.start)
+    return TRUE;
+
+  if(!buffer_clone(&h->buffer, &other->buffer) || !headers_reserve(h, other->count)) {
+    headers_free(h);
+    return FALSE;
   }
 
-  return i;
+  if(other->count)
+    memcpy(h->entries, other->entries, other->count * sizeof(HeaderEntry));
+
+  h->count = other->count;
+  h->stale = other->stale;
+
+  return h->stale || headers_rehash(h);
 }
 
-size_t
-headers_size(ByteBuffer* headers, const char* itemdelim) {
-  uint8_t *ptr, *end = headers->write;
-  size_t i = 0;
+void
+headers_reset(Headers* h) {
+  buffer_reset(&h->buffer);
+  h->count = 0;
+  h->stale = FALSE;
+  h->wsi = 0;
 
-  for(ptr = headers->start; ptr != end; ptr += headers_next(ptr, end, itemdelim))
-    ++i;
+  if(h->slots)
+    memset(h->slots, 0xff, h->nslots * sizeof(int32_t));
+}
 
-  return i;
+void
+headers_free(Headers* h) {
+  buffer_free(&h->buffer);
+
+  if(h->entries)
+    free(h->entries);
+  if(h->slots)
+    free(h->slots);
+
+  headers_zero(h);
 }
@@ -9,19 +9,82 @@
 #include "buffer.h"
 #include "utils.h"
 
+/* One "name: value" line of the serialized header buffer */
+typedef struct header_entry {
+  uint32_t offset, namelen;
+  uint32_t value, valuelen;
+  uint32_t hash; /* hash of the lowercased name */
+  int32_t token; /* lws token index, HEADERS_TOKEN_UNKNOWN or HEADERS_TOKEN_NONE */
+} HeaderEntry;
+
+#define HEADERS_TOKEN_UNKNOWN -1
+#define HEADERS_TOKEN_NONE -2
+
+/* Serialized "name: value\r\n" text plus an offset/length table and an
+ * open-addressing hash table over it, so that lookups do not rescan the text.
+ * While 'wsi' is set, known headers are copied from its header table on first
+ * lookup */
+typedef struct http_headers {
+  ByteBuffer buffer;
+  HeaderEntry* entries;
+  uint32_t count, capacity;
+  int32_t* slots;
+  uint32_t nslots;
+  BOOL stale;
+  struct lws* wsi;
+  uint8_t fetched[(WSI_TOKEN_COUNT + 7) / 8];
+} Headers;
+
 JSValue headers_object(JSContext*, const void* start, const void* e);
-size_t headers_write(ByteBuffer* buffer, struct lws* wsi, uint8_t**, uint8_t* end);
-int headers_fromobj(ByteBuffer*, JSValueConst obj, const char* itemdelim, const char* keydelim, JSContext* ctx);
-ssize_t headers_findb(ByteBuffer*, const char* name, size_t namelen, const char* itemdelim);
-char* headers_at(ByteBuffer*, size_t* lenptr, size_t index, const char* itemdelim);
-char* headers_getlen(ByteBuffer*, size_t* lenptr, const char* name, const char* itemdelim, const char* keydelim);
-char* headers_get(ByteBuffer*, const char* name, const char* itemdelim, const char* keydelim, JSContext* ctx);
-ssize_t headers_find(ByteBuffer*, const char* name, const char* itemdelim);
-int headers_tobuffer(JSContext*, ByteBuffer* headers, struct lws* wsi);
+size_t headers_write(Headers*, struct lws* wsi, uint8_t**, uint8_t* end);
+int headers_emit(Headers*, HeaderEntry*, struct lws* wsi, uint8_t**, uint8_t* end);
+int32_t headers_entry_token(Headers*, HeaderEntry*);
+int headers_fromobj(Headers*, JSValueConst obj, const char* itemdelim, const char* keydelim, JSContext* ctx);
+ssize_t headers_findb(Headers*, const char* name, size_t namelen, const char* itemdelim);
+ssize_t headers_findtoken(Headers*, enum lws_token_indexes tok);
+char* headers_at(Headers*, size_t* lenptr, size_t index, const char* itemdelim);
+char* headers_getlen(Headers*, size_t* lenptr, const char* name, const char* itemdelim, const char* keydelim);
+char* headers_get(Headers*, const char* name, const char* itemdelim, const char* keydelim, JSContext* ctx);
+ssize_t headers_find(Headers*, const char* name, const char* itemdelim);
+int headers_tobuffer(JSContext*, Headers* headers, struct lws* wsi);
 char* headers_gettoken(JSContext*, struct lws* wsi, enum lws_token_indexes tok);
-ssize_t headers_unsetb(ByteBuffer*, const char* name, size_t namelen, const char* itemdelim);
-ssize_t headers_set(ByteBuffer*, const char* name, const char* value, const char* itemdelim);
-ssize_t headers_appendb(ByteBuffer*, const char* name, size_t namelen, const char* value, size_t valuelen, const char* itemdelim);
+ssize_t headers_unsetb(Headers*, const char* name, size_t namelen, const char* itemdelim);
+ssize_t headers_set(Headers*, const char* name, const char* value, const char* itemdelim);
+ssize_t headers_appendb(Headers*, const char* name, size_t namelen, const char* value, size_t valuelen, const char* itemdelim);
+ssize_t headers_add(Headers*, const char* name, size_t namelen, const char* value, size_t valuelen, const char* itemdelim, int32_t token);
+uint32_t headers_hash(const char* name, size_t namelen);
+void headers_index(Headers*);
+void headers_attach(Headers*, struct lws* wsi);
+void headers_detach(Headers*, BOOL copy);
+BOOL headers_clone(Headers*, Headers* other);
+void headers_reset(Headers*);
+void headers_free(Headers*);
+
+static inline void
+headers_zero(Headers* h) {
+  memset(h, 0, sizeof(Headers));
+}
+
+static inline void
+headers_invalidate(Headers* h) {
+  h->stale = TRUE;
+}
+
+static inline HeaderEntry*
+headers_entry(Headers* h, size_t index) {
+  headers_index(h);
+  return index < h->count ? &h->entries[index] : 0;
+}
+
+static inline const char*
+headers_entry_name(Headers* h, const HeaderEntry* e) {
+  return (const char*)h->buffer.start + e->offset;
+}
+
+static inline const char*
+headers_entry_value(Headers* h, const HeaderEntry* e) {
+  return (const char*)h->buffer.start + e->value;
+}
 
 static inline size_t
 headers_length(const void* start, const void* end, const char* itemdelim) {
@@ -48,7 +111,7 @@ headers_value(const void* start, const void* end, const char* itemdelim) {
   return pos;
 }
 
-size_t headers_size(ByteBuffer* headers, const char* itemdelim);
+size_t headers_size(Headers* headers, const char* itemdelim);
 
 static inline char*
 headers_name(const void* start, const void* end, JSContext* ctx) {
@@ -56,8 +119,8 @@ headers_name(const void* start, const void* end, JSContext* ctx) {
 }
 
 static inline ssize_t
-headers_unset(ByteBuffer* buf, const char* name, const char* itemdelim) {
-  return headers_unsetb(buf, name, strlen(name), itemdelim);
+headers_unset(Headers* h, const char* name, const char* itemdelim) {
+  return headers_unsetb(h, name, strlen(name), itemdelim);
 }
 
 #endif /* QJSNET_LIB_HEADERS_H */
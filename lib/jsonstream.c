@@ -0,0 +1,293 @@
+/**
+ * @file jsonstream.c
+ */
+#include "jsonstream.h"
+#include <string.h>
+
+static inline BOOL
+is_space(int c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static const char*
+trim(const char* s, size_t* lenp) {
+  size_t n = *lenp;
+
+  while(n && is_space(*s)) {
+    ++s;
+    --n;
+  }
+
+  while(n && is_space(s[n - 1]))
+    --n;
+
+  *lenp = n;
+  return s;
+}
+
+static int
+jsonstream_emit(JsonStream* js, size_t start, size_t colon, size_t end) {
+  char *base = (char*)js->buf.buf, *key = 0, *value;
+  size_t keylen = 0, len;
+  char ksave = 0, vsave;
+  int ret;
+
+  if(colon) {
+    keylen = colon - start;
+    key = (char*)trim(base + start, &keylen);
+    value = base + colon + 1;
+  } else {
+    value = base + start;
+  }
+
+  len = base + end - value;
+  value = (char*)trim(value, &len);
+
+  if(len == 0)
+    return key ? -1 : 0;
+
+  if(key) {
+    ksave = key[keylen];
+    key[keylen] = '\0';
+  }
+
+  vsave = value[len];
+  value[len] = '\0';
+
+  ret = js->fn(js->opaque, key, keylen, value, len);
+
+  value[len] = vsave;
+
+  if(key)
+    key[keylen] = ksave;
+
+  ++js->items;
+  return ret;
+}
+
+static int
+jsonstream_fail(JsonStream* js, const char* error) {
+  js->error = error;
+  return -1;
+}
+
+/* Emits the member of the top-level container that ends at 'end' */
+static int
+jsonstream_member(JsonStream* js, size_t end, BOOL last) {
+  size_t len = end - js->start;
+
+  trim((const char*)js->buf.buf + js->start, &len);
+
+  /* only '[]' and '{}' may be empty */
+  if(len == 0)
+    return last && js->items == 0 ? 0 : jsonstream_fail(js, "unexpected ','");
+
+  if(js->container == '{' && !js->colon)
+    return jsonstream_fail(js, "expected ':'");
+
+  return jsonstream_emit(js, js->start, js->colon, end);
+}
+
+static void
+jsonstream_compact(JsonStream* js) {
+  if(js->start > 0) {
+    memmove(js->buf.buf, js->buf.buf + js->start, js->buf.size - js->start);
+
+    js->buf.size -= js->start;
+    js->pos -= js->start;
+
+    if(js->colon)
+      js->colon -= js->start;
+
+    js->start = 0;
+  }
+}
+
+static int
+jsonstream_lines(JsonStream* js) {
+  uint8_t* nl;
+
+  while((nl = memchr(js->buf.buf + js->pos, '\n', js->buf.size - js->pos))) {
+    size_t end = nl - js->buf.buf;
+
+    if(jsonstream_emit(js, js->start, 0, end) == -1)
+      return -1;
+
+    js->start = js->pos = end + 1;
+  }
+
+  js->pos = js->buf.size;
+  return 0;
+}
+
+static int
+jsonstream_elements(JsonStream* js) {
+  const uint8_t* p = js->buf.buf;
+  size_t i;
+
+  for(i = js->pos; i < js->buf.size; i++) {
+    uint8_t c = p[i];
+
+    if(js->string) {
+      if(js->escape)
+        js->escape = FALSE;
+      else if(c == '\\')
+        js->escape = TRUE;
+      else if(c == '"')
+        js->string = FALSE;
+      continue;
+    }
+
+    if(js->done) {
+      if(!is_space(c))
+        return jsonstream_fail(js, "unexpected input after the value");
+
+      js->start = i + 1;
+      continue;
+    }
+
+    if(!js->container) {
+      if(is_space(c)) {
+        js->start = i + 1;
+        continue;
+      }
+
+      if(c == '[' || c == '{') {
+        js->container = c;
+        js->depth = 1;
+        js->start = i + 1;
+        continue;
+      }
+
+      /* a scalar is only complete at the end of input */
+      js->container = 'v';
+      js->start = i;
+    }
+
+    switch(c) {
+      case '"': {
+        js->string = TRUE;
+        break;
+      }
+
+      case '[':
+      case '{': {
+        ++js->depth;
+        break;
+      }
+
+      case ']':
+      case '}': {
+        if(js->depth == 0)
+          return jsonstream_fail(js, "unexpected closing bracket");
+
+        if(--js->depth == 0) {
+          if(jsonstream_member(js, i, TRUE) == -1)
+            return -1;
+
+          js->done = TRUE;
+          js->start = i + 1;
+          js->colon = 0;
+        }
+        break;
+      }
+
+      case ',': {
+        if(js->depth == 1) {
+          if(jsonstream_member(js, i, FALSE) == -1)
+            return -1;
+
+          js->start = i + 1;
+          js->colon = 0;
+        }
+        break;
+      }
+
+      case ':': {
+        if(js->depth == 1 && js->container == '{' && !js->colon)
+          js->colon = i;
+        break;
+      }
+    }
+  }
+
+  js->pos = i;
+  return 0;
+}
+
+/**
+ * \defgroup jsonstream jsonstream
+ *
+ * Incremental JSON value splitter
+ * @{
+ */
+void
+jsonstream_init(JsonStream* js, JsonStreamMode mode, JsonStreamFunc* fn, void* opaque, JSContext* ctx) {
+  memset(js, 0, sizeof(JsonStream));
+  js->mode = mode;
+  js->fn = fn;
+  js->opaque = opaque;
+
+  dbuf_init2(&js->buf, ctx, (DynBufReallocFunc*)js_realloc);
+}
+
+void
+jsonstream_clear(JsonStream* js) {
+  dbuf_free(&js->buf);
+  js->pos = js->start = js->colon = 0;
+  js->error = 0;
+}
+
+/**
+ * Feeds a chunk of JSON text, calling back for every value it completes.
+ *
+ * @return 0 on success, -1 on malformed input or when the callback aborted
+ */
+int
+jsonstream_write(JsonStream* js, const void* data, size_t len) {
+  int ret;
+
+  if(dbuf_put(&js->buf, data, len))
+    return -1;
+
+  ret = js->mode == JSONSTREAM_LINES ? jsonstream_lines(js) : jsonstream_elements(js);
+
+  jsonstream_compact(js);
+  return ret;
+}
+
+/**
+ * Signals end of input, emitting a trailing line or a top-level scalar.
+ *
+ * @return 0 on success, -1 when the input was incomplete
+ */
+int
+jsonstream_end(JsonStream* js) {
+  int ret = 0;
+
+  if(js->string)
+    return -1;
+
+  /* room for the terminator written by jsonstream_emit() */
+  if(dbuf_putc(&js->buf, '\0'))
+    return -1;
+
+  --js->buf.size;
+
+  if(js->mode == JSONSTREAM_LINES) {
+    ret = jsonstream_emit(js, js->start, 0, js->buf.size);
+  } else if(js->container == 'v') {
+    ret = jsonstream_emit(js, js->start, 0, js->buf.size);
+    js->done = TRUE;
+  } else if(!js->done) {
+    ret = -1;
+  }
+
+  js->start = js->pos = js->buf.size;
+  jsonstream_compact(js);
+  return ret;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,41 @@
+/**
+ * @file jsonstream.h
+ */
+#ifndef QJSNET_LIB_JSONSTREAM_H
+#define QJSNET_LIB_JSONSTREAM_H
+
+#include <quickjs.h>
+#include <cutils.h>
+
+typedef enum {
+  JSONSTREAM_LINES = 0, /* newline delimited values */
+  JSONSTREAM_ELEMENTS,  /* members of the top-level array or object */
+} JsonStreamMode;
+
+/*
+ * Called for each complete value.  'key' is set for members of a top-level
+ * object and 0 otherwise.  Both slices are NUL-terminated during the call.
+ * Return -1 to abort the stream.
+ */
+typedef int JsonStreamFunc(void* opaque, const char* key, size_t keylen, const char* value, size_t len);
+
+/* Splits JSON text into values as chunks arrive, without parsing them */
+typedef struct json_stream {
+  JsonStreamMode mode;
+  DynBuf buf;
+  size_t pos, start, colon;
+  uint32_t depth;
+  BOOL string, escape, done;
+  char container; /* '[' or '{' once the top-level value has been seen, 'v' for a scalar */
+  uint64_t items;
+  const char* error; /* what was wrong when a write failed on malformed input */
+  JsonStreamFunc* fn;
+  void* opaque;
+} JsonStream;
+
+void jsonstream_init(JsonStream*, JsonStreamMode mode, JsonStreamFunc* fn, void* opaque, JSContext* ctx);
+void jsonstream_clear(JsonStream*);
+int jsonstream_write(JsonStream*, const void* data, size_t len);
+int jsonstream_end(JsonStream*);
+
+#endif /* QJSNET_LIB_JSONSTREAM_H */
@@ -23,6 +23,15 @@ opaque_clear(struct wsi_opaque_user_data* opaque, JSRuntime* rt) {
   if(opaque->req) {
     Request* req = opaque->req;
     opaque->req = 0;
+    headers_detach(&req->headers, req->ref_count > 1);
+
+    /* the connection of a streamed body is gone, end the iteration */
+    if(req->body && req->body->drain_fn) {
+      req->body->drain_fn = 0;
+      req->body->drain_opaque = 0;
+      generator_stop(req->body, JS_UNDEFINED);
+    }
+
     request_free(req, rt);
   }
 
@@ -2,6 +2,10 @@
  * @file query.c
  */
 #include "query.h"
+#include "utils.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 JSValue
 query_object(const char* q, JSContext* ctx) {
@@ -10,16 +14,22 @@ query_object(const char* q, JSContext* ctx) {
 
 JSValue
 query_object_len(const char* q, size_t n, JSContext* ctx) {
-  const char *p, *end = q + n;
-  size_t entrylen;
+  Query* query;
+  uint32_t i;
   JSValue ret = JS_NewObject(ctx);
-  JSEntry entry = JS_ENTRY();
 
-  for(p = q; p < end; p += entrylen + 1) {
-    entrylen = byte_chr(p, end - p, '&');
-    if(query_entry(p, entrylen, ctx, &entry))
-      js_entry_apply(ctx, &entry, ret);
+  if(!(query = query_new(q, n, ctx)))
+    return ret;
+
+  for(i = 0; i < query->count; i++) {
+    QueryParam* p = &query->params[i];
+    JSAtom prop = JS_NewAtomLen(ctx, &query->data[p->key], p->keylen);
+
+    JS_SetProperty(ctx, ret, prop, query_value(query, i, ctx));
+    JS_FreeAtom(ctx, prop);
   }
+
+  query_free(query, JS_GetRuntime(ctx));
   return ret;
 }
 
@@ -80,3 +90,242 @@ query_from(JSValueConst obj, JSContext* ctx) {
   js_free(ctx, tab);
   return (char*)out.buf;
 }
+
+/* Offset of the next '&', '=', '%' or '+', 16 bytes at a time where possible */
+static size_t
+query_special(const char* x, size_t n) {
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  const __m128i amp = _mm_set1_epi8('&'), eq = _mm_set1_epi8('='), pct = _mm_set1_epi8('%'), plus = _mm_set1_epi8('+');
+
+  for(; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)&x[i]);
+    int mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, amp), _mm_cmpeq_epi8(v, eq)), _mm_or_si128(_mm_cmpeq_epi8(v, pct), _mm_cmpeq_epi8(v, plus))));
+
+    if(mask)
+      return i + __builtin_ctz(mask);
+  }
+#endif
+
+  for(; i < n; i++)
+    switch(x[i]) {
+      case '&':
+      case '=':
+      case '%':
+      case '+': return i;
+    }
+
+  return n;
+}
+
+static int
+query_hexdigit(char c) {
+  if(c >= '0' && c <= '9')
+    return c - '0';
+  if(c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if(c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/* Decodes '+' and '%XX' in place, returns the new length */
+size_t
+query_decode(char* s, size_t n) {
+  size_t i, j;
+
+  for(i = 0, j = 0; i < n; i++, j++) {
+    int hi, lo;
+
+    if(s[i] == '+')
+      s[j] = ' ';
+    else if(s[i] == '%' && i + 2 < n && (hi = query_hexdigit(s[i + 1])) >= 0 && (lo = query_hexdigit(s[i + 2])) >= 0)
+      s[j] = (hi << 4) | lo, i += 2;
+    else
+      s[j] = s[i];
+  }
+
+  return j;
+}
+
+/* Form encoding: unreserved characters are kept, ' ' becomes '+' */
+void
+query_encode(DynBuf* db, const char* s, size_t n) {
+  static const char hex[] = "0123456789ABCDEF";
+  size_t i;
+
+  for(i = 0; i < n; i++) {
+    unsigned char c = s[i];
+
+    if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' || c == '~')
+      dbuf_putc(db, c);
+    else if(c == ' ')
+      dbuf_putc(db, '+');
+    else {
+      dbuf_putc(db, '%');
+      dbuf_putc(db, hex[c >> 4]);
+      dbuf_putc(db, hex[c & 0xf]);
+    }
+  }
+}
+
+static BOOL
+query_push(Query* q, uint32_t* capacity, size_t start, size_t eq, size_t end, BOOL keyenc, BOOL valenc, JSContext* ctx) {
+  QueryParam* p;
+
+  if(q->count == *capacity) {
+    uint32_t n = *capacity ? *capacity * 2 : 8;
+
+    if(!(p = js_realloc(ctx, q->params, n * sizeof(QueryParam))))
+      return FALSE;
+
+    q->params = p;
+    *capacity = n;
+  }
+
+  p = &q->params[q->count++];
+  p->key = start;
+  p->keylen = (eq < end ? eq : end) - start;
+  p->value = eq < end ? eq + 1 : end;
+  p->valuelen = end - p->value;
+  p->encoded = valenc;
+  p->decoded = JS_UNDEFINED;
+
+  /* keys are compared on every lookup, decode them right away */
+  if(keyenc)
+    p->keylen = query_decode(&q->data[p->key], p->keylen);
+
+  return TRUE;
+}
+
+Query*
+query_new(const char* s, size_t n, JSContext* ctx) {
+  Query* q;
+  uint32_t capacity = 0;
+  size_t pos, start = 0, eq = SIZE_MAX;
+  BOOL keyenc = FALSE, valenc = FALSE;
+
+  if(n && *s == '?')
+    ++s, --n;
+
+  n = byte_chr(s, n, '#');
+
+  if(!(q = js_mallocz(ctx, sizeof(Query))))
+    return 0;
+
+  q->ref_count = 1;
+
+  if(!(q->data = js_malloc(ctx, (n + 1) * 2)))
+    goto fail;
+
+  memcpy(q->data, s, n);
+  q->data[n] = '\0';
+  q->raw = memcpy(&q->data[n + 1], s, n);
+  q->data[n * 2 + 1] = '\0';
+  q->size = n;
+
+  for(pos = 0;; ++pos) {
+    pos += query_special(&q->data[pos], n - pos);
+
+    if(pos < n && q->data[pos] != '&') {
+      if(q->data[pos] == '=') {
+        if(eq == SIZE_MAX)
+          eq = pos;
+      } else if(eq == SIZE_MAX) {
+        keyenc = TRUE;
+      } else {
+        valenc = TRUE;
+      }
+      continue;
+    }
+
+    if(pos > start && !query_push(q, &capacity, start, eq, pos, keyenc, valenc, ctx))
+      goto fail;
+
+    if(pos >= n)
+      break;
+
+    start = pos + 1;
+    eq = SIZE_MAX;
+    keyenc = valenc = FALSE;
+  }
+
+  return q;
+
+fail:
+  query_free(q, JS_GetRuntime(ctx));
+  return 0;
+}
+
+Query*
+query_dup(Query* q) {
+  ++q->ref_count;
+  return q;
+}
+
+void
+query_free(Query* q, JSRuntime* rt) {
+  uint32_t i;
+
+  if(--q->ref_count == 0) {
+    for(i = 0; i < q->count; i++)
+      JS_FreeValueRT(rt, q->params[i].decoded);
+
+    if(q->params)
+      js_free_rt(rt, q->params);
+    if(q->data)
+      js_free_rt(rt, q->data);
+
+    js_free_rt(rt, q);
+  }
+}
+
+int32_t
+query_find(Query* q, const char* key, size_t keylen, uint32_t start) {
+  uint32_t i;
+
+  for(i = start; i < q->count; i++) {
+    QueryParam* p = &q->params[i];
+
+    if(p->keylen == keylen && !memcmp(&q->data[p->key], key, keylen))
+      return i;
+  }
+
+  return -1;
+}
+
+JSValue
+query_key(Query* q, uint32_t index, JSContext* ctx) {
+  QueryParam* p = &q->params[index];
+
+  return JS_NewStringLen(ctx, &q->data[p->key], p->keylen);
+}
+
+/* Decoded value bytes, decoding happens in place on first access */
+const char*
+query_string(Query* q, uint32_t index, size_t* len) {
+  QueryParam* p = &q->params[index];
+
+  if(p->encoded) {
+    p->valuelen = query_decode(&q->data[p->value], p->valuelen);
+    p->encoded = FALSE;
+  }
+
+  *len = p->valuelen;
+  return &q->data[p->value];
+}
+
+JSValue
+query_value(Query* q, uint32_t index, JSContext* ctx) {
+  QueryParam* p = &q->params[index];
+
+  if(JS_IsUndefined(p->decoded)) {
+    size_t len;
+    const char* s = query_string(q, index, &len);
+
+    p->decoded = JS_NewStringLen(ctx, s, len);
+  }
+
+  return JS_DupValue(ctx, p->decoded);
+}
@@ -6,6 +6,7 @@
 
 #include <quickjs.h>
 #include <cutils.h>
+#include <string.h>
 #include "js-utils.h"
 
 JSValue query_object(const char* q, JSContext* ctx);
@@ -13,4 +14,47 @@ JSValue query_object_len(const char* q, size_t n, JSContext* ctx);
 BOOL query_entry(const char* q, size_t n, JSContext* ctx, JSEntry* entry);
 char* query_from(JSValueConst obj, JSContext* ctx);
 
+/* One 'key=value' pair, as slices of Query.data */
+typedef struct query_param {
+  uint32_t key, keylen;
+  uint32_t value, valuelen;
+  BOOL encoded;    /* the value contains '%' or '+' and is not decoded yet */
+  JSValue decoded; /* cached string, JS_UNDEFINED until first access */
+} QueryParam;
+
+/* Lazy view over a query string. Only the '&' and '=' boundaries are
+ * located up front, values are decoded and converted on first access */
+typedef struct query {
+  int ref_count;
+  char* data; /* decoded in place */
+  const char* raw; /* the query as given, after data in the same allocation */
+  uint32_t size;
+  QueryParam* params;
+  uint32_t count;
+} Query;
+
+Query* query_new(const char* q, size_t n, JSContext* ctx);
+Query* query_dup(Query*);
+void query_free(Query*, JSRuntime* rt);
+int32_t query_find(Query*, const char* key, size_t keylen, uint32_t start);
+JSValue query_key(Query*, uint32_t index, JSContext* ctx);
+JSValue query_value(Query*, uint32_t index, JSContext* ctx);
+const char* query_string(Query*, uint32_t index, size_t* len);
+size_t query_decode(char* s, size_t n);
+void query_encode(DynBuf*, const char* s, size_t n);
+
+/* Whether the query was parsed from s, without the leading '?' and the '#' fragment */
+static inline BOOL
+query_equal(Query* q, const char* s, size_t n) {
+  const char* x;
+
+  if(n && *s == '?')
+    ++s, --n;
+
+  if((x = memchr(s, '#', n)))
+    n = x - s;
+
+  return q->size == n && !memcmp(q->raw, s, n);
+}
+
 #endif /* QJSNET_LIB_QUERY_H */
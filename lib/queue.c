@@ -162,6 +162,7 @@ queue_read(Queue* q, void* buf, size_t n) {
     } else {
 
       i->block = block_copy(b + j, len - j);
+      i->capacity = 0;
       block_free(&ret);
 
       break;
@@ -187,6 +188,7 @@ queue_add(Queue* q, ByteBlock chunk) {
 
   if((i = malloc(sizeof(QueueItem)))) {
     i->block = chunk;
+    i->capacity = 0;
     i->done = FALSE;
     i->unref = 0;
 
@@ -202,9 +204,7 @@ queue_put(Queue* q, ByteBlock chunk, JSContext* ctx) {
   QueueItem* i;
 
   if(q->continuous && (i = queue_last_chunk(q))) {
-    if(!block_SIZE(&i->block))
-      i->block = block_copy(chunk.start, block_SIZE(&chunk));
-    else if(block_append(&i->block, block_BEGIN(&chunk), block_SIZE(&chunk)) == -1)
+    if(block_extend(&i->block, &i->capacity, block_BEGIN(&chunk), block_SIZE(&chunk)) == -1)
       i = 0;
 
     block_free(&chunk);
@@ -221,7 +221,7 @@ queue_write(Queue* q, const void* data, size_t size, JSContext* ctx) {
   QueueItem* i;
 
   if(q->continuous && (i = queue_last_chunk(q))) {
-    if(block_append(&i->block, data, size) == -1)
+    if(block_extend(&i->block, &i->capacity, data, size) == -1)
       i = 0;
   } else {
     ByteBlock chunk = block_copy(data, size);
@@ -278,7 +278,7 @@ queue_append(Queue* q, const void* data, size_t size, JSContext* ctx) {
 
   if((i = queue_last_chunk(q))) {
 
-    if(block_append(&i->block, data, size) == -1)
+    if(block_extend(&i->block, &i->capacity, data, size) == -1)
       return 0;
 
   } else {
@@ -302,6 +302,7 @@ queue_close(Queue* q) {
 
   if((i = malloc(sizeof(QueueItem)))) {
     i->block = (ByteBlock){0, 0};
+    i->capacity = 0;
     i->done = TRUE;
     i->unref = 0;
 
@@ -339,6 +340,7 @@ queue_continuous(Queue* q) {
   if(!(i = queue_last_chunk(q))) {
     if((i = malloc(sizeof(QueueItem)))) {
       i->block = (ByteBlock){0, 0};
+      i->capacity = 0;
       i->done = FALSE;
       i->unref = 0;
 
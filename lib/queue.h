@@ -17,6 +17,7 @@ typedef struct queue {
 typedef struct queue_item {
   struct list_head link;
   ByteBlock block;
+  size_t capacity; /* allocated for block, when appended with block_extend() */
   BOOL binary, done;
   Deferred* unref;
 } QueueItem;
@@ -4,9 +4,16 @@
 #define _GNU_SOURCE
 #include "request.h"
 #include "headers.h"
+#include "utils.h"
 #include <ctype.h>
 #include <strings.h>
 #include <libwebsockets.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 static const char* const method_names[] = {
     "GET",
@@ -64,6 +71,7 @@ request_alloc(JSContext* ctx) {
 
   ret = js_mallocz(ctx, sizeof(Request));
   ret->ref_count = 1;
+  ret->spool.fd = -1;
   return ret;
 }
 
@@ -104,9 +112,26 @@ request_fromwsi(struct lws* wsi, JSContext* ctx) {
 void
 request_clear(Request* req, JSRuntime* rt) {
   url_free(&req->url, rt);
-  buffer_free(&req->headers);
+  headers_free(&req->headers);
+
+  if(req->query) {
+    query_free(req->query, rt);
+    req->query = 0;
+  }
+
+  if(req->spool.fd != -1) {
+    close(req->spool.fd);
+    req->spool.fd = -1;
+    req->spool.size = 0;
+  }
 
   if(req->body) {
+    if(req->body->drain_opaque == req) {
+      req->body->drain_fn = 0;
+      req->body->drain_opaque = 0;
+      generator_stop(req->body, JS_UNDEFINED);
+    }
+
     generator_free(req->body);
     req->body = 0;
   }
@@ -155,3 +180,165 @@ request_match(Request* req, const char* path, enum http_method method) {
 
   return TRUE;
 }
+
+static BOOL
+spool_write(Request* req, const void* data, size_t len) {
+  const uint8_t* x = data;
+
+  while(len > 0) {
+    ssize_t r = write(req->spool.fd, x, len);
+
+    if(r < 0) {
+      if(errno == EINTR)
+        continue;
+
+      return FALSE;
+    }
+
+    x += r;
+    len -= r;
+    req->spool.size += r;
+  }
+
+  return TRUE;
+}
+
+/* Moves the body received so far to an unlinked temporary file */
+static BOOL
+spool_open(Request* req) {
+  const char* tmpdir = getenv("TMPDIR");
+  char path[1024];
+  QueueItem* item;
+
+  snprintf(path, sizeof(path), "%s/body-XXXXXX", tmpdir ? tmpdir : "/tmp");
+
+  if((req->spool.fd = mkstemp(path)) == -1)
+    return FALSE;
+
+  unlink(path);
+  req->spool.size = 0;
+
+  if((item = queue_last_chunk(req->body->q)) && block_SIZE(&item->block)) {
+    if(!spool_write(req, block_BEGIN(&item->block), block_SIZE(&item->block)))
+      return FALSE;
+
+    block_free(&item->block);
+  }
+
+  return TRUE;
+}
+
+/**
+ * Appends to the request body, which is kept in memory until it grows
+ * beyond 'threshold' bytes (0 for no limit)
+ *
+ * @return bytes written or -1 on error
+ */
+ssize_t
+request_write(Request* req, const void* data, size_t len, uint64_t threshold, JSContext* ctx) {
+  Generator* gen;
+
+  if(!req->body && !(req->body = generator_new(ctx)))
+    return -1;
+
+  gen = req->body;
+
+  if(!gen->q || !gen->q->continuous)
+    generator_continuous(gen, JS_NULL);
+
+  if(req->spool.fd == -1 && (!threshold || gen->bytes_written + len <= threshold))
+    return generator_write(gen, data, len, JS_UNDEFINED);
+
+  if(req->spool.fd == -1 && !spool_open(req))
+    return -1;
+
+  if(!spool_write(req, data, len))
+    return -1;
+
+  gen->bytes_written += len;
+  gen->chunks_written += 1;
+  return len;
+}
+
+static void
+spool_unmap(JSRuntime* rt, void* opaque, void* ptr) {
+  munmap(ptr, (size_t)(uintptr_t)opaque);
+}
+
+/**
+ * The whole spooled body as an ArrayBuffer over a private mapping of the
+ * file. Its pages are backed by the file and released with the ArrayBuffer,
+ * the body is not read into the heap.
+ */
+JSValue
+request_spool_buffer(Request* req, JSContext* ctx) {
+  void* map;
+
+  if(req->spool.size == 0)
+    return JS_NewArrayBufferCopy(ctx, 0, 0);
+
+  if((map = mmap(0, req->spool.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, req->spool.fd, 0)) == MAP_FAILED)
+    return JS_ThrowInternalError(ctx, "mapping the request body failed: %s", strerror(errno));
+
+  madvise(map, req->spool.size, MADV_SEQUENTIAL);
+
+  return JS_NewArrayBuffer(ctx, map, req->spool.size, spool_unmap, (void*)(uintptr_t)req->spool.size, FALSE);
+}
+
+/* Reads the next chunks from the file for the reads pending on the body */
+static void
+spool_pump(Generator* gen, void* opaque) {
+  Request* req = opaque;
+  uint8_t buf[REQUEST_SPOOL_CHUNK];
+  ssize_t n = 1;
+
+  while(asynciterator_pending(&gen->iterator) && req->spool.offset < req->spool.size) {
+    if((n = pread(req->spool.fd, buf, MIN(sizeof(buf), req->spool.size - req->spool.offset), req->spool.offset)) <= 0) {
+      if(n < 0 && errno == EINTR)
+        continue;
+
+      break;
+    }
+
+    req->spool.offset += n;
+    generator_write(gen, buf, n, JS_UNDEFINED);
+  }
+
+  /* at the end of the file, or the file went short */
+  if(req->spool.offset >= req->spool.size || n <= 0) {
+    gen->drain_fn = 0;
+    gen->drain_opaque = 0;
+    generator_stop(gen, JS_UNDEFINED);
+  }
+}
+
+/**
+ * Hands a spooled body to iterating readers in REQUEST_SPOOL_CHUNK pieces,
+ * each one read from the file when it is asked for.
+ *
+ * @return TRUE when the body is spooled
+ */
+BOOL
+request_spool_stream(Request* req) {
+  Generator* gen;
+
+  if(req->spool.fd == -1 || !(gen = req->body))
+    return FALSE;
+
+  if(gen->drain_fn == spool_pump)
+    return TRUE;
+
+  /* the empty accumulating chunk goes, the body is complete once the file is read */
+  if(gen->q) {
+    queue_clear(gen->q, JS_GetRuntime(gen->ctx));
+    gen->q->continuous = FALSE;
+  }
+
+  gen->closing = FALSE;
+  gen->drain_fn = spool_pump;
+  gen->drain_opaque = req;
+  req->spool.offset = 0;
+
+  spool_pump(gen, req);
+  return TRUE;
+}
@@ -6,19 +6,31 @@
 
 #include "lws-utils.h"
 #include "buffer.h"
+#include "headers.h"
+#include "router.h"
 #include "generator.h"
 #include "url.h"
+#include "query.h"
 
 const char* method_string(enum http_method);
 int method_number(const char*);
 
+/* read size when a spooled body is iterated */
+#define REQUEST_SPOOL_CHUNK 65536
+
 typedef struct http_request {
   int ref_count;
   BOOL read_only, secure, h2;
   enum http_method method;
   URL url;
-  ByteBuffer headers;
+  Headers headers;
   Generator* body;
+  RouteMatch route; /* params are slices of url.path */
+  Query* query;     /* parsed on first access, rebuilt when the url changes */
+  struct {
+    int fd; /* body above the memory threshold, -1 while it is in memory */
+    uint64_t size, offset; /* offset: read so far by iterating readers */
+  } spool;
 } Request;
 
 const char* method_name(int m);
@@ -33,5 +45,8 @@ void request_clear(Request*, JSRuntime* rt);
 void request_free(Request*, JSRuntime* rt);
 Request* request_from(int, JSValueConst argv[], JSContext* ctx);
 BOOL request_match(Request*, const char* path, enum http_method method);
+ssize_t request_write(Request*, const void* data, size_t len, uint64_t threshold, JSContext* ctx);
+JSValue request_spool_buffer(Request*, JSContext*);
+BOOL request_spool_stream(Request*);
 
 #endif /* QJSNET_LIB_REQUEST_H */
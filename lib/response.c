@@ -26,7 +26,7 @@ response_init(Response* resp, URL url, int32_t status, char* status_text, BOOL h
   resp->status_text = status_text;
   resp->headers_sent = headers_sent;
   resp->url = url;
-  resp->headers = BUFFER_0();
+  headers_zero(&resp->headers);
   resp->body = NULL;
 }
 
@@ -39,7 +39,7 @@ response_dup(Response* resp) {
 void
 response_clear(Response* resp, JSRuntime* rt) {
   url_free(&resp->url, rt);
-  buffer_free(&resp->headers);
+  headers_free(&resp->headers);
 
   if(resp->status_text) {
     js_free_rt(rt, resp->status_text);
@@ -8,6 +8,7 @@
 #include <sys/types.h>
 #include "url.h"
 #include "buffer.h"
+#include "headers.h"
 #include "generator.h"
 
 struct session_data;
@@ -18,7 +19,7 @@ typedef struct http_response {
   URL url;
   int status;
   char* status_text;
-  ByteBuffer headers;
+  Headers headers;
   Generator* body;
 } Response;
 
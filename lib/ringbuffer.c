@@ -36,6 +36,10 @@ ringbuffer_new(JSContext* ctx) {
 size_t
 ringbuffer_insert(struct ringbuffer* rb, const void* ptr, size_t n) {
   size_t ret;
+
+  if(rb->shared)
+    return ringbuffer_shared_insert(rb->shared, ptr, n);
+
   assert(rb->ring);
 
   pthread_mutex_lock(&rb->lock_ring);
@@ -49,6 +53,10 @@ ringbuffer_insert(struct ringbuffer* rb, const void* ptr, size_t n) {
 size_t
 ringbuffer_consume(struct ringbuffer* rb, void* ptr, size_t n) {
   size_t ret;
+
+  if(rb->shared)
+    return ringbuffer_shared_consume(rb->shared, ptr, n);
+
   assert(rb->ring);
   pthread_mutex_lock(&rb->lock_ring);
 
@@ -61,6 +69,10 @@ ringbuffer_consume(struct ringbuffer* rb, void* ptr, size_t n) {
 size_t
 ringbuffer_skip(struct ringbuffer* rb, size_t n) {
   size_t ret;
+
+  if(rb->shared)
+    return ringbuffer_shared_consume(rb->shared, 0, n);
+
   assert(rb->ring);
   pthread_mutex_lock(&rb->lock_ring);
 
@@ -70,14 +82,31 @@ ringbuffer_skip(struct ringbuffer* rb, size_t n) {
   return ret;
 }
 
+/**
+ * The oldest element without consuming it. On a MPSC ring a slot counts only
+ * once its producer published it, a reserved slot still being written yields 0.
+ */
 const void*
 ringbuffer_next(struct ringbuffer* rb) {
+  if(rb->shared) {
+    struct ringbuffer_shared* s = rb->shared;
+    uint32_t tail = __atomic_load_n(&s->tail, __ATOMIC_RELAXED);
+
+    if(s->mode == RINGBUFFER_MPSC)
+      return (int32_t)(__atomic_load_n(&ringbuffer_shared_seq(s)[tail & (s->count - 1)], __ATOMIC_ACQUIRE) - (tail + 1)) < 0 ? 0 : ringbuffer_shared_slot(s, tail);
+
+    return ringbuffer_shared_waiting(s) ? ringbuffer_shared_slot(s, tail) : 0;
+  }
+
   assert(rb->ring);
   return lws_ring_get_element(rb->ring, 0);
 }
 
 size_t
 ringbuffer_waiting(struct ringbuffer* rb) {
+  if(rb->shared)
+    return ringbuffer_shared_waiting(rb->shared);
+
   assert(rb->ring);
   return lws_ring_get_count_waiting_elements(rb->ring, 0);
 }
@@ -89,20 +118,216 @@ ringbuffer_bytelength(struct ringbuffer* rb) {
 
 size_t
 ringbuffer_avail(struct ringbuffer* rb) {
+  if(rb->shared)
+    return rb->shared->count - ringbuffer_shared_waiting(rb->shared);
+
   assert(rb->ring);
   return lws_ring_get_count_free_elements(rb->ring);
 }
 
 void
 ringbuffer_zero(struct ringbuffer* rb) {
-  lws_ring_destroy(rb->ring);
+  if(rb->ring)
+    lws_ring_destroy(rb->ring);
   memset(rb, 0, sizeof(struct ringbuffer));
 }
 
 void
 ringbuffer_free(struct ringbuffer* rb, JSRuntime* rt) {
   if(--rb->ref_count == 0) {
+    if(rb->shared)
+      JS_FreeValueRT(rt, rb->shared_buf);
+
     ringbuffer_zero(rb);
     js_free_rt(rt, rb);
   }
 }
+
+static uint32_t
+ringbuffer_shared_count(size_t count) {
+  uint32_t n = 1;
+
+  while(n < count && n < RINGBUFFER_SHARED_MAX)
+    n <<= 1;
+
+  return n;
+}
+
+/**
+ * Bytes needed for a shared ring of count elements
+ *
+ * @return 0 when the count is above RINGBUFFER_SHARED_MAX or the size does not fit a size_t
+ */
+size_t
+ringbuffer_shared_size(size_t element_len, size_t count, RingbufferMode mode) {
+  uint32_t n = ringbuffer_shared_count(count);
+  size_t head = sizeof(struct ringbuffer_shared) + ringbuffer_shared_seqlen(n, mode);
+
+  if(count > RINGBUFFER_SHARED_MAX || (element_len && (SIZE_MAX - head) / element_len < n))
+    return 0;
+
+  return head + (size_t)n * element_len;
+}
+
+void
+ringbuffer_shared_init(struct ringbuffer_shared* s, size_t element_len, size_t count, RingbufferMode mode) {
+  uint32_t i, n = ringbuffer_shared_count(count);
+
+  memset(s, 0, sizeof(struct ringbuffer_shared));
+
+  s->mode = mode;
+  s->element_len = element_len;
+  s->count = n;
+
+  if(mode == RINGBUFFER_MPSC)
+    for(i = 0; i < n; i++)
+      ringbuffer_shared_seq(s)[i] = i;
+
+  __atomic_store_n(&s->magic, RINGBUFFER_SHARED_MAGIC, __ATOMIC_RELEASE);
+}
+
+BOOL
+ringbuffer_shared_valid(const struct ringbuffer_shared* s, size_t size) {
+  size_t need;
+
+  if(size < sizeof(struct ringbuffer_shared))
+    return FALSE;
+
+  if(__atomic_load_n(&s->magic, __ATOMIC_ACQUIRE) != RINGBUFFER_SHARED_MAGIC)
+    return FALSE;
+
+  if((s->mode != RINGBUFFER_SPSC && s->mode != RINGBUFFER_MPSC) || s->count == 0 || (s->count & (s->count - 1)) || s->element_len == 0)
+    return FALSE;
+
+  if(!(need = ringbuffer_shared_size(s->element_len, s->count, s->mode)))
+    return FALSE;
+
+  return size >= need;
+}
+
+/* Copies n elements starting at pos, splitting the memcpy where the ring wraps */
+static void
+ringbuffer_shared_copyin(struct ringbuffer_shared* s, uint32_t pos, const void* ptr, uint32_t n) {
+  uint32_t first = MIN(n, s->count - (pos & (s->count - 1)));
+
+  memcpy(ringbuffer_shared_slot(s, pos), ptr, (size_t)first * s->element_len);
+
+  if(n > first)
+    memcpy(ringbuffer_shared_slot(s, pos + first), (const uint8_t*)ptr + (size_t)first * s->element_len, (size_t)(n - first) * s->element_len);
+}
+
+static void
+ringbuffer_shared_copyout(struct ringbuffer_shared* s, uint32_t pos, void* ptr, uint32_t n) {
+  uint32_t first = MIN(n, s->count - (pos & (s->count - 1)));
+
+  memcpy(ptr, ringbuffer_shared_slot(s, pos), (size_t)first * s->element_len);
+
+  if(n > first)
+    memcpy((uint8_t*)ptr + (size_t)first * s->element_len, ringbuffer_shared_slot(s, pos + first), (size_t)(n - first) * s->element_len);
+}
+
+size_t
+ringbuffer_shared_insert(struct ringbuffer_shared* s, const void* ptr, size_t n) {
+  uint32_t head, tail, i;
+
+  if(s->mode == RINGBUFFER_SPSC) {
+    head = __atomic_load_n(&s->head, __ATOMIC_RELAXED);
+    tail = __atomic_load_n(&s->tail, __ATOMIC_ACQUIRE);
+
+    n = MIN(n, s->count - (head - tail));
+    ringbuffer_shared_copyin(s, head, ptr, n);
+
+    __atomic_store_n(&s->head, head + n, __ATOMIC_RELEASE);
+    return n;
+  }
+
+  /* MPSC: producers reserve a slot by CAS on head, then publish it through its sequence number */
+  for(i = 0; i < n; i++) {
+    uint32_t seq, *seqp;
+
+    head = __atomic_load_n(&s->head, __ATOMIC_RELAXED);
+
+    for(;;) {
+      seqp = &ringbuffer_shared_seq(s)[head & (s->count - 1)];
+      seq = __atomic_load_n(seqp, __ATOMIC_ACQUIRE);
+
+      if((int32_t)(seq - head) == 0) {
+        if(__atomic_compare_exchange_n(&s->head, &head, head + 1, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+          break;
+      } else if((int32_t)(seq - head) < 0) {
+        return i;
+      } else {
+        head = __atomic_load_n(&s->head, __ATOMIC_RELAXED);
+      }
+    }
+
+    memcpy(ringbuffer_shared_slot(s, head), (const uint8_t*)ptr + (size_t)i * s->element_len, s->element_len);
+    __atomic_store_n(seqp, head + 1, __ATOMIC_RELEASE);
+  }
+
+  return n;
+}
+
+size_t
+ringbuffer_shared_consume(struct ringbuffer_shared* s, void* ptr, size_t n) {
+  uint32_t head, tail, i;
+
+  tail = __atomic_load_n(&s->tail, __ATOMIC_RELAXED);
+
+  if(s->mode == RINGBUFFER_SPSC) {
+    head = __atomic_load_n(&s->head, __ATOMIC_ACQUIRE);
+
+    n = MIN(n, head - tail);
+
+    if(ptr)
+      ringbuffer_shared_copyout(s, tail, ptr, n);
+
+    __atomic_store_n(&s->tail, tail + n, __ATOMIC_RELEASE);
+    return n;
+  }
+
+  for(i = 0; i < n; i++, tail++) {
+    uint32_t* seqp = &ringbuffer_shared_seq(s)[tail & (s->count - 1)];
+
+    if((int32_t)(__atomic_load_n(seqp, __ATOMIC_ACQUIRE) - (tail + 1)) < 0)
+      break;
+
+    if(ptr)
+      memcpy((uint8_t*)ptr + (size_t)i * s->element_len, ringbuffer_shared_slot(s, tail), s->element_len);
+
+    __atomic_store_n(seqp, tail + s->count, __ATOMIC_RELEASE);
+  }
+
+  __atomic_store_n(&s->tail, tail, __ATOMIC_RELEASE);
+  return i;
+}
+
+size_t
+ringbuffer_shared_waiting(struct ringbuffer_shared* s) {
+  uint32_t tail = __atomic_load_n(&s->tail, __ATOMIC_ACQUIRE);
+  uint32_t head = __atomic_load_n(&s->head, __ATOMIC_ACQUIRE);
+
+  return MIN(head - tail, s->count);
+}
+
+BOOL
+ringbuffer_attach(struct ringbuffer* rb, JSValueConst buffer, JSContext* ctx) {
+  uint8_t* ptr;
+  size_t len;
+
+  if(!(ptr = JS_GetArrayBuffer(ctx, &len, buffer)))
+    return FALSE;
+
+  if(!ringbuffer_shared_valid((struct ringbuffer_shared*)ptr, len))
+    return FALSE;
+
+  if(rb->shared)
+    JS_FreeValue(ctx, rb->shared_buf);
+
+  rb->shared = (struct ringbuffer_shared*)ptr;
+  rb->shared_buf = JS_DupValue(ctx, buffer);
+  rb->size = rb->shared->count;
+  rb->element_len = rb->shared->element_len;
+
+  return TRUE;
+}
@@ -9,12 +9,37 @@
 #include <libwebsockets.h>
 #include <pthread.h>
 
+typedef enum {
+  RINGBUFFER_LOCKED = 0,
+  RINGBUFFER_SPSC,
+  RINGBUFFER_MPSC,
+} RingbufferMode;
+
+#define RINGBUFFER_SHARED_MAGIC 0x52494e47
+
+/* The count of a shared ring is rounded up to a power of two in 32 bits */
+#define RINGBUFFER_SHARED_MAX (1u << 31)
+
+/* Header of a lock-free ring living in (shared) memory, followed by a
+ * sequence number per slot (MPSC only) and the element storage.
+ * head and tail are free-running counters on separate cache lines. */
+struct ringbuffer_shared {
+  uint32_t magic, mode, element_len, count;
+  uint8_t pad0[48];
+  uint32_t head;
+  uint8_t pad1[60];
+  uint32_t tail;
+  uint8_t pad2[60];
+};
+
 struct ringbuffer {
   int ref_count;
   size_t size, element_len;
   char type[256];
   struct lws_ring* ring;
   pthread_mutex_t lock_ring; /* serialize access to the ring buffer */
+  struct ringbuffer_shared* shared;
+  JSValue shared_buf;
 };
 
 void ringbuffer_dump(struct ringbuffer const*);
@@ -31,6 +56,13 @@ size_t ringbuffer_waiting(struct ringbuffer*);
 size_t ringbuffer_avail(struct ringbuffer*);
 void ringbuffer_zero(struct ringbuffer*);
 void ringbuffer_free(struct ringbuffer*, JSRuntime* rt);
+size_t ringbuffer_shared_size(size_t element_len, size_t count, RingbufferMode mode);
+void ringbuffer_shared_init(struct ringbuffer_shared*, size_t element_len, size_t count, RingbufferMode mode);
+BOOL ringbuffer_shared_valid(const struct ringbuffer_shared*, size_t size);
+size_t ringbuffer_shared_insert(struct ringbuffer_shared*, const void* ptr, size_t n);
+size_t ringbuffer_shared_consume(struct ringbuffer_shared*, void* ptr, size_t n);
+size_t ringbuffer_shared_waiting(struct ringbuffer_shared*);
+BOOL ringbuffer_attach(struct ringbuffer*, JSValueConst buffer, JSContext* ctx);
 
 static inline int
 ringbuffer_lock(struct ringbuffer* strm) {
@@ -53,4 +85,24 @@ ringbuffer_element_len(struct ringbuffer* rb) {
   return rb->element_len;
 }
 
+static inline BOOL
+ringbuffer_is_shared(struct ringbuffer* rb) {
+  return rb->shared != 0;
+}
+
+static inline uint32_t
+ringbuffer_shared_seqlen(uint32_t count, uint32_t mode) {
+  return mode == RINGBUFFER_MPSC ? count * sizeof(uint32_t) : 0;
+}
+
+static inline uint32_t*
+ringbuffer_shared_seq(struct ringbuffer_shared* s) {
+  return (uint32_t*)(s + 1);
+}
+
+static inline uint8_t*
+ringbuffer_shared_slot(struct ringbuffer_shared* s, uint32_t pos) {
+  return (uint8_t*)(s + 1) + ringbuffer_shared_seqlen(s->count, s->mode) + (size_t)(pos & (s->count - 1)) * s->element_len;
+}
+
 #endif /* QJSNET_LIB_RINGBUFFER_H */
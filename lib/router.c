@@ -0,0 +1,325 @@
+/**
+ * @file router.c
+ */
+#include "router.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* A route ending at a node, with the names its pattern gives the parameters */
+typedef struct route_entry {
+  void* value;
+  char* names; /* '\0' terminated, one after the other */
+  uint32_t nnames;
+} RouteEntry;
+
+struct route_node {
+  char* segment; /* static text, ":" or "*" */
+  uint32_t seglen;
+  RouteNode** children;
+  uint32_t nchildren;
+  RouteNode *param, *wildcard;
+  RouteEntry entries[ROUTER_METHODS + 1]; /* per method, the last one for any method */
+};
+
+static RouteNode*
+node_new(const char* segment, size_t seglen) {
+  RouteNode* node;
+
+  if(!(node = calloc(1, sizeof(RouteNode))))
+    return 0;
+
+  if(!(node->segment = malloc(seglen + 1))) {
+    free(node);
+    return 0;
+  }
+
+  memcpy(node->segment, segment, seglen);
+  node->segment[seglen] = '\0';
+  node->seglen = seglen;
+  return node;
+}
+
+static void
+node_free(RouteNode* node) {
+  uint32_t i;
+
+  for(i = 0; i < node->nchildren; i++)
+    node_free(node->children[i]);
+
+  if(node->param)
+    node_free(node->param);
+  if(node->wildcard)
+    node_free(node->wildcard);
+
+  for(i = 0; i < countof(node->entries); i++)
+    free(node->entries[i].names);
+
+  free(node->children);
+  free(node->segment);
+  free(node);
+}
+
+static int
+node_compare(const RouteNode* node, const char* segment, size_t seglen) {
+  if(node->seglen != seglen)
+    return node->seglen < seglen ? -1 : 1;
+
+  return memcmp(node->segment, segment, seglen);
+}
+
+/* Binary search for a static child, returns the insert position if missing */
+static uint32_t
+node_search(const RouteNode* node, const char* segment, size_t seglen, BOOL* found) {
+  uint32_t lo = 0, hi = node->nchildren;
+
+  *found = FALSE;
+
+  while(lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    int r = node_compare(node->children[mid], segment, seglen);
+
+    if(r == 0) {
+      *found = TRUE;
+      return mid;
+    }
+
+    if(r < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+static RouteNode*
+node_child(RouteNode* node, const char* segment, size_t seglen) {
+  RouteNode **children, *child;
+  BOOL found;
+  uint32_t pos = node_search(node, segment, seglen, &found);
+
+  if(found)
+    return node->children[pos];
+
+  if(!(children = realloc(node->children, (node->nchildren + 1) * sizeof(RouteNode*))))
+    return 0;
+
+  node->children = children;
+
+  if(!(child = node_new(segment, seglen)))
+    return 0;
+
+  memmove(&children[pos + 1], &children[pos], (node->nchildren - pos) * sizeof(RouteNode*));
+  children[pos] = child;
+  node->nchildren++;
+
+  return child;
+}
+
+static RouteEntry*
+node_entry(RouteNode* node, int method) {
+  RouteEntry* e = 0;
+
+  if(method >= 0 && method < ROUTER_METHODS)
+    e = &node->entries[method];
+
+  if(!e || !e->value)
+    e = &node->entries[ROUTER_METHODS];
+
+  return e->value ? e : 0;
+}
+
+static void
+match_param(RouteMatch* m, size_t offset, size_t length) {
+  if(m->count < ROUTER_MAX_PARAMS) {
+    RouteParam* p = &m->params[m->count++];
+
+    p->name = "";
+    p->namelen = 0;
+    p->offset = offset;
+    p->length = length;
+  }
+}
+
+/* Names the captured parameters as the pattern of the matched route does */
+static BOOL
+match_route(RouteMatch* m, const RouteEntry* e) {
+  const char* name = e->names;
+
+  m->value = e->value;
+
+  for(uint32_t i = 0; i < m->count && i < e->nnames; i++) {
+    m->params[i].name = name;
+    m->params[i].namelen = strlen(name);
+    name += m->params[i].namelen + 1;
+  }
+
+  return TRUE;
+}
+
+static BOOL
+node_match(RouteNode* node, const char* path, size_t pos, size_t len, int method, RouteMatch* m) {
+  uint32_t count = m->count;
+  RouteEntry* e;
+  size_t end;
+
+  while(pos < len && path[pos] == '/')
+    ++pos;
+
+  if(pos < len) {
+    RouteNode* child;
+    BOOL found;
+    uint32_t i;
+
+    for(end = pos; end < len && path[end] != '/';)
+      ++end;
+
+    /* static segments take precedence over ':param' over '*' */
+    i = node_search(node, &path[pos], end - pos, &found);
+
+    if(found && node_match(node->children[i], path, end, len, method, m))
+      return TRUE;
+
+    if((child = node->param)) {
+      match_param(m, pos, end - pos);
+
+      if(node_match(child, path, end, len, method, m))
+        return TRUE;
+
+      m->count = count;
+    }
+  }
+
+  if(node->wildcard && (e = node_entry(node->wildcard, method))) {
+    match_param(m, pos, len > pos ? len - pos : 0);
+    m->length = len;
+    return match_route(m, e);
+  }
+
+  /* a route covers everything below it */
+  if((e = node_entry(node, method))) {
+    m->length = pos;
+    return match_route(m, e);
+  }
+
+  return FALSE;
+}
+
+BOOL
+router_add(Router* r, const char* pattern, int method, void* value) {
+  RouteNode* node;
+  RouteEntry* e;
+  const char *x = pattern, *end = pattern + strlen(pattern);
+  char *names, *n;
+  uint32_t nnames = 0;
+
+  if(!r->root && !(r->root = node_new("", 0)))
+    return FALSE;
+
+  /* no longer than the pattern itself */
+  if(!(n = names = malloc(end - pattern + 1)))
+    return FALSE;
+
+  for(node = r->root; x < end;) {
+    size_t seglen;
+
+    while(x < end && *x == '/')
+      ++x;
+
+    if(x == end)
+      break;
+
+    seglen = byte_chr(x, end - x, '/');
+
+    if(*x == '*') {
+      if(!node->wildcard && !(node->wildcard = node_new("*", 1)))
+        goto fail;
+
+      memcpy(n, "*", 2);
+      n += 2;
+      nnames++;
+
+      /* nothing after a wildcard can match */
+      node = node->wildcard;
+      break;
+    }
+
+    if(*x == ':') {
+      /* routes share the ':param' child of a node, each keeps its own names */
+      if(!node->param && !(node->param = node_new(":", 1)))
+        goto fail;
+
+      memcpy(n, x + 1, seglen - 1);
+      n[seglen - 1] = '\0';
+      n += seglen;
+      nnames++;
+
+      node = node->param;
+    } else if(!(node = node_child(node, x, seglen))) {
+      goto fail;
+    }
+
+    x += seglen;
+  }
+
+  /* later routes replace earlier ones, like later mounts did */
+  e = &node->entries[method >= 0 && method < ROUTER_METHODS ? method : ROUTER_METHODS];
+
+  free(e->names);
+  e->value = value;
+  e->names = names;
+  e->nnames = nnames;
+  r->count++;
+
+  return TRUE;
+
+fail:
+  free(names);
+  return FALSE;
+}
+
+/**
+ * Length of the leading static segments of a pattern, stopping before the
+ * first ':param' or '*' segment. At least the leading '/'.
+ */
+size_t
+router_prefix(const char* pattern, size_t len) {
+  size_t pos = 0, end = 1;
+
+  while(pos < len) {
+    while(pos < len && pattern[pos] == '/')
+      ++pos;
+
+    if(pos == len || pattern[pos] == ':' || pattern[pos] == '*')
+      break;
+
+    pos += byte_chr(&pattern[pos], len - pos, '/');
+    end = pos;
+  }
+
+  return end;
+}
+
+BOOL
+router_match(Router* r, const char* path, size_t len, int method, RouteMatch* match) {
+  match->value = 0;
+  match->length = 0;
+  match->count = 0;
+
+  if(!r->root)
+    return FALSE;
+
+  /* the query string is not part of the route */
+  len = byte_chrs(path, len, "?#", 2);
+
+  return node_match(r->root, path, 0, len, method, match);
+}
+
+void
+router_free(Router* r) {
+  if(r->root)
+    node_free(r->root);
+
+  router_zero(r);
+}
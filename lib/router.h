@@ -0,0 +1,50 @@
+/**
+ * @file router.h
+ */
+#ifndef QJSNET_LIB_ROUTER_H
+#define QJSNET_LIB_ROUTER_H
+
+#include <quickjs.h>
+#include <stdint.h>
+#include "lws-utils.h"
+
+#define ROUTER_MAX_PARAMS 8
+#define ROUTER_METHODS (METHOD_HEAD + 1)
+
+typedef struct route_node RouteNode;
+
+/* A ':name' or '*' segment captured from the matched path */
+typedef struct route_param {
+  const char* name; /* as the matched route names it, owned by the router */
+  uint32_t namelen;
+  uint32_t offset, length; /* slice of the path */
+} RouteParam;
+
+typedef struct route_match {
+  void* value;
+  uint32_t length; /* bytes of the path the route covered */
+  uint32_t count;
+  RouteParam params[ROUTER_MAX_PARAMS];
+} RouteMatch;
+
+/* Prefix tree over '/' separated path segments. Static segments are kept
+ * sorted per node and looked up by binary search, then ':param' and finally
+ * '*' children are tried. A route also matches paths below it, the deepest
+ * match wins */
+typedef struct router {
+  RouteNode* root;
+  uint32_t count;
+} Router;
+
+BOOL router_add(Router*, const char* pattern, int method, void* value);
+size_t router_prefix(const char* pattern, size_t len);
+BOOL router_match(Router*, const char* path, size_t len, int method, RouteMatch* match);
+void router_free(Router*);
+
+static inline void
+router_zero(Router* r) {
+  r->root = 0;
+  r->count = 0;
+}
+
+#endif /* QJSNET_LIB_ROUTER_H */
@@ -21,6 +21,9 @@ session_zero(struct session_data* session) {
   session->proxy = 0;
   session->generator = JS_NULL;
   session->next = JS_NULL;
+  session->resolved = JS_NULL;
+  session->rejected = JS_NULL;
+  session->type = SYNC;
   session->in_body = FALSE;
   session->response_sent = FALSE;
   session->want_write = FALSE;
@@ -53,12 +56,26 @@ session_clear(struct session_data* session, JSRuntime* rt) {
   JS_FreeValueRT(rt, session->next);
   session->next = JS_UNDEFINED;
 
+  session_unresolve(session, rt);
+
+  queue_clear(&session->sendq, rt);
+}
+
+/**
+ * Drops the then() handlers of the session.  A promise still pending keeps
+ * them alive, but they no longer reach the session.
+ */
+void
+session_unresolve(struct session_data* session, JSRuntime* rt) {
+  JS_FreeValueRT(rt, session->resolved);
+  session->resolved = JS_NULL;
+  JS_FreeValueRT(rt, session->rejected);
+  session->rejected = JS_NULL;
+
   if(session->wait_resolve_ptr) {
     *session->wait_resolve_ptr = 0;
     session->wait_resolve_ptr = 0;
   }
-
-  queue_clear(&session->sendq, rt);
 }
 
 JSValue
@@ -158,8 +175,12 @@ session_generator(struct session_data* session, JSValue generator, JSValueConst
   if(!async)
     async = js_is_async_generator(ctx, generator);
 
-  session->generator = JS_DupValue(ctx, generator);
+  JS_FreeValue(ctx, session->next);
   session->next = JS_NULL;
 
+  generator = JS_DupValue(ctx, generator);
+  JS_FreeValue(ctx, session->generator);
+  session->generator = generator;
+
   return JS_IsObject(generator) ? (async ? ASYNC_GENERATOR : GENERATOR) : 0;
 }
@@ -29,6 +29,8 @@ struct session_data {
   struct http_mount* mount;
   struct proxy_connection* proxy;
   JSValue generator, next;
+  JSValue resolved, rejected; /* then() handlers, reused for every promise of the session */
+  FunctionType type;          /* of the handler, or of the body of the Response it gave */
   BOOL in_body, response_sent, want_write;
   uint32_t wait_resolve, generator_run, callback_count;
   struct session_data** wait_resolve_ptr;
@@ -40,6 +42,7 @@ struct session_data {
 
 void session_init(struct session_data* session, struct context* context);
 void session_clear(struct session_data*, JSRuntime*);
+void session_unresolve(struct session_data*, JSRuntime*);
 JSValue session_object(struct session_data*, JSContext*);
 void session_want_write(struct session_data*, struct lws*);
 int session_writable(struct session_data*, struct lws*, JSContext*);
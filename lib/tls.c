@@ -0,0 +1,657 @@
+/**
+ * @file tls.c
+ */
+#define _GNU_SOURCE
+#include "tls.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#ifdef TLS_OPENSSL
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+#endif
+
+static char*
+tls_tag(const char* host, uint16_t port) {
+  size_t len = strlen(host) + 7;
+  char* tag;
+
+  if((tag = malloc(len)))
+    snprintf(tag, len, "%s:%u", host, port);
+
+  return tag;
+}
+
+static void
+tls_session_free(TLSSession* sess) {
+  free(sess->tag);
+  free(sess->blob);
+  free(sess);
+}
+
+/* Appends to the identity of a credentials entry */
+static BOOL
+tls_id_append(uint8_t** id, size_t* idlen, const void* data, size_t len) {
+  uint8_t* p;
+
+  if(!(p = realloc(*id, *idlen + len)))
+    return FALSE;
+
+  memcpy(p + *idlen, data, len);
+  *id = p;
+  *idlen += len;
+  return TRUE;
+}
+
+static BOOL
+tls_id_source(uint8_t** id, size_t* idlen, const TLSSource* src) {
+  struct stat st;
+
+  if(src && src->path) {
+    int64_t meta[2] = {-1, -1};
+
+    if(stat(src->path, &st) == 0) {
+      meta[0] = st.st_size;
+      meta[1] = st.st_mtime;
+    }
+
+    return tls_id_append(id, idlen, "f", 1) && tls_id_append(id, idlen, src->path, strlen(src->path) + 1) && tls_id_append(id, idlen, meta, sizeof(meta));
+  }
+
+  if(src && src->data) {
+    uint64_t len = src->len;
+
+    return tls_id_append(id, idlen, "m", 1) && tls_id_append(id, idlen, &len, sizeof(len)) && tls_id_append(id, idlen, src->data, src->len);
+  }
+
+  return tls_id_append(id, idlen, "-", 1);
+}
+
+#ifdef TLS_OPENSSL
+static BIO*
+tls_bio(const TLSSource* src) {
+  if(src->path)
+    return BIO_new_file(src->path, "r");
+
+  return BIO_new_mem_buf(src->data, src->len);
+}
+
+/* Reads PEM certificates, or a single DER one */
+static int
+tls_read_certs(const TLSSource* src, X509** first, STACK_OF(X509) * rest, X509_STORE* store) {
+  BIO* bio;
+  X509* x;
+  int count = 0;
+
+  if(!(bio = tls_bio(src)))
+    return 0;
+
+  while((x = PEM_read_bio_X509(bio, 0, 0, 0))) {
+    if(store) {
+      X509_STORE_add_cert(store, x);
+      X509_free(x);
+    } else if(!count) {
+      *first = x;
+    } else {
+      sk_X509_push(rest, x);
+    }
+
+    ++count;
+  }
+
+  if(!count && BIO_reset(bio) >= 0 && (x = d2i_X509_bio(bio, 0))) {
+    if(store) {
+      X509_STORE_add_cert(store, x);
+      X509_free(x);
+    } else {
+      *first = x;
+    }
+
+    ++count;
+  }
+
+  ERR_clear_error();
+  BIO_free(bio);
+  return count;
+}
+
+static EVP_PKEY*
+tls_read_key(const TLSSource* src) {
+  EVP_PKEY* key;
+  BIO* bio;
+
+  if(!(bio = tls_bio(src)))
+    return 0;
+
+  if(!(key = PEM_read_bio_PrivateKey(bio, 0, 0, 0)) && BIO_reset(bio) >= 0)
+    key = d2i_PrivateKey_bio(bio, 0);
+
+  ERR_clear_error();
+  BIO_free(bio);
+  return key;
+}
+
+static int tls_server_index = -1;
+
+static TLSServer*
+tls_server_get(SSL* ssl) {
+  return SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), tls_server_index);
+}
+
+/* Picks the certificate of the requested name on full handshakes */
+static int
+tls_server_cert(SSL* ssl, void* arg) {
+  TLSServer* server = arg;
+  TLSCredentials* creds;
+
+  server->handshakes++;
+
+  if(!(creds = tls_server_match(server, SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name))))
+    creds = server->credentials;
+
+  return !creds || tls_credentials_use(creds, ssl);
+}
+
+/* Makes a new current ticket key once the current one is 'rotate' seconds old */
+static BOOL
+tls_ticket_rotate(TLSServer* server, time_t now) {
+  TLSTicketKey key;
+
+  if(server->nkeys && server->keys[0].created + server->rotate > now)
+    return TRUE;
+
+  if(RAND_bytes(key.name, sizeof(key.name)) != 1 || RAND_bytes(key.aes, sizeof(key.aes)) != 1 || RAND_bytes(key.hmac, sizeof(key.hmac)) != 1)
+    return FALSE;
+
+  key.created = now;
+
+  if(server->nkeys < TLS_TICKET_KEYS)
+    server->nkeys++;
+
+  memmove(&server->keys[1], &server->keys[0], (server->nkeys - 1) * sizeof(TLSTicketKey));
+  server->keys[0] = key;
+  server->rotations++;
+
+  OPENSSL_cleanse(&key, sizeof(key));
+  return TRUE;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+typedef EVP_MAC_CTX TLSHmac;
+
+static BOOL
+tls_hmac_init(TLSHmac* hctx, const uint8_t* key) {
+  OSSL_PARAM params[] = {
+      OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, (void*)key, 32),
+      OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, "SHA256", 0),
+      OSSL_PARAM_construct_end(),
+  };
+
+  return EVP_MAC_CTX_set_params(hctx, params) == 1;
+}
+#else
+typedef HMAC_CTX TLSHmac;
+
+static BOOL
+tls_hmac_init(TLSHmac* hctx, const uint8_t* key) {
+  return HMAC_Init_ex(hctx, key, 32, EVP_sha256(), 0) == 1;
+}
+#endif
+
+/*
+ * Encrypts tickets with the current key, decrypts them with any key still
+ * kept.  Tickets of an older key are accepted and renewed.
+ */
+static int
+tls_ticket(SSL* ssl, unsigned char name[16], unsigned char* iv, EVP_CIPHER_CTX* cctx, TLSHmac* hctx, int enc) {
+  TLSServer* server;
+  TLSTicketKey* key = 0;
+  time_t now = time(0);
+
+  if(!(server = tls_server_get(ssl)))
+    return -1;
+
+  if(enc) {
+    if(!tls_ticket_rotate(server, now) || RAND_bytes(iv, 16) != 1)
+      return -1;
+
+    key = &server->keys[0];
+    memcpy(name, key->name, 16);
+
+    if(EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), 0, key->aes, iv) != 1 || !tls_hmac_init(hctx, key->hmac))
+      return -1;
+
+    server->tickets++;
+    return 1;
+  }
+
+  for(size_t i = 0; i < server->nkeys; i++)
+    if(!memcmp(server->keys[i].name, name, 16)) {
+      key = &server->keys[i];
+      break;
+    }
+
+  if(!key)
+    return 0;
+
+  if(EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), 0, key->aes, iv) != 1 || !tls_hmac_init(hctx, key->hmac))
+    return -1;
+
+  server->resumed++;
+  return key == &server->keys[0] && key->created + server->rotate > now ? 1 : 2;
+}
+#endif
+
+/**
+ * \defgroup tls tls
+ *
+ * Client TLS session and credential caches, server certificates and
+ * session tickets
+ * @{
+ */
+void
+tls_cache_init(TLSCache* cache, size_t max_sessions, uint32_t lifetime) {
+  memset(cache, 0, sizeof(TLSCache));
+  init_list_head(&cache->sessions);
+  init_list_head(&cache->credentials);
+  cache->max_sessions = max_sessions ? max_sessions : TLS_MAX_SESSIONS;
+  cache->lifetime = lifetime ? lifetime : TLS_SESSION_LIFETIME;
+}
+
+void
+tls_cache_clear(TLSCache* cache) {
+  struct list_head *el, *next;
+
+  list_for_each_safe(el, next, &cache->sessions) {
+    TLSSession* sess = list_entry(el, TLSSession, link);
+
+    list_del(&sess->link);
+    tls_session_free(sess);
+  }
+
+  list_for_each_safe(el, next, &cache->credentials) {
+    TLSCredentials* creds = list_entry(el, TLSCredentials, link);
+
+    list_del(&creds->link);
+    tls_credentials_free(creds);
+  }
+
+  cache->count = 0;
+  cache->credential_count = 0;
+}
+
+/**
+ * Looks up the session of a host.  Expired sessions are dropped on the way.
+ */
+TLSSession*
+tls_session_find(TLSCache* cache, const char* host, uint16_t port, time_t now) {
+  struct list_head* el;
+  char* tag;
+
+  if(!(tag = tls_tag(host, port)))
+    return 0;
+
+  list_for_each(el, &cache->sessions) {
+    TLSSession* sess = list_entry(el, TLSSession, link);
+
+    if(strcasecmp(sess->tag, tag))
+      continue;
+
+    list_del(&sess->link);
+
+    if(sess->expires <= now) {
+      tls_session_free(sess);
+      cache->count--;
+      break;
+    }
+
+    list_add(&sess->link, &cache->sessions);
+    free(tag);
+    return sess;
+  }
+
+  free(tag);
+  return 0;
+}
+
+/**
+ * Keeps a serialized session of a host, replacing an older one.  The least
+ * recently used session goes when there are 'max_sessions'.
+ */
+TLSSession*
+tls_session_store(TLSCache* cache, const char* host, uint16_t port, const void* blob, size_t len, time_t now) {
+  TLSSession* sess;
+
+  if((sess = tls_session_find(cache, host, port, now))) {
+    list_del(&sess->link);
+    tls_session_free(sess);
+    cache->count--;
+  }
+
+  if(!(sess = calloc(1, sizeof(TLSSession))))
+    return 0;
+
+  if(!(sess->tag = tls_tag(host, port)) || !(sess->blob = malloc(len))) {
+    tls_session_free(sess);
+    return 0;
+  }
+
+  memcpy(sess->blob, blob, len);
+  sess->len = len;
+  sess->expires = now + cache->lifetime;
+
+  while(cache->count >= cache->max_sessions && !list_empty(&cache->sessions)) {
+    TLSSession* last = list_entry(cache->sessions.prev, TLSSession, link);
+
+    list_del(&last->link);
+    tls_session_free(last);
+    cache->count--;
+  }
+
+  list_add(&sess->link, &cache->sessions);
+  cache->count++;
+  cache->stores++;
+  return sess;
+}
+
+/**
+ * Parses a CA store, certificate chain and key, outside of any cache.
+ *
+ * @return a new reference, 0 when a source does not parse or there is no
+ *         TLS library to parse it with
+ */
+TLSCredentials*
+tls_credentials_new(const TLSSource* ca, const TLSSource* cert, const TLSSource* key) {
+#ifdef TLS_OPENSSL
+  TLSCredentials* creds;
+
+  if(!(creds = calloc(1, sizeof(TLSCredentials))))
+    return 0;
+
+  creds->ref_count = 1;
+
+  if(ca && (ca->path || ca->data)) {
+    if(!(creds->store = X509_STORE_new()) || !tls_read_certs(ca, 0, 0, creds->store))
+      goto fail;
+  }
+
+  if(cert && (cert->path || cert->data)) {
+    if(!(creds->chain = sk_X509_new_null()) || !tls_read_certs(cert, &creds->cert, creds->chain, 0))
+      goto fail;
+  }
+
+  if(key && (key->path || key->data)) {
+    if(!(creds->key = tls_read_key(key)))
+      goto fail;
+  }
+
+  return creds;
+
+fail:
+  tls_credentials_free(creds);
+#endif
+  return 0;
+}
+
+/**
+ * Gets the parsed CA store, certificate chain and key for a set of sources.
+ * Files are parsed again once their size or modification time changes.
+ *
+ * @return a new reference, 0 when a source does not parse or there is no
+ *         TLS library to parse it with
+ */
+TLSCredentials*
+tls_credentials_get(TLSCache* cache, const TLSSource* ca, const TLSSource* cert, const TLSSource* key) {
+  TLSCredentials* creds;
+  struct list_head* el;
+  uint8_t* id = 0;
+  size_t idlen = 0;
+  uint32_t hash = 2166136261u;
+
+  if(!tls_id_source(&id, &idlen, ca) || !tls_id_source(&id, &idlen, cert) || !tls_id_source(&id, &idlen, key)) {
+    free(id);
+    return 0;
+  }
+
+  /* FNV-1a */
+  for(size_t i = 0; i < idlen; i++) {
+    hash ^= id[i];
+    hash *= 16777619u;
+  }
+
+  list_for_each(el, &cache->credentials) {
+    TLSCredentials* c = list_entry(el, TLSCredentials, link);
+
+    if(c->hash == hash && c->idlen == idlen && !memcmp(c->id, id, idlen)) {
+      list_del(&c->link);
+      list_add(&c->link, &cache->credentials);
+      free(id);
+      return tls_credentials_dup(c);
+    }
+  }
+
+  if(!(creds = tls_credentials_new(ca, cert, key))) {
+    free(id);
+    return 0;
+  }
+
+  creds->hash = hash;
+  creds->id = id;
+  creds->idlen = idlen;
+
+  while(cache->credential_count >= TLS_MAX_CREDENTIALS && !list_empty(&cache->credentials)) {
+    TLSCredentials* last = list_entry(cache->credentials.prev, TLSCredentials, link);
+
+    list_del(&last->link);
+    tls_credentials_free(last);
+    cache->credential_count--;
+  }
+
+  list_add(&creds->link, &cache->credentials);
+  cache->credential_count++;
+  return tls_credentials_dup(creds);
+}
+
+TLSCredentials*
+tls_credentials_dup(TLSCredentials* creds) {
+  ++creds->ref_count;
+  return creds;
+}
+
+void
+tls_credentials_free(TLSCredentials* creds) {
+  if(--creds->ref_count == 0) {
+#ifdef TLS_OPENSSL
+    if(creds->store)
+      X509_STORE_free(creds->store);
+    if(creds->cert)
+      X509_free(creds->cert);
+    if(creds->chain)
+      sk_X509_pop_free(creds->chain, X509_free);
+    if(creds->key)
+      EVP_PKEY_free(creds->key);
+#endif
+
+    free(creds->id);
+    free(creds);
+  }
+}
+
+/**
+ * Puts credentials into an SSL_CTX, the objects are shared, not copied.
+ */
+BOOL
+tls_credentials_apply(const TLSCredentials* creds, void* ssl_ctx) {
+#ifdef TLS_OPENSSL
+  SSL_CTX* ctx = ssl_ctx;
+
+  if(creds->store && X509_STORE_up_ref(creds->store))
+    SSL_CTX_set_cert_store(ctx, creds->store);
+
+  if(creds->cert) {
+    if(SSL_CTX_use_certificate(ctx, creds->cert) != 1)
+      return FALSE;
+
+    for(int i = 0; i < sk_X509_num(creds->chain); i++)
+      if(SSL_CTX_add1_chain_cert(ctx, sk_X509_value(creds->chain, i)) != 1)
+        return FALSE;
+  }
+
+  if(creds->key && (SSL_CTX_use_PrivateKey(ctx, creds->key) != 1 || SSL_CTX_check_private_key(ctx) != 1))
+    return FALSE;
+
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+/**
+ * Puts credentials into a single connection, replacing the certificates
+ * it got from its SSL_CTX.
+ */
+BOOL
+tls_credentials_use(const TLSCredentials* creds, void* ssl) {
+#ifdef TLS_OPENSSL
+  SSL* s = ssl;
+
+  if(creds->cert) {
+    SSL_certs_clear(s);
+
+    if(SSL_use_certificate(s, creds->cert) != 1)
+      return FALSE;
+
+    for(int i = 0; i < sk_X509_num(creds->chain); i++)
+      if(SSL_add1_chain_cert(s, sk_X509_value(creds->chain, i)) != 1)
+        return FALSE;
+  }
+
+  if(creds->key && (SSL_use_PrivateKey(s, creds->key) != 1 || SSL_check_private_key(s) != 1))
+    return FALSE;
+
+  if(creds->store && SSL_set1_verify_cert_store(s, creds->store) != 1)
+    return FALSE;
+
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+void
+tls_server_init(TLSServer* server, uint32_t rotate, uint32_t lifetime) {
+  memset(server, 0, sizeof(TLSServer));
+  server->rotate = rotate;
+  server->lifetime = lifetime;
+}
+
+void
+tls_server_clear(TLSServer* server) {
+  tls_server_swap(server, 0, 0, 0);
+
+#ifdef TLS_OPENSSL
+  OPENSSL_cleanse(server->keys, sizeof(server->keys));
+#endif
+  server->nkeys = 0;
+}
+
+/**
+ * Replaces the certificates of new handshakes, taking ownership of the
+ * credentials and the 'names' array.  Connections made before keep theirs.
+ */
+void
+tls_server_swap(TLSServer* server, TLSCredentials* creds, TLSServerName* names, size_t nnames) {
+  TLSCredentials* old = server->credentials;
+  TLSServerName* oldnames = server->names;
+  size_t oldcount = server->nnames;
+
+  server->credentials = creds;
+  server->names = names;
+  server->nnames = nnames;
+
+  if(old)
+    tls_credentials_free(old);
+
+  for(size_t i = 0; i < oldcount; i++) {
+    free(oldnames[i].name);
+    tls_credentials_free(oldnames[i].credentials);
+  }
+
+  free(oldnames);
+}
+
+/**
+ * Finds the certificate of a server name, an exact name before a wildcard
+ * covering its first label.
+ */
+TLSCredentials*
+tls_server_match(const TLSServer* server, const char* name) {
+  const char* dot;
+
+  if(!name)
+    return 0;
+
+  for(size_t i = 0; i < server->nnames; i++)
+    if(!strcasecmp(server->names[i].name, name))
+      return server->names[i].credentials;
+
+  if((dot = strchr(name, '.')))
+    for(size_t i = 0; i < server->nnames; i++)
+      if(server->names[i].name[0] == '*' && !strcasecmp(server->names[i].name + 1, dot))
+        return server->names[i].credentials;
+
+  return 0;
+}
+
+/**
+ * Hooks certificate selection, session tickets and the session lifetime
+ * into the SSL_CTX of a vhost.  The server must outlive it.
+ */
+BOOL
+tls_server_attach(TLSServer* server, void* ssl_ctx) {
+#ifdef TLS_OPENSSL
+  SSL_CTX* ctx = ssl_ctx;
+
+  if(tls_server_index == -1 && (tls_server_index = SSL_CTX_get_ex_new_index(0, 0, 0, 0, 0)) == -1)
+    return FALSE;
+
+  if(!SSL_CTX_set_ex_data(ctx, tls_server_index, server))
+    return FALSE;
+
+  SSL_CTX_set_cert_cb(ctx, tls_server_cert, server);
+  SSL_CTX_set_session_id_context(ctx, (const unsigned char*)"minnet", 6);
+
+  if(server->lifetime)
+    SSL_CTX_set_timeout(ctx, server->lifetime);
+
+  if(server->rotate) {
+    SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, tls_ticket);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(ctx, tls_ticket);
+#endif
+  } else {
+    SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    SSL_CTX_set_num_tickets(ctx, 0);
+#endif
+  }
+
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,102 @@
+/**
+ * @file tls.h
+ */
+#ifndef QJSNET_LIB_TLS_H
+#define QJSNET_LIB_TLS_H
+
+#include <libwebsockets.h>
+#include <list.h>
+#include <stdint.h>
+#include <time.h>
+#include "utils.h"
+
+#if defined(LWS_WITH_TLS) && !defined(LWS_WITH_MBEDTLS)
+#define TLS_OPENSSL 1
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#endif
+
+#define TLS_MAX_SESSIONS 64
+#define TLS_MAX_CREDENTIALS 16
+#define TLS_SESSION_LIFETIME 300
+#define TLS_TICKET_KEYS 3
+#define TLS_TICKET_ROTATE 3600
+
+/* A serialized session of a host, to resume the next handshake with */
+typedef struct tls_session {
+  struct list_head link; /* most recently used first */
+  char* tag;             /* "host:port" */
+  uint8_t* blob;
+  size_t len;
+  time_t expires;
+} TLSSession;
+
+/* Where certificate material comes from, a file or a buffer */
+typedef struct tls_source {
+  const char* path;
+  const void* data;
+  size_t len;
+} TLSSource;
+
+/* CA store, certificate chain and key parsed once for every SSL_CTX using them */
+typedef struct tls_credentials {
+  int ref_count;
+  struct list_head link;
+  uint32_t hash;
+  uint8_t* id; /* sources, files by name, size and mtime */
+  size_t idlen;
+#ifdef TLS_OPENSSL
+  X509_STORE* store;
+  X509* cert;
+  STACK_OF(X509) * chain;
+  EVP_PKEY* key;
+#endif
+} TLSCredentials;
+
+typedef struct tls_cache {
+  struct list_head sessions, credentials;
+  size_t count, max_sessions, credential_count;
+  uint32_t lifetime; /* seconds a session is offered for resumption */
+  uint64_t handshakes, resumed, stores;
+} TLSCache;
+
+/* Encrypts session tickets, the current one first */
+typedef struct tls_ticket_key {
+  uint8_t name[16], aes[32], hmac[32];
+  time_t created;
+} TLSTicketKey;
+
+/* Certificate of a server name, "host" or "*.domain" */
+typedef struct tls_server_name {
+  char* name;
+  TLSCredentials* credentials;
+} TLSServerName;
+
+typedef struct tls_server {
+  TLSCredentials* credentials; /* when no name matches, 0 for the one of the SSL_CTX */
+  TLSServerName* names;
+  size_t nnames;
+  uint32_t rotate;   /* seconds a ticket key is current, 0 without tickets */
+  uint32_t lifetime; /* seconds a session can be resumed */
+  TLSTicketKey keys[TLS_TICKET_KEYS];
+  size_t nkeys;
+  uint64_t handshakes, resumed, tickets, rotations, reloads; /* full handshakes, tickets accepted and issued */
+} TLSServer;
+
+void tls_cache_init(TLSCache*, size_t max_sessions, uint32_t lifetime);
+void tls_cache_clear(TLSCache*);
+TLSSession* tls_session_find(TLSCache*, const char* host, uint16_t port, time_t now);
+TLSSession* tls_session_store(TLSCache*, const char* host, uint16_t port, const void* blob, size_t len, time_t now);
+TLSCredentials* tls_credentials_new(const TLSSource* ca, const TLSSource* cert, const TLSSource* key);
+TLSCredentials* tls_credentials_get(TLSCache*, const TLSSource* ca, const TLSSource* cert, const TLSSource* key);
+TLSCredentials* tls_credentials_dup(TLSCredentials*);
+void tls_credentials_free(TLSCredentials*);
+BOOL tls_credentials_apply(const TLSCredentials*, void* ssl_ctx);
+BOOL tls_credentials_use(const TLSCredentials*, void* ssl);
+void tls_server_init(TLSServer*, uint32_t rotate, uint32_t lifetime);
+void tls_server_clear(TLSServer*);
+void tls_server_swap(TLSServer*, TLSCredentials*, TLSServerName* names, size_t nnames);
+TLSCredentials* tls_server_match(const TLSServer*, const char* name);
+BOOL tls_server_attach(TLSServer*, void* ssl_ctx);
+
+#endif /* QJSNET_LIB_TLS_H */
@@ -86,7 +86,7 @@ QueueItem*
 ws_enqueue(struct socket* ws, ByteBlock chunk) {
   struct wsi_opaque_user_data* opaque;
   struct session_data* session;
-  QueueItem* item;
+  QueueItem* item = 0;
 
   if((opaque = ws_opaque(ws)))
     if((session = opaque->sess))
@@ -95,3 +95,16 @@ ws_enqueue(struct socket* ws, ByteBlock chunk) {
 
   return item;
 }
+
+/**
+ * Keeps a message sent while there is no connection for the next one.
+ *
+ * @return 0 when there is no room left
+ */
+QueueItem*
+ws_pending(struct socket* ws, const void* data, size_t size) {
+  if(!ws->pending || queue_bytes(ws->pending) + size > ws->pending_max)
+    return 0;
+
+  return queue_add(ws->pending, block_copy(data, size));
+}
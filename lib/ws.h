@@ -21,7 +21,9 @@ struct socket {
   int ref_count;
   struct lws* lwsi;
   int fd;
-  BOOL raw : 1, binary : 1;
+  BOOL raw : 1, binary : 1, closed : 1; /* 'closed' by close() */
+  Queue* pending;     /* sends while there is no connection, reconnecting clients only */
+  size_t pending_max; /* bytes 'pending' holds at most */
 };
 
 struct socket* ws_new(struct lws*, JSContext* ctx);
@@ -30,6 +32,7 @@ void ws_free(struct socket*, JSRuntime* rt);
 struct socket* ws_dup(struct socket*);
 QueueItem* ws_enqueue(struct socket*, ByteBlock);
 Queue* ws_queue(struct socket* ws);
+QueueItem* ws_pending(struct socket*, const void* data, size_t size);
 
 static inline struct session_data*
 lws_session(struct lws* wsi) {
@@ -2,10 +2,42 @@
 #include "minnet-client-http.h"
 #include "minnet-websocket.h"
 #include "minnet-response.h"
+#include "minnet-hash.h"
+#include "minnet-fetch.h"
+#include "minnet-tls.h"
 #include "minnet.h"
 #include "headers.h"
+#include "cache.h"
 #include "js-utils.h"
 #include <libwebsockets.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define UPLOAD_SIZE 65536
+#define UPLOAD_CHUNK_HEAD 10 /* "%zx\r\n" of UPLOAD_SIZE, padded */
+#define UPLOAD_CHUNK_TAIL 7  /* "\r\n" and "0\r\n\r\n" */
+
+#define RECEIVE_SIZE 65536
+#define RECEIVE_MAX (1024 * 1024)
+#define RECEIVE_HIGH_WATER (1024 * 1024)
+
+#define SAVE_BUFFER (256 * 1024)
+
+enum {
+  UPLOAD_RESOLVED = 0,
+  UPLOAD_REJECTED,
+};
+
+/* Shared by the then() handlers, 'client' is reset when the upload is cleared */
+typedef struct upload_closure {
+  int ref_count;
+  MinnetClient* client;
+} UploadClosure;
 
 typedef struct {
   int ref_count;
@@ -15,6 +47,790 @@ typedef struct {
   struct lws* wsi;
 } HTTPAsyncResolveClosure;
 
+static void
+upload_closure_free(void* ptr) {
+  UploadClosure* closure = ptr;
+
+  if(--closure->ref_count == 0)
+    free(closure);
+}
+
+static JSValue
+upload_iterator(JSContext* ctx, JSValueConst value) {
+  static const char* const symbols[] = {"asyncIterator", "iterator"};
+  JSValue fn;
+
+  if(JS_IsFunction(ctx, value))
+    return JS_Call(ctx, value, JS_UNDEFINED, 0, 0);
+
+  for(size_t i = 0; i < countof(symbols); i++) {
+    JSAtom atom = js_symbol_static_atom(ctx, symbols[i]);
+
+    fn = JS_GetProperty(ctx, value, atom);
+    JS_FreeAtom(ctx, atom);
+
+    if(JS_IsFunction(ctx, fn)) {
+      JSValue ret = JS_Call(ctx, fn, value, 0, 0);
+
+      JS_FreeValue(ctx, fn);
+      return ret;
+    }
+
+    JS_FreeValue(ctx, fn);
+  }
+
+  return JS_DupValue(ctx, value);
+}
+
+/**
+ * Sets up the request body: strings and buffers are sent from their memory,
+ * { file: path } from a file descriptor and anything else is iterated.
+ *
+ * @return -1 with an exception thrown on failure
+ */
+int
+client_upload_init(MinnetClient* client, JSValueConst body, JSContext* ctx) {
+  ClientUpload* up = &client->upload;
+  JSValue file;
+
+  memset(up, 0, sizeof(ClientUpload));
+  up->fd = -1;
+  up->length = -1;
+  up->iterator = up->next = up->resolved = up->rejected = JS_NULL;
+
+  if(js_is_nullish(body))
+    return 0;
+
+  if(JS_IsString(body) || js_is_arraybuffer(ctx, body) || js_is_typedarray(ctx, body)) {
+    up->input = js_input_chars(ctx, body);
+    up->length = up->input.size;
+    up->source = UPLOAD_BUFFER;
+    return 0;
+  }
+
+  if(!JS_IsObject(body)) {
+    JS_ThrowTypeError(ctx, "body must be a string, buffer, iterable or { file }");
+    return -1;
+  }
+
+  file = JS_GetPropertyStr(ctx, body, "file");
+
+  if(JS_IsString(file)) {
+    const char* path = JS_ToCString(ctx, file);
+    struct stat st;
+
+    up->fd = open(path, O_RDONLY);
+
+    if(up->fd == -1)
+      JS_ThrowInternalError(ctx, "body: cannot open '%s': %s", path, strerror(errno));
+    else if(fstat(up->fd, &st) == 0 && S_ISREG(st.st_mode))
+      up->length = st.st_size;
+
+    JS_FreeCString(ctx, path);
+    JS_FreeValue(ctx, file);
+
+    if(up->fd == -1)
+      return -1;
+
+    /* { file, offset, length } sends a range */
+    if(js_has_propertystr(ctx, body, "offset")) {
+      int64_t offset = 0;
+      JSValue value = JS_GetPropertyStr(ctx, body, "offset");
+
+      JS_ToInt64(ctx, &offset, value);
+      JS_FreeValue(ctx, value);
+
+      if(offset > 0 && lseek(up->fd, offset, SEEK_SET) == -1) {
+        JS_ThrowInternalError(ctx, "body: cannot seek to %" PRId64 ": %s", offset, strerror(errno));
+        return -1;
+      }
+
+      if(up->length >= 0)
+        up->length = offset < up->length ? up->length - offset : 0;
+    }
+
+    if(js_has_propertystr(ctx, body, "length")) {
+      int64_t length = -1;
+      JSValue value = JS_GetPropertyStr(ctx, body, "length");
+
+      JS_ToInt64(ctx, &length, value);
+      JS_FreeValue(ctx, value);
+
+      if(length >= 0 && (up->length < 0 || length < up->length))
+        up->length = length;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(up->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    up->source = UPLOAD_FILE;
+    return 0;
+  }
+
+  JS_FreeValue(ctx, file);
+
+  up->iterator = upload_iterator(ctx, body);
+
+  if(JS_IsException(up->iterator)) {
+    up->iterator = JS_NULL;
+    return -1;
+  }
+
+  up->source = UPLOAD_ITERATOR;
+  return 0;
+}
+
+void
+client_upload_clear(MinnetClient* client, JSRuntime* rt) {
+  ClientUpload* up = &client->upload;
+
+  if(up->closure) {
+    up->closure->client = 0;
+    upload_closure_free(up->closure);
+    up->closure = 0;
+  }
+
+  if(up->input.data)
+    js_buffer_free(&up->input, rt);
+
+  if(up->fd != -1) {
+    close(up->fd);
+    up->fd = -1;
+  }
+
+  JS_FreeValueRT(rt, up->iterator);
+  JS_FreeValueRT(rt, up->next);
+  JS_FreeValueRT(rt, up->resolved);
+  JS_FreeValueRT(rt, up->rejected);
+  up->iterator = up->next = up->resolved = up->rejected = JS_NULL;
+
+  buffer_free(&up->out);
+  up->source = UPLOAD_NONE;
+}
+
+static BOOL
+upload_pending(MinnetClient* client) {
+  int method = method_number(client->connect_info.method);
+
+  return client->upload.source != UPLOAD_NONE && !client->upload.done && method != METHOD_GET && method != METHOD_HEAD;
+}
+
+static int
+upload_value(ClientUpload* up, JSValueConst value, BOOL done, JSContext* ctx) {
+  if(done) {
+    up->eof = TRUE;
+    return 0;
+  }
+
+  if(js_is_nullish(value))
+    return 0;
+
+  up->input = js_input_chars(ctx, value);
+  up->pos = 0;
+
+  return up->input.data || !up->input.size ? 0 : -1;
+}
+
+static JSValue
+upload_settled(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* opaque) {
+  UploadClosure* closure = opaque;
+  MinnetClient* client;
+  ClientUpload* up;
+
+  if(!(client = closure->client))
+    return JS_UNDEFINED;
+
+  up = &client->upload;
+  up->waiting = FALSE;
+
+  if(magic == UPLOAD_REJECTED) {
+    js_error_print(ctx, argv[0]);
+    up->error = TRUE;
+  } else {
+    JSValue value = JS_GetPropertyStr(ctx, argv[0], "value");
+
+    if(upload_value(up, value, js_get_propertystr_bool(ctx, argv[0], "done"), ctx) == -1)
+      up->error = TRUE;
+
+    JS_FreeValue(ctx, value);
+  }
+
+  if(client->wsi)
+    lws_callback_on_writable(client->wsi);
+
+  return JS_UNDEFINED;
+}
+
+/* Pulls the next value of an iterator body, waits for it if it is a promise */
+static int
+upload_next(MinnetClient* client, JSContext* ctx) {
+  ClientUpload* up = &client->upload;
+  BOOL done = FALSE;
+  JSValue value;
+  int ret = 0;
+
+  value = js_iterator_next(ctx, up->iterator, &up->next, &done, 0, 0);
+
+  if(JS_IsException(value)) {
+    JSValue exception = JS_GetException(ctx);
+
+    js_error_print(ctx, exception);
+    JS_FreeValue(ctx, exception);
+    return -1;
+  }
+
+  if(js_is_promise(ctx, value)) {
+    if(!up->closure) {
+      if(!(up->closure = malloc(sizeof(UploadClosure)))) {
+        JS_FreeValue(ctx, value);
+        return -1;
+      }
+
+      *up->closure = (UploadClosure){3, client};
+
+      up->resolved = js_function_cclosure(ctx, upload_settled, 1, UPLOAD_RESOLVED, up->closure, upload_closure_free);
+      up->rejected = js_function_cclosure(ctx, upload_settled, 1, UPLOAD_REJECTED, up->closure, upload_closure_free);
+    }
+
+    up->waiting = TRUE;
+    JS_FreeValue(ctx, js_async_then2(ctx, value, up->resolved, up->rejected));
+  } else {
+    ret = upload_value(up, value, done, ctx);
+  }
+
+  JS_FreeValue(ctx, value);
+  return ret;
+}
+
+/* Fills 'dst' with up to 'max' bytes of the body, sets 'done' after the last */
+static ssize_t
+upload_fill(MinnetClient* client, uint8_t* dst, size_t max, JSContext* ctx) {
+  ClientUpload* up = &client->upload;
+  size_t n = 0;
+
+  switch(up->source) {
+    case UPLOAD_BUFFER: {
+      n = MIN(max, up->input.size - up->pos);
+      memcpy(dst, up->input.data + up->pos, n);
+
+      if((up->pos += n) == up->input.size)
+        up->done = TRUE;
+
+      break;
+    }
+
+    case UPLOAD_FILE: {
+      ssize_t r;
+
+      if(up->length >= 0 && (uint64_t)up->length - up->sent < max)
+        max = up->length - up->sent;
+
+      while((r = read(up->fd, dst, max)) == -1 && errno == EINTR)
+        ;
+
+      if(r == -1)
+        return -1;
+
+      n = r;
+
+      if(r == 0 || (up->length >= 0 && up->sent + n == (uint64_t)up->length))
+        up->done = TRUE;
+
+      break;
+    }
+
+    case UPLOAD_ITERATOR: {
+      while(n < max && !up->error) {
+        if(up->input.data) {
+          size_t k = MIN(max - n, up->input.size - up->pos);
+
+          memcpy(dst + n, up->input.data + up->pos, k);
+          n += k;
+
+          if((up->pos += k) < up->input.size)
+            break;
+
+          js_buffer_free(&up->input, JS_GetRuntime(ctx));
+          memset(&up->input, 0, sizeof(JSBuffer));
+        }
+
+        if(up->eof || up->waiting)
+          break;
+
+        if(upload_next(client, ctx) == -1)
+          return -1;
+      }
+
+      if(up->error)
+        return -1;
+
+      if(up->eof && !up->input.data)
+        up->done = TRUE;
+
+      break;
+    }
+
+    default: {
+      up->done = TRUE;
+      break;
+    }
+  }
+
+  return n;
+}
+
+/* Sends one window of the request body, framed as a chunk if there is no Content-Length */
+static int
+upload_write(MinnetClient* client, struct lws* wsi, JSContext* ctx) {
+  ClientUpload* up = &client->upload;
+  lws_fileofs_t allow = lws_get_peer_write_allowance(wsi);
+  size_t max = UPLOAD_SIZE;
+  uint8_t *data, *p;
+  ssize_t n, size;
+
+  if(!up->out.start && !buffer_alloc(&up->out, UPLOAD_CHUNK_HEAD + UPLOAD_SIZE + UPLOAD_CHUNK_TAIL))
+    return -1;
+
+  if(allow == 0) {
+    lws_callback_on_writable(wsi);
+    return 0;
+  }
+
+  if(allow > 0 && (size_t)allow < max)
+    max = allow;
+
+  data = p = up->out.start + UPLOAD_CHUNK_HEAD;
+
+  if((n = upload_fill(client, data, max, ctx)) == -1)
+    return -1;
+
+  /* waiting for an async iterator, upload_settled() asks for the next callback */
+  if(n == 0 && !up->done)
+    return 0;
+
+  size = n;
+
+  if(up->chunked) {
+    if(n > 0) {
+      char head[UPLOAD_CHUNK_HEAD + 1];
+      int len = snprintf(head, sizeof(head), "%zx\r\n", (size_t)n);
+
+      memcpy(p -= len, head, len);
+      memcpy(data + size, "\r\n", 2);
+      size += 2;
+    }
+
+    if(up->done) {
+      memcpy(data + size, "0\r\n\r\n", 5);
+      size += 5;
+    }
+
+    size += data - p;
+  }
+
+  if(lws_write(wsi, p, size, up->done ? LWS_WRITE_HTTP_FINAL : LWS_WRITE_HTTP) != size)
+    return -1;
+
+  up->sent += n;
+
+  if(up->done)
+    lws_client_http_body_pending(wsi, 0);
+  else
+    lws_callback_on_writable(wsi);
+
+  return 0;
+}
+
+/**
+ * Reads the 'saveTo' and 'digest' options. The file is created only when a
+ * successful response arrives.
+ *
+ * @return -1 with an exception thrown on failure
+ */
+int
+client_save_init(MinnetClient* client, JSValueConst options, JSContext* ctx) {
+  ClientSave* save = &client->save;
+  JSValue path, digest;
+  int ret = 0;
+
+  memset(save, 0, sizeof(ClientSave));
+  save->fd = -1;
+  save->digest = JS_NULL;
+
+  if(!ctx)
+    return 0;
+
+  path = JS_GetPropertyStr(ctx, options, "saveTo");
+  digest = JS_GetPropertyStr(ctx, options, "digest");
+
+  if(JS_IsString(path)) {
+    save->path = js_tostring(ctx, path);
+
+    if(!js_is_nullish(digest)) {
+      if(!(save->hash = minnet_hash_data2(ctx, digest)))
+        ret = -1;
+      else
+        save->digest = JS_DupValue(ctx, digest);
+    }
+  }
+
+  JS_FreeValue(ctx, path);
+  JS_FreeValue(ctx, digest);
+  return ret;
+}
+
+static BOOL
+save_writeall(int fd, const uint8_t* data, size_t len) {
+  while(len > 0) {
+    ssize_t r = write(fd, data, len);
+
+    if(r == -1) {
+      if(errno == EINTR)
+        continue;
+
+      return FALSE;
+    }
+
+    data += r;
+    len -= r;
+  }
+
+  return TRUE;
+}
+
+static BOOL
+save_flush(ClientSave* save) {
+  BOOL ok = save_writeall(save->fd, save->buf.read, buffer_REMAIN(&save->buf));
+
+  buffer_reset(&save->buf);
+  return ok;
+}
+
+static BOOL
+save_write(ClientSave* save, const void* data, size_t len) {
+  if(save->hash && !save->hash->finalized)
+    hash_update(save->hash, data, len);
+
+  save->bytes += len;
+
+  if((size_t)buffer_AVAIL(&save->buf) < len && !save_flush(save))
+    return FALSE;
+
+  /* larger than the buffer: straight to the file */
+  if((size_t)buffer_AVAIL(&save->buf) < len)
+    return save_writeall(save->fd, data, len);
+
+  return buffer_write(&save->buf, data, len);
+}
+
+static char*
+save_partname(const char* path) {
+  size_t len = strlen(path);
+  char* name;
+
+  if((name = malloc(len + 6))) {
+    memcpy(name, path, len);
+    memcpy(name + len, ".part", 6);
+  }
+
+  return name;
+}
+
+/* Creates "<path>.part", to be renamed when the body is complete */
+static BOOL
+save_open(ClientSave* save) {
+  char* part;
+
+  if(!(part = save_partname(save->path)))
+    return FALSE;
+
+  save->fd = open(part, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  free(part);
+
+  if(save->fd == -1 || (!save->buf.start && !buffer_alloc(&save->buf, SAVE_BUFFER)))
+    return FALSE;
+
+  return TRUE;
+}
+
+static BOOL
+save_finish(ClientSave* save) {
+  BOOL ok = save_flush(save);
+  char* part = save_partname(save->path);
+
+  ok = close(save->fd) == 0 && ok;
+  save->fd = -1;
+
+  if(part) {
+    if(!ok || rename(part, save->path) == -1) {
+      unlink(part);
+      ok = FALSE;
+    }
+
+    free(part);
+  }
+
+  if(save->hash && !save->hash->finalized)
+    hash_finalize(save->hash);
+
+  return ok;
+}
+
+/* Drops an incomplete download */
+static void
+save_abort(ClientSave* save) {
+  char* part;
+
+  if(save->fd == -1)
+    return;
+
+  close(save->fd);
+  save->fd = -1;
+
+  if((part = save_partname(save->path))) {
+    unlink(part);
+    free(part);
+  }
+}
+
+void
+client_save_clear(MinnetClient* client, JSRuntime* rt) {
+  ClientSave* save = &client->save;
+
+  save_abort(save);
+
+  if(save->path) {
+    js_free_rt(rt, save->path);
+    save->path = 0;
+  }
+
+  JS_FreeValueRT(rt, save->digest);
+  save->digest = JS_NULL;
+  save->hash = 0;
+
+  buffer_free(&save->buf);
+}
+
+static const char* const cache_modes[] = {
+    "default",
+    "no-store",
+    "reload",
+    "no-cache",
+    "force-cache",
+};
+
+/* Fills a response from the stored entry */
+static void
+client_cache_apply(MinnetClient* client, MinnetResponse* resp, JSContext* ctx) {
+  CacheEntry* entry = client->cache.entry;
+  Generator* gen = response_generator(resp, ctx);
+
+  resp->status = entry->status;
+
+  if(resp->status_text)
+    js_free(ctx, resp->status_text);
+
+  resp->status_text = entry->status_text ? js_strdup(ctx, entry->status_text) : 0;
+
+  headers_free(&resp->headers);
+  headers_clone(&resp->headers, &entry->headers);
+
+  if(block_SIZE(&entry->body))
+    generator_write(gen, entry->body.start, block_SIZE(&entry->body), JS_UNDEFINED);
+
+  client->cache.hit = TRUE;
+}
+
+/**
+ * Reads the 'cache' option and looks the request up in the fetch() cache.
+ * A stale entry turns the request into a conditional one.
+ *
+ * @return 1 when a stored response can be used without a request, -1 with
+ * an exception thrown on failure
+ */
+int
+client_cache_init(MinnetClient* client, JSValueConst options, JSContext* ctx) {
+  ClientCache* cc = &client->cache;
+  Headers* headers;
+  JSValue value;
+  const char* method = "GET";
+  BOOL cacheable;
+  int ret = 0;
+
+  memset(cc, 0, sizeof(ClientCache));
+
+  if(!ctx || !fetch_cache)
+    return 0;
+
+  headers = &client->request->headers;
+  value = JS_GetPropertyStr(ctx, options, "cache");
+
+  if(JS_IsString(value)) {
+    const char* str = JS_ToCString(ctx, value);
+    size_t i;
+
+    for(i = 0; i < countof(cache_modes); i++)
+      if(!strcmp(str, cache_modes[i]))
+        break;
+
+    if(i == countof(cache_modes))
+      JS_ThrowTypeError(ctx, "invalid cache mode '%s'", str);
+    else
+      cc->mode = i;
+
+    JS_FreeCString(ctx, str);
+
+    if(i == countof(cache_modes)) {
+      JS_FreeValue(ctx, value);
+      return -1;
+    }
+  }
+
+  JS_FreeValue(ctx, value);
+
+  value = JS_GetPropertyStr(ctx, options, "method");
+
+  if(JS_IsString(value))
+    method = JS_ToCString(ctx, value);
+
+  cacheable = !strcasecmp(method, "GET");
+
+  /* unsafe methods invalidate what is stored for the target */
+  if(!cacheable && strcasecmp(method, "HEAD") && strcasecmp(method, "OPTIONS")) {
+    char* url;
+
+    if((url = url_format(client->request->url, ctx))) {
+      cache_invalidate(fetch_cache, url);
+      js_free(ctx, url);
+    }
+  }
+
+  if(JS_IsString(value))
+    JS_FreeCString(ctx, method);
+
+  JS_FreeValue(ctx, value);
+
+  /* conditional requests of the caller and downloads bypass the cache */
+  if(!cacheable || cc->mode == CACHE_NO_STORE || cache_bypass(headers) || client->save.path || headers_find(headers, "if-none-match", "\r\n") >= 0 ||
+     headers_find(headers, "if-modified-since", "\r\n") >= 0 || headers_find(headers, "range", "\r\n") >= 0)
+    return 0;
+
+  if(!(cc->url = url_format(client->request->url, ctx))) {
+    JS_ThrowOutOfMemory(ctx);
+    return -1;
+  }
+
+  if(cc->mode != CACHE_RELOAD && (cc->entry = cache_lookup(fetch_cache, "GET", cc->url, headers))) {
+    if(cc->mode == CACHE_FORCE_CACHE || (cc->mode == CACHE_DEFAULT && cache_fresh(cc->entry, time(0)))) {
+      fetch_cache->hits++;
+      ret = 1;
+    } else {
+      fetch_cache->stale++;
+
+      if(!cache_validators(cc->entry, headers)) {
+        /* nothing to revalidate with, fetch it again */
+        cache_entry_free(cc->entry);
+        cc->entry = 0;
+      }
+    }
+  }
+
+  return ret;
+}
+
+/* The stored response, for a request that was not sent */
+JSValue
+client_cache_response(MinnetClient* client, JSContext* ctx) {
+  MinnetResponse* resp;
+  char* type;
+
+  if(!client->response)
+    client->response = response_new(ctx);
+
+  resp = client->response;
+
+  url_copy(&resp->url, client->request->url, ctx);
+  client_cache_apply(client, resp, ctx);
+
+  if((type = response_type(resp, ctx))) {
+    if(!strncmp(type, "text/", 5))
+      resp->body->block_fn = &block_tostring;
+    js_free(ctx, type);
+  }
+
+  generator_finish(resp->body);
+
+  return minnet_response_wrap(ctx, resp);
+}
+
+void
+client_cache_clear(MinnetClient* client, JSRuntime* rt) {
+  ClientCache* cc = &client->cache;
+
+  if(cc->entry) {
+    cache_entry_free(cc->entry);
+    cc->entry = 0;
+  }
+
+  if(cc->url) {
+    js_free_rt(rt, cc->url);
+    cc->url = 0;
+  }
+
+  buffer_free(&cc->body);
+  cc->store = FALSE;
+}
+
+/* Keeps the body of a storable response, up to what the cache can hold */
+static void
+client_cache_write(MinnetClient* client, const void* data, size_t len) {
+  ClientCache* cc = &client->cache;
+
+  if(!fetch_cache || buffer_HEAD(&cc->body) + len > fetch_cache->max_bytes || buffer_append(&cc->body, data, len) == -1) {
+    buffer_free(&cc->body);
+    cc->store = FALSE;
+  }
+}
+
+static void
+client_response(MinnetClient* client, struct session_data* session, JSContext* ctx) {
+  if(client->on.http.ctx) {
+    JSValue retval = client_exception(client, callback_emit_this(&client->on.http, session->ws_obj, 2, &session->req_obj));
+
+    if(!js_is_nullish(retval)) {
+      BOOL terminate = JS_ToBool(ctx, retval);
+
+      if(terminate)
+        client->lwsret = 1;
+    }
+
+    JS_FreeValue(client->on.http.ctx, retval);
+  }
+}
+
+static size_t
+client_high_water(MinnetClient* client) {
+  return client->high_water ? client->high_water : RECEIVE_HIGH_WATER;
+}
+
+/* The response body is received only as fast as it is iterated */
+static void
+client_body_drain(Generator* gen, void* opaque) {
+  MinnetClient* client = opaque;
+
+  if(client->wsi && (!gen->q || queue_bytes(gen->q) < client_high_water(client) / 2))
+    lws_rx_flow_control(client->wsi, 1);
+}
+
+static void
+client_body_detach(MinnetResponse* resp) {
+  if(resp && resp->body && resp->body->drain_fn) {
+    resp->body->drain_fn = 0;
+    resp->body->drain_opaque = 0;
+  }
+}
+
 int
 http_client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, void* in, size_t len) {
 
@@ -151,7 +967,27 @@ http_client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
 
       *(uint8_t**)in += n;
 
-      if(method_number(client->connect_info.method) == METHOD_POST && !lws_http_is_redirected_to_get(wsi)) {
+      if(upload_pending(client) && !lws_http_is_redirected_to_get(wsi)) {
+        ClientUpload* up = &client->upload;
+        uint8_t** p = in;
+
+        if(headers_findb(&req->headers, "transfer-encoding", 17, "\r\n") != -1) {
+          up->chunked = !req->h2;
+        } else if(headers_findb(&req->headers, "content-length", 14, "\r\n") == -1) {
+          if(up->length >= 0) {
+            char str[32];
+            int len = snprintf(str, sizeof(str), "%" PRId64, up->length);
+
+            if(lws_add_http_header_by_token(wsi, WSI_TOKEN_HTTP_CONTENT_LENGTH, (const unsigned char*)str, len, p, buf.end))
+              return -1;
+          } else if(!req->h2) {
+            if(lws_add_http_header_by_token(wsi, WSI_TOKEN_HTTP_TRANSFER_ENCODING, (const unsigned char*)"chunked", 7, p, buf.end))
+              return -1;
+
+            up->chunked = TRUE;
+          }
+        }
+
         lws_client_http_body_pending(wsi, 1);
         lws_callback_on_writable(wsi);
       }
@@ -172,6 +1008,8 @@ http_client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
       MinnetResponse* resp;
       char* type;
 
+      client_tls_established(client, wsi);
+
       if(strcmp(lws_get_protocol(wsi)->name, "ws"))
         opaque->status = OPEN;
 
@@ -187,6 +1025,22 @@ http_client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
         session->resp_obj = minnet_response_wrap(ctx, opaque->resp);
       }
 
+      /* blocking fetch() hands in its response */
+      if(!resp->status) {
+        resp->status = lws_http_client_http_response(wsi);
+        headers_tobuffer(ctx, &resp->headers, wsi);
+      }
+
+      /* revalidated: the stored response stands in for the 304 */
+      if(client->cache.entry && resp->status == 304) {
+        if(fetch_cache)
+          cache_refresh(fetch_cache, client->cache.entry, &resp->headers);
+
+        client_cache_apply(client, resp, ctx);
+      } else if(client->cache.url && cache_storable(&resp->headers, resp->status)) {
+        client->cache.store = TRUE;
+      }
+
       if((type = response_type(resp, ctx))) {
         if(!strncmp(type, "text/", 5))
           resp->body->block_fn = &block_tostring;
@@ -195,6 +1049,11 @@ http_client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
 
       url_copy(&resp->url, client->request->url, ctx);
 
+      if(resp->body) {
+        resp->body->drain_fn = client_body_drain;
+        resp->body->drain_opaque = client;
+      }
+
       // opaque->resp->headers = headers_gettoken(ctx, wsi, WSI_TOKEN_HTTP_CONTENT_TYPE);
 
       if(!opaque->ws)
@@ -204,7 +1063,7 @@ http_client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
 
       lwsl_user("%-26s" FGC(171, "%-34s") "wsi#%d status=%d\n", "CLIENT-HTTP", lws_callback_name(reason) + 13, opaque ? (int)opaque->serial : -1, resp->status);
 
-      {
+      if(!client->cache.hit) {
         size_t i, hdrlen = lws_hdr_total_length(wsi, WSI_TOKEN_HTTP);
         char buf[(((hdrlen + 1) + 7) >> 3) << 3];
         lws_hdr_copy(wsi, buf, sizeof(buf), WSI_TOKEN_HTTP);
@@ -222,16 +1081,14 @@ http_client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
         JS_FreeValue(ctx, cli);
       }
 
-      if(client->on.http.ctx) {
-        JSValue retval = client_exception(client, callback_emit_this(&client->on.http, session->ws_obj, 2, &session->req_obj));
-        if(!js_is_nullish(retval)) {
-          BOOL terminate = JS_ToBool(ctx, retval);
-
-          if(terminate) {
-            client->lwsret = 1;
-          }
+      /* a saved body is reported once it is complete */
+      if(client->save.path && resp->status >= 200 && resp->status <= 299) {
+        if(!save_open(&client->save)) {
+          lwsl_err("saveTo: cannot write '%s': %s\n", client->save.path, strerror(errno));
+          return -1;
         }
-        JS_FreeValue(client->on.http.ctx, retval);
+      } else {
+        client_response(client, session, ctx);
       }
 
       if(resp->status >= 400) {
@@ -240,19 +1097,28 @@ http_client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
         lws_wsi_close(wsi, LWS_TO_KILL_SYNC);
       }
 
-      if(method_number(client->connect_info.method) == METHOD_POST) {
-        lws_client_http_body_pending(wsi, 1);
-        lws_callback_on_writable(wsi);
-      }
-
       return ret;
     }
 
     case LWS_CALLBACK_CLOSED_CLIENT_HTTP: {
+      client_tls_save(client);
+
+      /* closed before the body was complete */
+      if(client->save.fd != -1) {
+        save_abort(&client->save);
+
+        if(js_async_pending(&client->promise)) {
+          JSValue err = js_error_new(ctx, "saveTo: connection closed before the body of '%s' was complete", client->save.path);
+          js_async_reject(ctx, &client->promise, err);
+          JS_FreeValue(ctx, err);
+        }
+      }
 
       if(client->iter)
         asynciterator_stop(client->iter, JS_UNDEFINED, ctx);
 
+      client_body_detach(opaque->resp);
+
       if(opaque->resp) {
         /*if(opaque->resp->body)
           generator_finish(opaque->resp->body);*/
@@ -299,76 +1165,49 @@ http_client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
         return 0;
       }
 
-      if(method_number(client->connect_info.method) == METHOD_POST) {
-        BOOL done = FALSE;
-        JSValue value;
-        int n;
-        ssize_t size, r;
-        // MinnetRequest* req = client->request;
-        ByteBuffer buf;
-        buffer_alloc(&buf, 1024);
-
-        if(lws_http_is_redirected_to_get(wsi))
+      if(upload_pending(client)) {
+        if(lws_http_is_redirected_to_get(wsi)) {
+          lws_client_http_body_pending(wsi, 0);
           break;
-
-        if(JS_IsObject(client->body)) {
-          while(!done) {
-            value = js_iterator_next(ctx, client->body, &client->next, &done, 0, 0);
-
-#ifdef DEBUT_OUTPUT
-            printf("js_iterator_next() = %s %i done=%i\n", JS_ToCString(ctx, value), JS_VALUE_GET_TAG(value), done);
-#endif
-
-            if(JS_IsException(value)) {
-              JSValue exception = JS_GetException(ctx);
-              js_error_print(ctx, exception);
-              JS_Throw(ctx, exception);
-            } else if(!js_is_nullish(value)) {
-              JSBuffer input = js_buffer_new(ctx, value);
-              // js_std_dump_error(ctx);
-
-#ifdef DEBUT_OUTPUT
-              printf("\x1b[2K\ryielded %p %zu\n", input.data, input.size);
-#endif
-
-              buffer_append(&buf, input.data, input.size);
-#ifdef DEBUT_OUTPUT
-              printf("\x1b[2K\rbuffered %zu/%zu bytes\n", buffer_REMAIN(&buf), buffer_HEAD(&buf));
-#endif
-
-              js_buffer_free(&input, JS_GetRuntime(ctx));
-            }
-
-            break;
-          }
-        } else if(!js_is_nullish(client->body)) {
-          buffer_fromvalue(&buf, client->body, ctx);
-          done = TRUE;
         }
 
-        n = done ? LWS_WRITE_HTTP_FINAL : LWS_WRITE_HTTP;
-        size = buf.write - buf.start;
-        if((r = lws_write(wsi, buf.start, size, (enum lws_write_protocol)n)) != size)
-          return 1;
-#ifdef DEBUT_OUTPUT
-        printf("\x1b[2K\rwrote %zd%s\n", r, n == LWS_WRITE_HTTP_FINAL ? " (final)" : "");
-#endif
-
-        if(n != LWS_WRITE_HTTP_FINAL)
-          lws_callback_on_writable(wsi);
+        if(upload_write(client, wsi, ctx))
+          return -1;
       }
       return 0;
     }
 
     case LWS_CALLBACK_RECEIVE_CLIENT_HTTP: {
-      int ret;
-      static uint8_t buffer[1024 + LWS_PRE];
-      ByteBuffer buf = BUFFER(buffer);
-      int len = buffer_AVAIL(&buf);
-      // lwsl_user("http #1  " FGC(171, "%-38s") " fd=%d buf=%p write=%zu len=%d\n", lws_callback_name(reason) + 13, lws_get_socket_fd(wsi), block_BEGIN(&buf), buffer_HEAD(&buf), len);
-      ret = lws_http_client_read(wsi, (char**)&buf.write, &len);
-      if(ret)
+      ByteBuffer* buf = &client->rxbuf;
+      size_t size, raw;
+      char* ptr;
+      int avail;
+
+      if(!buf->start && !buffer_alloc(buf, RECEIVE_SIZE))
         return -1;
+
+      ptr = (char*)buf->start;
+      avail = buffer_SIZE(buf);
+      client->rx_bytes = 0;
+
+      if(lws_http_client_read(wsi, &ptr, &avail))
+        return -1;
+
+      /* lws advances ptr over everything it took from the socket, chunk
+       * framing included, while rx_bytes only counts the decoded body */
+      raw = MAX((size_t)(ptr - (char*)buf->start), client->rx_bytes);
+      size = buffer_SIZE(buf);
+
+      /* bulk transfer: the read filled the buffer, so double it for the next
+       * one. Back to half when a read needed less than a quarter */
+      if(raw >= size && size < RECEIVE_MAX) {
+        buffer_free(buf);
+        buffer_alloc(buf, MIN(size * 2, RECEIVE_MAX));
+      } else if(raw < size / 4 && size > RECEIVE_SIZE) {
+        buffer_free(buf);
+        buffer_alloc(buf, MAX(size / 2, RECEIVE_SIZE));
+      }
+
       return 0;
     }
 
@@ -398,8 +1237,26 @@ http_client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
       printf("LWS_CALLBACK_RECEIVE_CLIENT_HTTP_READ len=%zu in='%.*s'", len, /*len > 30 ? 30 :*/ (int)len, (char*)in);
 #endif
 
+      client->rx_bytes += len;
+
+      if(client->cache.store)
+        client_cache_write(client, in, len);
+
+      if(client->save.fd != -1) {
+        if(!save_write(&client->save, in, len)) {
+          lwsl_err("saveTo: write to '%s' failed: %s\n", client->save.path, strerror(errno));
+          return -1;
+        }
+
+        return 0;
+      }
+
       generator_write(resp->body, in, len, JS_UNDEFINED);
 
+      /* arrayBuffer()/text() accumulate instead and are never throttled */
+      if(resp->body->drain_fn && resp->body->q && !resp->body->q->continuous && queue_bytes(resp->body->q) >= client_high_water(client))
+        lws_rx_flow_control(wsi, 0);
+
       return 0;
     }
 
@@ -407,11 +1264,33 @@ http_client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
       MinnetResponse* resp = opaque->resp;
       /*  Generator* gen = resp->body;*/
 
+      client_tls_save(client);
+
       LOGCB("CLIENT-HTTP(2)", "resp->body=%p resp->body->q=%p", resp->body, resp->body->q);
 
-      //
+      client_body_detach(resp);
       generator_finish(resp->body);
 
+      if(client->cache.store && fetch_cache) {
+        ClientCache* cc = &client->cache;
+        CacheEntry* entry;
+
+        if((entry = cache_store(fetch_cache, "GET", cc->url, &client->request->headers, resp->status, client->response->status_text, &resp->headers, cc->body.start, buffer_HEAD(&cc->body))))
+          cache_entry_free(entry);
+
+        buffer_free(&cc->body);
+        cc->store = FALSE;
+      }
+
+      if(client->save.fd != -1) {
+        if(!save_finish(&client->save)) {
+          lwsl_err("saveTo: cannot complete '%s': %s\n", client->save.path, strerror(errno));
+          return -1;
+        }
+
+        client_response(client, session, ctx);
+      }
+
       if(client->on.http.ctx) {
         /*        MinnetRequest* req;
                 MinnetResponse* resp = minnet_response_data2(client->on.http.ctx, session->resp_obj);
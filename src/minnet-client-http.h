@@ -4,6 +4,15 @@
 #include "minnet-request.h"
 #include <libwebsockets.h>
 
+struct client_context;
+
+int client_upload_init(struct client_context*, JSValueConst body, JSContext* ctx);
+void client_upload_clear(struct client_context*, JSRuntime* rt);
+int client_save_init(struct client_context*, JSValueConst options, JSContext* ctx);
+void client_save_clear(struct client_context*, JSRuntime* rt);
+int client_cache_init(struct client_context*, JSValueConst options, JSContext* ctx);
+JSValue client_cache_response(struct client_context*, JSContext* ctx);
+void client_cache_clear(struct client_context*, JSRuntime* rt);
 int http_client_callback(struct lws*, enum lws_callback_reasons reason, void* user, void* in, size_t len);
 
 #endif /* MINNET_CLIENT_HTTP_H */
@@ -6,6 +6,8 @@
 #include "minnet-response.h"
 #include "minnet-asynciterator.h"
 #include "minnet-generator.h"
+#include "minnet-resolver.h"
+#include "minnet-tls.h"
 #include "context.h"
 #include "closure.h"
 #include "minnet.h"
@@ -21,6 +23,7 @@ THREAD_LOCAL JSClassID minnet_client_class_id;
 // static JSCallback client_cb_message, client_cb_connect, client_cb_close, client_cb_pong, client_cb_fd;
 
 static int client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, void* in, size_t len);
+static void client_reconnect_clear(MinnetClient*, JSRuntime*);
 
 static THREAD_LOCAL struct list_head minnet_clients = {0, 0};
 
@@ -28,6 +31,7 @@ static const struct lws_protocols client_protocols[] = {
     {"raw", client_callback, 0, 0, 0, 0, 0},
     {"http", http_client_callback, 0, 0, 0, 0, 0},
     {"ws", client_callback, 0, 0, 0, 0, 0},
+    {"minnet-dns", resolver_callback, 0, 0, 0, 0, 0},
     LWS_PROTOCOL_LIST_TERM,
 };
 
@@ -111,6 +115,13 @@ client_free(MinnetClient* client, JSRuntime* rt) {
     JS_FreeValueRT(rt, client->next);
     client->next = JS_UNDEFINED;
 
+    client_upload_clear(client, rt);
+    client_save_clear(client, rt);
+    client_cache_clear(client, rt);
+    client_tls_clear(client);
+    client_reconnect_clear(client, rt);
+    buffer_free(&client->rxbuf);
+
     client->connect_info.method = 0;
 
     js_async_free(rt, &client->promise);
@@ -138,6 +149,17 @@ client_zero(MinnetClient* client) {
   client->body = JS_NULL;
   client->next = JS_NULL;
 
+  client_upload_init(client, JS_NULL, 0);
+  client_save_init(client, JS_NULL, 0);
+  client_cache_init(client, JS_NULL, 0);
+
+  client->resolve.address[0] = '\0';
+  client->resolve.query = 0;
+  client->tls.credentials = 0;
+  client->tls.saved = FALSE;
+  memset(&client->reconnect, 0, sizeof(ClientReconnect));
+  client->reconnect.timer = JS_UNDEFINED;
+
   session_init(&client->session, 0);
   js_async_zero(&client->promise);
   callbacks_zero(&client->on);
@@ -151,6 +173,156 @@ client_zero(MinnetClient* client) {
   // asynciterator_zero(&client->iter);
 }
 
+/**
+ * Opens the connection described by connect_info, a udp:// URL gets an
+ * adopted UDP socket instead, bound to host:port with the 'bind' option.
+ */
+struct lws*
+client_connect(MinnetClient* client) {
+#ifdef LWS_WITH_UDP
+  if(protocol_number(client->request->url.protocol) == PROTOCOL_RAW && !strcmp(client->request->url.protocol, "udp")) {
+    struct lws_vhost* vhost;
+    MinnetURL* url = &client->request->url;
+
+    vhost = lws_create_vhost(client->context.lws, &client->context.info);
+    return *client->connect_info.pwsi = lws_create_adopt_udp(vhost, url->host, url->port, client->bind ? LWS_CAUDP_BIND : 0, "raw", 0, 0, 0, 0, 0);
+  }
+#endif
+
+  return lws_client_connect_via_info(&client->connect_info);
+}
+
+/**
+ * Reads the 'reconnect' option, true or an object with backoff, maxDelay,
+ * jitter and bufferSize.
+ */
+static void
+client_reconnect_init(MinnetClient* client, JSValueConst options, JSContext* ctx) {
+  ClientReconnect* rc = &client->reconnect;
+  JSValue value = JS_GetPropertyStr(ctx, options, "reconnect");
+
+  if(JS_IsObject(value) || JS_ToBool(ctx, value)) {
+    rc->backoff = 500;
+    rc->max_delay = 30000;
+    rc->jitter = 0.5;
+    rc->buffer = 1048576;
+
+    if(JS_IsObject(value)) {
+      JSValue jitter;
+
+      if(js_has_propertystr(ctx, value, "backoff"))
+        rc->backoff = js_get_propertystr_uint32(ctx, value, "backoff");
+      if(js_has_propertystr(ctx, value, "maxDelay"))
+        rc->max_delay = js_get_propertystr_uint32(ctx, value, "maxDelay");
+      if(js_has_propertystr(ctx, value, "bufferSize"))
+        rc->buffer = js_get_propertystr_uint32(ctx, value, "bufferSize");
+
+      jitter = JS_GetPropertyStr(ctx, value, "jitter");
+
+      if(JS_IsNumber(jitter)) {
+        JS_ToFloat64(ctx, &rc->jitter, jitter);
+        rc->jitter = rc->jitter < 0 ? 0 : rc->jitter > 1 ? 1 : rc->jitter;
+      }
+
+      JS_FreeValue(ctx, jitter);
+    }
+
+    /* 0 means not reconnecting */
+    if(rc->backoff == 0)
+      rc->backoff = 1;
+    if(rc->max_delay < rc->backoff)
+      rc->max_delay = rc->backoff;
+  }
+
+  JS_FreeValue(ctx, value);
+}
+
+static void
+client_reconnect_clear(MinnetClient* client, JSRuntime* rt) {
+  ClientReconnect* rc = &client->reconnect;
+  MinnetWebsocket* ws;
+
+  if(!JS_IsUndefined(rc->timer)) {
+    js_timer_cancel(client->context.js, rc->timer);
+    JS_FreeValueRT(rt, rc->timer);
+    rc->timer = JS_UNDEFINED;
+  }
+
+  /* the send queue goes away with the session */
+  if((ws = minnet_ws_data(client->session.ws_obj)))
+    ws->pending = 0;
+}
+
+static JSValue client_reconnect_timeout(JSContext*, JSValueConst, int, JSValueConst[], int, void*);
+
+/**
+ * Plans the next connection attempt, the delay doubles with each failed one
+ * up to max_delay and has a random part of it taken off.
+ *
+ * @return TRUE when the client is going to reconnect
+ */
+static BOOL
+client_reconnect_schedule(MinnetClient* client) {
+  ClientReconnect* rc = &client->reconnect;
+  MinnetWebsocket* ws = minnet_ws_data(client->session.ws_obj);
+  JSContext* ctx = client->context.js;
+  uint64_t delay = rc->backoff;
+  uint32_t r, i;
+  JSValue fn;
+
+  if(!rc->backoff || (ws && ws->closed))
+    return FALSE;
+
+  if(!JS_IsUndefined(rc->timer))
+    return TRUE;
+
+  for(i = 0; i < rc->attempt && delay < rc->max_delay; i++)
+    delay *= 2;
+
+  if(delay > rc->max_delay)
+    delay = rc->max_delay;
+
+  if(rc->jitter > 0 && lws_get_random(client->context.lws, &r, sizeof(r)) == sizeof(r))
+    delay -= (uint64_t)(delay * rc->jitter * ((double)r / UINT32_MAX));
+
+  /* sends are kept in 'pending' until connected again */
+  if(ws)
+    ws->lwsi = 0;
+
+  fn = js_function_cclosure(ctx, client_reconnect_timeout, 0, 0, client, 0);
+  rc->timer = js_timer_start(ctx, fn, delay);
+  JS_FreeValue(ctx, fn);
+
+  return TRUE;
+}
+
+static JSValue
+client_reconnect_timeout(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* opaque) {
+  MinnetClient* client = opaque;
+  MinnetWebsocket* ws = minnet_ws_data(client->session.ws_obj);
+
+  JS_FreeValue(ctx, client->reconnect.timer);
+  client->reconnect.timer = JS_UNDEFINED;
+
+  /* close() while waiting */
+  if(ws && ws->closed) {
+    queue_clear(&client->session.sendq, JS_GetRuntime(ctx));
+    return JS_UNDEFINED;
+  }
+
+  client->reconnect.attempt++;
+  client->wsi = 0;
+
+  client_tls_load(client);
+
+  int resolved = client_resolve(client);
+
+  if(resolved < 0 || (!resolved && !client_connect(client)))
+    client_reconnect_schedule(client);
+
+  return JS_UNDEFINED;
+}
+
 MinnetClient*
 client_dup(MinnetClient* client) {
   ++client->ref_count;
@@ -184,6 +356,10 @@ client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, v
   if(lws_reason_poll(reason))
     return wsi_handle_poll(wsi, reason, &client->on.fd, in);
 
+  /* 'wsi' is a stand-in, 'user' the SSL_CTX */
+  if(reason == LWS_CALLBACK_OPENSSL_LOAD_EXTRA_CLIENT_VERIFY_CERTS)
+    return client_tls_apply(client, user);
+
   if(lws_reason_http(reason))
     return http_client_callback(wsi, reason, user, in, len);
 
@@ -226,7 +402,9 @@ client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, v
 
     case LWS_CALLBACK_WS_CLIENT_BIND_PROTOCOL:
     case LWS_CALLBACK_RAW_SKT_BIND_PROTOCOL: {
-      session_init(&client->session, wsi_context(wsi));
+      /* a reconnecting client keeps its socket and send queue */
+      if(!JS_IsObject(client->session.ws_obj))
+        session_init(&client->session, wsi_context(wsi));
       break;
     }
 
@@ -243,8 +421,16 @@ client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, v
 
     case LWS_CALLBACK_WSI_CREATE:
     case LWS_CALLBACK_SERVER_NEW_CLIENT_INSTANTIATED: {
-      if(!opaque->ws)
-        opaque->ws = ws_new(wsi, ctx);
+      MinnetWebsocket* ws;
+
+      if(!opaque->ws) {
+        if((ws = minnet_ws_data(client->session.ws_obj))) {
+          opaque->ws = ws_dup(ws);
+          opaque->fd = lws_get_socket_fd(wsi);
+        } else {
+          opaque->ws = ws_new(wsi, ctx);
+        }
+      }
       break;
     }
 
@@ -258,6 +444,10 @@ client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, v
     case LWS_CALLBACK_WS_PEER_INITIATED_CLOSE:
     case LWS_CALLBACK_CLIENT_CONNECTION_ERROR: {
       int32_t result = -1, err = -1;
+      BOOL reconnect;
+
+      client_tls_save(client);
+      JS_FreeValue(ctx, client->context.error);
 
       if(reason == LWS_CALLBACK_CLIENT_CONNECTION_ERROR && in) {
         if(!strncmp("conn fail: ", in, 11)) {
@@ -271,7 +461,10 @@ client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, v
 
       opaque->status = CLOSING;
 
-      if(client->iter) {
+      /* onClose/onError still run, the iterator and the promise are kept */
+      reconnect = client_reconnect_schedule(client);
+
+      if(client->iter && !reconnect) {
         if(reason != LWS_CALLBACK_CLIENT_CONNECTION_ERROR)
           if(asynciterator_emplace(client->iter, JS_NULL, TRUE, ctx))
             return 0;
@@ -280,7 +473,7 @@ client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, v
           return 0;
       }
 
-      if(js_async_pending(&client->promise)) {
+      if(js_async_pending(&client->promise) && !reconnect) {
         js_async_reject(ctx, &client->promise, client->context.error);
       }
 
@@ -289,7 +482,7 @@ client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, v
       if(cb->ctx) {
         JSValue ret;
         int argc = 1;
-        JSValueConst argv[4] = {client->session.ws_obj};
+        JSValue argv[4] = {JS_DupValue(ctx, client->session.ws_obj)};
 
         if(reason == LWS_CALLBACK_CLIENT_CONNECTION_ERROR) {
           argv[argc++] = JS_UNDEFINED;
@@ -328,12 +521,34 @@ client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, v
 
       opaque->status = OPEN;
 
+      client_tls_established(client, wsi);
+
       if(!JS_IsObject(client->session.ws_obj))
         client->session.ws_obj = opaque->ws ? minnet_ws_wrap(ctx, opaque->ws) : minnet_ws_fromwsi(ctx, wsi);
 
       opaque->ws = minnet_ws_data(client->session.ws_obj);
 
       opaque->ws->raw = reason == LWS_CALLBACK_RAW_CONNECTED;
+      opaque->ws->lwsi = wsi;
+      opaque->ws->fd = lws_get_socket_fd(wsi);
+
+      if(client->reconnect.backoff) {
+        ClientReconnect* rc = &client->reconnect;
+
+        if(opaque->ws->pending)
+          rc->count++;
+
+        rc->attempt = 0;
+        opaque->ws->pending = &client->session.sendq;
+        opaque->ws->pending_max = rc->buffer;
+        opaque->sess = &client->session;
+
+        /* what was sent while disconnected */
+        client->session.want_write = FALSE;
+
+        if(!queue_empty(&client->session.sendq))
+          session_want_write(&client->session, wsi);
+      }
 
       if(js_async_pending(&client->promise)) {
         JSValue cli = minnet_client_wrap(ctx, client_dup(client));
@@ -344,8 +559,10 @@ client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, v
       }
 
       if(client->on.connect.ctx) {
-        if(reason != LWS_CALLBACK_RAW_CONNECTED)
+        if(reason != LWS_CALLBACK_RAW_CONNECTED) {
+          JS_FreeValue(ctx, client->session.req_obj);
           client->session.req_obj = minnet_request_wrap(ctx, client->request);
+        }
 
         client_exception(client, callback_emit(&client->on.connect, 3, &client->session.ws_obj));
       }
@@ -466,9 +683,10 @@ client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, v
 
     case LWS_CALLBACK_WSI_DESTROY: {
       if(client->wsi == wsi) {
-        BOOL is_error = JS_IsUndefined(client->context.error);
+        BOOL is_error = JS_IsUndefined(client->context.error), reconnecting = !JS_IsUndefined(client->reconnect.timer);
 
-        (is_error ? js_async_reject : js_async_resolve)(client->context.js, &client->promise, client->context.error);
+        if(!reconnecting)
+          (is_error ? js_async_reject : js_async_resolve)(client->context.js, &client->promise, client->context.error);
         JS_FreeValue(client->context.js, client->context.error);
         client->context.error = JS_UNDEFINED;
 
@@ -476,6 +694,9 @@ client_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, v
 
         if(opaque && opaque->ws)
           opaque->ws->lwsi = 0;
+
+        if(reconnecting)
+          client->wsi = 0;
       }
 
       break;
@@ -619,6 +840,7 @@ enum {
   CLIENT_ONPOST,
   CLIENT_ONWRITEABLE,
   CLIENT_LINEBUFFERED,
+  CLIENT_RECONNECTS,
 };
 
 static JSValue
@@ -663,6 +885,11 @@ minnet_client_get(JSContext* ctx, JSValueConst this_val, int magic) {
       ret = JS_NewBool(ctx, client->line_buffered);
       break;
     }
+
+    case CLIENT_RECONNECTS: {
+      ret = JS_NewUint32(ctx, client->reconnect.count);
+      break;
+    }
   }
   return ret;
 }
@@ -852,6 +1079,7 @@ minnet_client_closure(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
   JSValue value, options, ret = JS_UNDEFINED;
   MinnetClient* client = 0;
   struct lws* wsi2;
+  int resolved;
   MinnetProtocol proto;
 
   if(!(client = client_new(ctx)))
@@ -878,29 +1106,6 @@ minnet_client_closure(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
   if(!JS_IsObject(options))
     return JS_ThrowTypeError(ctx, "argument %d must be options object", argind + 1);
 
-  {
-    struct context* context = &client->context;
-
-    context->js = ctx;
-    context->error = JS_NULL;
-
-    memset(&context->info, 0, sizeof(struct lws_context_creation_info));
-    context->info.options = LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
-    context->info.options |= LWS_SERVER_OPTION_H2_JUST_FIX_WINDOW_UPDATE_OVERFLOW;
-    context->info.port = CONTEXT_PORT_NO_LISTEN;
-    context->info.protocols = client_protocols;
-    context->info.user = client;
-
-    if(!context->lws) {
-      //  client_certificate(&client->context, options);
-
-      if(!(context->lws = lws_create_context(&context->info))) {
-        lwsl_err("minnet-client: libwebsockets init failed\n");
-        return JS_ThrowInternalError(ctx, "minnet-client: libwebsockets init failed");
-      }
-    }
-  }
-
   GETCBPROP(options, "onPong", client->on.pong)
   GETCBPROP(options, "onClose", client->on.close)
   GETCBPROP(options, "onConnect", client->on.connect)
@@ -933,6 +1138,13 @@ minnet_client_closure(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
 
   JS_FreeValue(ctx, value);
 
+  value = JS_GetPropertyStr(ctx, options, "bind");
+
+  if(!JS_IsUndefined(value))
+    client->bind = JS_ToBool(ctx, value);
+
+  JS_FreeValue(ctx, value);
+
   value = JS_GetPropertyStr(ctx, options, "body");
 
   if(!JS_IsUndefined(value))
@@ -940,6 +1152,60 @@ minnet_client_closure(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
 
   JS_FreeValue(ctx, value);
 
+  if(client_upload_init(client, client->body, ctx) == -1 || client_save_init(client, options, ctx) == -1) {
+    client_free(client, JS_GetRuntime(ctx));
+    return JS_EXCEPTION;
+  }
+
+  if(magic == RETURN_RESPONSE) {
+    switch(client_cache_init(client, options, ctx)) {
+      case -1: {
+        client_free(client, JS_GetRuntime(ctx));
+        return JS_EXCEPTION;
+      }
+
+      /* stored and fresh, nothing is sent */
+      case 1: {
+        JSValue resp = client_cache_response(client, ctx);
+
+        if(client->blocking)
+          return resp;
+
+        ResolveFunctions fns;
+        ret = js_async_create(ctx, &fns);
+        js_async_resolve(ctx, &fns, resp);
+        JS_FreeValue(ctx, resp);
+        return ret;
+      }
+    }
+  }
+
+  {
+    struct context* context = &client->context;
+
+    context->js = ctx;
+    context->error = JS_NULL;
+
+    memset(&context->info, 0, sizeof(struct lws_context_creation_info));
+    context->info.options = LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+    context->info.options |= LWS_SERVER_OPTION_H2_JUST_FIX_WINDOW_UPDATE_OVERFLOW;
+    context->info.port = CONTEXT_PORT_NO_LISTEN;
+    context->info.protocols = client_protocols;
+    context->info.user = client;
+
+    if(!context->lws) {
+      if(client_tls_init(client, options, ctx) == -1) {
+        client_free(client, JS_GetRuntime(ctx));
+        return JS_EXCEPTION;
+      }
+
+      if(!(context->lws = lws_create_context(&context->info))) {
+        lwsl_err("minnet-client: libwebsockets init failed\n");
+        return JS_ThrowInternalError(ctx, "minnet-client: libwebsockets init failed");
+      }
+    }
+  }
+
   /* value = JS_GetPropertyStr(ctx, options, "headers");
    if(JS_IsObject(value))
      client->headers = JS_DupValue(ctx, value);
@@ -949,6 +1215,13 @@ minnet_client_closure(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
    if(JS_IsObject(client->headers))
      headers_fromobj(&client->request->headers, client->headers, ctx);*/
 
+  value = JS_GetPropertyStr(ctx, options, "highWaterMark");
+
+  if(JS_IsNumber(value))
+    JS_ToUint32(ctx, &client->high_water, value);
+
+  JS_FreeValue(ctx, value);
+
   if(js_has_propertystr(ctx, options, "buffering")) {
     client->buffering = TRUE;
     client->buf_size = js_get_propertystr_uint32(ctx, argv[1], "buffering");
@@ -962,8 +1235,19 @@ minnet_client_closure(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
 
   proto = protocol_number(client->request->url.protocol);
 
+  if(proto == PROTOCOL_WS || proto == PROTOCOL_WSS)
+    client_reconnect_init(client, options, ctx);
+
   url_info(client->request->url, &client->connect_info);
 
+  /* with an sslCA of its own the server certificate has to verify */
+  value = JS_GetPropertyStr(ctx, options, "sslCA");
+
+  if(!JS_IsUndefined(value) && !JS_IsNull(value))
+    client->connect_info.ssl_connection &= ~(LCCSCF_ALLOW_SELFSIGNED | LCCSCF_ALLOW_INSECURE);
+
+  JS_FreeValue(ctx, value);
+
   value = JS_GetPropertyStr(ctx, options, "protocol");
   if(!JS_IsUndefined(value)) {
     const char* str = JS_ToCString(ctx, value);
@@ -1044,32 +1328,28 @@ minnet_client_closure(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
     client->on.close = CALLBACK_INIT(ctx, js_function_cclosure(ctx, minnet_client_onclose, 0, 0, synchfetch_dup(c), synchfetch_free), JS_UNDEFINED);
   }
 
-#ifdef LWS_WITH_UDP
-  if(proto == PROTOCOL_RAW && !strcmp(client->request->url.protocol, "udp")) {
-    struct lws_vhost* vhost;
-    MinnetURL* url = &client->request->url;
+  client_tls_load(client);
 
-    vhost = lws_create_vhost(client->context.lws, &client->context.info);
-    wsi2 = lws_create_adopt_udp(vhost, url->host, url->port, 0, "raw", 0, 0, 0, 0, 0);
-    *client->connect_info.pwsi = wsi2;
-  } else
-#endif
-
-    wsi2 = lws_client_connect_via_info(&client->connect_info);
+  /* with a lookup in flight the connection is opened when it completes */
+  resolved = client_resolve(client);
+  wsi2 = resolved ? 0 : client_connect(client);
 
 #ifdef DEBUT_OUTPUT
   printf("client->wsi = %p, wsi2 = %p, h2 = %d, ssl = %d\n", client->wsi, wsi2, wsi_http2(client->wsi), wsi_tls(client->wsi));
 #endif
 
-  if(!client->wsi /*&& !wsi2*/) {
+  if(!client->wsi && !client->resolve.query && !client_reconnect_schedule(client)) {
     if(!client->blocking) {
       if(js_async_pending(&client->promise)) {
-        JSValue err = js_error_new(ctx, "[2] Connection failed: %s", strerror(errno));
+        JSValue err = resolved < 0 ? js_error_new(ctx, "[2] Host not found: %s", client->connect_info.address) : js_error_new(ctx, "[2] Connection failed: %s", strerror(errno));
         js_async_reject(ctx, &client->promise, err);
         JS_FreeValue(ctx, err);
       }
     } else {
       // ret = JS_Throw(ctx, c->exception);
+      if(resolved < 0)
+        ret = JS_Throw(ctx, js_error_new(ctx, "[2] Host not found: %s", client->connect_info.address));
+
       goto fail;
     }
   }
@@ -1179,6 +1459,7 @@ static const JSCFunctionListEntry minnet_client_proto_funcs[] = {
     JS_CGETSET_MAGIC_FLAGS_DEF("onhttp", minnet_client_get, minnet_client_set, CLIENT_ONHTTP, 0),
     JS_CGETSET_MAGIC_FLAGS_DEF("onwriteable", minnet_client_get, minnet_client_set, CLIENT_ONWRITEABLE, 0),
     JS_CGETSET_MAGIC_FLAGS_DEF("lineBuffered", minnet_client_get, minnet_client_set, CLIENT_LINEBUFFERED, 0),
+    JS_CGETSET_MAGIC_FLAGS_DEF("reconnects", minnet_client_get, 0, CLIENT_RECONNECTS, 0),
     // JS_CFUNC_MAGIC_DEF("[Symbol.asyncIterator]", 0, minnet_client_iterator, CLIENT_ASYNCITERATOR),
     JS_PROP_STRING_DEF("[Symbol.toStringTag]", "MinnetClient", JS_PROP_CONFIGURABLE),
 };
@@ -15,6 +15,86 @@
 
 #define client_exception(client, retval) context_exception(&(client->context), (retval))
 
+typedef enum {
+  UPLOAD_NONE = 0,
+  UPLOAD_BUFFER,
+  UPLOAD_FILE,
+  UPLOAD_ITERATOR,
+} UploadSource;
+
+struct upload_closure;
+struct hash_hmac;
+
+/* Request body, sent a window at a time from the writable callback */
+typedef struct client_upload {
+  UploadSource source;
+  JSBuffer input;  /* UPLOAD_BUFFER, or the iterator value being sent */
+  size_t pos;      /* read offset into 'input' */
+  int fd;          /* UPLOAD_FILE */
+  JSValue iterator, next, resolved, rejected;
+  struct upload_closure* closure;
+  ByteBuffer out;  /* allocated on the first write */
+  int64_t length;  /* -1 when unknown */
+  uint64_t sent;
+  BOOL chunked, waiting, eof, done, error;
+} ClientUpload;
+
+/* Response body written to a file instead of the body generator */
+typedef struct client_save {
+  char* path;
+  int fd;              /* on "<path>.part" once a 2xx status arrived */
+  ByteBuffer buf;      /* pending write(2) */
+  JSValue digest;      /* Hash object updated with the body */
+  struct hash_hmac* hash;
+  uint64_t bytes;
+} ClientSave;
+
+typedef enum {
+  CACHE_DEFAULT = 0,
+  CACHE_NO_STORE,
+  CACHE_RELOAD,
+  CACHE_NO_CACHE,
+  CACHE_FORCE_CACHE,
+} CacheMode;
+
+struct cache_entry;
+
+/* fetch() cache use of this request */
+typedef struct client_cache {
+  CacheMode mode;
+  char* url;                 /* key, 0 when the request does not use the cache */
+  struct cache_entry* entry; /* stored response being revalidated */
+  ByteBuffer body;           /* response body while it is to be stored */
+  BOOL store, hit;
+} ClientCache;
+
+struct resolver_query;
+
+/* Host name resolution through setResolver() */
+typedef struct client_resolve {
+  char address[INET_ADDRSTRLEN]; /* connect_info.address points here once resolved */
+  struct resolver_query* query;  /* pending, the connection is opened when it completes */
+} ClientResolve;
+
+struct tls_credentials;
+
+/* TLS material and session reuse of this client */
+typedef struct client_tls {
+  struct tls_credentials* credentials; /* shared, parsed once per runtime */
+  BOOL saved;                          /* session handed to the TLS cache */
+} ClientTLS;
+
+/* Reconnection of a WebSocket client that lost its connection */
+typedef struct client_reconnect {
+  uint32_t backoff;   /* milliseconds before the first attempt, 0 when not reconnecting */
+  uint32_t max_delay; /* the delay doubles after each failed attempt up to this */
+  double jitter;      /* fraction of the delay taken off at random */
+  size_t buffer;      /* bytes sent while disconnected that are kept */
+  uint32_t attempt;   /* failed attempts since the last connection */
+  uint32_t count;     /* connections made again */
+  JSValue timer;      /* pending attempt */
+} ClientReconnect;
+
 typedef struct client_context {
   union {
     struct {
@@ -28,6 +108,12 @@ typedef struct client_context {
   struct lws* wsi;
   CallbackList on;
   JSValue body, next;
+  ClientUpload upload;
+  ClientSave save;
+  ClientCache cache;
+  ClientResolve resolve;
+  ClientTLS tls;
+  ClientReconnect reconnect;
   struct session_data session;
   struct http_request* request;
   struct http_response* response;
@@ -37,7 +123,11 @@ typedef struct client_context {
     Generator* gen;
   };
   Queue* recvq;
+  ByteBuffer rxbuf;    /* response body reads, grows while reads fill it */
+  size_t rx_bytes;     /* delivered by the current read */
+  uint32_t high_water; /* unread response bytes at which receiving pauses, 0 for the default */
   BOOL blocking, buffering, line_buffered, binary;
+  BOOL bind; /* udp:// listens on host:port and answers whoever sent the last datagram */
   size_t buf_size;
   int lwsret;
 } MinnetClient;
@@ -51,6 +141,7 @@ void client_certificate(struct context*, JSValueConst);
 MinnetClient* client_new(JSContext*);
 void client_free(MinnetClient*, JSRuntime*);
 void client_zero(MinnetClient*);
+struct lws* client_connect(MinnetClient*);
 MinnetClient* client_dup(MinnetClient*);
 Generator* client_generator(MinnetClient*, JSContext*);
 struct client_context* lws_client(struct lws*);
@@ -6,9 +6,13 @@
 #include "buffer.h"
 #include "closure.h"
 #include "js-utils.h"
+#include "asynciterator.h"
+#include "cache.h"
 #include <strings.h>
 #include <quickjs.h>
 
+THREAD_LOCAL Cache* fetch_cache = 0;
+
 enum {
   ON_HTTP = 0,
   ON_ERROR,
@@ -117,3 +121,378 @@ minnet_fetch(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[
 
   return ret;
 }
+
+enum {
+  FETCH_ALL_NEXT = 0,
+  FETCH_ALL_RETURN,
+  FETCH_ALL_TIMINGS,
+};
+
+#define FETCH_ALL_CONCURRENCY 6
+
+/* State of a net.fetchAll() run, shared by its iterator methods and the then() handlers of each fetch.
+ * Every request is a plain fetch() with its own client and lws context, no connection is reused per origin */
+typedef struct fetch_all {
+  int ref_count;
+  JSContext* ctx;
+  JSValue requests, options;
+  JSValue results; /* completed and not yet taken by next() */
+  uint32_t head, tail;
+  uint32_t count, started, running, completed, failed, concurrency;
+  BOOL returned; /* return() was called, later results are dropped */
+  AsyncIterator iterator;
+  lws_usec_t start, *started_at;
+  lws_usec_t min, max, total;
+} FetchAll;
+
+static FetchAll*
+fetch_all_dup(FetchAll* fa) {
+  ++fa->ref_count;
+  return fa;
+}
+
+static void
+fetch_all_free(void* ptr) {
+  FetchAll* fa = ptr;
+  JSContext* ctx = fa->ctx;
+
+  if(--fa->ref_count == 0) {
+    JS_FreeValue(ctx, fa->requests);
+    JS_FreeValue(ctx, fa->options);
+    JS_FreeValue(ctx, fa->results);
+    asynciterator_clear(&fa->iterator, JS_GetRuntime(ctx));
+    js_free(ctx, fa->started_at);
+    js_free(ctx, fa);
+  }
+}
+
+static JSValue
+fetch_all_resolved(JSContext* ctx, JSValueConst value, BOOL done) {
+  ResolveFunctions async = {JS_NULL, JS_NULL};
+  JSValue ret = js_async_create(ctx, &async), result = js_iterator_result(ctx, value, done);
+
+  js_async_resolve(ctx, &async, result);
+  JS_FreeValue(ctx, result);
+  return ret;
+}
+
+/* Hands a result to a waiting next() or keeps it */
+static void
+fetch_all_record(FetchAll* fa, uint32_t index, JSValueConst value, BOOL error) {
+  JSContext* ctx = fa->ctx;
+  lws_usec_t elapsed = lws_now_usecs() - fa->started_at[index];
+  JSValue result;
+
+  if(fa->completed == 0 || elapsed < fa->min)
+    fa->min = elapsed;
+  if(elapsed > fa->max)
+    fa->max = elapsed;
+
+  fa->total += elapsed;
+  fa->completed++;
+  fa->running--;
+
+  if(error)
+    fa->failed++;
+
+  if(fa->returned)
+    return;
+
+  result = JS_NewObject(ctx);
+
+  JS_SetPropertyStr(ctx, result, "index", JS_NewUint32(ctx, index));
+  JS_SetPropertyStr(ctx, result, "time", JS_NewFloat64(ctx, (double)elapsed / 1000));
+  JS_SetPropertyStr(ctx, result, error ? "error" : "response", JS_DupValue(ctx, value));
+
+  if(!asynciterator_yield(&fa->iterator, result, ctx))
+    JS_SetPropertyUint32(ctx, fa->results, fa->tail++, JS_DupValue(ctx, result));
+
+  JS_FreeValue(ctx, result);
+}
+
+/* Ends the reads waiting for more results */
+static void
+fetch_all_end(FetchAll* fa) {
+  while(asynciterator_emplace(&fa->iterator, JS_UNDEFINED, TRUE, fa->ctx))
+    ;
+
+  fa->iterator.closed = TRUE;
+}
+
+static JSValue fetch_all_settled(JSContext*, JSValueConst, int, JSValueConst[], int, void*);
+
+/* Starts requests until 'concurrency' are running. A request that fails to
+ * start is recorded right away and the loop goes on with the next one. */
+static void
+fetch_all_launch(FetchAll* fa) {
+  JSContext* ctx = fa->ctx;
+
+  while(fa->running < fa->concurrency && fa->started < fa->count) {
+    uint32_t index = fa->started++;
+    JSValue item = JS_GetPropertyUint32(ctx, fa->requests, index);
+    JSValue args[2] = {JS_UNDEFINED, JS_NewObject(ctx)}, promise;
+
+    js_copy_properties(ctx, args[1], fa->options, JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY);
+
+    /* { url, ...options } overrides the shared options */
+    if(JS_IsObject(item) && !minnet_request_data(item) && js_has_propertystr(ctx, item, "url")) {
+      args[0] = JS_GetPropertyStr(ctx, item, "url");
+      js_copy_properties(ctx, args[1], item, JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY);
+    } else {
+      args[0] = JS_DupValue(ctx, item);
+    }
+
+    JS_SetPropertyStr(ctx, args[1], "block", JS_FALSE);
+
+    fa->started_at[index] = lws_now_usecs();
+    fa->running++;
+
+    promise = minnet_fetch(ctx, JS_UNDEFINED, 2, args);
+
+    if(JS_IsException(promise)) {
+      JSValue error = JS_GetException(ctx);
+
+      fetch_all_record(fa, index, error, TRUE);
+      JS_FreeValue(ctx, error);
+    } else {
+      JSValue handlers[2] = {
+          js_function_cclosure(ctx, fetch_all_settled, 1, index << 1, fetch_all_dup(fa), fetch_all_free),
+          js_function_cclosure(ctx, fetch_all_settled, 1, (index << 1) | 1, fetch_all_dup(fa), fetch_all_free),
+      };
+
+      JS_FreeValue(ctx, js_async_then2(ctx, promise, handlers[0], handlers[1]));
+      JS_FreeValue(ctx, handlers[0]);
+      JS_FreeValue(ctx, handlers[1]);
+    }
+
+    JS_FreeValue(ctx, promise);
+    JS_FreeValue(ctx, args[0]);
+    JS_FreeValue(ctx, args[1]);
+    JS_FreeValue(ctx, item);
+  }
+
+  /* every result has been handed out */
+  if(fa->running == 0 && fa->started == fa->count && fa->head == fa->tail)
+    fetch_all_end(fa);
+}
+
+static JSValue
+fetch_all_settled(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* opaque) {
+  FetchAll* fa = opaque;
+
+  fetch_all_record(fa, magic >> 1, argv[0], magic & 1);
+  fetch_all_launch(fa);
+  return JS_UNDEFINED;
+}
+
+static JSValue
+fetch_all_function(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* opaque) {
+  FetchAll* fa = opaque;
+  JSValue ret = JS_UNDEFINED;
+
+  switch(magic) {
+    case FETCH_ALL_NEXT: {
+      if(fa->head < fa->tail) {
+        JSAtom atom = JS_NewAtomUInt32(ctx, fa->head++);
+        JSValue value = JS_GetProperty(ctx, fa->results, atom);
+
+        JS_DeleteProperty(ctx, fa->results, atom, 0);
+        JS_FreeAtom(ctx, atom);
+
+        ret = fetch_all_resolved(ctx, value, FALSE);
+        JS_FreeValue(ctx, value);
+      } else if(fa->returned || (fa->running == 0 && fa->started == fa->count)) {
+        ret = fetch_all_resolved(ctx, JS_UNDEFINED, TRUE);
+      } else {
+        ret = asynciterator_next(&fa->iterator, argc > 0 ? argv[0] : JS_UNDEFINED, ctx);
+      }
+
+      break;
+    }
+
+    case FETCH_ALL_RETURN: {
+      /* requests in flight complete, no new ones are started and their results are dropped */
+      fa->count = fa->started;
+      fa->returned = TRUE;
+
+      JS_FreeValue(ctx, fa->results);
+      fa->results = JS_NewArray(ctx);
+      fa->head = fa->tail = 0;
+
+      fetch_all_end(fa);
+
+      ret = fetch_all_resolved(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, TRUE);
+      break;
+    }
+
+    case FETCH_ALL_TIMINGS: {
+      ret = JS_NewObject(ctx);
+
+      JS_SetPropertyStr(ctx, ret, "count", JS_NewUint32(ctx, fa->count));
+      JS_SetPropertyStr(ctx, ret, "completed", JS_NewUint32(ctx, fa->completed));
+      JS_SetPropertyStr(ctx, ret, "failed", JS_NewUint32(ctx, fa->failed));
+      JS_SetPropertyStr(ctx, ret, "elapsed", JS_NewFloat64(ctx, (double)(lws_now_usecs() - fa->start) / 1000));
+      JS_SetPropertyStr(ctx, ret, "min", JS_NewFloat64(ctx, (double)fa->min / 1000));
+      JS_SetPropertyStr(ctx, ret, "max", JS_NewFloat64(ctx, (double)fa->max / 1000));
+      JS_SetPropertyStr(ctx, ret, "mean", JS_NewFloat64(ctx, fa->completed ? (double)fa->total / fa->completed / 1000 : 0));
+      break;
+    }
+  }
+
+  return ret;
+}
+
+static const JSCFunctionListEntry minnet_fetch_all_iter[] = {
+    JS_CFUNC_DEF("[Symbol.asyncIterator]", 0, (JSCFunction*)&JS_DupValue),
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "MinnetFetchAll", JS_PROP_CONFIGURABLE),
+};
+
+/**
+ * Runs fetch() for each of 'requests', at most 'concurrency' at a time.
+ *
+ * @return Async iterator yielding { index, time, response | error } in completion order
+ */
+JSValue
+minnet_fetch_all(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  static const char* method_names[] = {
+      "next",
+      "return",
+  };
+  FetchAll* fa;
+  JSValue ret, proto, value;
+  int64_t length;
+
+  if(!JS_IsArray(ctx, argv[0]))
+    return JS_ThrowTypeError(ctx, "argument 1 must be an array of requests");
+
+  if(argc > 1 && !js_is_nullish(argv[1]) && !JS_IsObject(argv[1]))
+    return JS_ThrowTypeError(ctx, "argument 2 must be an object");
+
+  if(!(fa = js_mallocz(ctx, sizeof(FetchAll))))
+    return JS_EXCEPTION;
+
+  length = js_array_length(ctx, argv[0]);
+
+  fa->ref_count = 1;
+  fa->ctx = ctx;
+  fa->requests = JS_DupValue(ctx, argv[0]);
+  fa->options = argc > 1 && JS_IsObject(argv[1]) ? JS_DupValue(ctx, argv[1]) : JS_NewObject(ctx);
+  fa->results = JS_NewArray(ctx);
+  fa->count = length > 0 ? length : 0;
+  fa->concurrency = FETCH_ALL_CONCURRENCY;
+  fa->start = lws_now_usecs();
+  asynciterator_zero(&fa->iterator);
+
+  value = JS_GetPropertyStr(ctx, fa->options, "concurrency");
+
+  if(JS_IsNumber(value))
+    JS_ToUint32(ctx, &fa->concurrency, value);
+
+  JS_FreeValue(ctx, value);
+
+  if(fa->concurrency == 0)
+    fa->concurrency = 1;
+
+  if(!(fa->started_at = js_mallocz(ctx, sizeof(lws_usec_t) * (fa->count + 1)))) {
+    fetch_all_free(fa);
+    return JS_EXCEPTION;
+  }
+
+  proto = js_asyncgenerator_prototype(ctx);
+  ret = JS_NewObjectProto(ctx, proto);
+  JS_FreeValue(ctx, proto);
+
+  for(size_t i = 0; i < countof(method_names); i++) {
+    JSValue func = js_function_cclosure(ctx, fetch_all_function, 0, i, fetch_all_dup(fa), fetch_all_free);
+    JS_DefinePropertyValueStr(ctx, ret, method_names[i], func, JS_PROP_CONFIGURABLE | JS_PROP_WRITABLE);
+  }
+
+  {
+    JSAtom atom = JS_NewAtom(ctx, "timings");
+    JSValue getter = js_function_cclosure(ctx, fetch_all_function, 0, FETCH_ALL_TIMINGS, fetch_all_dup(fa), fetch_all_free);
+
+    JS_DefinePropertyGetSet(ctx, ret, atom, getter, JS_UNDEFINED, JS_PROP_CONFIGURABLE);
+    JS_FreeAtom(ctx, atom);
+  }
+
+  JS_SetPropertyFunctionList(ctx, ret, minnet_fetch_all_iter, countof(minnet_fetch_all_iter));
+
+  fetch_all_launch(fa);
+
+  fetch_all_free(fa);
+  return ret;
+}
+
+static JSValue
+fetch_cache_stats(JSContext* ctx, Cache* cache) {
+  JSValue ret = JS_NewObject(ctx);
+  struct list_head* el;
+  uint32_t entries = 0;
+
+  list_for_each(el, &cache->entries) ++entries;
+
+  JS_SetPropertyStr(ctx, ret, "entries", JS_NewUint32(ctx, entries));
+  JS_SetPropertyStr(ctx, ret, "bytes", JS_NewInt64(ctx, cache->bytes));
+  JS_SetPropertyStr(ctx, ret, "maxSize", JS_NewInt64(ctx, cache->max_bytes));
+  JS_SetPropertyStr(ctx, ret, "hits", JS_NewInt64(ctx, cache->hits));
+  JS_SetPropertyStr(ctx, ret, "misses", JS_NewInt64(ctx, cache->misses));
+  JS_SetPropertyStr(ctx, ret, "stale", JS_NewInt64(ctx, cache->stale));
+  JS_SetPropertyStr(ctx, ret, "revalidated", JS_NewInt64(ctx, cache->revalidated));
+  JS_SetPropertyStr(ctx, ret, "stores", JS_NewInt64(ctx, cache->stores));
+
+  if(cache->dir)
+    JS_SetPropertyStr(ctx, ret, "dir", JS_NewString(ctx, cache->dir));
+
+  return ret;
+}
+
+/**
+ * Enables the fetch() response cache with true or { maxSize, dir }, disables
+ * it with false.  Without argument the settings are kept.
+ *
+ * @return statistics of the cache, null when it is disabled
+ */
+JSValue
+minnet_set_fetch_cache(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  if(argc > 0 && !JS_IsUndefined(argv[0])) {
+    uint32_t max_size = 0;
+    char* dir = 0;
+
+    if(JS_IsObject(argv[0])) {
+      JSValue value = JS_GetPropertyStr(ctx, argv[0], "maxSize");
+
+      if(JS_IsNumber(value))
+        JS_ToUint32(ctx, &max_size, value);
+
+      JS_FreeValue(ctx, value);
+
+      value = JS_GetPropertyStr(ctx, argv[0], "dir");
+
+      if(JS_IsString(value))
+        dir = js_tostring(ctx, value);
+
+      JS_FreeValue(ctx, value);
+    } else if(!JS_IsBool(argv[0]) && !JS_IsNull(argv[0])) {
+      return JS_ThrowTypeError(ctx, "argument 1 must be a boolean or an object");
+    }
+
+    if(fetch_cache) {
+      cache_clear(fetch_cache);
+      free(fetch_cache);
+      fetch_cache = 0;
+    }
+
+    if(JS_IsObject(argv[0]) || JS_ToBool(ctx, argv[0])) {
+      if(!(fetch_cache = malloc(sizeof(Cache)))) {
+        js_free(ctx, dir);
+        return JS_ThrowOutOfMemory(ctx);
+      }
+
+      cache_init(fetch_cache, max_size, dir);
+    }
+
+    js_free(ctx, dir);
+  }
+
+  return fetch_cache ? fetch_cache_stats(ctx, fetch_cache) : JS_NULL;
+}
@@ -2,7 +2,14 @@
 #define MINNET_FETCH_H
 
 #include <quickjs.h>
+#include "utils.h"
+
+struct cache;
+
+extern THREAD_LOCAL struct cache* fetch_cache;
 
 JSValue minnet_fetch(JSContext*, JSValueConst this_val, int argc, JSValueConst argv[]);
+JSValue minnet_fetch_all(JSContext*, JSValueConst this_val, int argc, JSValueConst argv[]);
+JSValue minnet_set_fetch_cache(JSContext*, JSValueConst this_val, int argc, JSValueConst argv[]);
 
 #endif /* MINNET_FETCH_H */
@@ -5,6 +5,8 @@
 #include "callback.h"
 #include "js-utils.h"
 #include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 #include <libwebsockets.h>
 
@@ -64,6 +66,7 @@ minnet_formparser_constructor(JSContext* ctx, JSValueConst new_target, int argc,
     JSValue cb_close = JS_GetPropertyStr(ctx, argv[2], "onClose");
     JSValue cb_finalize = JS_GetPropertyStr(ctx, argv[2], "onFinalize");
     JSValue opt_chunksz = JS_GetPropertyStr(ctx, argv[2], "chunkSize");
+    JSValue opt_directory = JS_GetPropertyStr(ctx, argv[2], "directory");
 
     GETCB(cb_content, fp->cb.content)
     GETCB(cb_open, fp->cb.open)
@@ -72,6 +75,41 @@ minnet_formparser_constructor(JSContext* ctx, JSValueConst new_target, int argc,
 
     if(JS_IsNumber(opt_chunksz))
       JS_ToIndex(ctx, &chunk_size, opt_chunksz);
+
+    /* file parts are written to this directory, onClose gets their metadata */
+    if(JS_IsString(opt_directory) || JS_IsBool(opt_directory)) {
+      const char* tmpdir = getenv("TMPDIR");
+      const char* dir = JS_IsString(opt_directory) ? JS_ToCString(ctx, opt_directory) : 0;
+      uint64_t max_size = 0, buffer_size = 0;
+      int32_t hash_type = -1;
+
+      JSValue opt_maxsize = JS_GetPropertyStr(ctx, argv[2], "maxFileSize");
+      JSValue opt_hash = JS_GetPropertyStr(ctx, argv[2], "hash");
+      JSValue opt_bufsize = JS_GetPropertyStr(ctx, argv[2], "bufferSize");
+
+      if(JS_IsNumber(opt_maxsize))
+        JS_ToIndex(ctx, &max_size, opt_maxsize);
+      if(JS_IsNumber(opt_hash))
+        JS_ToInt32(ctx, &hash_type, opt_hash);
+      if(JS_IsNumber(opt_bufsize))
+        JS_ToIndex(ctx, &buffer_size, opt_bufsize);
+
+      JS_FreeValue(ctx, opt_maxsize);
+      JS_FreeValue(ctx, opt_hash);
+      JS_FreeValue(ctx, opt_bufsize);
+
+      if(hash_type < LWS_GENHASH_TYPE_MD5 || hash_type > LWS_GENHASH_TYPE_SHA512)
+        hash_type = -1;
+
+      if(dir || JS_ToBool(ctx, opt_directory))
+        formparser_sink(fp, dir ? dir : tmpdir ? tmpdir : "/tmp", max_size, hash_type, buffer_size);
+
+      if(dir)
+        JS_FreeCString(ctx, dir);
+    }
+
+    JS_FreeValue(ctx, opt_directory);
+    JS_FreeValue(ctx, opt_chunksz);
   }
 
   formparser_init(fp, ws, param_count, (const char* const*)param_names, chunk_size);
@@ -334,6 +372,9 @@ minnet_formparser_call(JSContext* ctx, JSValueConst func_obj, JSValueConst this_
     ret = JS_NewInt32(ctx, formparser_process(fp, buf.data, buf.size));
 
     js_buffer_free(&buf, JS_GetRuntime(ctx));
+
+    if(fp->sink.error && JS_IsNull(fp->exception))
+      return JS_ThrowInternalError(ctx, "FormParser upload: %s", strerror(fp->sink.error));
   }
   if(!JS_IsNull(fp->exception)) {
 
@@ -1,4 +1,5 @@
 #include "minnet-generator.h"
+#include "minnet-json.h"
 #include "js-utils.h"
 #include <quickjs.h>
 #include <assert.h>
@@ -17,6 +18,9 @@ enum {
   GENERATOR_BUFFERING,
   GENERATOR_STOP,
   GENERATOR_ITERATOR,
+  GENERATOR_JSON,
+  GENERATOR_JSON_LINES,
+  GENERATOR_BUFFERED,
 };
 
 static JSValue
@@ -50,6 +54,21 @@ minnet_generator_function(JSContext* ctx, JSValueConst this_val, int argc, JSVal
       ret = generator_throw(gen, argv[0]);
       break;
     }
+
+    case GENERATOR_JSON: {
+      ret = minnet_json_parse(ctx, gen);
+      break;
+    }
+
+    case GENERATOR_JSON_LINES: {
+      ret = minnet_json_lines(ctx, gen);
+      break;
+    }
+
+    case GENERATOR_BUFFERED: {
+      ret = JS_NewInt64(ctx, gen->q ? queue_bytes(gen->q) : 0);
+      break;
+    }
   }
   return ret;
 }
@@ -101,6 +120,16 @@ minnet_generator_method(JSContext* ctx, JSValueConst this_val, int argc, JSValue
       ret = minnet_generator_iterator(ctx, gen);
       break;
     }
+
+    case GENERATOR_JSON: {
+      ret = minnet_json_parse(ctx, gen);
+      break;
+    }
+
+    case GENERATOR_JSON_LINES: {
+      ret = minnet_json_lines(ctx, gen);
+      break;
+    }
   }
 
   return ret;
@@ -190,6 +219,8 @@ static const JSCFunctionListEntry minnet_generator_proto_funcs[] = {
     JS_CFUNC_MAGIC_DEF("continuous", 0, minnet_generator_method, GENERATOR_CONTINUOUS),
     JS_CFUNC_MAGIC_DEF("buffering", 0, minnet_generator_method, GENERATOR_BUFFERING),
     JS_CFUNC_MAGIC_DEF("stop", 0, minnet_generator_method, GENERATOR_STOP),
+    JS_CFUNC_MAGIC_DEF("json", 0, minnet_generator_method, GENERATOR_JSON),
+    JS_CFUNC_MAGIC_DEF("jsonLines", 0, minnet_generator_method, GENERATOR_JSON_LINES),
     JS_CFUNC_MAGIC_DEF("[Symbol.asyncIterator]", 0, minnet_generator_method, GENERATOR_ITERATOR),
     JS_PROP_STRING_DEF("[Symbol.toStringTag]", "MinnetGenerator", JS_PROP_CONFIGURABLE),
 };
@@ -210,6 +241,14 @@ minnet_generator_iterator(JSContext* ctx, MinnetGenerator* gen) {
     JS_DefinePropertyValueStr(ctx, ret, method_names[i], func, JS_PROP_CONFIGURABLE | JS_PROP_WRITABLE);
   }
 
+  JS_DefinePropertyValueStr(ctx, ret, "json", js_function_cclosure(ctx, minnet_generator_function, 0, GENERATOR_JSON, generator_dup(gen), (void*)&generator_free), JS_PROP_CONFIGURABLE | JS_PROP_WRITABLE);
+  JS_DefinePropertyValueStr(ctx, ret, "jsonLines", js_function_cclosure(ctx, minnet_generator_function, 0, GENERATOR_JSON_LINES, generator_dup(gen), (void*)&generator_free), JS_PROP_CONFIGURABLE | JS_PROP_WRITABLE);
+
+  /* bytes received and not yet iterated */
+  JSAtom atom = JS_NewAtom(ctx, "buffered");
+  JS_DefinePropertyGetSet(ctx, ret, atom, js_function_cclosure(ctx, minnet_generator_function, 0, GENERATOR_BUFFERED, generator_dup(gen), (void*)&generator_free), JS_UNDEFINED, JS_PROP_CONFIGURABLE);
+  JS_FreeAtom(ctx, atom);
+
   JS_SetPropertyFunctionList(ctx, ret, minnet_generator_iter, countof(minnet_generator_iter));
 
   return ret;
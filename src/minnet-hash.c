@@ -46,7 +46,7 @@ hash_size(MinnetHash* h) {
   return h->hmac ? lws_genhmac_size(h->type - (LWS_GENHASH_TYPE_SHA256 - LWS_GENHMAC_TYPE_SHA256)) : lws_genhash_size(h->type);
 }
 
-static BOOL
+BOOL
 hash_update(MinnetHash* h, const void* data, size_t size) {
   assert(h->initialized);
   assert(!h->finalized);
@@ -85,7 +85,7 @@ hash_tostring(MinnetHash* h, int bits_per_char) {
   return (char*)dbuf.buf;
 }
 
-static BOOL
+BOOL
 hash_finalize(MinnetHash* h) {
   assert(h->initialized);
   assert(!h->finalized);
@@ -15,6 +15,8 @@ typedef struct hash_hmac {
   uint8_t digest[0];
 } MinnetHash;
 
+BOOL hash_update(MinnetHash*, const void* data, size_t size);
+BOOL hash_finalize(MinnetHash*);
 JSValue minnet_hash_constructor(JSContext*, JSValueConst, int, JSValueConst[]);
 int minnet_hash_init(JSContext*, JSModuleDef*);
 
@@ -23,7 +23,7 @@ enum {
 };
 
 struct MinnetHeadersOpaque {
-  ByteBuffer* headers;
+  Headers* headers;
   void* opaque;
   HeadersFreeFunc* free_func;
   struct {
@@ -50,7 +50,7 @@ minnet_headers_opaque(JSValueConst obj) {
   return JS_GetOpaque(obj, minnet_headers_class_id);
 }
 
-ByteBuffer*
+Headers*
 minnet_headers_data2(JSContext* ctx, JSValueConst obj) {
   struct MinnetHeadersOpaque* ptr;
   if(!(ptr = JS_GetOpaque2(ctx, obj, minnet_headers_class_id)))
@@ -59,7 +59,7 @@ minnet_headers_data2(JSContext* ctx, JSValueConst obj) {
 }
 
 JSValue
-minnet_headers_value(JSContext* ctx, ByteBuffer* headers, JSValueConst obj) {
+minnet_headers_value(JSContext* ctx, Headers* headers, JSValueConst obj) {
   JSValue headers_obj = JS_NewObjectProtoClass(ctx, minnet_headers_proto, minnet_headers_class_id);
   struct MinnetHeadersOpaque* ptr;
 
@@ -81,7 +81,7 @@ minnet_headers_value(JSContext* ctx, ByteBuffer* headers, JSValueConst obj) {
 }
 
 JSValue
-minnet_headers_wrap(JSContext* ctx, ByteBuffer* headers, void* opaque, void (*free_func)(void* opaque, JSRuntime* rt)) {
+minnet_headers_wrap(JSContext* ctx, Headers* headers, void* opaque, void (*free_func)(void* opaque, JSRuntime* rt)) {
   JSValue headers_obj = JS_NewObjectProtoClass(ctx, minnet_headers_proto, minnet_headers_class_id);
   struct MinnetHeadersOpaque* ptr;
 
@@ -104,7 +104,7 @@ minnet_headers_wrap(JSContext* ctx, ByteBuffer* headers, void* opaque, void (*fr
 
 static JSValue
 minnet_headers_get(JSContext* ctx, JSValueConst this_val, int magic) {
-  ByteBuffer* headers;
+  Headers* headers;
   JSValue ret = JS_UNDEFINED;
 
   if(!(headers = minnet_headers_data2(ctx, this_val)))
@@ -122,7 +122,7 @@ enum {
 
 static JSValue
 minnet_headers_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic) {
-  ByteBuffer* headers;
+  Headers* headers;
   JSValue ret = JS_UNDEFINED;
   struct MinnetHeadersOpaque* ptr = minnet_headers_opaque(this_val);
 
@@ -186,7 +186,7 @@ minnet_headers_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
 
 static JSValue
 minnet_headers_iterator(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic) {
-  ByteBuffer* headers;
+  Headers* headers;
   JSValue ret = JS_UNDEFINED;
   struct MinnetHeadersOpaque* ptr = minnet_headers_opaque(this_val);
 
@@ -194,23 +194,17 @@ minnet_headers_iterator(JSContext* ctx, JSValueConst this_val, int argc, JSValue
     return JS_EXCEPTION;
 
   ret = JS_NewArray(ctx);
-  uint32_t i = 0;
-  uint8_t *x, *end = headers->write;
+  uint32_t i, size = headers_size(headers, ptr->separator.item);
 
-  for(x = headers->start; x != end; x += headers_next(x, end, ptr->separator.item)) {
-    size_t len;
+  for(i = 0; i < size; i++) {
+    HeaderEntry* e = &headers->entries[i];
     JSValue name = JS_NULL, value = JS_NULL, entry = JS_NULL;
 
-    if(magic == HEADERS_KEYS || magic == HEADERS_ENTRIES) {
-      len = headers_namelen(x, end);
-      name = JS_NewStringLen(ctx, (const char*)x, len);
-    }
+    if(magic == HEADERS_KEYS || magic == HEADERS_ENTRIES)
+      name = JS_NewStringLen(ctx, headers_entry_name(headers, e), e->namelen);
 
-    if(magic == HEADERS_VALUES || magic == HEADERS_ENTRIES) {
-      x += headers_value(x, end, ":");
-      len = headers_length(x, end, ptr->separator.item);
-      value = JS_NewStringLen(ctx, (const char*)x, len);
-    }
+    if(magic == HEADERS_VALUES || magic == HEADERS_ENTRIES)
+      value = JS_NewStringLen(ctx, headers_entry_value(headers, e), e->valuelen);
 
     if(magic == HEADERS_ENTRIES) {
       entry = JS_NewArray(ctx);
@@ -221,7 +215,7 @@ minnet_headers_iterator(JSContext* ctx, JSValueConst this_val, int argc, JSValue
       JS_FreeValue(ctx, magic == HEADERS_KEYS ? value : name);
     }
 
-    JS_SetPropertyUint32(ctx, ret, i++, entry);
+    JS_SetPropertyUint32(ctx, ret, i, entry);
   }
 
   return ret;
@@ -250,7 +244,7 @@ static const JSCFunctionListEntry minnet_headers_proto_funcs[] = {
 
 static int
 minnet_headers_get_own_property(JSContext* ctx, JSPropertyDescriptor* pdesc, JSValueConst obj, JSAtom prop) {
-  ByteBuffer* headers = minnet_headers_data2(ctx, obj);
+  Headers* headers = minnet_headers_data2(ctx, obj);
   const char* propstr = JS_AtomToCString(ctx, prop);
   char* value;
   size_t len;
@@ -274,19 +268,15 @@ minnet_headers_get_own_property(JSContext* ctx, JSPropertyDescriptor* pdesc, JSV
 static int
 minnet_headers_get_own_property_names(JSContext* ctx, JSPropertyEnum** ptab, uint32_t* plen, JSValueConst obj) {
   struct MinnetHeadersOpaque* ptr = minnet_headers_opaque(obj);
-  ByteBuffer* headers = ptr->headers;
-  uint32_t i = 0, size = headers_size(headers, ptr->separator.item);
-  uint8_t *x, *end = headers->write;
+  Headers* headers = ptr->headers;
+  uint32_t i, size = headers_size(headers, ptr->separator.item);
   JSPropertyEnum* props = js_malloc(ctx, sizeof(JSPropertyEnum) * size);
 
-  for(x = headers->start; i < size && x != end; x += headers_next(x, end, ptr->separator.item)) {
-    size_t len = headers_namelen(x, end);
-    JSAtom prop = JS_NewAtomLen(ctx, (const char*)x, len);
+  for(i = 0; i < size; i++) {
+    HeaderEntry* e = &headers->entries[i];
 
     props[i].is_enumerable = TRUE;
-    props[i].atom = prop;
-
-    ++i;
+    props[i].atom = JS_NewAtomLen(ctx, headers_entry_name(headers, e), e->namelen);
   }
   *ptab = props;
   *plen = size;
@@ -296,7 +286,7 @@ minnet_headers_get_own_property_names(JSContext* ctx, JSPropertyEnum** ptab, uin
 
 static int
 minnet_headers_has_property(JSContext* ctx, JSValueConst obj, JSAtom prop) {
-  ByteBuffer* headers = minnet_headers_data2(ctx, obj);
+  Headers* headers = minnet_headers_data2(ctx, obj);
   const char* propstr = JS_AtomToCString(ctx, prop);
   ssize_t index;
   BOOL ret = FALSE;
@@ -312,7 +302,7 @@ minnet_headers_has_property(JSContext* ctx, JSValueConst obj, JSAtom prop) {
 static int
 minnet_headers_set_property(JSContext* ctx, JSValueConst obj, JSAtom prop, JSValueConst value, JSValueConst receiver, int flags) {
   struct MinnetHeadersOpaque* ptr = minnet_headers_opaque(obj);
-  ByteBuffer* headers = ptr->headers;
+  Headers* headers = ptr->headers;
   const char* propstr = JS_AtomToCString(ctx, prop);
   const char* valuestr = JS_ToCString(ctx, value);
 
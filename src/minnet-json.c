@@ -0,0 +1,416 @@
+#include "minnet-json.h"
+#include "js-utils.h"
+#include <inttypes.h>
+
+enum {
+  JSON_READER_CHUNK = 0,
+  JSON_READER_ERROR,
+  JSON_READER_BUFFER,
+};
+
+enum {
+  JSON_LINES_NEXT = 0,
+  JSON_LINES_RETURN,
+};
+
+/* Pulls chunks from a body Generator and parses JSON values as they complete */
+typedef struct json_reader {
+  int ref_count;
+  JSContext* ctx;
+  Generator* gen;
+  JsonStream stream;
+  AsyncIterator iterator;   /* jsonLines(): one read per value */
+  ResolveFunctions promise; /* json(): settled with the whole document */
+  JSValue result, values, error;
+  uint32_t head, tail;
+  BOOL lines, reading, eof;
+} JsonReader;
+
+static JsonReader*
+json_reader_dup(JsonReader* rd) {
+  ++rd->ref_count;
+  return rd;
+}
+
+static void
+json_reader_free(void* ptr) {
+  JsonReader* rd = ptr;
+
+  if(--rd->ref_count == 0) {
+    JSContext* ctx = rd->ctx;
+    JSRuntime* rt = JS_GetRuntime(ctx);
+
+    jsonstream_clear(&rd->stream);
+    asynciterator_clear(&rd->iterator, rt);
+    js_async_free(rt, &rd->promise);
+
+    JS_FreeValue(ctx, rd->result);
+    JS_FreeValue(ctx, rd->values);
+    JS_FreeValue(ctx, rd->error);
+
+    generator_free(rd->gen);
+    js_free(ctx, rd);
+  }
+}
+
+static void
+json_reader_fail(JsonReader* rd, const char* message) {
+  if(JS_IsUndefined(rd->error)) {
+    JS_ThrowSyntaxError(rd->ctx, "%s after %" PRIu64 " values", message, rd->stream.items);
+    rd->error = JS_GetException(rd->ctx);
+  }
+
+  rd->eof = TRUE;
+}
+
+static int
+json_reader_value(void* opaque, const char* key, size_t keylen, const char* data, size_t len) {
+  JsonReader* rd = opaque;
+  JSContext* ctx = rd->ctx;
+  JSValue value;
+
+  if(JS_IsException((value = JS_ParseJSON(ctx, data, len, "<json>")))) {
+    rd->error = JS_GetException(ctx);
+    return -1;
+  }
+
+  if(rd->lines) {
+    JS_SetPropertyUint32(ctx, rd->values, rd->tail++, value);
+    return 0;
+  }
+
+  switch(rd->stream.container) {
+    case '[': {
+      if(JS_IsUndefined(rd->result))
+        rd->result = JS_NewArray(ctx);
+
+      JS_SetPropertyUint32(ctx, rd->result, rd->stream.items, value);
+      break;
+    }
+
+    case '{': {
+      JSValue name;
+      JSAtom atom;
+
+      if(!key) {
+        JS_FreeValue(ctx, value);
+        json_reader_fail(rd, "expected ':'");
+        return -1;
+      }
+
+      name = JS_ParseJSON(ctx, key, keylen, "<json>");
+
+      if(!JS_IsString(name)) {
+        JS_FreeValue(ctx, name);
+        JS_FreeValue(ctx, value);
+        json_reader_fail(rd, "invalid object key");
+        return -1;
+      }
+
+      if(JS_IsUndefined(rd->result))
+        rd->result = JS_NewObject(ctx);
+
+      atom = JS_ValueToAtom(ctx, name);
+      JS_DefinePropertyValue(ctx, rd->result, atom, value, JS_PROP_C_W_E);
+      JS_FreeAtom(ctx, atom);
+      JS_FreeValue(ctx, name);
+      break;
+    }
+
+    default: {
+      JS_FreeValue(ctx, rd->result);
+      rd->result = value;
+      break;
+    }
+  }
+
+  return 0;
+}
+
+static void
+json_reader_write(JsonReader* rd, const void* data, size_t len) {
+  if(rd->eof || len == 0)
+    return;
+
+  if(jsonstream_write(&rd->stream, data, len) == -1)
+    json_reader_fail(rd, rd->stream.error ? rd->stream.error : "unexpected JSON input");
+}
+
+static void
+json_reader_end(JsonReader* rd) {
+  if(rd->eof)
+    return;
+
+  if(jsonstream_end(&rd->stream) == -1) {
+    json_reader_fail(rd, "unexpected end of JSON input");
+    return;
+  }
+
+  if(!rd->lines && JS_IsUndefined(rd->result)) {
+    if(rd->stream.container == '[')
+      rd->result = JS_NewArray(rd->ctx);
+    else if(rd->stream.container == '{')
+      rd->result = JS_NewObject(rd->ctx);
+    else
+      json_reader_fail(rd, "unexpected end of JSON input");
+  }
+
+  rd->eof = TRUE;
+}
+
+static JSValue json_reader_callback(JSContext*, JSValueConst, int, JSValueConst[], int, void*);
+
+static void
+json_reader_pull(JsonReader* rd) {
+  JSContext* ctx = rd->ctx;
+  JSValue promise, fns[2], tmp;
+
+  if(rd->lines) {
+    while(asynciterator_pending(&rd->iterator) && rd->head < rd->tail) {
+      JSValue value = JS_GetPropertyUint32(ctx, rd->values, rd->head++);
+
+      asynciterator_yield(&rd->iterator, value, ctx);
+      JS_FreeValue(ctx, value);
+    }
+
+    if(rd->tail && rd->head == rd->tail) {
+      JS_FreeValue(ctx, rd->values);
+      rd->values = JS_NewArray(ctx);
+      rd->head = rd->tail = 0;
+    }
+
+    if(!asynciterator_pending(&rd->iterator))
+      return;
+
+    if(!JS_IsUndefined(rd->error)) {
+      asynciterator_cancel(&rd->iterator, rd->error, ctx);
+      return;
+    }
+
+    if(rd->eof) {
+      while(asynciterator_pending(&rd->iterator))
+        asynciterator_emplace(&rd->iterator, JS_UNDEFINED, TRUE, ctx);
+      return;
+    }
+  } else {
+    if(!js_async_pending(&rd->promise))
+      return;
+
+    if(!JS_IsUndefined(rd->error)) {
+      js_async_reject(ctx, &rd->promise, rd->error);
+      return;
+    }
+
+    if(rd->eof) {
+      js_async_resolve(ctx, &rd->promise, rd->result);
+      return;
+    }
+  }
+
+  /* one outstanding read at a time, so a slow consumer holds back the body */
+  if(rd->reading)
+    return;
+
+  rd->reading = TRUE;
+
+  promise = generator_next(rd->gen, JS_UNDEFINED);
+  fns[0] = js_function_cclosure(ctx, json_reader_callback, 1, JSON_READER_CHUNK, json_reader_dup(rd), json_reader_free);
+  fns[1] = js_function_cclosure(ctx, json_reader_callback, 1, JSON_READER_ERROR, json_reader_dup(rd), json_reader_free);
+
+  tmp = js_async_then2(ctx, promise, fns[0], fns[1]);
+
+  JS_FreeValue(ctx, tmp);
+  JS_FreeValue(ctx, fns[0]);
+  JS_FreeValue(ctx, fns[1]);
+  JS_FreeValue(ctx, promise);
+}
+
+static JSValue
+json_reader_callback(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* opaque) {
+  JsonReader* rd = opaque;
+  JSValueConst arg = argc > 0 ? argv[0] : JS_UNDEFINED;
+
+  rd->reading = FALSE;
+
+  switch(magic) {
+    case JSON_READER_CHUNK: {
+      if(js_get_propertystr_bool(ctx, arg, "done")) {
+        json_reader_end(rd);
+      } else {
+        JSValue value = JS_GetPropertyStr(ctx, arg, "value");
+
+        if(!js_is_nullish(value)) {
+          JSBuffer buf = js_input_chars(ctx, value);
+
+          json_reader_write(rd, buf.data, buf.size);
+          js_buffer_free(&buf, JS_GetRuntime(ctx));
+        }
+
+        JS_FreeValue(ctx, value);
+      }
+      break;
+    }
+
+    case JSON_READER_ERROR: {
+      if(JS_IsUndefined(rd->error))
+        rd->error = JS_DupValue(ctx, arg);
+
+      rd->eof = TRUE;
+      break;
+    }
+
+    case JSON_READER_BUFFER: {
+      if(!js_is_nullish(arg)) {
+        JSBuffer buf = js_input_chars(ctx, arg);
+
+        json_reader_write(rd, buf.data, buf.size);
+        js_buffer_free(&buf, JS_GetRuntime(ctx));
+      }
+
+      json_reader_end(rd);
+      break;
+    }
+  }
+
+  json_reader_pull(rd);
+  return JS_UNDEFINED;
+}
+
+static JsonReader*
+json_reader_new(JSContext* ctx, Generator* gen, BOOL lines) {
+  JsonReader* rd;
+
+  if(!(rd = js_mallocz(ctx, sizeof(JsonReader))))
+    return 0;
+
+  rd->ref_count = 1;
+  rd->ctx = ctx;
+  rd->gen = generator_dup(gen);
+  rd->lines = lines;
+  rd->result = JS_UNDEFINED;
+  rd->error = JS_UNDEFINED;
+  rd->values = lines ? JS_NewArray(ctx) : JS_UNDEFINED;
+
+  asynciterator_zero(&rd->iterator);
+  js_async_zero(&rd->promise);
+  jsonstream_init(&rd->stream, lines ? JSONSTREAM_LINES : JSONSTREAM_ELEMENTS, json_reader_value, rd, ctx);
+
+  return rd;
+}
+
+static void
+json_reader_start(JsonReader* rd) {
+  Generator* gen = rd->gen;
+  QueueItem* item;
+
+  /* a buffered body is either complete or handed over in one piece by generator_stop() */
+  if(gen->q && gen->q->continuous) {
+    if(generator_stopped(gen)) {
+      if((item = queue_last_chunk(gen->q)))
+        json_reader_write(rd, block_BEGIN(&item->block), block_SIZE(&item->block));
+
+      json_reader_end(rd);
+    } else {
+      JSValue fn = js_function_cclosure(rd->ctx, json_reader_callback, 1, JSON_READER_BUFFER, json_reader_dup(rd), json_reader_free);
+
+      rd->reading = TRUE;
+      generator_continuous(gen, fn);
+      JS_FreeValue(rd->ctx, fn);
+    }
+  }
+}
+
+/**
+ * Parses a body as JSON while it arrives.  Members of a top-level array or
+ * object are parsed as soon as they are complete, so only the member in
+ * transit is kept as text.
+ *
+ * @return Promise resolving to the parsed value
+ */
+JSValue
+minnet_json_parse(JSContext* ctx, Generator* gen) {
+  JsonReader* rd;
+  JSValue ret;
+
+  if(!(rd = json_reader_new(ctx, gen, FALSE)))
+    return JS_ThrowOutOfMemory(ctx);
+
+  ret = js_async_create(ctx, &rd->promise);
+
+  json_reader_start(rd);
+  json_reader_pull(rd);
+  json_reader_free(rd);
+
+  return ret;
+}
+
+static JSValue
+minnet_json_lines_function(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* opaque) {
+  JsonReader* rd = opaque;
+  JSValue ret = JS_UNDEFINED;
+
+  switch(magic) {
+    case JSON_LINES_NEXT: {
+      ret = asynciterator_next(&rd->iterator, argc > 0 ? argv[0] : JS_UNDEFINED, ctx);
+      json_reader_pull(rd);
+      break;
+    }
+
+    case JSON_LINES_RETURN: {
+      ResolveFunctions async = {JS_NULL, JS_NULL};
+      JSValue result;
+
+      ret = js_async_create(ctx, &async);
+
+      rd->eof = TRUE;
+      rd->head = rd->tail;
+      json_reader_pull(rd);
+
+      result = js_iterator_result(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, TRUE);
+      js_async_resolve(ctx, &async, result);
+      JS_FreeValue(ctx, result);
+      break;
+    }
+  }
+
+  return ret;
+}
+
+static const JSCFunctionListEntry minnet_json_lines_iter[] = {
+    JS_CFUNC_DEF("[Symbol.asyncIterator]", 0, (JSCFunction*)&JS_DupValue),
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "MinnetJSONLines", JS_PROP_CONFIGURABLE),
+};
+
+/**
+ * Parses newline delimited JSON from a body while it arrives.
+ *
+ * @return Async iterator yielding one parsed value per line
+ */
+JSValue
+minnet_json_lines(JSContext* ctx, Generator* gen) {
+  static const char* method_names[] = {
+      "next",
+      "return",
+  };
+  JsonReader* rd;
+  JSValue ret, proto;
+
+  if(!(rd = json_reader_new(ctx, gen, TRUE)))
+    return JS_ThrowOutOfMemory(ctx);
+
+  json_reader_start(rd);
+
+  proto = js_asyncgenerator_prototype(ctx);
+  ret = JS_NewObjectProto(ctx, proto);
+  JS_FreeValue(ctx, proto);
+
+  for(size_t i = 0; i < countof(method_names); i++) {
+    JSValue func = js_function_cclosure(ctx, minnet_json_lines_function, 0, i, json_reader_dup(rd), json_reader_free);
+    JS_DefinePropertyValueStr(ctx, ret, method_names[i], func, JS_PROP_CONFIGURABLE | JS_PROP_WRITABLE);
+  }
+
+  JS_SetPropertyFunctionList(ctx, ret, minnet_json_lines_iter, countof(minnet_json_lines_iter));
+
+  json_reader_free(rd);
+  return ret;
+}
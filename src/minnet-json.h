@@ -0,0 +1,10 @@
+#ifndef MINNET_JSON_H
+#define MINNET_JSON_H
+
+#include "generator.h"
+#include "jsonstream.h"
+
+JSValue minnet_json_parse(JSContext*, Generator* gen);
+JSValue minnet_json_lines(JSContext*, Generator* gen);
+
+#endif /* MINNET_JSON_H */
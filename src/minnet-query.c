@@ -0,0 +1,254 @@
+#include "minnet-query.h"
+#include "js-utils.h"
+#include "utils.h"
+
+THREAD_LOCAL JSValue minnet_query_proto, minnet_query_ctor;
+THREAD_LOCAL JSClassID minnet_query_class_id;
+
+enum {
+  QUERY_GET,
+  QUERY_GET_ALL,
+  QUERY_HAS,
+  QUERY_KEYS,
+  QUERY_VALUES,
+  QUERY_ENTRIES,
+  QUERY_TO_STRING,
+  QUERY_TO_OBJECT,
+};
+
+enum {
+  QUERY_SIZE,
+};
+
+Query*
+minnet_query_data(JSValueConst obj) {
+  return JS_GetOpaque(obj, minnet_query_class_id);
+}
+
+JSValue
+minnet_query_wrap(JSContext* ctx, Query* q) {
+  JSValue obj;
+
+  if(!minnet_query_class_id)
+    minnet_query_init(ctx, 0);
+
+  obj = JS_NewObjectProtoClass(ctx, minnet_query_proto, minnet_query_class_id);
+
+  if(JS_IsException(obj))
+    return JS_EXCEPTION;
+
+  JS_SetOpaque(obj, query_dup(q));
+  return obj;
+}
+
+JSValue
+minnet_query_new(JSContext* ctx, const char* s, size_t n) {
+  Query* q;
+  JSValue ret;
+
+  if(!(q = query_new(s, n, ctx)))
+    return JS_ThrowOutOfMemory(ctx);
+
+  ret = minnet_query_wrap(ctx, q);
+  query_free(q, JS_GetRuntime(ctx));
+  return ret;
+}
+
+static JSValue
+minnet_query_get(JSContext* ctx, JSValueConst this_val, int magic) {
+  Query* q;
+  JSValue ret = JS_UNDEFINED;
+
+  if(!(q = minnet_query_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  switch(magic) {
+    case QUERY_SIZE: {
+      ret = JS_NewUint32(ctx, q->count);
+      break;
+    }
+  }
+  return ret;
+}
+
+static JSValue
+minnet_query_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic) {
+  Query* q;
+  JSValue ret = JS_UNDEFINED;
+  const char* key = 0;
+  size_t keylen = 0;
+  uint32_t i, n = 0;
+  int32_t index;
+
+  if(!(q = minnet_query_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  if(magic <= QUERY_HAS && !(key = JS_ToCStringLen(ctx, &keylen, argv[0])))
+    return JS_EXCEPTION;
+
+  switch(magic) {
+    case QUERY_GET: {
+      ret = (index = query_find(q, key, keylen, 0)) != -1 ? query_value(q, index, ctx) : JS_NULL;
+      break;
+    }
+
+    case QUERY_GET_ALL: {
+      ret = JS_NewArray(ctx);
+
+      for(index = 0; (index = query_find(q, key, keylen, index)) != -1; index++)
+        JS_SetPropertyUint32(ctx, ret, n++, query_value(q, index, ctx));
+      break;
+    }
+
+    case QUERY_HAS: {
+      ret = JS_NewBool(ctx, query_find(q, key, keylen, 0) != -1);
+      break;
+    }
+
+    case QUERY_KEYS:
+    case QUERY_VALUES:
+    case QUERY_ENTRIES: {
+      ret = JS_NewArray(ctx);
+
+      for(i = 0; i < q->count; i++) {
+        JSValue item;
+
+        if(magic == QUERY_KEYS) {
+          item = query_key(q, i, ctx);
+        } else if(magic == QUERY_VALUES) {
+          item = query_value(q, i, ctx);
+        } else {
+          item = JS_NewArray(ctx);
+          JS_SetPropertyUint32(ctx, item, 0, query_key(q, i, ctx));
+          JS_SetPropertyUint32(ctx, item, 1, query_value(q, i, ctx));
+        }
+
+        JS_SetPropertyUint32(ctx, ret, i, item);
+      }
+      break;
+    }
+
+    case QUERY_TO_STRING: {
+      /* keys and values may have been decoded in place, so encode them again */
+      DynBuf buf;
+      dbuf_init2(&buf, ctx, (DynBufReallocFunc*)js_realloc);
+
+      for(i = 0; i < q->count; i++) {
+        QueryParam* p = &q->params[i];
+        size_t len;
+        const char* value = query_string(q, i, &len);
+
+        if(i > 0)
+          dbuf_putc(&buf, '&');
+
+        query_encode(&buf, &q->data[p->key], p->keylen);
+        dbuf_putc(&buf, '=');
+        query_encode(&buf, value, len);
+      }
+
+      ret = JS_NewStringLen(ctx, (const char*)buf.buf, buf.size);
+      dbuf_free(&buf);
+      break;
+    }
+
+    case QUERY_TO_OBJECT: {
+      ret = JS_NewObject(ctx);
+
+      /* like URL.query, the last of repeated keys wins */
+      for(i = 0; i < q->count; i++) {
+        QueryParam* p = &q->params[i];
+        JSAtom prop = JS_NewAtomLen(ctx, &q->data[p->key], p->keylen);
+
+        JS_SetProperty(ctx, ret, prop, query_value(q, i, ctx));
+        JS_FreeAtom(ctx, prop);
+      }
+      break;
+    }
+  }
+
+  if(key)
+    JS_FreeCString(ctx, key);
+
+  return ret;
+}
+
+JSValue
+minnet_query_constructor(JSContext* ctx, JSValueConst new_target, int argc, JSValueConst argv[]) {
+  JSValue proto, obj;
+  Query* q = 0;
+  const char* str = 0;
+  size_t len = 0;
+
+  if(argc > 0 && !JS_IsUndefined(argv[0]) && !(str = JS_ToCStringLen(ctx, &len, argv[0])))
+    return JS_EXCEPTION;
+
+  q = query_new(str ? str : "", len, ctx);
+
+  if(str)
+    JS_FreeCString(ctx, str);
+
+  if(!q)
+    return JS_ThrowOutOfMemory(ctx);
+
+  /* using new_target to get the prototype is necessary when the class is extended. */
+  proto = JS_GetPropertyStr(ctx, new_target, "prototype");
+  if(JS_IsException(proto))
+    proto = JS_DupValue(ctx, minnet_query_proto);
+
+  obj = JS_NewObjectProtoClass(ctx, proto, minnet_query_class_id);
+  JS_FreeValue(ctx, proto);
+  if(JS_IsException(obj))
+    goto fail;
+
+  JS_SetOpaque(obj, q);
+  return obj;
+
+fail:
+  query_free(q, JS_GetRuntime(ctx));
+  JS_FreeValue(ctx, obj);
+  return JS_EXCEPTION;
+}
+
+static void
+minnet_query_finalizer(JSRuntime* rt, JSValue val) {
+  Query* q;
+
+  if((q = minnet_query_data(val)))
+    query_free(q, rt);
+}
+
+static const JSClassDef minnet_query_class = {
+    "MinnetURLSearchParams",
+    .finalizer = minnet_query_finalizer,
+};
+
+static const JSCFunctionListEntry minnet_query_proto_funcs[] = {
+    JS_CFUNC_MAGIC_DEF("get", 1, minnet_query_method, QUERY_GET),
+    JS_CFUNC_MAGIC_DEF("getAll", 1, minnet_query_method, QUERY_GET_ALL),
+    JS_CFUNC_MAGIC_DEF("has", 1, minnet_query_method, QUERY_HAS),
+    JS_CFUNC_MAGIC_DEF("keys", 0, minnet_query_method, QUERY_KEYS),
+    JS_CFUNC_MAGIC_DEF("values", 0, minnet_query_method, QUERY_VALUES),
+    JS_CFUNC_MAGIC_DEF("entries", 0, minnet_query_method, QUERY_ENTRIES),
+    JS_CFUNC_MAGIC_DEF("toString", 0, minnet_query_method, QUERY_TO_STRING),
+    JS_CFUNC_MAGIC_DEF("toObject", 0, minnet_query_method, QUERY_TO_OBJECT),
+    JS_CGETSET_MAGIC_FLAGS_DEF("size", minnet_query_get, 0, QUERY_SIZE, 0),
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "MinnetURLSearchParams", JS_PROP_CONFIGURABLE),
+};
+
+int
+minnet_query_init(JSContext* ctx, JSModuleDef* m) {
+  // Add class URLSearchParams
+  JS_NewClassID(&minnet_query_class_id);
+  JS_NewClass(JS_GetRuntime(ctx), minnet_query_class_id, &minnet_query_class);
+  minnet_query_proto = JS_NewObject(ctx);
+  JS_SetPropertyFunctionList(ctx, minnet_query_proto, minnet_query_proto_funcs, countof(minnet_query_proto_funcs));
+
+  minnet_query_ctor = JS_NewCFunction2(ctx, minnet_query_constructor, "MinnetURLSearchParams", 1, JS_CFUNC_constructor, 0);
+
+  JS_SetConstructor(ctx, minnet_query_ctor, minnet_query_proto);
+
+  if(m)
+    JS_SetModuleExport(ctx, m, "URLSearchParams", minnet_query_ctor);
+
+  return 0;
+}
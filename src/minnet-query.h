@@ -0,0 +1,20 @@
+#ifndef MINNET_QUERY_H
+#define MINNET_QUERY_H
+
+#include "query.h"
+
+Query* minnet_query_data(JSValueConst);
+JSValue minnet_query_wrap(JSContext*, Query* q);
+JSValue minnet_query_new(JSContext*, const char* s, size_t n);
+JSValue minnet_query_constructor(JSContext*, JSValueConst new_target, int argc, JSValueConst argv[]);
+int minnet_query_init(JSContext*, JSModuleDef* m);
+
+extern THREAD_LOCAL JSClassID minnet_query_class_id;
+extern THREAD_LOCAL JSValue minnet_query_proto, minnet_query_ctor;
+
+static inline Query*
+minnet_query_data2(JSContext* ctx, JSValueConst obj) {
+  return JS_GetOpaque2(ctx, obj, minnet_query_class_id);
+}
+
+#endif /* MINNET_QUERY_H */
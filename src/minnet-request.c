@@ -4,7 +4,9 @@
 #include "minnet-request.h"
 #include "minnet-ringbuffer.h"
 #include "minnet-generator.h"
+#include "minnet-json.h"
 #include "minnet-headers.h"
+#include "minnet-query.h"
 #include "minnet.h"
 #include "headers.h"
 #include "js-utils.h"
@@ -47,7 +49,8 @@ minnet_request_constructor(JSContext* ctx, JSValueConst new_target, int argc, JS
     req->h2 = other->h2;
     req->method = other->method;
     req->url = url_clone(other->url, ctx);
-    buffer_clone(&req->headers, &other->headers);
+    headers_clone(&req->headers, &other->headers);
+    req->route = other->route;
 
   } else {
     url_fromvalue(&req->url, argv[0], ctx);
@@ -96,9 +99,11 @@ enum {
   REQUEST_HEADERS,
   REQUEST_IP,
   REQUEST_METHOD,
+  REQUEST_PARAMS,
   REQUEST_PATH,
   REQUEST_PROTOCOL,
   REQUEST_REFERER,
+  REQUEST_SEARCH_PARAMS,
   REQUEST_SECURE,
   REQUEST_TYPE,
   REQUEST_URI,
@@ -156,22 +161,14 @@ minnet_request_get(JSContext* ctx, JSValueConst this_val, int magic) {
     }
 
     case REQUEST_BODY: {
-      switch(req->method) {
-        case METHOD_GET:
-        case METHOD_OPTIONS:
-        case METHOD_PATCH:
-        case METHOD_PUT:
-        case METHOD_DELETE:
-        case METHOD_HEAD: {
-          assert(!req->body);
-          ret = JS_NULL;
-          break;
-        }
-
-        case METHOD_POST: {
-          ret = minnet_generator_create(ctx, &req->body);
-          break;
-        }
+      /* any method may carry a body when it is streamed */
+      if(req->body || req->method == METHOD_POST) {
+        if(req->body && generator_stopped(req->body))
+          request_spool_stream(req);
+
+        ret = minnet_generator_create(ctx, &req->body);
+      } else {
+        ret = JS_NULL;
       }
       break;
     }
@@ -190,6 +187,48 @@ minnet_request_get(JSContext* ctx, JSValueConst this_val, int magic) {
       ret = JS_NewBool(ctx, req->h2);
       break;
     }
+
+    case REQUEST_PARAMS: {
+      size_t len = req->url.path ? strlen(req->url.path) : 0;
+
+      ret = JS_NewObject(ctx);
+
+      for(uint32_t i = 0; i < req->route.count; i++) {
+        RouteParam* p = &req->route.params[i];
+        JSAtom prop;
+
+        /* the path was changed after routing */
+        if(p->offset + p->length > len)
+          break;
+
+        prop = JS_NewAtomLen(ctx, p->name, p->namelen);
+        JS_DefinePropertyValue(ctx, ret, prop, JS_NewStringLen(ctx, req->url.path + p->offset, p->length), JS_PROP_C_W_E);
+        JS_FreeAtom(ctx, prop);
+      }
+
+      break;
+    }
+
+    case REQUEST_SEARCH_PARAMS: {
+      const char* s = req->url.path ? url_query(req->url) : 0;
+      size_t len;
+
+      if(!s)
+        s = "";
+
+      len = byte_chr(s, strlen(s), '#');
+
+      if(req->query && !query_equal(req->query, s, len)) {
+        query_free(req->query, JS_GetRuntime(ctx));
+        req->query = 0;
+      }
+
+      if(!req->query && !(req->query = query_new(s, len, ctx)))
+        return JS_ThrowOutOfMemory(ctx);
+
+      ret = minnet_query_wrap(ctx, req->query);
+      break;
+    }
   }
   return ret;
 }
@@ -256,6 +295,7 @@ enum {
   REQUEST_ARRAYBUFFER,
   REQUEST_TEXT,
   REQUEST_JSON,
+  REQUEST_JSON_LINES,
 };
 
 static JSValue
@@ -269,6 +309,35 @@ minnet_request_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
     return JS_EXCEPTION;
 
   if((gen = req->body)) {
+    /* a complete spooled body is mapped as a whole, or read from the file in chunks */
+    if(req->spool.fd != -1 && generator_stopped(gen)) {
+      if(magic == REQUEST_ARRAYBUFFER || magic == REQUEST_TEXT) {
+        JSValue buf = request_spool_buffer(req, ctx);
+
+        if(JS_IsException(buf))
+          return buf;
+
+        if(magic == REQUEST_TEXT) {
+          ret = js_arraybuffer_tostring(ctx, JS_UNDEFINED, 1, &buf);
+          JS_FreeValue(ctx, buf);
+          buf = ret;
+        }
+
+        ret = js_async_create(ctx, &funcs);
+        js_async_resolve(ctx, &funcs, buf);
+        JS_FreeValue(ctx, buf);
+        return ret;
+      }
+
+      request_spool_stream(req);
+    }
+
+    /* parsed in C while the body arrives */
+    if(magic == REQUEST_JSON)
+      return minnet_json_parse(ctx, gen);
+    if(magic == REQUEST_JSON_LINES)
+      return minnet_json_lines(ctx, gen);
+
     ret = js_async_create(ctx, &funcs);
 
     switch(magic) {
@@ -284,24 +353,6 @@ minnet_request_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
         JS_FreeValue(ctx, ret);
         ret = tmp;
 
-        generator_continuous(gen, funcs.resolve);
-        break;
-      }
-      case REQUEST_JSON: {
-        JSValue tmp, fn = JS_NewCFunction(ctx, js_arraybuffer_tostring, "", 1);
-
-        tmp = js_invoke(ctx, ret, "then", 1, &fn);
-        JS_FreeValue(ctx, fn);
-        JS_FreeValue(ctx, ret);
-        ret = tmp;
-
-        fn = js_global_static_func(ctx, "JSON", "parse");
-
-        tmp = js_invoke(ctx, ret, "then", 1, &fn);
-        JS_FreeValue(ctx, fn);
-        JS_FreeValue(ctx, ret);
-        ret = tmp;
-
         generator_continuous(gen, funcs.resolve);
         break;
       }
@@ -383,12 +434,15 @@ static const JSCFunctionListEntry minnet_request_proto_funcs[] = {
     JS_CGETSET_MAGIC_FLAGS_DEF("url", minnet_request_get, minnet_request_set, REQUEST_URI, JS_PROP_ENUMERABLE),
     JS_CGETSET_MAGIC_FLAGS_DEF("method", minnet_request_get, minnet_request_set, REQUEST_METHOD, JS_PROP_ENUMERABLE),
     JS_CGETSET_MAGIC_FLAGS_DEF("path", minnet_request_get, minnet_request_set, REQUEST_PATH, 0),
+    JS_CGETSET_MAGIC_FLAGS_DEF("params", minnet_request_get, 0, REQUEST_PARAMS, 0),
+    JS_CGETSET_MAGIC_FLAGS_DEF("searchParams", minnet_request_get, 0, REQUEST_SEARCH_PARAMS, 0),
     JS_CGETSET_MAGIC_FLAGS_DEF("protocol", minnet_request_get, 0, REQUEST_PROTOCOL, 0),
     JS_CGETSET_MAGIC_FLAGS_DEF("headers", minnet_request_get, minnet_request_set, REQUEST_HEADERS, 0),
     JS_CGETSET_MAGIC_FLAGS_DEF("referer", minnet_request_get, 0, REQUEST_REFERER, 0),
     JS_CFUNC_MAGIC_DEF("arrayBuffer", 0, minnet_request_method, REQUEST_ARRAYBUFFER),
     JS_CFUNC_MAGIC_DEF("text", 0, minnet_request_method, REQUEST_TEXT),
     JS_CFUNC_MAGIC_DEF("json", 0, minnet_request_method, REQUEST_JSON),
+    JS_CFUNC_MAGIC_DEF("jsonLines", 0, minnet_request_method, REQUEST_JSON_LINES),
     JS_CGETSET_MAGIC_FLAGS_DEF("body", minnet_request_get, 0, REQUEST_BODY, 0),
     JS_CGETSET_MAGIC_FLAGS_DEF("secure", minnet_request_get, 0, REQUEST_SECURE, JS_PROP_ENUMERABLE),
     JS_CGETSET_MAGIC_FLAGS_DEF("h2", minnet_request_get, 0, REQUEST_H2, JS_PROP_CONFIGURABLE | JS_PROP_ENUMERABLE),
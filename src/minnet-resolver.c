@@ -0,0 +1,417 @@
+#define _GNU_SOURCE
+#include "minnet-resolver.h"
+#include "minnet-client.h"
+#include "minnet.h"
+#include "js-utils.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+THREAD_LOCAL Resolver* minnet_resolver = 0;
+
+/* A lookup on a UDP socket adopted into the client's context */
+struct resolver_query {
+  MinnetClient* client;
+  char* host;
+  uint16_t id;
+  size_t len;
+  BOOL adopted, done;
+  uint8_t buf[LWS_PRE + DNS_PACKET_SIZE];
+};
+
+static void
+resolver_query_free(struct resolver_query* q) {
+  client_free(q->client, JS_GetRuntime(q->client->context.js));
+  free(q->host);
+  free(q);
+}
+
+/* Points the connection at 'addr', 'host' stays the Host header and TLS server name */
+static void
+client_resolved(MinnetClient* client, const struct in_addr* addr) {
+  inet_ntop(AF_INET, addr, client->resolve.address, sizeof(client->resolve.address));
+  client->connect_info.address = client->resolve.address;
+}
+
+/* Accounts for a completed query and caches its outcome */
+static void
+resolver_result(Resolver* r, const char* host, const struct in_addr* addrs, int count, uint32_t ttl) {
+  if(!r)
+    return;
+
+  if(count < 0)
+    r->cache.failures++;
+  else
+    dns_cache_store(&r->cache, host, addrs, count, ttl, time(0));
+}
+
+/* Sends the query and waits up to the timeout, for blocking clients */
+static int
+resolver_query_sync(Resolver* r, struct lws_context* context, const char* host, struct in_addr* addrs, uint32_t* ttl) {
+  struct sockaddr_in sa = {.sin_family = AF_INET, .sin_port = htons(r->port), .sin_addr = r->server};
+  uint8_t buf[DNS_PACKET_SIZE];
+  lws_usec_t deadline = lws_now_usecs() + (lws_usec_t)r->timeout * 1000;
+  uint16_t id;
+  int fd, len, ret = -2;
+
+  lws_get_random(context, &id, sizeof(id));
+
+  if((len = dns_query_build(buf, sizeof(buf), id, host)) == -1)
+    return -2;
+
+  if((fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) == -1)
+    return -2;
+
+  r->cache.queries++;
+
+  if(connect(fd, (struct sockaddr*)&sa, sizeof(sa)) == -1 || send(fd, buf, len, 0) != len) {
+    close(fd);
+    return -2;
+  }
+
+  for(;;) {
+    lws_usec_t now = lws_now_usecs();
+    struct pollfd pfd = {fd, POLLIN, 0};
+    ssize_t n;
+
+    if(now >= deadline || poll(&pfd, 1, (deadline - now + 999) / 1000) <= 0)
+      break;
+
+    if((n = recv(fd, buf, sizeof(buf), 0)) == -1)
+      break;
+
+    /* a stray datagram is skipped */
+    if((ret = dns_answer_parse(buf, n, id, host, addrs, DNS_MAX_ADDRS, ttl)) != -1)
+      break;
+
+    ret = -2;
+  }
+
+  close(fd);
+  return ret;
+}
+
+/**
+ * Opens the connection deferred by client_resolve(), by name when the query
+ * failed.  A name the server says has no address fails the connection.
+ */
+static void
+resolver_complete(struct resolver_query* q, const struct in_addr* addrs, int count, uint32_t ttl) {
+  MinnetClient* client = q->client;
+  JSContext* ctx = client->context.js;
+  JSValue err;
+
+  q->done = TRUE;
+  client->resolve.query = 0;
+
+  resolver_result(minnet_resolver, q->host, addrs, count, ttl);
+
+  if(count > 0)
+    client_resolved(client, &addrs[0]);
+
+  errno = 0;
+
+  if(count == 0)
+    err = js_error_new(ctx, "[2] Host not found: %s", q->host);
+  else if(!client_connect(client) && !client->wsi)
+    err = js_error_new(ctx, "[2] Connection failed: %s", strerror(errno));
+  else
+    return;
+
+  if(js_async_pending(&client->promise))
+    js_async_reject(ctx, &client->promise, err);
+
+  JS_FreeValue(ctx, err);
+}
+
+static int
+resolver_start(Resolver* r, MinnetClient* client, const char* host) {
+  struct lws_vhost* vhost;
+  struct resolver_query* q;
+  char server[INET_ADDRSTRLEN];
+  int len;
+
+  if(!(vhost = lws_get_vhost_by_name(client->context.lws, "default")))
+    return 0;
+
+  if(!(q = calloc(1, sizeof(struct resolver_query))))
+    return 0;
+
+  lws_get_random(client->context.lws, &q->id, sizeof(q->id));
+
+  if((len = dns_query_build(q->buf + LWS_PRE, DNS_PACKET_SIZE, q->id, host)) == -1 || !(q->host = strdup(host))) {
+    free(q);
+    return 0;
+  }
+
+  q->len = len;
+  q->client = client_dup(client);
+  client->resolve.query = q;
+
+  inet_ntop(AF_INET, &r->server, server, sizeof(server));
+
+  if(!lws_create_adopt_udp(vhost, server, r->port, 0, "minnet-dns", 0, 0, q, 0, 0)) {
+    client->resolve.query = 0;
+
+    /* once adopted, the close callback frees it */
+    if(!q->adopted)
+      resolver_query_free(q);
+
+    return 0;
+  }
+
+  r->cache.queries++;
+  return 1;
+}
+
+/**
+ * Resolves the host of a client's connect_info through the cache of
+ * setResolver(), then the hosts file, then a query to the server.  Blocking
+ * clients wait for the answer.  Address literals, localhost and unix sockets
+ * are left alone, as are names the resolver fails on: those go to lws.  A
+ * name cached or answered as having no address is not connected at all.
+ *
+ * @return 1 when a query is in flight and client_connect() will follow,
+ *         -1 when the host does not exist
+ */
+int
+client_resolve(MinnetClient* client) {
+  Resolver* r = minnet_resolver;
+  const char* host = client->connect_info.address;
+  struct in_addr addrs[DNS_MAX_ADDRS];
+  DnsEntry* entry;
+  uint32_t ttl;
+
+  if(!r || !host || !*host || *host == '+' || dns_literal(host) || !strcasecmp(host, "localhost"))
+    return 0;
+
+  if(!strcmp(client->request->url.protocol, "udp"))
+    return 0;
+
+  if((entry = dns_cache_find(&r->cache, host, time(0)))) {
+    if(!dns_cache_next(entry, &addrs[0]))
+      return -1;
+
+    client_resolved(client, &addrs[0]);
+    return 0;
+  }
+
+  if(r->hosts && dns_hosts_lookup(r->hosts, host, &addrs[0])) {
+    dns_cache_store(&r->cache, host, addrs, 1, RESOLVER_HOSTS_TTL, time(0));
+    client_resolved(client, &addrs[0]);
+    return 0;
+  }
+
+  if(!client->blocking)
+    return resolver_start(r, client, host);
+
+  int count = resolver_query_sync(r, client->context.lws, host, addrs, &ttl);
+
+  resolver_result(r, host, addrs, count, ttl);
+
+  if(count == 0)
+    return -1;
+
+  if(count > 0)
+    client_resolved(client, &addrs[0]);
+
+  return 0;
+}
+
+int
+resolver_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, void* in, size_t len) {
+  MinnetClient* client = lws_client(wsi);
+  struct resolver_query* q = lws_get_opaque_user_data(wsi);
+
+  if(lws_reason_poll(reason))
+    return wsi_handle_poll(wsi, reason, &client->on.fd, in);
+
+  switch(reason) {
+    case LWS_CALLBACK_RAW_ADOPT: {
+      if(q) {
+        uint32_t timeout = minnet_resolver ? minnet_resolver->timeout : RESOLVER_TIMEOUT;
+
+        q->adopted = TRUE;
+        lws_set_timeout(wsi, PENDING_TIMEOUT_USER_OK, MAX(1, (timeout + 999) / 1000));
+        lws_callback_on_writable(wsi);
+      }
+
+      break;
+    }
+
+    case LWS_CALLBACK_RAW_WRITEABLE: {
+      if(q && !q->done && lws_write(wsi, q->buf + LWS_PRE, q->len, LWS_WRITE_RAW) < (int)q->len)
+        return -1;
+
+      break;
+    }
+
+    case LWS_CALLBACK_RAW_RX: {
+      struct in_addr addrs[DNS_MAX_ADDRS];
+      uint32_t ttl = 0;
+      int count;
+
+      /* a stray datagram is skipped */
+      if(!q || q->done || (count = dns_answer_parse(in, len, q->id, q->host, addrs, countof(addrs), &ttl)) == -1)
+        break;
+
+      resolver_complete(q, addrs, count, ttl);
+      return -1;
+    }
+
+    case LWS_CALLBACK_RAW_CLOSE: {
+      if(q && q->adopted) {
+        lws_set_opaque_user_data(wsi, 0);
+
+        /* timed out or the socket failed */
+        if(!q->done && q->client->resolve.query == q)
+          resolver_complete(q, 0, -2, 0);
+
+        resolver_query_free(q);
+      }
+
+      break;
+    }
+
+    default: {
+      break;
+    }
+  }
+
+  return 0;
+}
+
+static JSValue
+resolver_stats(JSContext* ctx, Resolver* r) {
+  JSValue ret = JS_NewObject(ctx);
+  char server[INET_ADDRSTRLEN];
+
+  inet_ntop(AF_INET, &r->server, server, sizeof(server));
+
+  JS_SetPropertyStr(ctx, ret, "entries", JS_NewUint32(ctx, r->cache.count));
+  JS_SetPropertyStr(ctx, ret, "hits", JS_NewInt64(ctx, r->cache.hits));
+  JS_SetPropertyStr(ctx, ret, "misses", JS_NewInt64(ctx, r->cache.misses));
+  JS_SetPropertyStr(ctx, ret, "expired", JS_NewInt64(ctx, r->cache.expired));
+  JS_SetPropertyStr(ctx, ret, "queries", JS_NewInt64(ctx, r->cache.queries));
+  JS_SetPropertyStr(ctx, ret, "failures", JS_NewInt64(ctx, r->cache.failures));
+  JS_SetPropertyStr(ctx, ret, "server", JS_NewString(ctx, server));
+  JS_SetPropertyStr(ctx, ret, "port", JS_NewUint32(ctx, r->port));
+
+  return ret;
+}
+
+/**
+ * Enables the resolver of client() and fetch() with true or { server, port,
+ * timeout, hosts, maxEntries, minTtl, maxTtl, negativeTtl }, disables it
+ * with false.  Without argument the settings are kept.
+ *
+ * @return statistics of the resolver, null when it is disabled
+ */
+JSValue
+minnet_set_resolver(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  if(argc > 0 && !JS_IsUndefined(argv[0])) {
+    Resolver* r = 0;
+
+    if(!JS_IsObject(argv[0]) && !JS_IsBool(argv[0]) && !JS_IsNull(argv[0]))
+      return JS_ThrowTypeError(ctx, "argument 1 must be a boolean or an object");
+
+    if(JS_IsObject(argv[0]) || JS_ToBool(ctx, argv[0])) {
+      uint32_t max_entries = 0, port = DNS_PORT;
+
+      if(!(r = malloc(sizeof(Resolver))))
+        return JS_ThrowOutOfMemory(ctx);
+
+      r->timeout = RESOLVER_TIMEOUT;
+      r->hosts = strdup("/etc/hosts");
+
+      if(!dns_nameserver("/etc/resolv.conf", &r->server))
+        inet_pton(AF_INET, "127.0.0.1", &r->server);
+
+      if(JS_IsObject(argv[0])) {
+        JSValue value = JS_GetPropertyStr(ctx, argv[0], "server");
+
+        if(JS_IsString(value)) {
+          const char* str = JS_ToCString(ctx, value);
+          int ok = inet_pton(AF_INET, str, &r->server);
+
+          JS_FreeCString(ctx, str);
+
+          if(ok != 1) {
+            JS_FreeValue(ctx, value);
+            free(r->hosts);
+            free(r);
+            return JS_ThrowTypeError(ctx, "server must be an IPv4 address");
+          }
+        }
+
+        JS_FreeValue(ctx, value);
+
+        value = JS_GetPropertyStr(ctx, argv[0], "port");
+
+        if(JS_IsNumber(value))
+          JS_ToUint32(ctx, &port, value);
+
+        JS_FreeValue(ctx, value);
+
+        value = JS_GetPropertyStr(ctx, argv[0], "timeout");
+
+        if(JS_IsNumber(value))
+          JS_ToUint32(ctx, &r->timeout, value);
+
+        JS_FreeValue(ctx, value);
+
+        value = JS_GetPropertyStr(ctx, argv[0], "hosts");
+
+        if(JS_IsString(value) || JS_IsBool(value) || JS_IsNull(value)) {
+          free(r->hosts);
+          r->hosts = 0;
+
+          if(JS_IsString(value)) {
+            const char* str = JS_ToCString(ctx, value);
+            r->hosts = strdup(str);
+            JS_FreeCString(ctx, str);
+          } else if(JS_ToBool(ctx, value)) {
+            r->hosts = strdup("/etc/hosts");
+          }
+        }
+
+        JS_FreeValue(ctx, value);
+
+        value = JS_GetPropertyStr(ctx, argv[0], "maxEntries");
+
+        if(JS_IsNumber(value))
+          JS_ToUint32(ctx, &max_entries, value);
+
+        JS_FreeValue(ctx, value);
+      }
+
+      dns_cache_init(&r->cache, max_entries);
+      r->port = port;
+
+      if(JS_IsObject(argv[0])) {
+        r->cache.min_ttl = js_get_propertystr_uint32(ctx, argv[0], "minTtl");
+
+        if(js_has_propertystr(ctx, argv[0], "maxTtl"))
+          r->cache.max_ttl = js_get_propertystr_uint32(ctx, argv[0], "maxTtl");
+
+        if(js_has_propertystr(ctx, argv[0], "negativeTtl"))
+          r->cache.negative_ttl = js_get_propertystr_uint32(ctx, argv[0], "negativeTtl");
+      }
+    }
+
+    /* queries in flight complete without it */
+    if(minnet_resolver) {
+      dns_cache_clear(&minnet_resolver->cache);
+      free(minnet_resolver->hosts);
+      free(minnet_resolver);
+    }
+
+    minnet_resolver = r;
+  }
+
+  return minnet_resolver ? resolver_stats(ctx, minnet_resolver) : JS_NULL;
+}
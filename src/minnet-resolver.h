@@ -0,0 +1,28 @@
+#ifndef MINNET_RESOLVER_H
+#define MINNET_RESOLVER_H
+
+#include <libwebsockets.h>
+#include <quickjs.h>
+#include "dns.h"
+
+#define RESOLVER_TIMEOUT 2000
+#define RESOLVER_HOSTS_TTL 60
+
+/* Settings and cache of setResolver(), used by client() and fetch() */
+typedef struct resolver {
+  DnsCache cache;
+  struct in_addr server;
+  uint16_t port;
+  uint32_t timeout; /* milliseconds */
+  char* hosts;      /* hosts(5) file consulted before the server, 0 for none */
+} Resolver;
+
+struct client_context;
+
+extern THREAD_LOCAL Resolver* minnet_resolver;
+
+int client_resolve(struct client_context*);
+int resolver_callback(struct lws*, enum lws_callback_reasons, void*, void*, size_t);
+JSValue minnet_set_resolver(JSContext*, JSValueConst this_val, int argc, JSValueConst argv[]);
+
+#endif /* MINNET_RESOLVER_H */
@@ -1,6 +1,7 @@
 #include "minnet-websocket.h"
 #include "minnet-response.h"
 #include "minnet-generator.h"
+#include "minnet-json.h"
 #include "minnet-headers.h"
 #include "minnet.h"
 #include "buffer.h"
@@ -62,6 +63,7 @@ enum {
   RESPONSE_ARRAYBUFFER = 0,
   RESPONSE_TEXT,
   RESPONSE_JSON,
+  RESPONSE_JSON_LINES,
 };
 
 static JSValue
@@ -75,6 +77,13 @@ minnet_response_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueC
   if(!(resp = minnet_response_data2(ctx, this_val)))
     return JS_EXCEPTION;
 
+  if(magic == RESPONSE_JSON_LINES)
+    return minnet_json_lines(ctx, response_generator(resp, ctx));
+
+  /* parsed in C while the body arrives */
+  if(magic == RESPONSE_JSON && !resp->sync)
+    return minnet_json_parse(ctx, response_generator(resp, ctx));
+
   if(!resp->sync)
     ret = js_async_create(ctx, &funcs);
 
@@ -106,13 +115,8 @@ minnet_response_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueC
     }
 
     case RESPONSE_JSON: {
-      if(resp->sync) {
-        ByteBlock blk = queue_next(gen->q, NULL, NULL);
-        ret = block_tojson(&blk, ctx);
-      } else {
-        generator_continuous(gen, funcs.resolve);
-      }
-
+      ByteBlock blk = queue_next(gen->q, NULL, NULL);
+      ret = block_tojson(&blk, ctx);
       break;
     }
 
@@ -238,7 +242,7 @@ minnet_response_clone(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
   clone->read_only = resp->read_only;
   clone->url = url_clone(resp->url, ctx);
 
-  buffer_clone(&clone->headers, &resp->headers);
+  headers_clone(&clone->headers, &resp->headers);
   // buffer_clone(clone->body, resp->body);
 
   return minnet_response_wrap(ctx, clone);
@@ -284,7 +288,7 @@ minnet_response_get(JSContext* ctx, JSValueConst this_val, int magic) {
     }
 
     case RESPONSE_HEADERS: {
-      ret = headers_object(ctx, resp->headers.start, resp->headers.end);
+      ret = headers_object(ctx, resp->headers.buffer.start, resp->headers.buffer.write);
       //    ret = minnet_headers_wrap(ctx, &resp->headers, response_dup(resp), (HeadersFreeFunc*)&response_free);
       break;
     }
@@ -348,7 +352,7 @@ minnet_response_set(JSContext* ctx, JSValueConst this_val, JSValueConst value, i
     }
 
     case RESPONSE_HEADERS: {
-      buffer_reset(&resp->headers);
+      headers_reset(&resp->headers);
       headers_fromobj(&resp->headers, value, "\n", ": ", ctx);
       break;
     }
@@ -436,6 +440,7 @@ static const JSCFunctionListEntry minnet_response_proto_funcs[] = {
     JS_CFUNC_MAGIC_DEF("append", 2, minnet_response_header, HEADERS_APPEND),
     JS_CFUNC_MAGIC_DEF("get", 1, minnet_response_header, HEADERS_GET),
     JS_CFUNC_MAGIC_DEF("json", 0, minnet_response_method, RESPONSE_JSON),
+    JS_CFUNC_MAGIC_DEF("jsonLines", 0, minnet_response_method, RESPONSE_JSON_LINES),
     JS_CFUNC_MAGIC_DEF("location", 1, minnet_response_header, HEADERS_LOCATION),
     JS_CFUNC_MAGIC_DEF("set", 2, minnet_response_header, HEADERS_SET),
     JS_CFUNC_MAGIC_DEF("text", 0, minnet_response_method, RESPONSE_TEXT),
@@ -29,8 +29,69 @@ enum {
   RINGBUFFER_OLDEST_TAIL,
   RINGBUFFER_INSERTRANGE,
   RINGBUFFER_CONSUMERANGE,
+  RINGBUFFER_TAKE,
+  RINGBUFFER_MODE,
 };
 
+/* Resolves an ArrayBuffer or TypedArray argument to the byte range it covers */
+static uint8_t*
+ringbuffer_argbuf(JSContext* ctx, JSValueConst value, JSBuffer* buf, size_t* size) {
+  *buf = js_input_buffer(ctx, value);
+
+  if(!buf->data)
+    return 0;
+
+  if(buf->range.length < 0) {
+    *size = buf->size;
+    return buf->data;
+  }
+
+  *size = buf->range.length;
+  return buf->data + buf->range.offset;
+}
+
+static BOOL
+ringbuffer_shared_create(JSContext* ctx, MinnetRingbuffer* rb, uint32_t element_len, uint32_t count, RingbufferMode mode) {
+  JSValue ctor, buf;
+  size_t size = ringbuffer_shared_size(element_len, count, mode);
+  BOOL ret;
+
+  if(size == 0) {
+    JS_ThrowRangeError(ctx, "%" PRIu32 " elements of %" PRIu32 " bytes do not fit a buffer", count, element_len);
+    return FALSE;
+  }
+
+  ctor = js_global_get(ctx, "SharedArrayBuffer");
+
+  /* Allocate through the SharedArrayBuffer constructor, so the memory can be posted to Workers */
+  if(!JS_IsFunction(ctx, ctor)) {
+    JS_FreeValue(ctx, ctor);
+    JS_ThrowTypeError(ctx, "SharedArrayBuffer is not available");
+    return FALSE;
+  }
+
+  {
+    JSValue arg = JS_NewInt64(ctx, size);
+    buf = JS_CallConstructor(ctx, ctor, 1, &arg);
+  }
+
+  JS_FreeValue(ctx, ctor);
+
+  if(JS_IsException(buf))
+    return FALSE;
+
+  {
+    size_t len;
+    uint8_t* ptr = JS_GetArrayBuffer(ctx, &len, buf);
+
+    ringbuffer_shared_init((struct ringbuffer_shared*)ptr, element_len, count, mode);
+  }
+
+  ret = ringbuffer_attach(rb, buf, ctx);
+  JS_FreeValue(ctx, buf);
+  return ret;
+}
+
 JSValue
 minnet_ringbuffer_constructor(JSContext* ctx, JSValueConst new_target, int argc, JSValueConst argv[]) {
   JSValue proto, obj;
@@ -60,14 +121,48 @@ minnet_ringbuffer_constructor(JSContext* ctx, JSValueConst new_target, int argc,
       argv += 1;
 
     } else if(argc >= 2 && JS_IsNumber(argv[0]) && JS_IsNumber(argv[1])) {
-      uint32_t element_size = 0, count = 0;
+      uint32_t element_size = 0, count = 0, mode = RINGBUFFER_LOCKED;
       JS_ToUint32(ctx, &element_size, argv[0]);
       JS_ToUint32(ctx, &count, argv[1]);
 
-      rb->ring = lws_ring_create(rb->element_len = element_size, rb->size = count, ringbuffer_destroy_element);
+      if(argc >= 3 && JS_IsNumber(argv[2])) {
+        JS_ToUint32(ctx, &mode, argv[2]);
+        argc -= 1;
+        argv += 1;
+      }
+
+      if(mode > RINGBUFFER_MPSC) {
+        JS_ThrowRangeError(ctx, "invalid mode %" PRIu32 " (LOCKED, SPSC or MPSC)", mode);
+        goto fail;
+      }
+
+      if(mode == RINGBUFFER_SPSC || mode == RINGBUFFER_MPSC) {
+        if(element_size == 0 || count == 0) {
+          JS_ThrowRangeError(ctx, "element size and count must be non-zero");
+          goto fail;
+        }
+
+        if(count > RINGBUFFER_SHARED_MAX) {
+          JS_ThrowRangeError(ctx, "count %" PRIu32 " exceeds %" PRIu32, count, RINGBUFFER_SHARED_MAX);
+          goto fail;
+        }
+
+        if(!ringbuffer_shared_create(ctx, rb, element_size, count, mode))
+          goto fail;
+      } else {
+        ringbuffer_init(rb, element_size, count, 0, 0);
+      }
 
       argc -= 2;
       argv += 2;
+    } else if(JS_IsObject(argv[0])) {
+      if(!ringbuffer_attach(rb, argv[0], ctx)) {
+        JS_ThrowTypeError(ctx, "argument 1 must be the buffer of a shared Ringbuffer");
+        goto fail;
+      }
+
+      argc -= 1;
+      argv += 1;
     } else {
       break;
     }
@@ -78,7 +173,7 @@ minnet_ringbuffer_constructor(JSContext* ctx, JSValueConst new_target, int argc,
   return obj;
 
 fail:
-  js_free(ctx, rb);
+  ringbuffer_free(rb, JS_GetRuntime(ctx));
   JS_FreeValue(ctx, obj);
   return JS_EXCEPTION;
 }
@@ -144,6 +239,9 @@ minnet_ringbuffer_multitail(JSContext* ctx, JSValueConst this_val, int argc, JSV
   if(!(rb = JS_GetOpaque2(ctx, this_val, minnet_ringbuffer_class_id)))
     return JS_EXCEPTION;
 
+  if(ringbuffer_is_shared(rb))
+    return JS_ThrowTypeError(ctx, "tails are not supported on a shared Ringbuffer");
+
   index += js_buffer_fromargs(ctx, argc, argv, &tail_buf);
 
   if(tail_buf.data) {
@@ -226,6 +324,134 @@ fail:
   return ret;
 }
 
+/* Moves up to max elements out of the ring in one call. On a lws_ring backed
+ * buffer the result are one or two (if the run wraps around) Uint8Array views
+ * into the ring storage, valid until the next insert. A shared ring may be
+ * refilled by another thread as soon as the tail moves, so the run is copied
+ * into a single fresh buffer instead. */
+static JSValue
+minnet_ringbuffer_consumemany(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  MinnetRingbuffer* rb;
+  JSValue ret, ab;
+  JSBuffer tail_buf = JS_BUFFER_DEFAULT();
+  uint32_t max = UINT32_MAX, n, tail, *tail_ptr = 0;
+  size_t elem_len, first;
+  int index = 0;
+
+  if(!(rb = JS_GetOpaque2(ctx, this_val, minnet_ringbuffer_class_id)))
+    return JS_EXCEPTION;
+
+  elem_len = ringbuffer_element_len(rb);
+
+  /* (tail, max) in every mode, a shared ring has no tails */
+  if(argc > 0 && !js_is_nullish(argv[0])) {
+    if(ringbuffer_is_shared(rb))
+      return JS_ThrowTypeError(ctx, "tails are not supported on a shared Ringbuffer");
+
+    tail_buf = js_input_buffer(ctx, argv[0]);
+
+    if(tail_buf.size < sizeof(uint32_t)) {
+      js_buffer_free(&tail_buf, JS_GetRuntime(ctx));
+      return JS_ThrowRangeError(ctx, "invalid tail");
+    }
+
+    tail_ptr = (uint32_t*)tail_buf.data;
+  }
+
+  ++index;
+
+  if(argc > index && !js_is_nullish(argv[index]) && JS_ToUint32(ctx, &max, argv[index])) {
+    js_buffer_free(&tail_buf, JS_GetRuntime(ctx));
+    return JS_ThrowRangeError(ctx, "expecting element count");
+  }
+
+  ret = JS_NewArray(ctx);
+
+  if(ringbuffer_is_shared(rb)) {
+    ByteBlock blk = BLOCK_0();
+
+    if((n = MIN(max, ringbuffer_waiting(rb))) == 0)
+      return ret;
+
+    if(!block_alloc(&blk, n * elem_len)) {
+      JS_FreeValue(ctx, ret);
+      return JS_ThrowOutOfMemory(ctx);
+    }
+
+    n = ringbuffer_consume(rb, block_BEGIN(&blk), n);
+    blk.end = blk.start + n * elem_len;
+
+    ab = block_toarraybuffer(&blk, ctx);
+    JS_SetPropertyUint32(ctx, ret, 0, js_typedarray_new(ctx, 8, FALSE, FALSE, ab, 0, n * elem_len));
+    JS_FreeValue(ctx, ab);
+    return ret;
+  }
+
+  ringbuffer_lock(rb);
+
+  tail = tail_ptr ? *tail_ptr : lws_ring_get_oldest_tail(rb->ring);
+
+  if((n = MIN(max, lws_ring_get_count_waiting_elements(rb->ring, tail_ptr))) > 0) {
+    size_t buflen = ringbuffer_bytelength(rb);
+
+    ab = JS_GetPropertyStr(ctx, this_val, "buffer");
+    first = MIN(n * elem_len, buflen - tail);
+
+    JS_SetPropertyUint32(ctx, ret, 0, js_typedarray_new(ctx, 8, FALSE, FALSE, ab, tail, first));
+
+    if(n * elem_len > first)
+      JS_SetPropertyUint32(ctx, ret, 1, js_typedarray_new(ctx, 8, FALSE, FALSE, ab, 0, n * elem_len - first));
+
+    JS_FreeValue(ctx, ab);
+
+    lws_ring_consume(rb->ring, tail_ptr, 0, n);
+  }
+
+  ringbuffer_unlock(rb);
+
+  js_buffer_free(&tail_buf, JS_GetRuntime(ctx));
+  return ret;
+}
+
+/* Inserts runs of elements from any number of ArrayBuffers/TypedArrays,
+ * stopping when the ring is full. Returns the number of elements inserted. */
+static JSValue
+minnet_ringbuffer_insertmany(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  MinnetRingbuffer* rb;
+  size_t elem_len, total = 0;
+  int i;
+
+  if(!(rb = JS_GetOpaque2(ctx, this_val, minnet_ringbuffer_class_id)))
+    return JS_EXCEPTION;
+
+  elem_len = ringbuffer_element_len(rb);
+
+  for(i = 0; i < argc; i++) {
+    JSBuffer buf;
+    size_t size, count, inserted;
+    uint8_t* data;
+
+    if(!(data = ringbuffer_argbuf(ctx, argv[i], &buf, &size)))
+      return JS_EXCEPTION;
+
+    if((size % elem_len) != 0) {
+      js_buffer_free(&buf, JS_GetRuntime(ctx));
+      return JS_ThrowRangeError(ctx, "argument %d size not a multiple of element length (%lu)", i + 1, (unsigned long int)elem_len);
+    }
+
+    count = size / elem_len;
+    inserted = ringbuffer_insert(rb, data, count);
+    total += inserted;
+
+    js_buffer_free(&buf, JS_GetRuntime(ctx));
+
+    if(inserted < count)
+      break;
+  }
+
+  return JS_NewInt64(ctx, total);
+}
+
 static void
 tail_decorate(JSContext* ctx, JSValueConst obj, JSValueConst ringbuffer, const char* name, int argc, int magic) {
   JSValue func = JS_NewCFunctionMagic(ctx, minnet_ringbuffer_multitail, name, 0, JS_CFUNC_generic_magic, magic);
@@ -241,6 +467,10 @@ minnet_ringbuffer_method(JSContext* ctx, JSValueConst this_val, int argc, JSValu
     return JS_EXCEPTION;
 
   JSValue ret = JS_UNDEFINED;
+
+  if(ringbuffer_is_shared(rb) && (magic == RINGBUFFER_CREATE_TAIL || magic == RINGBUFFER_BUMP_HEAD))
+    return JS_ThrowTypeError(ctx, "tails are not supported on a shared Ringbuffer");
+
   switch(magic) {
 
     case RINGBUFFER_CREATE_TAIL: {
@@ -278,6 +508,42 @@ minnet_ringbuffer_method(JSContext* ctx, JSValueConst this_val, int argc, JSValu
       lws_ring_bump_head(rb->ring, n);
       break;
     }
+
+    case RINGBUFFER_TAKE: {
+      size_t elem_len = ringbuffer_element_len(rb);
+
+      if(argc > 0 && JS_IsObject(argv[0])) {
+        JSBuffer buf;
+        size_t size;
+        uint8_t* data;
+
+        if(!(data = ringbuffer_argbuf(ctx, argv[0], &buf, &size)))
+          return JS_EXCEPTION;
+
+        if((size % elem_len) != 0)
+          ret = JS_ThrowRangeError(ctx, "buffer size not a multiple of element length (%lu)", (unsigned long int)elem_len);
+        else
+          ret = JS_NewUint32(ctx, ringbuffer_consume(rb, data, size / elem_len));
+
+        js_buffer_free(&buf, JS_GetRuntime(ctx));
+      } else {
+        uint32_t count = ringbuffer_waiting(rb);
+        uint8_t* data;
+
+        if(argc > 0 && JS_ToUint32(ctx, &count, argv[0]))
+          return JS_ThrowRangeError(ctx, "expecting element count");
+
+        count = MIN(count, ringbuffer_waiting(rb));
+
+        if(!(data = js_malloc(ctx, count * elem_len + 1)))
+          return JS_EXCEPTION;
+
+        count = ringbuffer_consume(rb, data, count);
+        ret = JS_NewArrayBufferCopy(ctx, data, count * elem_len);
+        js_free(ctx, data);
+      }
+      break;
+    }
   }
   return ret;
 }
@@ -323,6 +589,11 @@ minnet_ringbuffer_get(JSContext* ctx, JSValueConst this_val, int magic) {
     }
 
     case RINGBUFFER_BUFFER: {
+      if(ringbuffer_is_shared(rb)) {
+        ret = JS_DupValue(ctx, rb->shared_buf);
+        break;
+      }
+
       struct {
         void* buf;
         void (*destroy)(void*);
@@ -334,6 +605,11 @@ minnet_ringbuffer_get(JSContext* ctx, JSValueConst this_val, int magic) {
     }
 
     case RINGBUFFER_HEAD: {
+      if(ringbuffer_is_shared(rb)) {
+        ret = JS_NewUint32(ctx, __atomic_load_n(&rb->shared->head, __ATOMIC_ACQUIRE));
+        break;
+      }
+
       struct {
         void* buf;
         void (*destroy_element)(void* element);
@@ -345,11 +621,19 @@ minnet_ringbuffer_get(JSContext* ctx, JSValueConst this_val, int magic) {
     }
 
     case RINGBUFFER_OLDEST_TAIL: {
-      ret = JS_NewUint32(ctx, lws_ring_get_oldest_tail(rb->ring));
+      ret = ringbuffer_is_shared(rb) ? JS_NewUint32(ctx, __atomic_load_n(&rb->shared->tail, __ATOMIC_ACQUIRE)) : JS_NewUint32(ctx, lws_ring_get_oldest_tail(rb->ring));
+      break;
+    }
+
+    case RINGBUFFER_MODE: {
+      ret = JS_NewUint32(ctx, ringbuffer_is_shared(rb) ? rb->shared->mode : RINGBUFFER_LOCKED);
       break;
     }
 
     case RINGBUFFER_INSERTRANGE: {
+      if(ringbuffer_is_shared(rb))
+        return JS_ThrowTypeError(ctx, "not supported on a shared Ringbuffer");
+
       struct {
         void* buf;
         void (*destroy_element)(void*);
@@ -379,6 +663,9 @@ minnet_ringbuffer_set(JSContext* ctx, JSValueConst this_val, JSValueConst value,
   if(!(rb = JS_GetOpaque2(ctx, this_val, minnet_ringbuffer_class_id)))
     return JS_EXCEPTION;
 
+  if(ringbuffer_is_shared(rb))
+    return JS_ThrowTypeError(ctx, "cannot move head/tail of a shared Ringbuffer");
+
   r = (void*)rb->ring;
 
   JSValue ret = JS_UNDEFINED;
@@ -435,6 +722,9 @@ static const JSCFunctionListEntry minnet_ringbuffer_proto_funcs[] = {
     JS_CFUNC_MAGIC_DEF("createTail", 0, minnet_ringbuffer_method, RINGBUFFER_CREATE_TAIL),
     JS_CFUNC_MAGIC_DEF("insert", 1, minnet_ringbuffer_method, RINGBUFFER_INSERT),
     JS_CFUNC_MAGIC_DEF("bumpHead", 1, minnet_ringbuffer_method, RINGBUFFER_BUMP_HEAD),
+    JS_CFUNC_MAGIC_DEF("take", 1, minnet_ringbuffer_method, RINGBUFFER_TAKE),
+    JS_CFUNC_DEF("consumeMany", 2, minnet_ringbuffer_consumemany),
+    JS_CFUNC_DEF("insertMany", 1, minnet_ringbuffer_insertmany),
     JS_CGETSET_MAGIC_FLAGS_DEF("type", minnet_ringbuffer_get, 0, RINGBUFFER_TYPE, JS_PROP_ENUMERABLE),
     JS_CGETSET_MAGIC_FLAGS_DEF("length", minnet_ringbuffer_get, 0, RINGBUFFER_COUNT, JS_PROP_ENUMERABLE),
     JS_CGETSET_MAGIC_FLAGS_DEF("byteLength", minnet_ringbuffer_get, 0, RINGBUFFER_BYTELEN, JS_PROP_ENUMERABLE),
@@ -445,9 +735,16 @@ static const JSCFunctionListEntry minnet_ringbuffer_proto_funcs[] = {
     JS_CGETSET_MAGIC_FLAGS_DEF("head", minnet_ringbuffer_get, minnet_ringbuffer_set, RINGBUFFER_HEAD, JS_PROP_ENUMERABLE),
     JS_CGETSET_MAGIC_FLAGS_DEF("oldestTail", minnet_ringbuffer_get, minnet_ringbuffer_set, RINGBUFFER_OLDEST_TAIL, JS_PROP_ENUMERABLE),
     JS_CGETSET_MAGIC_FLAGS_DEF("linearInsertRange", minnet_ringbuffer_get, 0, RINGBUFFER_INSERTRANGE, 0),
+    JS_CGETSET_MAGIC_FLAGS_DEF("mode", minnet_ringbuffer_get, 0, RINGBUFFER_MODE, JS_PROP_ENUMERABLE),
     JS_PROP_STRING_DEF("[Symbol.toStringTag]", "MinnetRingbuffer", JS_PROP_CONFIGURABLE),
 };
 
+static const JSCFunctionListEntry minnet_ringbuffer_static_funcs[] = {
+    JS_PROP_INT32_DEF("LOCKED", RINGBUFFER_LOCKED, 0),
+    JS_PROP_INT32_DEF("SPSC", RINGBUFFER_SPSC, 0),
+    JS_PROP_INT32_DEF("MPSC", RINGBUFFER_MPSC, 0),
+};
+
 int
 minnet_ringbuffer_init(JSContext* ctx, JSModuleDef* m) {
   // Add class Ringbuffer
@@ -460,6 +757,7 @@ minnet_ringbuffer_init(JSContext* ctx, JSModuleDef* m) {
 
   minnet_ringbuffer_ctor = JS_NewCFunction2(ctx, minnet_ringbuffer_constructor, "MinnetRingbuffer", 0, JS_CFUNC_constructor, 0);
   JS_SetConstructor(ctx, minnet_ringbuffer_ctor, minnet_ringbuffer_proto);
+  JS_SetPropertyFunctionList(ctx, minnet_ringbuffer_ctor, minnet_ringbuffer_static_funcs, countof(minnet_ringbuffer_static_funcs));
 
   if(m)
     JS_SetModuleExport(ctx, m, "Ringbuffer", minnet_ringbuffer_ctor);
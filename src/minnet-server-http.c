@@ -2,11 +2,13 @@
 #include "minnet-server-http.h"
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
 #include <cutils.h>
 #include <inttypes.h>
 #include <libwebsockets.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include "context.h"
@@ -23,9 +25,14 @@
 #include <quickjs.h>
 #include "utils.h"
 #include "buffer.h"
+#include "compress.h"
 
 static int serve_generator(JSContext* ctx, struct session_data* session, struct lws* wsi, BOOL* done_p);
 
+/* Default budget for values pulled from a sync generator per writable callback */
+#define GENERATOR_BUDGET_BYTES 65536
+#define GENERATOR_BUDGET_MS 10
+
 int lws_hdr_simple_create(struct lws*, enum lws_token_indexes, const char*);
 
 MinnetVhostOptions*
@@ -185,7 +192,10 @@ mount_new(JSContext* ctx, const char* mnt, const char* org, const char* def, con
     m->pro = pro ? pro : js_strdup(ctx, /*origin_proto == LWSMPRO_CALLBACK ? "http" :*/ "defprot");
 
     m->lws.origin_protocol = origin_proto;
-    m->lws.mountpoint_len = strlen(mnt);
+    /* lws matches the static part, the route tree the ':param' and '*' segments */
+    m->lws.mountpoint_len = router_prefix(mnt, strlen(mnt));
+    m->method = -1;
+    m->stream_body = -1;
   }
 
   return m;
@@ -196,6 +206,7 @@ mount_fromobj(JSContext* ctx, JSValueConst obj, const char* key) {
   MinnetHttpMount* ret;
   JSValue mnt = JS_UNDEFINED, org = JS_UNDEFINED, def = JS_UNDEFINED, pro = JS_UNDEFINED;
   const char* path;
+  int method = -1;
 
   if(JS_IsArray(ctx, obj)) {
     int i = 0;
@@ -215,14 +226,29 @@ mount_fromobj(JSContext* ctx, JSValueConst obj, const char* key) {
     mnt = JS_NewString(ctx, key);
 
   {
-    size_t namelen;
-    const char* namestr = JS_ToCStringLen(ctx, &namelen, mnt);
+    size_t namelen, methodlen;
+    const char *str = JS_ToCStringLen(ctx, &namelen, mnt), *namestr = str;
+
+    /* "METHOD /path" restricts the mount to one method */
+    if((methodlen = byte_chr(namestr, namelen, ' ')) < namelen) {
+      char m[methodlen + 1];
+
+      pstrcpy(m, methodlen + 1, namestr);
+
+      if((method = method_number(m)) != -1) {
+        namestr += methodlen + 1;
+        namelen -= methodlen + 1;
+      }
+    }
+
     char buf[namelen + 2];
     size_t i = namestr[0] == '/' ? 0 : 1;
 
     pstrcpy(&buf[i], namelen + 1, namestr);
     buf[0] = '/';
     buf[namelen + i] = '\0';
+    JS_FreeCString(ctx, str);
+    JS_FreeValue(ctx, mnt);
     mnt = JS_NewString(ctx, buf);
   }
 
@@ -247,83 +273,36 @@ mount_fromobj(JSContext* ctx, JSValueConst obj, const char* key) {
     JS_FreeCString(ctx, origin);
   }
 
-  JS_FreeCString(ctx, path);
-
-  JS_FreeValue(ctx, mnt);
-  JS_FreeValue(ctx, org);
-  JS_FreeValue(ctx, def);
-
-  return ret;
-}
-
-MinnetHttpMount*
-mount_find(MinnetHttpMount* mounts, const char* x, size_t n) {
-  struct lws_http_mount *p, *m = 0;
-  int protocol = n == 0 ? LWSMPRO_CALLBACK : LWSMPRO_HTTP;
-  size_t l = 0;
+  if(ret) {
+    ret->method = method;
 
-  // DBG("'%.*s'", (int)n, x);
+    /* limits for this mount only, set as properties of the handler */
+    if(JS_IsObject(obj)) {
+      JSValue max_body = JS_GetPropertyStr(ctx, obj, "maxBodySize");
+      JSValue threshold = JS_GetPropertyStr(ctx, obj, "memoryThreshold");
+      JSValue stream_body = JS_GetPropertyStr(ctx, obj, "streamBody");
 
-  if(n == 0)
-    n = strlen(x);
+      if(JS_IsNumber(max_body))
+        JS_ToIndex(ctx, &ret->max_body_size, max_body);
+      if(JS_IsNumber(threshold))
+        JS_ToIndex(ctx, &ret->memory_threshold, threshold);
 
-  if(protocol == LWSMPRO_CALLBACK && x[0] == '/') {
-    x++;
-    n--;
-  }
-
-  for(p = (struct lws_http_mount*)mounts; p; p = (struct lws_http_mount*)p->mount_next) {
-    if(protocol != LWSMPRO_CALLBACK || p->origin_protocol == LWSMPRO_CALLBACK) {
-      const char* mnt = p->mountpoint;
-      size_t len = p->mountpoint_len;
-      if(protocol == LWSMPRO_CALLBACK && mnt[0] == '/') {
-        mnt++;
-        len--;
-      }
-      DBG("x='%.*s' '%.*s'", (int)n, x, (int)len, mnt);
+      if(JS_IsBool(stream_body))
+        ret->stream_body = JS_ToBool(ctx, stream_body);
 
-      if((len == n || (n > len && (x[len] == '/' || x[len] == '?'))) && !strncmp(x, mnt, n)) {
-        m = p;
-        /*   break;*/
-      }
-      if(n >= len && len >= l && !strncmp(mnt, x, MIN(len, n))) {
-        m = p;
-      }
+      JS_FreeValue(ctx, max_body);
+      JS_FreeValue(ctx, threshold);
+      JS_FreeValue(ctx, stream_body);
     }
   }
 
-  DBG("'%.*s' = %s", (int)n, x, m ? m->mountpoint : "0");
-  /* if(m) {
-     DBG("org=%s mnt=%s cb.ctx=%p", ((MinnetHttpMount*)m)->org, ((MinnetHttpMount*)m)->mnt, ((MinnetHttpMount*)m)->callback.ctx);
-   }*/
-  return (MinnetHttpMount*)m;
-}
-
-MinnetHttpMount*
-mount_find_s(MinnetHttpMount* mounts, const char* x) {
-  struct lws_http_mount *p, *m = 0;
-  size_t n = strlen(x);
-
-  for(p = (struct lws_http_mount*)mounts; p; p = (struct lws_http_mount*)p->mount_next) {
-    const char* mnt = p->mountpoint;
-    size_t len = p->mountpoint_len;
-
-    DBG("x='%.*s' '%.*s'", (int)n, x, (int)len, mnt);
-
-    if(len == n && !strncmp(x, mnt, n)) {
-      m = p;
-      break;
-    }
+  JS_FreeCString(ctx, path);
 
-    if(len == 1 && mnt[0] == '/')
-      m = p;
+  JS_FreeValue(ctx, mnt);
+  JS_FreeValue(ctx, org);
+  JS_FreeValue(ctx, def);
 
-    if((n > len && (x[len] == '/' || x[len] == '?')) && (len == 0 || !strncmp(x, mnt, len))) {
-      m = p;
-      break;
-    }
-  }
-  return (MinnetHttpMount*)m;
+  return ret;
 }
 
 void
@@ -351,7 +330,6 @@ typedef struct {
   int ref_count;
   JSContext* ctx;
   struct session_data* session;
-  MinnetResponse* resp;
   struct lws* wsi;
 } HTTPAsyncResolveClosure;
 
@@ -366,35 +344,41 @@ serve_resolved_free(void* ptr) {
         closure->session->wait_resolve_ptr = 0;
     }
 
-    if(closure->resp)
-      response_free(closure->resp, JS_GetRuntime(closure->ctx));
-
     js_free(closure->ctx, ptr);
   }
 }
 
-static JSValue
-serve_rejected(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* ptr) {
-  HTTPAsyncResolveClosure* closure = ptr;
-  struct session_data* session = closure->session;
-
-  assert(session);
+/* Bytes a generator may produce per writable callback, also the size of a chunk */
+static size_t
+serve_budget(MinnetServer* server) {
+  return server && server->generator_bytes ? server->generator_bytes : GENERATOR_BUDGET_BYTES;
+}
 
-  char* error = js_error_string(ctx, argv[0]);
+/* Values produced between two writable callbacks go out as one chunk */
+static void
+serve_write(MinnetServer* server, struct session_data* session, const void* data, size_t size, JSContext* ctx) {
+  QueueItem* item;
 
-  assert(session->wait_resolve > 0);
-  --session->wait_resolve;
+  if(queue_size(&session->sendq) && (item = queue_last_chunk(&session->sendq)) && !item->done && block_SIZE(&item->block) < serve_budget(server))
+    if(block_extend(&item->block, &item->capacity, data, size) != -1)
+      return;
 
-  DBG("wait_resolve=%i error=%s", session->wait_resolve, error);
+  queue_write(&session->sendq, data, size, ctx);
+}
 
+static void
+serve_error(JSContext* ctx, struct session_data* session, struct lws* wsi, JSValueConst error) {
+  char* str = js_error_string(ctx, error);
   MinnetServer* server;
 
-  if((server = lws_context_user(lws_get_context(closure->wsi))))
-    server_exception(server, JS_Throw(ctx, argv[0]));
+  DBG("wait_resolve=%i error=%s", session->wait_resolve, str);
+
+  if((server = lws_context_user(lws_get_context(wsi))))
+    server_exception(server, JS_Throw(ctx, JS_DupValue(ctx, error)));
 
-  queue_write(&session->sendq, error, strlen(error), ctx);
+  queue_write(&session->sendq, str, strlen(str), ctx);
 
-  js_free(ctx, error);
+  js_free(ctx, str);
   /*if(js_has_propertystr(ctx, argv[0], "stack")) {
     const char* stack = js_get_propertystr_cstring(ctx, argv[0], "stack");
 
@@ -416,55 +400,83 @@ serve_rejected(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst arg
     opaque->resp = minnet_response_data(session->resp_obj);
   }
 
-  session_want_write(session, closure->wsi);
-
-  return JS_UNDEFINED;
+  session_want_write(session, wsi);
 }
 
-static JSValue
-serve_resolved(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* ptr) {
-  HTTPAsyncResolveClosure* closure = ptr;
-  struct session_data* session = closure->session;
+/**
+ * Serves what a handler promise resolved to: a Response, an iterator
+ * result of an async generator, or the body a plain async handler returned.
+ *
+ * @return TRUE when the response is complete
+ */
+static BOOL
+serve_value(JSContext* ctx, struct session_data* session, struct lws* wsi, JSValueConst result) {
+  MinnetServer* server = lws_context_user(lws_get_context(wsi));
   JSValue value = JS_UNDEFINED;
   BOOL done = FALSE;
 
-  assert(session);
-  assert(session->wait_resolve > 0);
-  --session->wait_resolve;
-
-  DBG("wait_resolve=%i argv[0]=%s", session->wait_resolve, JS_ToCString(ctx, argv[0]));
+  DBG("wait_resolve=%i result=%s", session->wait_resolve, JS_ToCString(ctx, result));
 
-  if(JS_IsObject(argv[0])) {
+  if(JS_IsObject(result)) {
     MinnetResponse* resp;
 
-    if((resp = minnet_response_data(argv[0]))) {
-      JSValue body = JS_GetPropertyStr(ctx, argv[0], "body");
+    if((resp = minnet_response_data(result))) {
       MinnetWebsocket* ws = minnet_ws_data2(ctx, session->ws_obj);
       struct wsi_opaque_user_data* opaque = ws_opaque(ws);
 
       JS_FreeValue(ctx, session->resp_obj);
-      session->resp_obj = JS_DupValue(ctx, argv[0]);
+      session->resp_obj = JS_DupValue(ctx, result);
       opaque->resp = minnet_response_data(session->resp_obj);
 
-      session->generator = body;
+      JS_FreeValue(ctx, session->generator);
+      JS_FreeValue(ctx, session->next);
+      session->generator = JS_GetProperty(ctx, result, server->atoms.body);
+      session->next = JS_UNDEFINED;
+      session->type = js_is_async_generator(ctx, session->generator) ? ASYNC_GENERATOR : GENERATOR;
+
+      /* complete only when the body is */
       serve_generator(ctx, session, ws->lwsi, &done);
-      return JS_UNDEFINED;
+      return done;
+    }
+  }
+
+  if(session->type == ASYNC) {
+    /* undefined leaves the body to the Response, as for a sync handler */
+    if(JS_IsUndefined(result)) {
+      JSValue body = JS_GetProperty(ctx, session->resp_obj, server->atoms.body);
+
+      session->type = session_generator(session, body, session->resp_obj);
+      JS_FreeValue(ctx, body);
+
+      if(session->type)
+        serve_generator(ctx, session, wsi, &done);
+      else
+        session_want_write(session, wsi);
+
+      return done;
+    }
 
-    } else if(js_has_propertystr(ctx, argv[0], "value") && js_has_propertystr(ctx, argv[0], "done")) {
-      value = JS_GetPropertyStr(ctx, argv[0], "value");
-      done = js_get_propertystr_bool(ctx, argv[0], "done");
+    value = JS_DupValue(ctx, result);
+    done = TRUE;
+  } else if(JS_IsObject(result)) {
+    if(JS_HasProperty(ctx, result, server->atoms.value) > 0) {
+      JSValue tmp = JS_GetProperty(ctx, result, server->atoms.done);
+
+      value = JS_GetProperty(ctx, result, server->atoms.value);
+      done = JS_ToBool(ctx, tmp);
+      JS_FreeValue(ctx, tmp);
     }
   }
 
   if(!JS_IsUndefined(value)) {
     JSBuffer out = js_buffer_new(ctx, value);
 
-    DBG("wait_resolve=%i value=%s done=%i out={ size: %zu, data: '%.*s' }", session->wait_resolve, JS_ToCString(ctx, value), done, out.size, out.size > 50 ? 50 : (int)out.size, out.data);
+    DBG("wait_resolve=%i done=%i out={ size: %zu, data: '%.*s' }", session->wait_resolve, done, out.size, out.size > 50 ? 50 : (int)out.size, out.data);
 
     if(out.data) {
-      queue_write(&session->sendq, out.data, out.size, ctx);
+      serve_write(server, session, out.data, out.size, ctx);
 
-      session_want_write(session, closure->wsi);
+      session_want_write(session, wsi);
     }
 
     js_buffer_free(&out, JS_GetRuntime(ctx));
@@ -475,43 +487,101 @@ serve_resolved(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst arg
   if(done) {
     queue_close(&session->sendq);
 
-    session_want_write(session, closure->wsi);
+    session_want_write(session, wsi);
   }
 
+  return done;
+}
+
+static JSValue
+serve_rejected(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* ptr) {
+  HTTPAsyncResolveClosure* closure = ptr;
+  struct session_data* session;
+
+  /* the session went away while the promise was pending */
+  if(!(session = closure->session))
+    return JS_UNDEFINED;
+
+  assert(session->wait_resolve > 0);
+  --session->wait_resolve;
+
+  serve_error(ctx, session, closure->wsi, argv[0]);
   return JS_UNDEFINED;
 }
 
 static JSValue
-serve_promise(JSContext* ctx, struct session_data* session, JSValueConst value) {
-  HTTPAsyncResolveClosure* p;
-  JSValue ret = JS_UNDEFINED;
-  MinnetResponse* resp = minnet_response_data(session->resp_obj);
+serve_resolved(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* ptr) {
+  HTTPAsyncResolveClosure* closure = ptr;
+  struct session_data* session;
+  BOOL done = FALSE;
+
+  if(!(session = closure->session))
+    return JS_UNDEFINED;
+
+  assert(session->wait_resolve > 0);
+  --session->wait_resolve;
+
+  if(!serve_value(ctx, session, closure->wsi, argv[0]) && (session->type == GENERATOR || session->type == ASYNC_GENERATOR)) {
+    /* more values may already be waiting in an async generator */
+    if(!session->want_write && !session->wait_resolve && !queue_complete(&session->sendq))
+      serve_generator(ctx, session, closure->wsi, &done);
+  }
+
+  return JS_UNDEFINED;
+}
+
+/**
+ * Waits for a handler promise.  The then() handlers are created once per
+ * transaction and dropped by http_server_detach(), and a promise that is
+ * already fulfilled is served right away.
+ *
+ * @param done_p  set when an already fulfilled promise completed the response
+ *
+ * @return FALSE on error
+ */
+static BOOL
+serve_promise(JSContext* ctx, struct session_data* session, JSValueConst promise, BOOL* done_p) {
   MinnetWebsocket* ws = minnet_ws_data(session->ws_obj);
+  JSValue ret;
 
-  ++session->wait_resolve;
+  DBG("promise=%s", JS_ToCString(ctx, promise));
 
-  DBG("promise=%s", JS_ToCString(ctx, value));
+#ifdef HAVE_JS_PROMISESTATE
+  if(JS_PromiseState(ctx, promise) == JS_PROMISE_FULFILLED) {
+    JSValue result = JS_PromiseResult(ctx, promise);
+    BOOL done = serve_value(ctx, session, ws->lwsi, result);
 
-  if((p = js_malloc(ctx, sizeof(HTTPAsyncResolveClosure)))) {
-    *p = (HTTPAsyncResolveClosure){2, ctx, session, resp ? response_dup(resp) : 0, ws->lwsi};
+    JS_FreeValue(ctx, result);
 
-    session->wait_resolve_ptr = &p->session;
+    if(done_p)
+      *done_p = done;
+
+    return TRUE;
+  }
+#endif
 
-    JSValue resolve = js_function_cclosure(ctx, serve_resolved, 1, 0, p, serve_resolved_free);
-    JSValue reject = js_function_cclosure(ctx, serve_rejected, 1, 0, p, serve_resolved_free);
-    JSValue catched = js_async_then2(ctx, value, resolve, reject);
+  if(!JS_IsFunction(ctx, session->resolved)) {
+    HTTPAsyncResolveClosure* p;
 
-    DBG("catched=%s", JS_ToCString(ctx, catched));
+    if(!(p = js_malloc(ctx, sizeof(HTTPAsyncResolveClosure))))
+      return FALSE;
 
-    JS_FreeValue(ctx, resolve);
-    JS_FreeValue(ctx, reject);
-    ret = catched;
+    *p = (HTTPAsyncResolveClosure){2, ctx, session, ws->lwsi};
 
-  } else {
-    ret = JS_EXCEPTION;
+    session->wait_resolve_ptr = &p->session;
+
+    JS_FreeValue(ctx, session->resolved);
+    JS_FreeValue(ctx, session->rejected);
+    session->resolved = js_function_cclosure(ctx, serve_resolved, 1, 0, p, serve_resolved_free);
+    session->rejected = js_function_cclosure(ctx, serve_rejected, 1, 0, p, serve_resolved_free);
   }
 
-  return ret;
+  ++session->wait_resolve;
+
+  ret = js_async_then2(ctx, promise, session->resolved, session->rejected);
+  JS_FreeValue(ctx, ret);
+
+  return TRUE;
 }
 
 static int
@@ -533,19 +603,21 @@ serve_generator(JSContext* ctx, struct session_data* session, struct lws* wsi, B
     return result;
 
   if(JS_IsObject(session->generator) && !queue_complete(&session->sendq)) {
-    session->next = JS_UNDEFINED;
+    MinnetServer* server = lws_context_user(lws_get_context(wsi));
+    size_t budget = serve_budget(server), start = queue_bytes(&session->sendq);
+    lws_usec_t deadline = lws_now_usecs() + (server && server->generator_time ? server->generator_time : GENERATOR_BUDGET_MS) * LWS_US_PER_MS;
 
+    /* a generator is pulled until the budget is spent, its values go out in one write */
     while(!*done_p && !session->wait_resolve) {
       JSValue ret = js_iterator_next(ctx, session->generator, &session->next, done_p, 0, 0);
 
       DBG("done=%s wait_resolve=%d ret=%s", *done_p ? "TRUE" : "FALSE", session->wait_resolve, JS_ToCString(ctx, ret));
 
       if(js_is_promise(ctx, ret)) {
-        JSValue promise = serve_promise(ctx, session, ret);
-        const char* prstr;
-        DBG("pr=%s", prstr = JS_ToCString(ctx, promise));
-        JS_FreeCString(ctx, prstr);
-        // JS_FreeValue(ctx, promise);
+        if(!serve_promise(ctx, session, ret, done_p)) {
+          *done_p = TRUE;
+          result = 1;
+        }
       } else if(JS_IsException(ret)) {
         JSValue exception = JS_GetException(ctx);
         js_error_print(ctx, exception);
@@ -557,7 +629,7 @@ serve_generator(JSContext* ctx, struct session_data* session, struct lws* wsi, B
         if(js_buffer_from(ctx, &out, ret)) {
           DBG("out={ .data = '%.*s', .size = %zu }", (int)(out.size > 255 ? 255 : out.size), out.size > 255 ? &out.data[out.size - 255] : out.data, out.size);
 
-          queue_write(&session->sendq, out.data, out.size, ctx);
+          serve_write(server, session, out.data, out.size, ctx);
         }
 
         js_buffer_free(&out, JS_GetRuntime(ctx));
@@ -565,7 +637,8 @@ serve_generator(JSContext* ctx, struct session_data* session, struct lws* wsi, B
 
       JS_FreeValue(ctx, ret);
 
-      break; /* XXX: generate multiple? */
+      if(queue_complete(&session->sendq) || queue_bytes(&session->sendq) - start >= budget || lws_now_usecs() >= deadline)
+        break;
     }
   } else {
     *done_p = TRUE;
@@ -584,7 +657,7 @@ serve_generator(JSContext* ctx, struct session_data* session, struct lws* wsi, B
 
 static int
 serve_callback(JSCallback* cb, struct session_data* session, struct lws* wsi) {
-  FunctionType type = session_callback(session, cb);
+  FunctionType type = session->type = session_callback(session, cb);
 
   DBG("type=%s generator=%s", ((const char*[]){"SYNC", "ASYNC", "GENERATOR", "ASYNC_GENERATOR"})[type], JS_ToCString(cb->ctx, session->generator));
 
@@ -605,7 +678,8 @@ serve_callback(JSCallback* cb, struct session_data* session, struct lws* wsi) {
     }
 
     case ASYNC: {
-      serve_promise(cb->ctx, session, session->generator);
+      if(!serve_promise(cb->ctx, session, session->generator, 0))
+        return 1;
       break;
     }
     default: {
@@ -616,23 +690,153 @@ serve_callback(JSCallback* cb, struct session_data* session, struct lws* wsi) {
   return 0;
 }
 
+/* Replaces a complete body with its encoded form, unless that is not smaller */
 static BOOL
-has_transfer_encoding(MinnetRequest* req, const char* enc) {
-  const char* accept;
-  size_t len, enclen = strlen(enc);
+compress_queue(Queue* q, CompressEncoding enc, int level, JSContext* ctx) {
+  ByteBlock body, out = {0, 0};
+  size_t size = queue_bytes(q);
+  uint8_t* x;
+  BOOL done = FALSE, ret = FALSE;
 
-  if((accept = headers_getlen(&req->headers, &len, "accept-encoding", "\r\n", ":"))) {
-    size_t toklen, pos;
+  if(!block_alloc(&body, size))
+    return FALSE;
 
-    for(pos = 0; pos < len; (pos += toklen, pos += scan_charsetnskip(&accept[pos], ", ", len - pos))) {
-      toklen = scan_noncharsetnskip(&accept[pos], ", ", len - pos);
+  for(x = body.start; !done;) {
+    ByteBlock blk = queue_next(q, &done, 0);
 
-      if(toklen == enclen && !strncmp(&accept[pos], enc, toklen))
-        return TRUE;
+    if(!done) {
+      memcpy(x, block_BEGIN(&blk), block_SIZE(&blk));
+      x += block_SIZE(&blk);
+      block_free(&blk);
     }
   }
 
-  return FALSE;
+  queue_clear(q, JS_GetRuntime(ctx));
+
+  if(compress_block(enc, level, body.start, size, &out) && block_SIZE(&out) < size) {
+    block_free(&body);
+    body = out;
+    ret = TRUE;
+  } else {
+    block_free(&out);
+  }
+
+  queue_put(q, body, ctx);
+  queue_close(q);
+  return ret;
+}
+
+/* Negotiates a Content-Encoding. A complete body is encoded here, otherwise
+ * the returned encoding is to be applied by lws while streaming */
+static CompressEncoding
+serve_compress(MinnetServer* server, MinnetRequest* req, MinnetResponse* resp, Queue* q, JSContext* ctx) {
+  CompressOptions* opts = &server->compression;
+  const char *accept, *type;
+  size_t len, typelen = 0;
+  BOOL complete = q && queue_complete(q);
+  CompressEncoding enc;
+
+  if(!opts->enabled || !req || req->method == METHOD_HEAD)
+    return COMPRESS_NONE;
+
+  if(resp->status < 200 || resp->status == 204 || resp->status == 206 || (resp->status >= 300 && resp->status <= 399))
+    return COMPRESS_NONE;
+
+  if(headers_findtoken(&resp->headers, WSI_TOKEN_HTTP_CONTENT_ENCODING) != -1)
+    return COMPRESS_NONE;
+
+  if(complete && queue_bytes(q) < opts->min_size)
+    return COMPRESS_NONE;
+
+  type = headers_getlen(&resp->headers, &typelen, "content-type", "\r\n", ":");
+
+  if(!compress_type(opts, type, typelen))
+    return COMPRESS_NONE;
+
+  if(headers_findb(&resp->headers, "vary", 4, "\r\n") == -1)
+    headers_set(&resp->headers, "Vary", "Accept-Encoding", "\r\n");
+  else
+    headers_appendb(&resp->headers, "vary", 4, "Accept-Encoding", 15, "\r\n");
+
+  if(!(accept = headers_getlen(&req->headers, &len, "accept-encoding", "\r\n", ":")))
+    return COMPRESS_NONE;
+
+  if((enc = compress_negotiate(accept, len, !complete)) == COMPRESS_NONE)
+    return COMPRESS_NONE;
+
+  if(complete) {
+    if(compress_queue(q, enc, opts->level, ctx))
+      headers_set(&resp->headers, "Content-Encoding", compress_names[enc], "\r\n");
+
+    return COMPRESS_NONE;
+  }
+
+  return enc;
+}
+
+/* lws drops its header table with the transaction. The session lets go of
+ * the request object first, request headers which have not been looked up are
+ * then copied only if something besides the wsi still holds the request */
+static void
+http_server_detach(struct session_data* session, struct lws* wsi) {
+  struct wsi_opaque_user_data* opaque;
+  MinnetRequest* req;
+
+  if((opaque = lws_get_opaque_user_data(wsi)) && (req = opaque->req) && req->headers.wsi) {
+    JS_FreeValue(session->context->js, session->req_obj);
+    session->req_obj = JS_UNDEFINED;
+
+    headers_detach(&req->headers, req->ref_count > 1);
+  }
+
+  /* the next transaction on this connection creates its own */
+  if(session->context)
+    session_unresolve(session, JS_GetRuntime(session->context->js));
+}
+
+static uint64_t
+http_max_body(MinnetServer* server, MinnetHttpMount* mount) {
+  return mount && mount->max_body_size ? mount->max_body_size : server->max_body_size;
+}
+
+static uint64_t
+http_memory_threshold(MinnetServer* server, MinnetHttpMount* mount) {
+  return mount && mount->memory_threshold ? mount->memory_threshold : server->memory_threshold;
+}
+
+static BOOL
+http_stream_body(MinnetServer* server, MinnetHttpMount* mount) {
+  return mount && mount->stream_body != -1 ? mount->stream_body : server->stream_body;
+}
+
+#define HTTP_BODY_HIGH_WATER 65536
+
+/* A streamed body is received only as fast as the handler iterates it */
+static void
+http_body_drain(Generator* gen, void* opaque) {
+  if(!gen->q || queue_bytes(gen->q) < HTTP_BODY_HIGH_WATER / 2)
+    lws_rx_flow_control(opaque, 1);
+}
+
+static int
+serve_headers(struct lws* wsi, ByteBuffer* buf, MinnetResponse* resp) {
+  Headers* h = &resp->headers;
+  uint32_t i;
+
+  headers_index(h);
+
+  for(i = 0; i < h->count; i++) {
+    HeaderEntry* e = &h->entries[i];
+
+    /* sent by lws_http_redirect() */
+    if(headers_entry_token(h, e) == WSI_TOKEN_HTTP_LOCATION)
+      continue;
+
+    if(headers_emit(h, e, wsi, &buf->write, buf->end))
+      return 1;
+  }
+
+  return 0;
 }
 
 static int
@@ -640,12 +844,15 @@ serve_response(struct lws* wsi, ByteBuffer* buf, MinnetResponse* resp, JSContext
   struct wsi_opaque_user_data* opaque = lws_opaque(wsi, ctx);
   lws_filepos_t content_len = LWS_ILLEGAL_HTTP_CONTENT_LEN;
   Queue* q = session_queue(session);
+  CompressEncoding enc;
 
   if(session->response_sent)
     return 0;
 
   DBG("status=%d generator=%d", resp->status, resp->body != NULL);
 
+  enc = serve_compress(lws_context_user(lws_get_context(wsi)), opaque->req, resp, q, ctx);
+
   if(q && queue_complete(q))
     content_len = queue_bytes(q);
 
@@ -665,31 +872,11 @@ serve_response(struct lws* wsi, ByteBuffer* buf, MinnetResponse* resp, JSContext
       return 1;
   }
 
-  // headers_write(&resp->headers, wsi, &buf->write, buf->end);
-
-  for(const uint8_t *x = resp->headers.start, *end = resp->headers.write; x < end; x += headers_next(x, end, "\r\n")) {
-    size_t len, n;
-    len = headers_length(x, end, "\r\n");
-    n = headers_namelen(x, end);
-
-    if(n == 8 && !strncasecmp((const char*)x, "location", n))
-      continue;
-
-    if(len > n) {
-      char* prop = headers_name(x, end, ctx);
-      n = headers_value(x, end, ":");
-
-      DBG("header=%s = value='%.*s'", prop, (int)(len - n), &x[n]);
-      if((lws_add_http_header_by_name(wsi, (const unsigned char*)prop, (const unsigned char*)&x[n], len - n, &buf->write, buf->end)))
-        JS_ThrowInternalError(ctx, "Adding header '%s' failed", prop);
-      js_free(ctx, (void*)prop);
-    }
-  }
+  if(serve_headers(wsi, buf, resp))
+    return 1;
 
-  if(has_transfer_encoding(opaque->req, "deflate")) {
-    if(!(byte_finds(buf->start, block_SIZE(buf), wsi_http2(wsi) ? "\020content-encoding" : "content-encoding") < block_SIZE(buf)))
-      lws_http_compression_apply(wsi, "deflate", &buf->write, buf->end, 0);
-  }
+  if(enc != COMPRESS_NONE)
+    lws_http_compression_apply(wsi, compress_names[enc], &buf->write, buf->end, 0);
 
   int ret = lws_finalize_write_http_header(wsi, buf->start, &buf->write, buf->end);
 
@@ -721,7 +908,6 @@ serve_file(JSContext* ctx, struct session_data* session, struct lws* wsi, const
   MinnetResponse* resp = opaque_fromwsi(wsi)->resp;
   FILE* fp;
   const char* mime = lws_get_mimetype(path, &mount->lws);
-  // BOOL compressed = has_transfer_encoding(req, "gzip");
 
   DBG("path=%s mount=%s mime=%s", path, mount->mnt, mime);
 
@@ -807,6 +993,7 @@ http_server_writeable(struct session_data* session, struct lws* wsi, BOOL done)
   DBG("done=%i remain=%zu closed=%d", done, remain, queue_closed(q));
 
   if(done || queue_closed(q)) {
+    http_server_detach(session, wsi);
     lws_http_transaction_completed(wsi);
     return 1;
   }
@@ -874,7 +1061,7 @@ http_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
 
     case LWS_CALLBACK_FILTER_HTTP_CONNECTION: {
 
-      if((session->mount = mount_find((MinnetHttpMount*)server->context.info.mounts, in, len)))
+      if((session->mount = server_route(server, in, len, wsi_method(wsi), 0)))
         if(mount_is_proxy(session->mount))
           lws_hdr_simple_create(wsi, wsi_http2(wsi) ? WSI_TOKEN_HTTP_COLON_AUTHORITY : WSI_TOKEN_HOST, "");
 
@@ -907,6 +1094,10 @@ http_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
     }
 
     case LWS_CALLBACK_HTTP_BIND_PROTOCOL: {
+      /* handlers of an earlier binding would be overwritten */
+      if(session->context)
+        session_unresolve(session, JS_GetRuntime(session->context->js));
+
       session_init(session, wsi_context(wsi));
 
       opaque->status = OPEN;
@@ -926,16 +1117,29 @@ http_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
       session->in_body = TRUE;
 
       if(len) {
-        if(opaque->form_parser) {
-          formparser_process(opaque->form_parser, in, len);
-        } else {
-          if(!req->body)
-            req->body = generator_new(ctx);
+        uint64_t max = http_max_body(server, session->mount);
+        uint64_t received = opaque->form_parser ? opaque->form_parser->read : req->body ? req->body->bytes_written : 0;
 
-          if(!req->body->q || !req->body->q->continuous)
-            generator_continuous(req->body, JS_NULL);
+        if(max && received + len > max) {
+          lws_return_http_status(wsi, HTTP_STATUS_REQ_ENTITY_TOO_LARGE, 0);
+          return -1;
+        }
 
+        if(opaque->form_parser) {
+          if(formparser_process(opaque->form_parser, in, len) < 0 && opaque->form_parser->sink.error == EFBIG) {
+            lws_return_http_status(wsi, HTTP_STATUS_REQ_ENTITY_TOO_LARGE, 0);
+            return -1;
+          }
+        } else if(req->body && req->body->drain_fn) {
           generator_write(req->body, in, len, JS_UNDEFINED);
+
+          /* arrayBuffer()/text() accumulate instead and are never throttled */
+          if(req->body->q && !req->body->q->continuous && queue_bytes(req->body->q) >= HTTP_BODY_HIGH_WATER)
+            lws_rx_flow_control(wsi, 0);
+
+        } else if(request_write(req, in, len, http_memory_threshold(server, session->mount), ctx) == -1) {
+          lws_return_http_status(wsi, HTTP_STATUS_INTERNAL_SERVER_ERROR, 0);
+          return -1;
         }
       }
 
@@ -955,6 +1159,7 @@ http_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
       JSCallback* cb;
       MinnetRequest* req = opaque->req;
       Generator* gen = req->body;
+      BOOL streaming = gen && gen->drain_fn;
 
       session->in_body = FALSE;
 
@@ -976,7 +1181,8 @@ http_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
         }
       }
 
-      cb = session->mount ? &session->mount->callback : 0;
+      /* a streaming handler is already running since LWS_CALLBACK_HTTP */
+      cb = session->mount && !streaming ? &session->mount->callback : 0;
 
       if(cb && cb->ctx)
         ret = serve_callback(cb, session, wsi);
@@ -993,7 +1199,29 @@ http_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
            JS_FreeValue(ctx, value);
          }*/
 
-        generator_stop(req->body, JS_UNDEFINED);
+        if(streaming) {
+          gen->drain_fn = 0;
+          gen->drain_opaque = 0;
+        }
+
+        /* a spooled body goes to a waiting reader from the file, mapped or in chunks */
+        if(req->spool.fd != -1 && JS_IsFunction(ctx, gen->callback)) {
+          JSValue fn = gen->callback, buf = server_exception(server, request_spool_buffer(req, ctx));
+
+          gen->callback = JS_NULL;
+
+          /* the file could not be mapped or read, the reader gets nothing */
+          if(!JS_IsException(buf))
+            JS_FreeValue(ctx, JS_Call(ctx, fn, JS_UNDEFINED, 1, &buf));
+
+          JS_FreeValue(ctx, buf);
+          JS_FreeValue(ctx, fn);
+          generator_stop(req->body, JS_UNDEFINED);
+        } else if(req->spool.fd != -1 && asynciterator_pending(&gen->iterator)) {
+          request_spool_stream(req);
+        } else {
+          generator_stop(req->body, JS_UNDEFINED);
+        }
       }
 
       if(server->on.post.ctx) {
@@ -1021,7 +1249,7 @@ http_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
       MinnetRequest* req = opaque->req ? opaque->req : (opaque->req = request_fromwsi(wsi, ctx));
       char* path = in;
       size_t mountpoint_len = 0, pathlen = 0;
-      MinnetHttpMount *mounts, *mount;
+      MinnetHttpMount* mount;
       JSCallback* cb;
 
       assert(req);
@@ -1034,30 +1262,42 @@ http_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
 
       LOGCB("HTTP(2)", "mountpoint='%.*s' path='%s'", (int)mountpoint_len, req->url.path, path);
 
-      if(!opaque->req->headers.write)
-        headers_tobuffer(ctx, &opaque->req->headers, wsi);
+      /* headers are copied from lws when the handler looks them up */
+      if(!opaque->req->headers.wsi)
+        headers_attach(&opaque->req->headers, wsi);
 
-      mounts = (MinnetHttpMount*)server->context.info.mounts;
+      /* one lookup in the route tree, also capturing ':param' and '*' segments */
+      session->mount = server_route(server, req->url.path, pathlen, req->method, &req->route);
 
-      if(!session->mount)
-        if(path)
-          session->mount = mount_find(mounts, path, 0);
-      if(!session->mount)
-        if(req->url.path)
-          session->mount = mount_find(mounts, req->url.path, mountpoint_len);
-      if(req->url.path && !session->mount)
-        if(!(session->mount = mount_find(mounts, req->url.path, mountpoint_len)))
-          session->mount = mount_find(mounts, req->url.path, 0);
+      /* the handler runs now and iterates req.body while it arrives */
+      if(http_stream_body(server, session->mount) &&
+         (req->method == METHOD_POST || req->method == METHOD_PUT || req->method == METHOD_PATCH || lws_hdr_total_length(wsi, WSI_TOKEN_HTTP_CONTENT_LENGTH) > 0)) {
+        if(!req->body)
+          req->body = generator_new(ctx);
+
+        req->body->drain_fn = http_body_drain;
+        req->body->drain_opaque = wsi;
+      }
+
+      /* refuse an announced body above the limit before any of it is read */
+      if(http_max_body(server, session->mount)) {
+        char length[32];
+
+        if(lws_hdr_copy(wsi, length, sizeof(length), WSI_TOKEN_HTTP_CONTENT_LENGTH) > 0 && strtoull(length, 0, 10) > http_max_body(server, session->mount)) {
+          lws_return_http_status(wsi, HTTP_STATUS_REQ_ENTITY_TOO_LARGE, 0);
+          return -1;
+        }
+      }
 
       if((mount = session->mount)) {
-        size_t mlen = strlen(mount->mnt);
+        /* a pattern like '/users/:id' can be longer than the path it matched */
+        size_t mlen = MIN(req->route.length, pathlen);
 
         DBG("mnt='%s'", mount->mnt);
-        DBG("mnt='%.*s'", (int)mlen, mount->mnt);
+        DBG("matched='%.*s'", (int)mlen, req->url.path);
 
         assert(req->url.path);
         assert(mount->mnt);
-        assert(mlen);
 
         if(!strcmp(req->url.path + mlen, path)) {
           assert(!strcmp(req->url.path + mlen, path));
@@ -1085,9 +1325,8 @@ http_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
           if(opaque->ws)
             session->ws_obj = minnet_ws_wrap(ctx, opaque->ws);
 
-        LOGCB("HTTP(3)", "req=%p, header=%zu mnt=%s org=%s", req, buffer_HEAD(&req->headers), mount->mnt, mount->org);
+        LOGCB("HTTP(3)", "req=%p, header=%zu mnt=%s org=%s", req, buffer_HEAD(&req->headers.buffer), mount->mnt, mount->org);
 
-        request_dup(req);
         cb = &mount->callback;
         if(mount && !mount->callback.ctx)
           cb = 0;
@@ -1102,9 +1341,7 @@ http_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
             response_redirect(opaque->resp, HTTP_STATUS_MOVED_PERMANENTLY, mount->def);
             session_want_write(session, wsi);
             lws_set_timeout(wsi, PENDING_TIMEOUT_USER_REASON_BASE, 30);
-          } else {
-            mount = mount_find_s(mounts, "/404.html");
-
+          } else if((mount = server_route(server, "/404.html", 9, req->method, 0))) {
             cb = &mount->callback;
           }
           /*  session_want_write(session, wsi);
@@ -1134,18 +1371,15 @@ http_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
         }
       }
 
-      if(callback_valid(&server->on.http)) {
-        cb = &server->on.http;
-
+      if(callback_valid(&server->on.http) || server->nmatchers) {
         if(!JS_IsObject(session->ws_obj) && opaque->ws)
           session->ws_obj = minnet_ws_wrap(ctx, opaque->ws);
 
-        // if(!JS_IsObject(session->req_obj) && opaque->req)
-        session->req_obj = minnet_request_wrap(ctx, opaque->req);
-
-        JSValue val = server_exception(server, callback_emit_this(cb, session->ws_obj, 2, &session->req_obj));
+        /* a mount already wrapped the request */
+        if(!JS_IsObject(session->req_obj) && opaque->req)
+          session->req_obj = minnet_request_wrap(ctx, opaque->req);
 
-        JS_FreeValue(ctx, val);
+        JS_FreeValue(ctx, server_dispatch(server, session, req));
       }
 
       return ret;
@@ -1206,8 +1440,10 @@ http_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
       if(q && http_server_writeable(session, wsi, !!queue_closed(q))) {
         ret = http_server_callback(wsi, LWS_CALLBACK_HTTP_FILE_COMPLETION, session, in, len);
 
-        if(queue_size(q) == 0)
+        if(queue_size(q) == 0) {
+          http_server_detach(session, wsi);
           ret = lws_http_transaction_completed(wsi);
+        }
       }
 
       if(qsize && !session->want_write) {
@@ -1239,9 +1475,12 @@ http_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* us
       break;
     }
 
-    case LWS_CALLBACK_HTTP_DROP_PROTOCOL: {
+    case LWS_CALLBACK_HTTP_DROP_PROTOCOL:
+    case LWS_CALLBACK_WSI_DESTROY: {
       // session_clear(session, ctx);
       // opaque_clear(opaque, ctx);
+      if(session && session->context)
+        session_unresolve(session, JS_GetRuntime(session->context->js));
       break;
     }
 
@@ -27,6 +27,10 @@ typedef struct http_mount {
     struct lws_http_mount lws;
   };
   JSCallback callback;
+  int method;             /* -1 for any method */
+  uint64_t max_body_size; /* 0 to use the server's limits */
+  uint64_t memory_threshold;
+  int stream_body; /* -1 to use the server's setting */
 } MinnetHttpMount;
 
 MinnetVhostOptions* vhost_options_create(JSContext*, const char*, const char*);
@@ -38,8 +42,6 @@ void vhost_options_free_list(JSContext*, MinnetVhostOptions*);
 void vhost_options_free(JSContext*, MinnetVhostOptions*);
 MinnetHttpMount* mount_new(JSContext*, const char*, const char*, const char* def, const char* pro);
 MinnetHttpMount* mount_fromobj(JSContext*, JSValue, const char*);
-struct http_mount* mount_find(MinnetHttpMount*, const char*, size_t);
-struct http_mount* mount_find_s(MinnetHttpMount*, const char*);
 void mount_fromvalue(JSContext* ctx, MinnetHttpMount** m, JSValueConst opt_mounts);
 void mount_free(JSContext*, MinnetHttpMount const*);
 BOOL mount_is_proxy(MinnetHttpMount const* m);
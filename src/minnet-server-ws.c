@@ -4,6 +4,7 @@
 #include "js-utils.h"
 #include "headers.h"
 #include "minnet-response.h"
+#include "minnet-tls.h"
 #include <assert.h>
 #include <libwebsockets.h>
 
@@ -58,7 +59,11 @@ ws_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user
       break;
     }
 
-    case LWS_CALLBACK_OPENSSL_LOAD_EXTRA_SERVER_VERIFY_CERTS:
+    case LWS_CALLBACK_OPENSSL_LOAD_EXTRA_SERVER_VERIFY_CERTS: {
+      server_tls_attach(server, user);
+      return lws_callback_http_dummy(wsi, reason, user, in, len);
+    }
+
     case LWS_CALLBACK_OPENSSL_LOAD_EXTRA_CLIENT_VERIFY_CERTS: {
       return lws_callback_http_dummy(wsi, reason, user, in, len);
     }
@@ -142,7 +147,7 @@ ws_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user
       if(!opaque->req) {
         opaque->req = request_new(url, METHOD_GET, ctx);
         opaque->req->secure = wsi_tls(wsi);
-        headers_tobuffer(ctx, &opaque->req->headers, wsi);
+        headers_attach(&opaque->req->headers, wsi);
       } else {
         url_free(&url, JS_GetRuntime(ctx));
       }
@@ -162,7 +167,11 @@ ws_server_callback(struct lws* wsi, enum lws_callback_reasons reason, void* user
       if(opaque->req) {
         url = &opaque->req->url;
 
-        if((mount = mount_find_s((MinnetHttpMount*)server->context.info.mounts, url->path))) {
+        /* the request stays with the connection, past the upgrade */
+        if(opaque->req->headers.wsi)
+          headers_detach(&opaque->req->headers, TRUE);
+
+        if((mount = server_route(server, url->path, url->path ? strlen(url->path) : 0, opaque->req->method, &opaque->req->route))) {
           // printf("found mount mnt=%s org=%s def=%s pro=%s\n", mount->mnt, mount->org, mount->def, mount->pro);
         }
 
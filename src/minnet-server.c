@@ -6,6 +6,7 @@
 #include "minnet-server-proxy.h"
 #include "minnet-response.h"
 #include "minnet-request.h"
+#include "minnet-tls.h"
 #include "closure.h"
 #include <list.h>
 #include <quickjs-libc.h>
@@ -93,6 +94,14 @@ server_new(JSContext* ctx) {
   server->context.js = ctx;
   server->context.info = (struct lws_context_creation_info){.protocols = protocols2, .user = server};
   server->promise = (ResolveFunctions){JS_NULL, JS_NULL};
+  server->next = JS_UNDEFINED;
+  server->tls_options = JS_UNDEFINED;
+
+  server->atoms.body = JS_NewAtom(ctx, "body");
+  server->atoms.value = JS_NewAtom(ctx, "value");
+  server->atoms.done = JS_NewAtom(ctx, "done");
+
+  compress_options_init(&server->compression);
 
   context_add(&server->context);
 
@@ -137,128 +146,107 @@ server_free(MinnetServer* server) {
   if(--server->ref_count == 0) {
     js_async_free(JS_GetRuntime(ctx), &server->promise);
 
-    context_clear(&server->context);
+    for(uint32_t i = 0; i < server->nmatchers; i++) {
+      if(server->matchers[i].path)
+        js_free(ctx, server->matchers[i].path);
+      JS_FreeValue(ctx, server->matchers[i].callback);
+    }
 
-    js_free(ctx, server);
-  }
-}
+    js_free(ctx, server->matchers);
+    JS_FreeValue(ctx, server->next);
 
-struct ServerMatchClosure {
-  int ref_count;
-  JSContext* ctx;
-  const char* path;
-  enum http_method method;
-  JSValue this_cb, prev_cb;
-  BOOL next;
-};
+    JS_FreeAtom(ctx, server->atoms.body);
+    JS_FreeAtom(ctx, server->atoms.value);
+    JS_FreeAtom(ctx, server->atoms.done);
 
-static BOOL
-server_match_all(struct ServerMatchClosure* closure) {
-  return closure->path == 0 && (int)closure->method == -1;
-}
+    compress_options_clear(&server->compression, ctx);
 
-static struct ServerMatchClosure*
-server_match_dup(struct ServerMatchClosure* closure) {
-  ++closure->ref_count;
-  return closure;
-}
+    context_clear(&server->context);
+    context_delete(&server->context);
+    server_tls_clear(server);
 
-static void
-server_match_free(void* ptr) {
-  struct ServerMatchClosure* closure = ptr;
-
-  if(--closure->ref_count == 0) {
-    JSContext* ctx = closure->ctx;
-    JS_FreeCString(ctx, closure->path);
-    JS_FreeValue(ctx, closure->this_cb);
-    JS_FreeValue(ctx, closure->prev_cb);
+    js_free(ctx, server);
   }
 }
 
 static JSValue
 minnet_server_next(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* opaque) {
-  struct ServerMatchClosure* closure = opaque;
+  MinnetServer* server = opaque;
 
-  closure->next = TRUE;
+  server->next_called = TRUE;
   return JS_UNDEFINED;
 };
 
-static JSValue
-minnet_server_match(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* opaque) {
-  struct ServerMatchClosure* closure = opaque;
-  JSValue ret = JS_UNDEFINED;
-  MinnetRequest* req;
-  int32_t n;
-  BOOL all = server_match_all(closure);
-  JSValueConst args[] = {
-      argv[0],
-      argv[1],
-      JS_NULL,
-  };
-
-  if(!js_is_nullish(closure->prev_cb)) {
-    /*if(closure->path==0 && closure->method==-1)
-      args[2]= js_function_bind_argv(ctx, closure->this_cb, */
-
-    ret = JS_Call(ctx, closure->prev_cb, JS_NULL, 2, args);
-  }
-
-  JS_ToInt32(ctx, &n, ret);
-  DBG("all=%s ret=%" PRId32 " path=%s method=%s", all ? "TRUE" : "FALSE", n, closure->path, method_name(closure->method));
-
-  if(n == 1)
-    return ret;
-
-  if((req = minnet_request_data2(ctx, argv[0]))) {
-    BOOL match = request_match(req, closure->path, closure->method);
-
-    DBG("match=%s all=%s", match ? "TRUE" : "FALSE", all ? "TRUE" : "FALSE");
-
-    if(match) {
+/* Adds a server.get/post/use() handler to the dispatch table */
+BOOL
+server_match(MinnetServer* server, const char* path, enum http_method method, JSValueConst callback) {
+  JSContext* ctx = server->context.js;
+  ServerMatcher *matchers, *m;
 
-      //    if(all)
-      args[2] = js_function_cclosure(ctx, minnet_server_next, 0, 0, server_match_dup(closure), server_match_free);
+  if(!(matchers = js_realloc(ctx, server->matchers, (server->nmatchers + 1) * sizeof(ServerMatcher))))
+    return FALSE;
 
-      ret = JS_Call(ctx, closure->this_cb, JS_NULL, all ? 3 : 2, args);
+  server->matchers = matchers;
+  m = &matchers[server->nmatchers];
 
-      if(all && !closure->next)
-        ret = JS_NewInt32(ctx, 1);
+  if(!(m->path = path ? js_strdup(ctx, path) : 0) && path)
+    return FALSE;
 
-      JS_FreeValue(ctx, args[2]);
-    }
-  }
+  m->pathlen = path ? strlen(path) : 0;
+  m->method = method;
+  m->callback = JS_DupValue(ctx, callback);
 
-  return ret;
+  server->nmatchers++;
+  return TRUE;
 }
 
+/* Calls onRequest, then the server.get/post/use() handlers matching method
+ * and path in the order they were added. A handler returning 1, or a use()
+ * handler that does not call next(), ends the chain. next() is one function
+ * per server */
 JSValue
-server_match(MinnetServer* server, const char* path, enum http_method method, JSValue callback, JSValue prev_callback) {
+server_dispatch(MinnetServer* server, struct session_data* session, MinnetRequest* req) {
   JSContext* ctx = server->context.js;
-  struct ServerMatchClosure* closure;
+  JSValue ret = JS_UNDEFINED;
+  JSValueConst args[] = {session->req_obj, session->resp_obj, JS_UNDEFINED};
+  size_t len = req->url.path ? strlen(req->url.path) : 0;
+  int32_t n = 0;
+  uint32_t i;
+
+  if(callback_valid(&server->on.http)) {
+    ret = server_exception(server, callback_emit_this(&server->on.http, session->ws_obj, 2, &session->req_obj));
+    JS_ToInt32(ctx, &n, ret);
+  }
 
-  if(!(closure = js_mallocz(ctx, sizeof(struct ServerMatchClosure))))
-    return JS_EXCEPTION;
+  for(i = 0; i < server->nmatchers && n != 1; i++) {
+    ServerMatcher* m = &server->matchers[i];
+    BOOL all = m->path == 0 && m->method == -1, called = server->next_called;
 
-  *closure = (struct ServerMatchClosure){
-      1,
-      ctx,
-      path,
-      method,
-      callback,
-      prev_callback,
-      FALSE,
-  };
+    if(m->method != -1 && m->method != (int)req->method)
+      continue;
 
-  JSValue ret = js_function_cclosure(ctx, minnet_server_match, 0, 0, closure, server_match_free);
+    if(m->path && (m->pathlen != len || memcmp(m->path, req->url.path, len)))
+      continue;
 
-  JS_DefinePropertyValueStr(ctx, ret, "name", JS_NewString(ctx, path != 0 ? path : "*"), 0);
+    if(all) {
+      if(!JS_IsFunction(ctx, server->next))
+        server->next = js_function_cclosure(ctx, minnet_server_next, 0, 0, server, 0);
 
-  if((int)method != -1)
-    JS_SetPropertyStr(ctx, ret, "method", JS_NewString(ctx, method_name(method)));
+      args[2] = server->next;
+      server->next_called = FALSE;
+    }
+
+    JS_FreeValue(ctx, ret);
+    ret = server_exception(server, JS_Call(ctx, m->callback, JS_NULL, all ? 3 : 2, args));
+
+    n = 0;
+
+    if(all && !server->next_called)
+      n = 1;
+    else
+      JS_ToInt32(ctx, &n, ret);
 
-  if(JS_IsFunction(ctx, prev_callback)) {
-    JS_SetPropertyStr(ctx, prev_callback, "next", ret);
-    JS_SetPropertyStr(ctx, ret, "prev", JS_DupValue(ctx, prev_callback));
+    server->next_called = called;
   }
 
   return ret;
@@ -268,14 +256,13 @@ void
 server_mounts(MinnetServer* server, JSValueConst opt_mounts) {
   JSContext* ctx = server->context.js;
   struct lws_context_creation_info* info = &server->context.info;
-  MinnetHttpMount** m = (MinnetHttpMount**)&info->mounts;
+  MinnetHttpMount *mount, **m = (MinnetHttpMount**)&info->mounts;
 
   *m = 0;
 
   if(JS_IsArray(ctx, opt_mounts)) {
     uint32_t i;
     for(i = 0;; i++) {
-      MinnetHttpMount* mount;
       JSValue mountval = JS_GetPropertyUint32(ctx, opt_mounts, i);
       if(JS_IsUndefined(mountval))
         break;
@@ -290,7 +277,6 @@ server_mounts(MinnetServer* server, JSValueConst opt_mounts) {
     JS_GetOwnPropertyNames(ctx, &tmp_tab, &tmp_len, opt_mounts, JS_GPN_ENUM_ONLY | JS_GPN_STRING_MASK | JS_GPN_SYMBOL_MASK);
 
     for(i = 0; i < tmp_len; i++) {
-      MinnetHttpMount* mount;
       JSAtom prop = tmp_tab[i].atom;
       const char* name = JS_AtomToCString(ctx, prop);
       JSValue mountval = JS_GetProperty(ctx, opt_mounts, prop);
@@ -301,6 +287,25 @@ server_mounts(MinnetServer* server, JSValueConst opt_mounts) {
       JS_FreeCString(ctx, name);
     }
   }
+
+  /* the route tree is built once, requests never walk the mount list */
+  router_free(&server->router);
+
+  for(mount = (MinnetHttpMount*)info->mounts; mount; mount = mount->next)
+    router_add(&server->router, mount->mnt, mount->method, mount);
+}
+
+MinnetHttpMount*
+server_route(MinnetServer* server, const char* path, size_t len, int method, RouteMatch* match) {
+  RouteMatch tmp;
+
+  if(!path)
+    return 0;
+
+  if(!router_match(&server->router, path, len, method, match ? match : &tmp))
+    return 0;
+
+  return (match ? match : &tmp)->value;
 }
 
 void
@@ -366,6 +371,7 @@ minnet_server_wrap(JSContext* ctx, MinnetServer* srv) {
 enum {
   SERVER_ONREQUEST,
   SERVER_LISTENING,
+  SERVER_TLS,
 };
 
 JSValue
@@ -386,6 +392,11 @@ minnet_server_get(JSContext* ctx, JSValueConst this_val, int magic) {
       ret = JS_NewBool(ctx, server->context.lws != 0);
       break;
     }
+
+    case SERVER_TLS: {
+      ret = server_tls_stats(server, ctx);
+      break;
+    }
   }
   return ret;
 }
@@ -415,6 +426,7 @@ enum {
   SERVER_POST,
   SERVER_USE,
   SERVER_MOUNT,
+  SERVER_RELOAD_CERTIFICATES,
 };
 
 JSValue
@@ -446,27 +458,16 @@ minnet_server_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueCon
       const char* path = 0;
       int index = 0;
       enum http_method method = magic == SERVER_GET ? METHOD_GET : magic == SERVER_POST ? METHOD_POST : -1;
-      JSValue fn, new_cb;
 
       if(JS_IsString(argv[0]) && argc > 1)
         path = JS_ToCString(ctx, argv[index++]);
 
       if(!JS_IsFunction(ctx, argv[index])) {
         ret = JS_ThrowTypeError(ctx, "argument %d must be a function", index + 1);
-        break;
-      }
-
-      /*if(method == -1 && path == 0 && server->on.http.ctx == 0) {
-        new_cb = JS_DupValue(ctx, argv[index]);
-      } else */
-      {
-        new_cb = server_match(server, path, method, JS_DupValue(ctx, argv[index]), server->on.http.func_obj);
-        path = 0;
+      } else if(!server_match(server, path, method, argv[index])) {
+        ret = JS_ThrowOutOfMemory(ctx);
       }
 
-      server->on.http.func_obj = new_cb;
-      server->on.http.ctx = ctx;
-
       if(path)
         JS_FreeCString(ctx, path);
       break;
@@ -510,11 +511,24 @@ minnet_server_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueCon
           JS_FreeCString(ctx, def);
       }
 
-      ADD(m, mount, next);
-
       if(path)
         JS_FreeCString(ctx, path);
 
+      if(!mount) {
+        ret = JS_ThrowTypeError(ctx, "invalid mount");
+        break;
+      }
+
+      ADD(m, mount, next);
+      router_add(&server->router, mount->mnt, mount->method, mount);
+
+      break;
+    }
+
+    case SERVER_RELOAD_CERTIFICATES: {
+      if(server_tls_reload(server, argc > 0 ? argv[0] : JS_UNDEFINED, ctx) == -1)
+        ret = JS_EXCEPTION;
+
       break;
     }
   }
@@ -602,8 +616,10 @@ minnet_server_closure(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
 
   options = argv[argind];
 
-  if(!JS_IsObject(options))
-    return JS_ThrowTypeError(ctx, "argument %d must be options object", argind + 1);
+  if(!JS_IsObject(options)) {
+    JS_ThrowTypeError(ctx, "argument %d must be options object", argind + 1);
+    goto fail;
+  }
 
   /* JSValue opt_port = JS_GetPropertyStr(ctx, options, "port");
    JSValue opt_host = JS_GetPropertyStr(ctx, options, "host");
@@ -621,6 +637,48 @@ minnet_server_closure(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
   JSValue opt_mimetypes = JS_GetPropertyStr(ctx, options, "mimetypes");
   JSValue opt_error_document = JS_GetPropertyStr(ctx, options, "errorDocument");
   JSValue opt_options = JS_GetPropertyStr(ctx, options, "options");
+  JSValue opt_max_body = JS_GetPropertyStr(ctx, options, "maxBodySize");
+  JSValue opt_threshold = JS_GetPropertyStr(ctx, options, "memoryThreshold");
+  JSValue opt_generator_bytes = JS_GetPropertyStr(ctx, options, "generatorBytes");
+  JSValue opt_generator_time = JS_GetPropertyStr(ctx, options, "generatorTime");
+  JSValue opt_compression = JS_GetPropertyStr(ctx, options, "compression");
+
+  if(JS_IsNumber(opt_max_body))
+    JS_ToIndex(ctx, &server->max_body_size, opt_max_body);
+  if(JS_IsNumber(opt_threshold))
+    JS_ToIndex(ctx, &server->memory_threshold, opt_threshold);
+  if(JS_IsNumber(opt_generator_bytes))
+    JS_ToUint32(ctx, &server->generator_bytes, opt_generator_bytes);
+  if(JS_IsNumber(opt_generator_time))
+    JS_ToUint32(ctx, &server->generator_time, opt_generator_time);
+
+  JS_FreeValue(ctx, opt_max_body);
+  JS_FreeValue(ctx, opt_threshold);
+  JS_FreeValue(ctx, opt_generator_bytes);
+  JS_FreeValue(ctx, opt_generator_time);
+
+  if(JS_IsObject(opt_compression)) {
+    JSValue min_size = JS_GetPropertyStr(ctx, opt_compression, "minSize");
+    JSValue level = JS_GetPropertyStr(ctx, opt_compression, "level");
+    JSValue types = JS_GetPropertyStr(ctx, opt_compression, "types");
+
+    if(JS_IsNumber(min_size))
+      JS_ToUint32(ctx, &server->compression.min_size, min_size);
+    if(JS_IsNumber(level))
+      JS_ToInt32(ctx, &server->compression.level, level);
+    if(JS_IsArray(ctx, types))
+      server->compression.types = js_array_to_argv(ctx, 0, types);
+
+    JS_FreeValue(ctx, min_size);
+    JS_FreeValue(ctx, level);
+    JS_FreeValue(ctx, types);
+  } else if(!JS_IsUndefined(opt_compression)) {
+    server->compression.enabled = JS_ToBool(ctx, opt_compression);
+  }
+
+  JS_FreeValue(ctx, opt_compression);
+
+  BOOL_OPTION(opt_stream_body, "streamBody", server->stream_body);
 
   if(!JS_IsFunction(ctx, opt_on_fd))
     opt_on_fd = minnet_default_fd_callback(ctx);
@@ -697,6 +755,9 @@ minnet_server_closure(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
   if(is_tls) {
     server_certificate(&server->context, options);
 
+    if(server_tls_init(server, options, ctx) == -1)
+      goto fail;
+
     // info->options |= LWS_SERVER_OPTION_REDIRECT_HTTP_TO_HTTPS;
     info->options |= LWS_SERVER_OPTION_ALLOW_HTTP_ON_HTTPS_LISTENER;
     info->options |= LWS_SERVER_OPTION_ALLOW_NON_SSL_ON_SSL_PORT;
@@ -751,8 +812,10 @@ printf("pvo mimetype %s %s\n", pvo->name, pvo->value);
   server_mounts(server, opt_mounts);
 
   if(server->context.info.port > 0)
-    if(!server_listen(server))
-      return JS_ThrowInternalError(ctx, "libwebsockets init failed");
+    if(!server_listen(server)) {
+      JS_ThrowInternalError(ctx, "libwebsockets init failed");
+      goto fail;
+    }
 
   ret = minnet_server_wrap(ctx, server);
 
@@ -785,6 +848,8 @@ printf("pvo mimetype %s %s\n", pvo->name, pvo->value);
     }
   }
 
+  router_free(&server->router);
+
   if(info->server_ssl_ca_mem)
     js_clear(ctx, &info->server_ssl_ca_mem);
   if(info->server_ssl_cert_mem)
@@ -818,6 +883,58 @@ printf("pvo mimetype %s %s\n", pvo->name, pvo->value);
   FREECB(server->on.http)
 
   return ret;
+
+fail:
+  /* the server is not handed out, minnet_server() must not wrap it */
+  if(ptr) {
+    union closure* closure = ptr;
+    closure->pointer = 0;
+    closure->free_func = 0;
+  }
+
+  if(server->mimetypes)
+    vhost_options_free_list(ctx, server->mimetypes);
+
+  if(info->mounts && info->mounts != &mount) {
+    const MinnetHttpMount *m, *next;
+
+    for(m = (MinnetHttpMount*)info->mounts; m; m = next) {
+      next = (MinnetHttpMount*)m->lws.mount_next;
+      mount_free(ctx, m);
+    }
+  }
+
+  router_free(&server->router);
+
+  if(info->vhost_name)
+    js_free(ctx, (void*)info->vhost_name);
+  if(info->error_document_404)
+    js_free(ctx, (void*)info->error_document_404);
+  if(info->server_ssl_ca_mem)
+    js_clear(ctx, &info->server_ssl_ca_mem);
+  if(info->server_ssl_cert_mem)
+    js_clear(ctx, &info->server_ssl_cert_mem);
+  if(info->server_ssl_private_key_mem)
+    js_clear(ctx, &info->server_ssl_private_key_mem);
+  if(info->ssl_ca_filepath)
+    js_clear(ctx, &info->ssl_ca_filepath);
+  if(info->ssl_cert_filepath)
+    js_clear(ctx, &info->ssl_cert_filepath);
+  if(info->ssl_private_key_filepath)
+    js_clear(ctx, &info->ssl_private_key_filepath);
+
+  FREECB(server->on.pong)
+  FREECB(server->on.close)
+  FREECB(server->on.connect)
+  FREECB(server->on.message)
+  FREECB(server->on.fd)
+  FREECB(server->on.http)
+  FREECB(server->on.read)
+  FREECB(server->on.post)
+
+  /* tls_options and the context go with it */
+  server_free(server_dup(server));
+  return JS_EXCEPTION;
 }
 
 JSValue
@@ -861,8 +978,10 @@ static const JSCFunctionListEntry minnet_server_proto_funcs[] = {
     JS_CFUNC_MAGIC_DEF("post", 2, minnet_server_method, SERVER_POST),
     JS_CFUNC_MAGIC_DEF("use", 2, minnet_server_method, SERVER_USE),
     JS_CFUNC_MAGIC_DEF("mount", 1, minnet_server_method, SERVER_MOUNT),
+    JS_CFUNC_MAGIC_DEF("reloadCertificates", 0, minnet_server_method, SERVER_RELOAD_CERTIFICATES),
     JS_CGETSET_MAGIC_DEF("onrequest", minnet_server_get, minnet_server_set, SERVER_ONREQUEST),
     JS_CGETSET_MAGIC_FLAGS_DEF("listening", minnet_server_get, 0, SERVER_LISTENING, JS_PROP_ENUMERABLE),
+    JS_CGETSET_MAGIC_DEF("tls", minnet_server_get, 0, SERVER_TLS),
     JS_PROP_STRING_DEF("[Symbol.toStringTag]", "MinnetServer", JS_PROP_CONFIGURABLE),
 };
 
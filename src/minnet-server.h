@@ -6,11 +6,22 @@
 #include "minnet.h"
 #include "minnet-server-http.h"
 #include "context.h"
+#include "router.h"
+#include "compress.h"
+#include "tls.h"
 
 #define server_exception(server, retval) context_exception(&((server)->context), (retval))
 
 struct http_mount;
 
+/* A server.get/post/use() handler, 'path' 0 and 'method' -1 match anything */
+typedef struct server_matcher {
+  char* path;
+  size_t pathlen;
+  int method;
+  JSValue callback;
+} ServerMatcher;
+
 typedef struct server_context {
   union {
     struct {
@@ -25,14 +36,32 @@ typedef struct server_context {
   CallbackList on;
   MinnetVhostOptions* mimetypes;
   BOOL listening;
+  Router router;
+  ServerMatcher* matchers;
+  uint32_t nmatchers;
+  JSValue next;
+  BOOL next_called;
+  uint64_t max_body_size;    /* 413 above this, 0 for no limit */
+  uint64_t memory_threshold; /* request bodies above this go to a temp file */
+  BOOL stream_body;          /* call handlers before the body has arrived */
+  uint32_t generator_bytes;  /* bytes pulled from a sync generator per write, 0 for the default */
+  uint32_t generator_time;   /* milliseconds spent pulling per write, 0 for the default */
+  CompressOptions compression;
+  TLSServer tls;
+  JSValue tls_options; /* what reloadCertificates() reads again, undefined without TLS */
+  struct {
+    JSAtom body, value, done;
+  } atoms; /* looked up on every value an async handler resolves */
 } MinnetServer;
 
 struct proxy_connection;
 
 MinnetServer* server_dup(MinnetServer*);
 void server_free(MinnetServer*);
-JSValue server_match(MinnetServer*, const char*, enum http_method, JSValueConst callback, JSValueConst prev_callback);
+BOOL server_match(MinnetServer*, const char*, enum http_method, JSValueConst callback);
+JSValue server_dispatch(MinnetServer*, struct session_data*, struct http_request*);
 void server_mounts(MinnetServer*, JSValueConst);
+MinnetHttpMount* server_route(MinnetServer*, const char* path, size_t len, int method, RouteMatch* match);
 void server_certificate(struct context*, JSValueConst);
 JSValue minnet_server_wrap(JSContext*, MinnetServer*);
 JSValue minnet_server_method(JSContext*, JSValueConst, int, JSValueConst argv[], int magic);
@@ -0,0 +1,483 @@
+#define _GNU_SOURCE
+#include "minnet-tls.h"
+#include "minnet-client.h"
+#include "minnet-server.h"
+#include "js-utils.h"
+#include <string.h>
+
+THREAD_LOCAL TLSCache* minnet_tls_cache = 0;
+static THREAD_LOCAL BOOL minnet_tls_cache_off = FALSE;
+
+static TLSCache*
+tls_cache(void) {
+  if(!minnet_tls_cache && !minnet_tls_cache_off) {
+    if((minnet_tls_cache = malloc(sizeof(TLSCache))))
+      tls_cache_init(minnet_tls_cache, 0, 0);
+  }
+
+  return minnet_tls_cache;
+}
+
+static BOOL
+client_tls_secure(MinnetClient* client) {
+  return (client->connect_info.ssl_connection & LCCSCF_USE_SSL) && client->connect_info.host && client->context.lws;
+}
+
+#if defined(LWS_WITH_TLS_SESSIONS)
+/* Hands a stored session to lws, which frees the copy */
+static int
+tls_session_load(struct lws_context* context, struct lws_tls_session_dump* info) {
+  TLSSession* sess = info->opaque;
+
+  if(!(info->blob = malloc(sess->len)))
+    return 1;
+
+  memcpy(info->blob, sess->blob, sess->len);
+  info->blob_len = sess->len;
+  return 0;
+}
+
+static int
+tls_session_save(struct lws_context* context, struct lws_tls_session_dump* info) {
+  MinnetClient* client = info->opaque;
+
+  if(!minnet_tls_cache)
+    return 1;
+
+  return tls_session_store(minnet_tls_cache, client->connect_info.host, client->connect_info.port, info->blob, info->blob_len, time(0)) ? 0 : 1;
+}
+#endif
+
+static const char* const tls_source_names[] = {"sslCA", "sslCert", "sslPrivateKey"};
+
+/* Reads sslCA, sslCert and sslPrivateKey, each a file name or an ArrayBuffer */
+static BOOL
+tls_sources_get(JSContext* ctx, JSValueConst options, TLSSource src[], JSValue values[]) {
+  BOOL any = FALSE;
+
+  for(size_t i = 0; i < countof(tls_source_names); i++) {
+    size_t len;
+
+    memset(&src[i], 0, sizeof(TLSSource));
+    values[i] = JS_GetPropertyStr(ctx, options, tls_source_names[i]);
+
+    if(JS_IsString(values[i])) {
+      src[i].path = JS_ToCString(ctx, values[i]);
+    } else if(js_is_arraybuffer(ctx, values[i]) && (src[i].data = JS_GetArrayBuffer(ctx, &len, values[i]))) {
+      src[i].len = len;
+    }
+
+    if(src[i].path || src[i].data)
+      any = TRUE;
+  }
+
+  return any;
+}
+
+static void
+tls_sources_free(JSContext* ctx, TLSSource src[], JSValue values[]) {
+  for(size_t i = 0; i < countof(tls_source_names); i++) {
+    if(src[i].path)
+      JS_FreeCString(ctx, src[i].path);
+
+    JS_FreeValue(ctx, values[i]);
+  }
+}
+
+/**
+ * Reads sslCA, sslCert and sslPrivateKey.  They are parsed once per
+ * runtime and shared with every client using the same material, without
+ * the TLS cache lws parses them.
+ *
+ * @return -1 with an exception when they do not parse
+ */
+int
+client_tls_init(MinnetClient* client, JSValueConst options, JSContext* ctx) {
+  TLSSource src[countof(tls_source_names)];
+  JSValue values[countof(tls_source_names)];
+  TLSCache* cache;
+
+#if defined(TLS_OPENSSL)
+  cache = tls_cache();
+#else
+  cache = 0;
+#endif
+
+  /* lws parses them itself */
+  if(!cache) {
+    client_certificate(&client->context, options);
+    return 0;
+  }
+
+  if(tls_sources_get(ctx, options, src, values) && !(client->tls.credentials = tls_credentials_get(cache, &src[0], &src[1], &src[2]))) {
+    tls_sources_free(ctx, src, values);
+    JS_ThrowTypeError(ctx, "sslCA, sslCert or sslPrivateKey could not be loaded");
+    return -1;
+  }
+
+  tls_sources_free(ctx, src, values);
+  return 0;
+}
+
+/**
+ * Puts the shared credentials into the SSL_CTX lws just created, from
+ * LWS_CALLBACK_OPENSSL_LOAD_EXTRA_CLIENT_VERIFY_CERTS.
+ */
+int
+client_tls_apply(MinnetClient* client, void* ssl_ctx) {
+  if(client->tls.credentials && ssl_ctx && !tls_credentials_apply(client->tls.credentials, ssl_ctx))
+    lwsl_err("minnet-client: failed to use sslCert/sslPrivateKey\n");
+
+  return 0;
+}
+
+/**
+ * Offers the stored session of the host to lws before connecting.
+ */
+void
+client_tls_load(MinnetClient* client) {
+#if defined(LWS_WITH_TLS_SESSIONS)
+  struct lws_vhost* vhost;
+  TLSSession* sess;
+
+  if(!client_tls_secure(client) || !tls_cache())
+    return;
+
+  if(!(sess = tls_session_find(minnet_tls_cache, client->connect_info.host, client->connect_info.port, time(0))))
+    return;
+
+  if((vhost = lws_get_vhost_by_name(client->context.lws, "default")))
+    lws_tls_session_dump_load(vhost, client->connect_info.host, client->connect_info.port, tls_session_load, sess);
+#endif
+}
+
+void
+client_tls_established(MinnetClient* client, struct lws* wsi) {
+  if(!client_tls_secure(client) || !minnet_tls_cache || !lws_is_ssl(wsi))
+    return;
+
+  minnet_tls_cache->handshakes++;
+
+#if defined(LWS_WITH_TLS_SESSIONS)
+  if(lws_tls_session_is_reused(wsi))
+    minnet_tls_cache->resumed++;
+#endif
+}
+
+/**
+ * Keeps the session of a finished connection, once.  TLS 1.3 tickets
+ * arrive after the handshake, so this waits for the connection to end.
+ */
+void
+client_tls_save(MinnetClient* client) {
+#if defined(LWS_WITH_TLS_SESSIONS)
+  struct lws_vhost* vhost;
+
+  if(client->tls.saved || !client_tls_secure(client) || !minnet_tls_cache)
+    return;
+
+  if((vhost = lws_get_vhost_by_name(client->context.lws, "default")))
+    if(!lws_tls_session_dump_save(vhost, client->connect_info.host, client->connect_info.port, tls_session_save, client))
+      client->tls.saved = TRUE;
+#endif
+}
+
+void
+client_tls_clear(MinnetClient* client) {
+  if(client->tls.credentials) {
+    tls_credentials_free(client->tls.credentials);
+    client->tls.credentials = 0;
+  }
+
+  client->tls.saved = FALSE;
+}
+
+static JSValue
+tls_cache_stats(JSContext* ctx, TLSCache* cache) {
+  JSValue ret = JS_NewObject(ctx);
+
+  JS_SetPropertyStr(ctx, ret, "sessions", JS_NewUint32(ctx, cache->count));
+  JS_SetPropertyStr(ctx, ret, "credentials", JS_NewUint32(ctx, cache->credential_count));
+  JS_SetPropertyStr(ctx, ret, "maxSessions", JS_NewUint32(ctx, cache->max_sessions));
+  JS_SetPropertyStr(ctx, ret, "lifetime", JS_NewUint32(ctx, cache->lifetime));
+  JS_SetPropertyStr(ctx, ret, "handshakes", JS_NewInt64(ctx, cache->handshakes));
+  JS_SetPropertyStr(ctx, ret, "resumed", JS_NewInt64(ctx, cache->resumed));
+  JS_SetPropertyStr(ctx, ret, "stores", JS_NewInt64(ctx, cache->stores));
+
+  return ret;
+}
+
+/**
+ * Configures the TLS cache of client() and fetch() with { maxSessions,
+ * lifetime }, disables it with false.  It is on by default.
+ *
+ * @return statistics of the cache, null when it is disabled
+ */
+JSValue
+minnet_set_tls_cache(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  if(argc > 0 && !JS_IsUndefined(argv[0])) {
+    uint32_t max_sessions = 0, lifetime = 0;
+
+    if(JS_IsObject(argv[0])) {
+      max_sessions = js_get_propertystr_uint32(ctx, argv[0], "maxSessions");
+      lifetime = js_get_propertystr_uint32(ctx, argv[0], "lifetime");
+    } else if(!JS_IsBool(argv[0]) && !JS_IsNull(argv[0])) {
+      return JS_ThrowTypeError(ctx, "argument 1 must be a boolean or an object");
+    }
+
+    if(minnet_tls_cache) {
+      tls_cache_clear(minnet_tls_cache);
+      free(minnet_tls_cache);
+      minnet_tls_cache = 0;
+    }
+
+    minnet_tls_cache_off = !JS_IsObject(argv[0]) && !JS_ToBool(ctx, argv[0]);
+
+    if(!minnet_tls_cache_off) {
+      if(!(minnet_tls_cache = malloc(sizeof(TLSCache))))
+        return JS_ThrowOutOfMemory(ctx);
+
+      tls_cache_init(minnet_tls_cache, max_sessions, lifetime);
+    }
+  }
+
+  return tls_cache() ? tls_cache_stats(ctx, minnet_tls_cache) : JS_NULL;
+}
+
+/* Reads { "host": { sslCert, sslPrivateKey, sslCA }, "*.domain": ... } */
+static int
+server_tls_names(JSContext* ctx, JSValueConst sni, TLSServerName** names, size_t* nnames) {
+  JSPropertyEnum* tab;
+  uint32_t tab_len, i;
+  TLSServerName* ret;
+  size_t n = 0;
+
+  *names = 0;
+  *nnames = 0;
+
+  if(JS_IsUndefined(sni) || JS_IsNull(sni))
+    return 0;
+
+  if(!JS_IsObject(sni)) {
+    JS_ThrowTypeError(ctx, "sni must be an object");
+    return -1;
+  }
+
+  if(JS_GetOwnPropertyNames(ctx, &tab, &tab_len, sni, JS_GPN_ENUM_ONLY | JS_GPN_STRING_MASK))
+    return -1;
+
+  if(!(ret = calloc(tab_len ? tab_len : 1, sizeof(TLSServerName))))
+    JS_ThrowOutOfMemory(ctx);
+
+  for(i = 0; ret && i < tab_len; i++) {
+    TLSSource src[countof(tls_source_names)];
+    JSValue values[countof(tls_source_names)], value = JS_GetProperty(ctx, sni, tab[i].atom);
+    const char* name = JS_AtomToCString(ctx, tab[i].atom);
+    TLSCredentials* creds = 0;
+
+    if(JS_IsObject(value)) {
+      if(tls_sources_get(ctx, value, src, values) && (src[1].path || src[1].data) && (src[2].path || src[2].data))
+        creds = tls_credentials_new(&src[0], &src[1], &src[2]);
+
+      tls_sources_free(ctx, src, values);
+    }
+
+    JS_FreeValue(ctx, value);
+
+    if(creds && name && (ret[n].name = strdup(name))) {
+      ret[n++].credentials = creds;
+    } else {
+      JS_ThrowTypeError(ctx, "the certificate of '%s' could not be loaded", name ? name : "");
+
+      if(creds)
+        tls_credentials_free(creds);
+
+      for(size_t j = 0; j < n; j++) {
+        free(ret[j].name);
+        tls_credentials_free(ret[j].credentials);
+      }
+
+      free(ret);
+      ret = 0;
+    }
+
+    JS_FreeCString(ctx, name);
+  }
+
+  for(i = 0; i < tab_len; i++)
+    JS_FreeAtom(ctx, tab[i].atom);
+  js_free(ctx, tab);
+
+  if(!ret)
+    return -1;
+
+  *names = ret;
+  *nnames = n;
+  return 0;
+}
+
+/**
+ * Reads the sni and sessionTickets options of a TLS server, sslCert and
+ * sslPrivateKey stay the certificate of names not listed in sni.
+ *
+ * @return -1 with an exception when a certificate does not parse
+ */
+int
+server_tls_init(MinnetServer* server, JSValueConst options, JSContext* ctx) {
+  JSValue tickets = JS_GetPropertyStr(ctx, options, "sessionTickets");
+  JSValue sni = JS_GetPropertyStr(ctx, options, "sni");
+  uint32_t rotate = TLS_TICKET_ROTATE, lifetime = TLS_SESSION_LIFETIME;
+  TLSServerName* names;
+  size_t nnames;
+  int ret = -1;
+
+  if(JS_IsObject(tickets)) {
+    if(js_has_propertystr(ctx, tickets, "rotate"))
+      rotate = js_get_propertystr_uint32(ctx, tickets, "rotate");
+    if(js_has_propertystr(ctx, tickets, "lifetime"))
+      lifetime = js_get_propertystr_uint32(ctx, tickets, "lifetime");
+  } else if(!JS_IsUndefined(tickets) && !JS_ToBool(ctx, tickets)) {
+    rotate = 0;
+  }
+
+  tls_server_init(&server->tls, rotate, lifetime);
+  server->tls_options = JS_DupValue(ctx, options);
+
+#if defined(TLS_OPENSSL)
+  if(server_tls_names(ctx, sni, &names, &nnames) == 0) {
+    tls_server_swap(&server->tls, 0, names, nnames);
+    ret = 0;
+  }
+#else
+  if(JS_IsUndefined(sni))
+    ret = 0;
+  else
+    JS_ThrowTypeError(ctx, "sni needs OpenSSL");
+#endif
+
+  JS_FreeValue(ctx, tickets);
+  JS_FreeValue(ctx, sni);
+  return ret;
+}
+
+/**
+ * Hooks SNI and session tickets into the SSL_CTX of the vhost, from
+ * LWS_CALLBACK_OPENSSL_LOAD_EXTRA_SERVER_VERIFY_CERTS.
+ */
+int
+server_tls_attach(MinnetServer* server, void* ssl_ctx) {
+#if defined(TLS_OPENSSL)
+  if(!JS_IsUndefined(server->tls_options) && ssl_ctx && !tls_server_attach(&server->tls, ssl_ctx))
+    lwsl_err("minnet-server: failed to set up SNI and session tickets\n");
+#endif
+
+  return 0;
+}
+
+/* The certificate options of 'base', with those 'options' has replaced */
+static JSValue
+server_tls_merge(JSContext* ctx, JSValueConst base, JSValueConst options) {
+  static const char* const keys[] = {"sslCA", "sslCert", "sslPrivateKey", "sni"};
+  JSValue ret = JS_NewObject(ctx);
+
+  for(size_t i = 0; i < countof(keys); i++) {
+    JSValueConst from = js_has_propertystr(ctx, options, keys[i]) ? options : base;
+
+    JS_SetPropertyStr(ctx, ret, keys[i], JS_GetPropertyStr(ctx, from, keys[i]));
+  }
+
+  return ret;
+}
+
+/**
+ * Loads sslCert, sslPrivateKey, sslCA and sni again, those missing from
+ * 'options' as they were last given.  New handshakes use them, current
+ * connections keep theirs, and nothing changes when one does not parse.
+ *
+ * @return -1 with an exception
+ */
+int
+server_tls_reload(MinnetServer* server, JSValueConst options, JSContext* ctx) {
+  TLSSource src[countof(tls_source_names)];
+  JSValue values[countof(tls_source_names)], sni, merged;
+  TLSCredentials* creds = 0;
+  TLSServerName* names;
+  size_t nnames;
+  BOOL any;
+  int ret;
+
+  if(JS_IsUndefined(server->tls_options)) {
+    JS_ThrowTypeError(ctx, "the server does not use TLS");
+    return -1;
+  }
+
+#if !defined(TLS_OPENSSL)
+  JS_ThrowTypeError(ctx, "reloading certificates needs OpenSSL");
+  return -1;
+#endif
+
+  merged = JS_IsObject(options) ? server_tls_merge(ctx, server->tls_options, options) : JS_DupValue(ctx, server->tls_options);
+  any = tls_sources_get(ctx, merged, src, values);
+
+  if(any)
+    creds = tls_credentials_new(&src[0], &src[1], &src[2]);
+  else if(server->tls.credentials)
+    creds = tls_credentials_dup(server->tls.credentials);
+
+  tls_sources_free(ctx, src, values);
+
+  if(any && !creds) {
+    JS_FreeValue(ctx, merged);
+    JS_ThrowTypeError(ctx, "sslCA, sslCert or sslPrivateKey could not be loaded");
+    return -1;
+  }
+
+  sni = JS_GetPropertyStr(ctx, merged, "sni");
+  ret = server_tls_names(ctx, sni, &names, &nnames);
+  JS_FreeValue(ctx, sni);
+
+  if(ret == -1) {
+    if(creds)
+      tls_credentials_free(creds);
+    JS_FreeValue(ctx, merged);
+    return -1;
+  }
+
+  tls_server_swap(&server->tls, creds, names, nnames);
+  server->tls.reloads++;
+
+  JS_FreeValue(ctx, server->tls_options);
+  server->tls_options = merged;
+
+  return 0;
+}
+
+/**
+ * @return statistics of the server, null without TLS
+ */
+JSValue
+server_tls_stats(MinnetServer* server, JSContext* ctx) {
+  JSValue ret;
+
+  if(JS_IsUndefined(server->tls_options))
+    return JS_NULL;
+
+  ret = JS_NewObject(ctx);
+
+  JS_SetPropertyStr(ctx, ret, "names", JS_NewUint32(ctx, server->tls.nnames));
+  JS_SetPropertyStr(ctx, ret, "handshakes", JS_NewInt64(ctx, server->tls.handshakes + server->tls.resumed));
+  JS_SetPropertyStr(ctx, ret, "resumed", JS_NewInt64(ctx, server->tls.resumed));
+  JS_SetPropertyStr(ctx, ret, "tickets", JS_NewInt64(ctx, server->tls.tickets));
+  JS_SetPropertyStr(ctx, ret, "rotations", JS_NewInt64(ctx, server->tls.rotations));
+  JS_SetPropertyStr(ctx, ret, "reloads", JS_NewInt64(ctx, server->tls.reloads));
+
+  return ret;
+}
+
+void
+server_tls_clear(MinnetServer* server) {
+  tls_server_clear(&server->tls);
+
+  JS_FreeValue(server->context.js, server->tls_options);
+  server->tls_options = JS_UNDEFINED;
+}
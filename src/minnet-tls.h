@@ -0,0 +1,26 @@
+#ifndef MINNET_TLS_H
+#define MINNET_TLS_H
+
+#include <libwebsockets.h>
+#include <quickjs.h>
+#include "tls.h"
+
+struct client_context;
+struct server_context;
+
+extern THREAD_LOCAL TLSCache* minnet_tls_cache;
+
+int client_tls_init(struct client_context*, JSValueConst options, JSContext*);
+int client_tls_apply(struct client_context*, void* ssl_ctx);
+void client_tls_load(struct client_context*);
+void client_tls_established(struct client_context*, struct lws*);
+void client_tls_save(struct client_context*);
+void client_tls_clear(struct client_context*);
+int server_tls_init(struct server_context*, JSValueConst options, JSContext*);
+int server_tls_attach(struct server_context*, void* ssl_ctx);
+int server_tls_reload(struct server_context*, JSValueConst options, JSContext*);
+JSValue server_tls_stats(struct server_context*, JSContext*);
+void server_tls_clear(struct server_context*);
+JSValue minnet_set_tls_cache(JSContext*, JSValueConst this_val, int argc, JSValueConst argv[]);
+
+#endif /* MINNET_TLS_H */
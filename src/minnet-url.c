@@ -1,7 +1,7 @@
 #include "minnet-url.h"
 #include "js-utils.h"
 #include "utils.h"
-#include "query.h"
+#include "minnet-query.h"
 #include <assert.h>
 #include <limits.h>
 #include <ctype.h>
@@ -19,6 +19,7 @@ enum {
   URL_QUERY,
   URL_TLS,
   URL_SEARCH,
+  URL_SEARCH_PARAMS,
   URL_HASH,
   URL_ORIGIN,
   URL_HREF,
@@ -123,6 +124,13 @@ minnet_url_get(JSContext* ctx, JSValueConst this_val, int magic) {
       break;
     }
 
+    case URL_SEARCH_PARAMS: {
+      const char* query = url->path ? url_query(*url) : 0;
+
+      ret = minnet_query_new(ctx, query ? query : "", query ? strlen(query) : 0);
+      break;
+    }
+
     case URL_HASH: {
       const char* hash;
       if((hash = url_hash(*url)))
@@ -356,6 +364,7 @@ static const JSCFunctionListEntry minnet_url_proto_funcs[] = {
     JS_CGETSET_MAGIC_FLAGS_DEF("path", minnet_url_get, 0, URL_PATHNAME, 0),
     JS_CGETSET_MAGIC_FLAGS_DEF("query", minnet_url_get, minnet_url_set, URL_QUERY, 0),
     JS_CGETSET_MAGIC_FLAGS_DEF("search", minnet_url_get, 0, URL_SEARCH, JS_PROP_ENUMERABLE),
+    JS_CGETSET_MAGIC_FLAGS_DEF("searchParams", minnet_url_get, 0, URL_SEARCH_PARAMS, 0),
     JS_CGETSET_MAGIC_FLAGS_DEF("hash", minnet_url_get, 0, URL_HASH, JS_PROP_ENUMERABLE),
     JS_CGETSET_MAGIC_FLAGS_DEF("origin", minnet_url_get, 0, URL_ORIGIN, 0),
     JS_CGETSET_MAGIC_FLAGS_DEF("tls", minnet_url_get, 0, URL_TLS, 0),
@@ -95,14 +95,15 @@ minnet_ws_send(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst arg
   MinnetWebsocket* ws;
   JSValue ret = JS_UNDEFINED;
   JSBuffer jsbuf;
-  QueueItem* item;
+  QueueItem* item = 0;
+  Queue* q;
   struct wsi_opaque_user_data* opaque;
 
   if(!(ws = minnet_ws_data2(ctx, this_val)))
     return JS_EXCEPTION;
 
   // assert(ws->lwsi);
-  if(ws->lwsi == 0 || ((size_t)ws->lwsi) >> 4 == 0xfffffffffffffff)
+  if((ws->lwsi == 0 && (!ws->pending || ws->closed)) || ((size_t)ws->lwsi) >> 4 == 0xfffffffffffffff)
     return ret;
 
   if(argc == 0)
@@ -110,7 +111,12 @@ minnet_ws_send(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst arg
 
   int i = js_buffer_fromargs(ctx, argc, argv, &jsbuf);
 
-  if((opaque = ws_opaque(ws)) && opaque->writable) {
+  if(ws->lwsi == 0) {
+    /* reconnecting, sent once connected again */
+    if(!(item = ws_pending(ws, jsbuf.data, jsbuf.size)))
+      return JS_FALSE;
+
+  } else if((opaque = ws_opaque(ws)) && opaque->writable && (!(q = ws_queue(ws)) || queue_empty(q))) {
     int result;
     int32_t protocol = JS_IsString(jsbuf.value) ? LWS_WRITE_TEXT : LWS_WRITE_BINARY;
 
@@ -120,7 +126,11 @@ minnet_ws_send(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst arg
     result = lws_write(ws->lwsi, jsbuf.data, jsbuf.size, protocol);
     ret = JS_NewInt32(ctx, result);
 
-  } else if((item = ws_send(ws, jsbuf.data, jsbuf.size, ctx))) {
+  } else {
+    item = ws_send(ws, jsbuf.data, jsbuf.size, ctx);
+  }
+
+  if(item) {
     ResolveFunctions fns;
 
     ret = js_async_create(ctx, &fns);
@@ -257,6 +267,9 @@ minnet_ws_close(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst ar
   if(!(ws = minnet_ws_data2(ctx, this_val)))
     return JS_EXCEPTION;
 
+  /* no reconnecting after this */
+  ws->closed = TRUE;
+
   if(ws->lwsi) {
     int optind = 0;
     int32_t status = LWS_CLOSE_STATUS_NORMAL;
@@ -10,7 +10,10 @@
 #include "minnet-formparser.h"
 #include "minnet-hash.h"
 #include "minnet-fetch.h"
+#include "minnet-resolver.h"
+#include "minnet-tls.h"
 #include "minnet-headers.h"
+#include "minnet-query.h"
 #include "js-utils.h"
 #include "utils.h"
 #include "buffer.h"
@@ -435,6 +438,10 @@ static const JSCFunctionListEntry minnet_funcs[] = {
     JS_CFUNC_DEF("createServer", 1, minnet_server),
     JS_CFUNC_DEF("client", 1, minnet_client),
     JS_CFUNC_DEF("fetch", 1, minnet_fetch),
+    JS_CFUNC_DEF("fetchAll", 1, minnet_fetch_all),
+    JS_CFUNC_DEF("setFetchCache", 1, minnet_set_fetch_cache),
+    JS_CFUNC_DEF("setResolver", 1, minnet_set_resolver),
+    JS_CFUNC_DEF("setTLSCache", 1, minnet_set_tls_cache),
     JS_CFUNC_DEF("getSessions", 0, minnet_get_sessions),
     JS_CFUNC_DEF("setLog", 1, minnet_set_log),
     JS_PROP_INT32_DEF("METHOD_GET", METHOD_GET, 0),
@@ -478,6 +485,7 @@ js_minnet_init(JSContext* ctx, JSModuleDef* m) {
   minnet_asynciterator_init(ctx, m);
   minnet_url_init(ctx, m);
   minnet_headers_init(ctx, m);
+  minnet_query_init(ctx, m);
   minnet_client_init(ctx, m);
   minnet_server_init(ctx, m);
 
@@ -501,6 +509,7 @@ JS_INIT_MODULE(JSContext* ctx, const char* module_name) {
   JS_AddModuleExport(ctx, m, "AsyncIterator");
   JS_AddModuleExport(ctx, m, "URL");
   JS_AddModuleExport(ctx, m, "Headers");
+  JS_AddModuleExport(ctx, m, "URLSearchParams");
   JS_AddModuleExport(ctx, m, "Client");
   JS_AddModuleExport(ctx, m, "Server");
 
@@ -0,0 +1,57 @@
+import { createServer, fetch } from 'net.so';
+import { exit } from 'std';
+import { kill, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+
+/*
+ * Download throughput: a server returning a large body in 64 KiB pieces,
+ * fetched sequentially over loopback.
+ *
+ *   qjsm tests/bench-fetch.js [seconds] [megabytes] [port]
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+
+function server(port, megabytes) {
+  const piece = new ArrayBuffer(65536);
+  const count = (megabytes * 1048576) / piece.byteLength;
+
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    mounts: {
+      *'/large'(req, resp) {
+        for(let i = 0; i < count; i++) yield piece;
+      }
+    }
+  });
+}
+
+async function client(seconds = 5, megabytes = 64, port = 30081) {
+  const pid = spawn('bench-fetch.js', ['server', port, megabytes]);
+  const url = `http://localhost:${port}/large`;
+  let count = 0,
+    bytes = 0;
+
+  sleep(250);
+
+  const start = Date.now(),
+    end = start + seconds * 1000;
+
+  while(Date.now() < end) {
+    const response = await fetch(url);
+    bytes += (await response.arrayBuffer()).byteLength;
+    ++count;
+  }
+
+  const elapsed = (Date.now() - start) / 1000;
+
+  console.log(`${count} downloads, ${bytes} bytes in ${elapsed.toFixed(2)}s: ${(bytes / 1048576 / elapsed).toFixed(1)} MiB/s`);
+
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(+args[0], +args[1]);
+else client(...[mode, ...args].filter(a => a !== undefined).map(Number));
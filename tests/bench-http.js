@@ -0,0 +1,63 @@
+import { createServer, fetch } from 'net.so';
+import { exit } from 'std';
+import { kill, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+
+/*
+ * Small-request throughput: a server whose handler reads two headers and
+ * returns a few bytes, hammered sequentially by fetch().
+ *
+ *   qjsm tests/bench-http.js [seconds] [port]
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+
+function server(port) {
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    mounts: {
+      *'/small'(req, resp) {
+        const { headers } = req;
+        yield `${headers.get('host')} ${headers.get('user-agent') ?? '-'}\n`;
+      }
+    }
+  });
+}
+
+async function client(seconds = 5, port = 30080) {
+  const pid = spawn('bench-http.js', ['server', port + '']);
+  const url = `http://localhost:${port}/small`;
+  let count = 0,
+    bytes = 0,
+    error;
+
+  sleep(250);
+
+  const start = Date.now(),
+    end = start + seconds * 1000;
+
+  try {
+    while(Date.now() < end) {
+      const response = await fetch(url, { headers: { 'user-agent': 'bench-http' } });
+      bytes += (await response.arrayBuffer()).byteLength;
+      ++count;
+    }
+  } catch(e) {
+    error = e;
+  }
+
+  const elapsed = (Date.now() - start) / 1000;
+
+  console.log(`${count} requests, ${bytes} bytes in ${elapsed.toFixed(2)}s`);
+  console.log(`${(count / elapsed).toFixed(1)} req/s, ${count ? ((elapsed * 1000) / count).toFixed(3) : '-'} ms/request`);
+
+  if(error) console.log(`stopped by ${error}`);
+
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(error ? 1 : 0);
+}
+
+if(mode == 'server') server(+args[0]);
+else client(...[mode, ...args].filter(a => a !== undefined).map(Number));
@@ -0,0 +1,66 @@
+import { createServer, fetch, setTLSCache } from 'net.so';
+import { exit } from 'std';
+import { kill, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+
+/*
+ * Handshake rate: a TLS server answering with a few bytes, fetched over a
+ * new connection each time, first with full handshakes, then resuming
+ * sessions with tickets.
+ *
+ *   qjsm tests/bench-tls.js [seconds] [port]
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+
+function server(port) {
+  createServer({
+    host: 'localhost',
+    port,
+    tls: true,
+    sslCert: 'localhost.crt',
+    sslPrivateKey: 'localhost.key',
+    mounts: {
+      *'/'(req, resp) {
+        yield 'ok';
+      }
+    }
+  });
+}
+
+async function run(url, seconds) {
+  let count = 0;
+
+  const start = Date.now(),
+    end = start + seconds * 1000;
+
+  while(Date.now() < end) {
+    await (await fetch(url)).text();
+    ++count;
+  }
+
+  return count / ((Date.now() - start) / 1000);
+}
+
+async function client(seconds = 5, port = 30086) {
+  const pid = spawn('bench-tls.js', ['server', port]);
+  const url = `https://localhost:${port}/`;
+
+  sleep(250);
+
+  setTLSCache(false);
+  const full = await run(url, seconds);
+
+  setTLSCache(true);
+  const resumed = await run(url, seconds);
+  const stats = setTLSCache();
+
+  console.log(`full: ${full.toFixed(1)} handshakes/s`);
+  console.log(`resumed: ${resumed.toFixed(1)} handshakes/s (${stats.resumed} of ${stats.handshakes} resumed)`);
+
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(+args[0]);
+else client(...[mode, ...args].filter(a => a !== undefined).map(Number));
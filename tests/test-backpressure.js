@@ -0,0 +1,86 @@
+import { createServer, fetch } from 'net.so';
+import { exit } from 'std';
+import { kill, setTimeout, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * Slow readers on both ends: a streamed upload read by a handler that waits
+ * between chunks, and a large download iterated the same way. What waits in
+ * memory has to stay around the high-water mark while the rest is held back.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30090;
+const size = 4 * 1024 * 1024;
+const chunk = 'x'.repeat(65536);
+
+const delay = ms => new Promise(resolve => setTimeout(resolve, ms));
+
+function server(port) {
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    streamBody: true,
+    mounts: {
+      async *'/upload'(req, resp) {
+        let received = 0,
+          max = 0;
+
+        for await(let data of req.body) {
+          received += data.byteLength;
+          max = Math.max(max, req.body.buffered);
+          await delay(2);
+        }
+
+        yield `${received} ${max}`;
+      },
+      *'/download'(req, resp) {
+        for(let i = 0; i < size; i += chunk.length) yield chunk;
+      }
+    }
+  });
+}
+
+async function client() {
+  const pid = spawn('test-backpressure.js', ['server']);
+
+  sleep(250);
+
+  await tests({
+    async 'a slow handler holds back the upload'() {
+      const body = new Uint8Array(size).fill(0x61).buffer;
+      const [received, max] = (await (await fetch(`http://localhost:${port}/upload`, { method: 'POST', body })).text()).split(' ').map(Number);
+
+      eq(received, size);
+      eq(max < 2 * 65536, true);
+    },
+    async 'a slow consumer holds back the download'() {
+      const highWaterMark = 256 * 1024;
+      const response = await fetch(`http://localhost:${port}/download`, { highWaterMark });
+      let received = 0,
+        max = 0;
+
+      for await(let data of response.body) {
+        received += data.byteLength;
+        max = Math.max(max, response.body.buffered);
+        await delay(2);
+      }
+
+      eq(received, size);
+      eq(max < 2 * highWaterMark, true);
+    },
+    async 'arrayBuffer() is not throttled'() {
+      const response = await fetch(`http://localhost:${port}/download`, { highWaterMark: 4096 });
+
+      eq((await response.arrayBuffer()).byteLength, size);
+    }
+  });
+
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else client();
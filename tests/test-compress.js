@@ -0,0 +1,201 @@
+import { createServer, fetch } from 'net.so';
+import { exit, open, popen } from 'std';
+import { kill, setTimeout, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * Content-Encoding chosen for Accept-Encoding headers, for complete and for
+ * streamed bodies, and which content types get compressed with the default
+ * list and with a 'types' allowlist. Bodies below minSize stay as they are,
+ * a higher level gives a smaller body and gzip output decodes to the body
+ * that was sent.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30091;
+const allowlistPort = 30092;
+const levelPorts = [30101, 30102];
+const text = 'compressible text '.repeat(256);
+const words = wordlist(16384);
+const tmp = '/tmp/test-compress.gz';
+
+/* the same pseudo random text every time, compressible but not trivially */
+function wordlist(n) {
+  const list = ['alpha', 'beta', 'gamma', 'delta', 'epsilon', 'zeta', 'eta', 'theta', 'iota', 'kappa', 'lambda', 'mu'];
+  let out = '',
+    x = 12345;
+
+  while(out.length < n) {
+    x = (x * 1103515245 + 12345) & 0x7fffffff;
+    out += list[x % list.length] + (x & 0x100 ? ' ' : '\n');
+  }
+
+  return out;
+}
+
+function gunzip(buf) {
+  const f = open(tmp, 'wb');
+
+  f.write(buf, 0, buf.byteLength);
+  f.close();
+
+  const p = popen(`gzip -dc ${tmp}`, 'r');
+  const str = p.readAsString();
+
+  p.close();
+  return str;
+}
+
+const delay = ms => new Promise(resolve => setTimeout(resolve, ms));
+
+function server(port, compression) {
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    compression,
+    mounts: {
+      *'/text'(req, resp) {
+        resp.set('Content-Type', 'text/plain');
+        yield text;
+      },
+      async *'/stream'(req, resp) {
+        resp.set('Content-Type', 'text/plain');
+
+        for(let i = 0; i < 4; i++) {
+          yield text;
+          await delay(10);
+        }
+      },
+      *'/type'(req, resp) {
+        resp.set('Content-Type', req.searchParams.get('t'));
+        yield text;
+      },
+      *'/size'(req, resp) {
+        resp.set('Content-Type', 'text/plain');
+        yield text.slice(0, +req.searchParams.get('n'));
+      },
+      *'/words'(req, resp) {
+        resp.set('Content-Type', 'text/plain');
+        yield words;
+      }
+    }
+  });
+}
+
+async function body(path, accept, p = port) {
+  const response = await fetch(`http://localhost:${p}${path}`, { headers: { 'accept-encoding': accept } });
+  const buf = await response.arrayBuffer();
+
+  return [response.get('content-encoding') ?? 'identity', buf];
+}
+
+const encoding = async (...args) => (await body(...args))[0];
+
+
+async function client() {
+  const pids = ['server', 'allowlist', 'level1', 'level9'].map(mode => spawn('test-compress.js', [mode]));
+
+  sleep(250);
+
+  /* brotli is only there when libwebsockets was built with it */
+  const br = (await encoding('/text', 'br')) == 'br';
+
+  await tests({
+    async 'negotiating a complete body'() {
+      const table = [
+        ['gzip', 'gzip'],
+        ['x-gzip', 'gzip'],
+        ['GZip', 'gzip'],
+        ['deflate', 'deflate'],
+        ['gzip, deflate', 'gzip'],
+        ['deflate;q=1.0, gzip;q=1', 'gzip'],
+        ['gzip;q=0.5, deflate', 'deflate'],
+        ['gzip;q=0.001', 'gzip'],
+        ['br;q=0.9, gzip;q=0.8', br ? 'br' : 'gzip'],
+        ['*', br ? 'br' : 'gzip'],
+        ['*;q=0.5, gzip;q=0', br ? 'br' : 'deflate'],
+        ['gzip;q=0, deflate;q=0', 'identity'],
+        ['gzip, identity;q=0', 'gzip'],
+        ['identity', 'identity'],
+        ['identity;q=0', 'identity'],
+        ['compress, zstd', 'identity']
+      ];
+
+      for(let [accept, expected] of table) eq(`${accept}: ${await encoding('/text', accept)}`, `${accept}: ${expected}`);
+    },
+    async 'negotiating a streamed body'() {
+      const table = [
+        ['gzip', 'identity'],
+        ['gzip, deflate', 'deflate'],
+        ['*', br ? 'br' : 'deflate']
+      ];
+
+      for(let [accept, expected] of table) eq(`${accept}: ${await encoding('/stream', accept)}`, `${accept}: ${expected}`);
+    },
+    async 'content types compressed by default'() {
+      const table = [
+        ['text/html', 'gzip'],
+        ['application/json; charset=utf-8', 'gzip'],
+        ['image/svg+xml', 'gzip'],
+        ['IMAGE/PNG', 'identity'],
+        ['video/mp4', 'identity'],
+        ['font/woff2', 'identity'],
+        ['application/zip', 'identity']
+      ];
+
+      for(let [type, expected] of table) eq(`${type}: ${await encoding(`/type?t=${encodeURIComponent(type)}`, 'gzip')}`, `${type}: ${expected}`);
+    },
+    async 'content types of an allowlist'() {
+      const table = [
+        ['text/plain', 'gzip'],
+        ['TEXT/CSS', 'gzip'],
+        ['application/json', 'gzip'],
+        ['application/json; charset=utf-8', 'gzip'],
+        ['application/javascript', 'identity'],
+        ['textual/plain', 'identity'],
+        ['image/svg+xml', 'identity']
+      ];
+
+      for(let [type, expected] of table)
+        eq(`${type}: ${await encoding(`/type?t=${encodeURIComponent(type)}`, 'gzip', allowlistPort)}`, `${type}: ${expected}`);
+    },
+    async 'bodies below minSize are not compressed'() {
+      eq(await encoding('/size?n=1000', 'gzip'), 'identity');
+      eq(await encoding('/size?n=2000', 'gzip'), 'gzip');
+      eq(await encoding('/size?n=2000', 'gzip', levelPorts[1]), 'identity');
+      eq(await encoding('/size?n=4608', 'gzip', levelPorts[1]), 'gzip');
+    },
+    async 'a higher level gives a smaller body'() {
+      const [[enc1, fast], [enc9, best]] = [await body('/words', 'gzip', levelPorts[0]), await body('/words', 'gzip', levelPorts[1])];
+
+      eq(`${enc1} ${enc9}`, 'gzip gzip');
+      eq(best.byteLength < fast.byteLength, true);
+    },
+    async 'a gzip body decodes to what was sent'() {
+      for(let [path, expected, p] of [
+        ['/text', text, port],
+        ['/words', words, levelPorts[0]],
+        ['/words', words, levelPorts[1]]
+      ]) {
+        const [enc, buf] = await body(path, 'gzip', p);
+
+        eq(enc, 'gzip');
+        eq(gunzip(buf) == expected, true);
+      }
+    }
+  });
+
+  for(let pid of pids) {
+    kill(pid, SIGTERM);
+    wait4(pid, [], WNOHANG);
+  }
+
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else if(mode == 'allowlist') server(allowlistPort, { types: ['text/*', 'application/json'] });
+else if(mode == 'level1') server(levelPorts[0], { level: 1 });
+else if(mode == 'level9') server(levelPorts[1], { level: 9, minSize: 4096 });
+else client();
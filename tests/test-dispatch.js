@@ -0,0 +1,92 @@
+import { createServer, fetch } from 'net.so';
+import { exit } from 'std';
+import { kill, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * server.get/post/use() handlers run after the mount, in the order they were
+ * added, on the request object the mount was given. A use() handler without
+ * a path continues only through next(), any handler returning 1 ends the
+ * chain. '/log' answers with what the handlers saw since the last '/log'.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30099;
+
+function server(port) {
+  let log = [],
+    mounted;
+
+  const record = (req, what) => req.path != '/log' && log.push(what);
+
+  const srv = createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    mounts: {
+      async '/a'(req, resp) {
+        mounted = req;
+        return 'a';
+      },
+      async '/b'(req, resp) {
+        mounted = req;
+        return 'b';
+      },
+      *'/log'(req, resp) {
+        yield log.join(',');
+        log = [];
+      }
+    }
+  });
+
+  srv.use((req, resp, next) => {
+    record(req, 'use');
+    if(!req.get('x-stop')) next();
+  });
+
+  srv.get('/a', (req, resp) => record(req, `get /a ${req === mounted}`));
+  srv.post('/a', (req, resp) => record(req, 'post /a'));
+
+  srv.get('/b', (req, resp) => {
+    record(req, 'get /b');
+    return 1;
+  });
+  srv.get('/b', (req, resp) => record(req, 'get /b again'));
+}
+
+const request = async (path, options = {}) => {
+  const response = await fetch(`http://localhost:${port}${path}`, options);
+
+  await response.text();
+
+  return await (await fetch(`http://localhost:${port}/log`)).text();
+};
+
+async function client() {
+  const pid = spawn('test-dispatch.js', ['server']);
+
+  sleep(250);
+
+  await tests({
+    async 'handlers run by method and path'() {
+      eq(await request('/a'), 'use,get /a true');
+      eq(await request('/a', { method: 'POST', body: 'x' }), 'use,post /a');
+    },
+    async 'use() without next() ends the chain'() {
+      eq(await request('/a', { headers: { 'x-stop': '1' } }), 'use');
+    },
+    async 'returning 1 ends the chain'() {
+      eq(await request('/b'), 'use,get /b');
+    },
+    async 'handlers get the request object of the mount'() {
+      for(let i = 0; i < 3; i++) eq(await request('/a'), 'use,get /a true');
+    }
+  });
+
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else client();
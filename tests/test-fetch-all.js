@@ -0,0 +1,122 @@
+import { createServer, fetchAll } from 'net.so';
+import { exit } from 'std';
+import { kill, setTimeout, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * fetchAll() against handlers that answer after a delay. The server counts
+ * the requests it is working on at once.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30096;
+const base = `http://localhost:${port}`;
+
+const delay = ms => new Promise(resolve => setTimeout(resolve, ms));
+
+function server(port) {
+  let active = 0,
+    peak = 0;
+
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    mounts: {
+      async *'/delay/:ms'(req, resp) {
+        peak = Math.max(peak, ++active);
+        await delay(+req.params.ms);
+        --active;
+
+        yield req.params.ms;
+      },
+      *'/peak'(req, resp) {
+        yield `${peak}`;
+        peak = 0;
+      }
+    }
+  });
+}
+
+async function collect(results) {
+  const values = [];
+
+  for await(let result of results) values.push(result);
+
+  return values;
+}
+
+async function client() {
+  const pid = spawn('test-fetch-all.js', ['server']);
+
+  sleep(250);
+
+  await tests({
+    async 'results come in completion order'() {
+      const results = fetchAll([`${base}/delay/300`, `${base}/delay/10`, `${base}/delay/120`]);
+      const values = await collect(results);
+
+      eq(values.map(({ index }) => index).join(), '1,2,0');
+      eq(await values[0].response.text(), '10');
+      eq(values.every(({ time }) => time > 0), true);
+
+      const { count, completed, failed, min, max } = results.timings;
+
+      eq(count, 3);
+      eq(completed, 3);
+      eq(failed, 0);
+      eq(min <= max, true);
+    },
+    async 'no more than concurrency requests are in flight'() {
+      const urls = [...Array(8)].map(() => `${base}/delay/50`);
+      const values = await collect(fetchAll(urls, { concurrency: 2 }));
+
+      eq(values.length, 8);
+      eq(new Set(values.map(({ index }) => index)).size, 8);
+
+      const [{ response }] = await collect(fetchAll([`${base}/peak`]));
+
+      eq(await response.text(), '2');
+    },
+    async 'failed requests are results with an error'() {
+      const requests = [`${base}/delay/1`, 'http://localhost:1/', ...[...Array(64)].map(() => ({ url: 42 }))];
+      const results = fetchAll(requests, { concurrency: 1 });
+      const values = await collect(results);
+
+      eq(values.length, requests.length);
+      eq(values.filter(({ error }) => error).length, requests.length - 1);
+      eq(results.timings.failed, requests.length - 1);
+    },
+    async 'return() ends pending reads and starts nothing new'() {
+      const results = fetchAll([`${base}/delay/100`, `${base}/delay/100`, `${base}/delay/100`], { concurrency: 1 });
+      const pending = [results.next(), results.next()];
+
+      eq((await results.return(7)).done, true);
+
+      for(let read of pending) eq((await read).done, true);
+
+      eq((await results.next()).done, true);
+
+      await delay(200);
+
+      eq((await results.next()).done, true);
+      eq(results.timings.count, 1);
+    },
+    async 'leaving a loop early'() {
+      let n = 0;
+
+      for await(let result of fetchAll([`${base}/delay/1`, `${base}/delay/1`, `${base}/delay/1`], { concurrency: 3 })) {
+        if(++n == 1) break;
+      }
+
+      eq(n, 1);
+    }
+  });
+
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else client();
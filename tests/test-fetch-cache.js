@@ -0,0 +1,119 @@
+import { createServer, fetch, setFetchCache } from 'net.so';
+import { exit } from 'std';
+import { kill, readdir, remove, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * A config endpoint that is fresh for a second and then revalidated with
+ * its ETag, plus a counter of the full responses sent. '/lang' varies on
+ * Accept-Language, each variant has to survive in the on-disk tier.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30082;
+const dir = '/tmp/test-fetch-cache';
+
+function server(port) {
+  let sent = 0;
+
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    mounts: {
+      *'/config'(req, resp) {
+        resp.set('Cache-Control', 'max-age=1');
+        resp.set('ETag', '"v1"');
+
+        if(req.get('if-none-match') == '"v1"') {
+          resp.status = 304;
+          return;
+        }
+
+        ++sent;
+        resp.set('Content-Type', 'application/json');
+        yield JSON.stringify({ setting: 42 });
+      },
+      *'/sent'(req, resp) {
+        resp.set('Cache-Control', 'no-store');
+        yield `${sent}`;
+      },
+      *'/lang'(req, resp) {
+        resp.set('Cache-Control', 'max-age=60');
+        resp.set('Vary', 'Accept-Language');
+
+        ++sent;
+        yield req.get('accept-language');
+      }
+    }
+  });
+}
+
+async function client() {
+  const pid = spawn('test-fetch-cache.js', ['server']);
+  const url = `http://localhost:${port}/config`;
+  const sent = async () => +(await (await fetch(`http://localhost:${port}/sent`)).text());
+
+  sleep(250);
+  setFetchCache({ maxSize: 1 << 20 });
+
+  await tests({
+    async 'fresh responses come from memory'() {
+      eq((await (await fetch(url)).json()).setting, 42);
+      eq((await (await fetch(url)).json()).setting, 42);
+
+      eq(await sent(), 1);
+      eq(setFetchCache().hits, 1);
+    },
+    async 'stale responses are revalidated with a 304'() {
+      sleep(1100);
+
+      const response = await fetch(url);
+
+      eq(response.status, 200);
+      eq((await response.json()).setting, 42);
+      eq(await sent(), 1);
+      eq(setFetchCache().revalidated, 1);
+      eq(setFetchCache().stale, 1);
+    },
+    async "cache: 'reload' fetches it again"() {
+      await (await fetch(url, { cache: 'reload' })).arrayBuffer();
+
+      eq(await sent(), 2);
+    },
+    async 'no-store responses are not kept'() {
+      const { stores } = setFetchCache();
+
+      await sent();
+      eq(setFetchCache().stores, stores);
+    },
+    async 'the on-disk tier keeps each variant'() {
+      const lang = async language => (await fetch(`http://localhost:${port}/lang`, { headers: { 'accept-language': language } })).text();
+
+      for(const name of readdir(dir)[0] ?? []) if(name[0] != '.') remove(`${dir}/${name}`);
+
+      setFetchCache({ maxSize: 1 << 20, dir });
+
+      const before = await sent();
+
+      eq(await lang('en'), 'en');
+      eq(await lang('de'), 'de');
+
+      /* a new memory tier, both come from disk */
+      setFetchCache({ maxSize: 1 << 20, dir });
+
+      eq(await lang('en'), 'en');
+      eq(await lang('de'), 'de');
+      eq(await sent(), before + 2);
+      eq(setFetchCache().hits, 2);
+    }
+  });
+
+  setFetchCache(false);
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else client();
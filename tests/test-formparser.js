@@ -0,0 +1,98 @@
+import { createServer, fetch, FormParser, Hash } from 'net.so';
+import { exit } from 'std';
+import { kill, mkdir, readdir, remove, sleep, stat, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * FormParser writing file parts to a directory: each part gets its size and
+ * digest, a part above maxFileSize is answered with 413 and leaves no file.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30100;
+const dir = '/tmp/test-formparser';
+const boundary = 'test-formparser-boundary';
+
+function server(port) {
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    mounts: {
+      async '/upload'(req, resp) {
+        const parts = [];
+
+        return new Promise(resolve => {
+          new FormParser(this, ['file'], {
+            directory: dir,
+            maxFileSize: 1024,
+            hash: Hash.TYPE_SHA256,
+            onClose(name, part) {
+              if(part) parts.push(part);
+            },
+            onFinalize() {
+              resolve(JSON.stringify(parts.map(({ filename, size, digest, path }) => ({ filename, size, digest, exists: stat(path)[1] == 0 }))));
+            }
+          });
+        });
+      }
+    }
+  });
+}
+
+const multipart = files =>
+  files.map(([filename, content]) => `--${boundary}\r\nContent-Disposition: form-data; name="file"; filename="${filename}"\r\nContent-Type: text/plain\r\n\r\n${content}\r\n`).join('') +
+  `--${boundary}--\r\n`;
+
+const upload = files =>
+  fetch(`http://localhost:${port}/upload`, {
+    method: 'POST',
+    headers: { 'content-type': `multipart/form-data; boundary=${boundary}` },
+    body: multipart(files)
+  });
+
+const uploads = () => readdir(dir)[0].filter(name => name.startsWith('upload-'));
+
+async function client() {
+  const pid = spawn('test-formparser.js', ['server']);
+
+  for(const name of readdir(dir)[0] ?? []) if(name.startsWith('upload-')) remove(`${dir}/${name}`);
+  mkdir(dir);
+
+  sleep(250);
+
+  await tests({
+    async 'file parts are written with their digest'() {
+      const response = await upload([
+        ['a.txt', 'hello world'],
+        ['b.txt', 'second part']
+      ]);
+
+      eq(response.status, 200);
+
+      const [a, b] = JSON.parse(await response.text());
+
+      eq(a.filename, 'a.txt');
+      eq(a.size, 11);
+      eq(a.digest, 'b94d27b9934d3e08a52e52d7da7dabfac484efe37a5380ee9088f7ace2efcde9');
+      eq(a.exists, true);
+      eq(b.size, 11);
+      eq(b.digest, '8efc9e792dd598f91089dfe22e1b9b973389985dfc551f0e98315dde240c117b');
+
+      for(const name of uploads()) remove(`${dir}/${name}`);
+    },
+    async 'a part above maxFileSize is refused and removed'() {
+      const response = await upload([['big.txt', 'x'.repeat(4096)]]);
+
+      eq(response.status, 413);
+      eq(uploads().length, 0);
+    }
+  });
+
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else client();
@@ -0,0 +1,100 @@
+import { createServer, fetch } from 'net.so';
+import { exit } from 'std';
+import { kill, setTimeout, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * Handlers whose result arrives through a promise: plain async functions
+ * returning the body and async generators, with a small generatorBytes so
+ * the values of a generator are split over several chunks. A request kept
+ * past its transaction still has its headers.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30098;
+
+const delay = ms => new Promise(resolve => setTimeout(resolve, ms));
+
+function server(port) {
+  let kept;
+
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    compression: false,
+    generatorBytes: 16,
+    mounts: {
+      async '/async'(req, resp) {
+        await delay(10);
+        return 'returned by an async handler';
+      },
+      async '/async-now'(req, resp) {
+        return 'returned at once';
+      },
+      async *'/async-generator'(req, resp) {
+        yield 'one ';
+        await delay(10);
+        yield 'two ';
+        yield await Promise.resolve('three');
+      },
+      *'/generator'(req, resp) {
+        for(let i = 0; i < 100; i++) yield `${i % 10}`;
+      },
+      *'/bytes'(req, resp) {
+        for(let i = 0; i < 10000; i++) yield String.fromCharCode(97 + (i % 26));
+      },
+      *'/keep'(req, resp) {
+        kept = req;
+        yield 'kept';
+      },
+      *'/kept'(req, resp) {
+        yield `${kept.get('x-kept')} ${req.get('x-kept')}`;
+      }
+    }
+  });
+}
+
+const get = async (path, headers = {}) => {
+  const response = await fetch(`http://localhost:${port}${path}`, { headers });
+
+  return [response.status, await response.text()];
+};
+
+async function client() {
+  const pid = spawn('test-handlers.js', ['server']);
+
+  sleep(250);
+
+  await tests({
+    async 'an async handler returns the body'() {
+      eq((await get('/async')).join(' '), '200 returned by an async handler');
+      eq((await get('/async-now')).join(' '), '200 returned at once');
+    },
+    async 'an async generator yields the body'() {
+      for(let i = 0; i < 3; i++) eq((await get('/async-generator')).join(' '), '200 one two three');
+    },
+    async 'values beyond generatorBytes are not lost'() {
+      eq((await get('/generator'))[1], '0123456789'.repeat(10));
+    },
+    async 'many one byte values arrive in order'() {
+      const [status, body] = await get('/bytes');
+
+      eq(status, 200);
+      eq(body.length, 10000);
+      eq(body.slice(0, 28), 'abcdefghijklmnopqrstuvwxyzab');
+      eq(body.slice(-4), 'mnop');
+    },
+    async 'a kept request keeps its headers'() {
+      eq((await get('/keep', { 'x-kept': 'first' }))[1], 'kept');
+      eq((await get('/kept', { 'x-kept': 'second' }))[1], 'first second');
+    }
+  });
+
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else client();
@@ -0,0 +1,36 @@
+import { Request } from 'net.so';
+import { eq, tests } from './tinytest.js';
+
+tests({
+  'case-insensitive lookup'() {
+    const { headers } = new Request('http://localhost/', { headers: { 'Content-Type': 'text/plain', 'X-Test': 'a' } });
+
+    eq(headers.get('content-type'), 'text/plain');
+    eq(headers.get('X-TEST'), 'a');
+    eq(headers.has('x-test'), true);
+    eq(headers.has('x-missing'), false);
+  },
+  'set/append/delete'() {
+    const { headers } = new Request('http://localhost/', { headers: { 'Content-Type': 'text/plain', 'X-Test': 'a' } });
+
+    headers.set('x-test', 'b');
+    eq(headers.get('X-Test'), 'b');
+    headers.set('x-test', 'longer');
+    eq(headers.get('x-test'), 'longer');
+    headers.append('X-Test', 'c');
+    eq(headers.get('x-test'), 'longer, c');
+    headers.delete('X-TEST');
+    eq(headers.has('x-test'), false);
+    eq(headers.get('content-type'), 'text/plain');
+    eq(headers.keys().join(','), 'Content-Type');
+  },
+  'many headers'() {
+    const obj = {};
+    for(let i = 0; i < 100; i++) obj['X-Header-' + i] = 'value' + i;
+    const { headers } = new Request('http://localhost/', { headers: obj });
+
+    eq(headers.keys().length, 100);
+    eq(headers.get('x-header-42'), 'value42');
+    eq(headers.get('X-HEADER-99'), 'value99');
+  }
+});
@@ -0,0 +1,60 @@
+import { Generator } from 'net.so';
+import { eq, tests } from './tinytest.js';
+
+function chunked(text, size) {
+  return new Generator(async (push, stop) => {
+    for(let i = 0; i < text.length; i += size) await push(text.slice(i, i + size));
+    stop();
+  });
+}
+
+tests({
+  async 'json() across chunks'() {
+    const text = JSON.stringify({ a: [1, 2, { b: 'x,]}' }], 'c:d': null, e: 'é' });
+
+    for(let size of [1, 3, 7, text.length]) {
+      const obj = await chunked(text, size).json();
+
+      eq(JSON.stringify(obj), text);
+    }
+  },
+  async 'json() scalars and empty containers'() {
+    eq(await chunked(' 42 ', 1).json(), 42);
+    eq(await chunked('"s"', 2).json(), 's');
+    eq((await chunked('[]', 1).json()).length, 0);
+    eq(Object.keys(await chunked('{ }', 1).json()).length, 0);
+  },
+  async 'json() rejects malformed input'() {
+    let error;
+
+    try {
+      await chunked('[1, 2', 2).json();
+    } catch(e) {
+      error = e;
+    }
+
+    eq(error instanceof SyntaxError, true);
+  },
+  async 'json() rejects members without a colon and empty elements'() {
+    for(let text of ['{"a"}', '{1}', '{"a":1,"b"}', '[1,]', '[,1]', '[1,,2]', '{"a":1,}', '{,}']) {
+      for(let size of [1, text.length]) {
+        let error;
+
+        try {
+          await chunked(text, size).json();
+        } catch(e) {
+          error = e;
+        }
+
+        eq(error instanceof SyntaxError, true);
+      }
+    }
+  },
+  async 'jsonLines()'() {
+    const values = [];
+
+    for await(let value of chunked('{"n":1}\n\n{"n":2}\r\n[3]\n4', 5).jsonLines()) values.push(value);
+
+    eq(JSON.stringify(values), '[{"n":1},{"n":2},[3],4]');
+  }
+});
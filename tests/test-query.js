@@ -0,0 +1,37 @@
+import { Request, URL, URLSearchParams } from 'net.so';
+import { eq, tests } from './tinytest.js';
+
+tests({
+  'decode on access'() {
+    const params = new URLSearchParams('a=1&b=hello+world%21&%41bc=x%2');
+
+    eq(params.size, 3);
+    eq(params.get('a'), '1');
+    eq(params.get('b'), 'hello world!');
+    eq(params.get('b'), 'hello world!');
+    eq(params.get('Abc'), 'x%2');
+    eq(params.get('missing'), null);
+    eq(params.has('a'), true);
+    eq(params.toString(), 'a=1&b=hello+world%21&Abc=x%252');
+  },
+  'repeated keys'() {
+    const params = new URLSearchParams('?x=1&&x=2&y&x=3#hash');
+
+    eq(params.get('x'), '1');
+    eq(params.getAll('x').join(','), '1,2,3');
+    eq(params.get('y'), '');
+    eq(params.keys().join(','), 'x,x,y,x');
+    eq(params.toObject().x, '3');
+  },
+  'URL and Request'() {
+    const url = new URL('http://localhost/path?q=search+term&page=2');
+
+    eq(url.searchParams.get('q'), 'search term');
+    eq(url.searchParams.get('page'), '2');
+
+    const req = new Request('http://localhost/path?id=42&tag=a&tag=b');
+
+    eq(req.searchParams.get('id'), '42');
+    eq(req.searchParams.getAll('tag').join(','), 'a,b');
+  }
+});
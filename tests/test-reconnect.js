@@ -0,0 +1,112 @@
+import { client, createServer } from 'net.so';
+import { exit } from 'std';
+import { kill, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * An echo server that hangs up on 'drop'. The client sends while it is
+ * disconnected, the message goes out once it is connected again. The same
+ * socket object is handed to the callbacks through several reconnects.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30087;
+
+function server(port) {
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    onMessage(ws, msg) {
+      if(msg == 'drop') ws.close(1001);
+      else ws.send(msg);
+    }
+  });
+}
+
+function reconnecting() {
+  let connects = 0,
+    overflow,
+    cli;
+
+  return new Promise((resolve, reject) => {
+    client(`ws://localhost:${port}/`, {
+      reconnect: { backoff: 50, maxDelay: 200, bufferSize: 16 },
+      onConnect(ws) {
+        if(++connects == 1) ws.send('drop');
+      },
+      onClose(ws) {
+        if(connects == 1) {
+          eq(typeof ws.send('buffered'), 'object');
+          overflow = ws.send('more than sixteen bytes');
+        }
+      },
+      onMessage(ws, msg) {
+        ws.close();
+        resolve({ connects, msg, overflow, reconnects: cli.reconnects });
+      }
+    }).then(c => (cli = c), reject);
+  });
+}
+
+function cycles(n) {
+  let connects = 0,
+    closes = 0,
+    first,
+    cli;
+
+  return new Promise((resolve, reject) => {
+    client(`ws://localhost:${port}/`, {
+      reconnect: { backoff: 20, maxDelay: 50 },
+      onConnect(ws) {
+        first ??= ws;
+
+        ws.send(++connects <= n ? 'drop' : 'done');
+      },
+      onClose(ws, status) {
+        if(connects <= n) {
+          ++closes;
+          eq(ws === first, true);
+          eq(typeof ws.send, 'function');
+        }
+      },
+      onMessage(ws, msg) {
+        ws.close();
+        resolve({ connects, closes, msg, same: ws === first, reconnects: cli.reconnects });
+      }
+    }).then(c => (cli = c), reject);
+  });
+}
+
+async function main() {
+  const pid = spawn('test-reconnect.js', ['server']);
+
+  sleep(250);
+
+  await tests({
+    async 'sends while disconnected go out after reconnecting'() {
+      const { connects, msg, overflow, reconnects } = await reconnecting();
+
+      eq(connects, 2);
+      eq(reconnects, 1);
+      eq(msg, 'buffered');
+      eq(overflow, false);
+    },
+    async 'the socket survives repeated drops'() {
+      const { connects, closes, msg, same, reconnects } = await cycles(5);
+
+      eq(connects, 6);
+      eq(closes, 5);
+      eq(reconnects, 5);
+      eq(msg, 'done');
+      eq(same, true);
+    }
+  });
+
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else main();
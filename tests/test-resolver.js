@@ -0,0 +1,216 @@
+import { client as connect, createServer, fetch, setResolver } from 'net.so';
+import { exit, open } from 'std';
+import { kill, remove, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * Names come from a private hosts file or from a stub nameserver on a
+ * loopback UDP port. The stub answers A records, CNAME chains, NXDOMAIN with
+ * an SOA, records for names that were not asked for, and nothing at all.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30083;
+const dnsPort = port + 1;
+const hosts = '/tmp/test-resolver.hosts';
+
+const TYPE_A = 1,
+  TYPE_CNAME = 5,
+  TYPE_SOA = 6;
+
+function server(port) {
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    mounts: {
+      *'/'(req, resp) {
+        yield 'resolved';
+      }
+    }
+  });
+}
+
+const u16 = n => [(n >> 8) & 0xff, n & 0xff];
+const u32 = n => [...u16(n >>> 16), ...u16(n & 0xffff)];
+const encodeName = name => [...name.split('.').flatMap(label => [label.length, ...[...label].map(c => c.charCodeAt(0))]), 0];
+const record = (owner, type, ttl, data) => [...encodeName(owner), ...u16(type), ...u16(1), ...u32(ttl), ...u16(data.length), ...data];
+const soa = minimum => [...encodeName('ns.stub.test'), ...encodeName('hostmaster.stub.test'), ...u32(1), ...u32(3600), ...u32(600), ...u32(86400), ...u32(minimum)];
+
+/* answer and authority records for each name, in the order they are sent */
+const zone = {
+  'a.stub.test': { answer: [record('other.stub.test', TYPE_A, 60, [10, 255, 255, 1]), record('a.stub.test', TYPE_A, 60, [127, 0, 0, 1])] },
+  'www.stub.test': { answer: [record('a.stub.test', TYPE_A, 60, [127, 0, 0, 1]), record('www.stub.test', TYPE_CNAME, 30, encodeName('a.stub.test'))] },
+  'spoof.stub.test': { answer: [record('elsewhere.test', TYPE_A, 60, [127, 0, 0, 1])] },
+  'nx.stub.test': { rcode: 3, authority: [record('stub.test', TYPE_SOA, 300, soa(1))] }
+};
+
+function questionName(bytes) {
+  const labels = [];
+  let pos = 12;
+
+  while(bytes[pos]) {
+    labels.push(String.fromCharCode(...bytes.subarray(pos + 1, pos + 1 + bytes[pos])));
+    pos += 1 + bytes[pos];
+  }
+
+  return [labels.join('.').toLowerCase(), pos + 5];
+}
+
+function nameserver(port) {
+  connect(`udp://127.0.0.1:${port}`, {
+    bind: true,
+    binary: true,
+    onMessage(sock, data) {
+      const query = new Uint8Array(data);
+      const [name, end] = questionName(query);
+
+      /* 'silent.stub.test' and other unknown names time out */
+      if(!zone[name]) return;
+
+      const { rcode = 0, answer = [], authority = [] } = zone[name];
+
+      const reply = [
+        ...query.subarray(0, 2),
+        0x81,
+        0x80 | rcode,
+        ...u16(1),
+        ...u16(answer.length),
+        ...u16(authority.length),
+        ...u16(0),
+        ...query.subarray(12, end),
+        ...answer.flat(),
+        ...authority.flat()
+      ];
+
+      sock.send(new Uint8Array(reply).buffer);
+    }
+  });
+}
+
+const get = async host => (await (await fetch(`http://${host}:${port}/`)).text());
+
+async function error(host) {
+  try {
+    await fetch(`http://${host}:${port}/`);
+  } catch(e) {
+    return e.message;
+  }
+}
+
+const fails = async host => (await error(host)) !== undefined;
+
+function delta(before) {
+  const after = setResolver();
+
+  return Object.fromEntries(['entries', 'hits', 'misses', 'expired', 'queries', 'failures'].map(key => [key, after[key] - before[key]]));
+}
+
+async function client() {
+  const pids = [spawn('test-resolver.js', ['server']), spawn('test-resolver.js', ['dns'])];
+  const file = open(hosts, 'w');
+
+  file.puts('127.0.0.1 resolver.test\n');
+  file.close();
+
+  sleep(250);
+  setResolver({ server: '127.0.0.1', port: dnsPort, timeout: 500, hosts });
+
+  await tests({
+    async 'hosts file names are cached'() {
+      eq(await get('resolver.test'), 'resolved');
+      eq(await get('resolver.test'), 'resolved');
+
+      const { entries, hits, misses } = setResolver();
+
+      eq(entries, 1);
+      eq(misses, 1);
+      eq(hits, 1);
+    },
+    async 'address literals bypass the resolver'() {
+      const { hits, misses } = setResolver();
+
+      eq(await get('127.0.0.1'), 'resolved');
+      eq(setResolver().hits + setResolver().misses, hits + misses);
+    },
+    async 'A records of other names are ignored'() {
+      const before = setResolver();
+
+      /* twice, so round robin would come to an address taken from the wrong record */
+      eq(await get('a.stub.test'), 'resolved');
+      eq(await get('a.stub.test'), 'resolved');
+
+      const { queries, failures, hits } = delta(before);
+
+      eq(queries, 1);
+      eq(failures, 0);
+      eq(hits, 1);
+    },
+    async 'CNAME chains are followed in any order'() {
+      const before = setResolver();
+
+      eq(await get('www.stub.test'), 'resolved');
+      eq(await get('www.stub.test'), 'resolved');
+
+      const { queries, failures } = delta(before);
+
+      eq(queries, 1);
+      eq(failures, 0);
+    },
+    async 'an answer for another name has no addresses'() {
+      const before = setResolver();
+
+      eq(await fails('spoof.stub.test'), true);
+      eq(delta(before).failures, 1);
+    },
+    async 'NXDOMAIN is cached for the SOA minimum'() {
+      const before = setResolver();
+
+      /* neither the answer nor the cached failure go on to lws */
+      eq(await error('nx.stub.test'), '[2] Host not found: nx.stub.test');
+      eq(await error('nx.stub.test'), '[2] Host not found: nx.stub.test');
+
+      const { queries, failures, hits } = delta(before);
+
+      eq(queries, 1);
+      eq(failures, 1);
+      eq(hits, 1);
+
+      /* the SOA gives 1 second, less than negativeTtl */
+      sleep(1500);
+
+      eq(await fails('nx.stub.test'), true);
+
+      const { queries: requeried, expired } = delta(before);
+
+      eq(requeried, 2);
+      eq(expired, 1);
+    },
+    async 'failed queries are counted'() {
+      const before = setResolver();
+
+      eq(await fails('silent.stub.test'), true);
+
+      const { queries, failures } = delta(before);
+
+      eq(queries, 1);
+      eq(failures, 1);
+    },
+    'the resolver can be turned off'() {
+      eq(setResolver(false), null);
+    }
+  });
+
+  remove(hosts);
+
+  for(let pid of pids) {
+    kill(pid, SIGTERM);
+    wait4(pid, [], WNOHANG);
+  }
+
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else if(mode == 'dns') nameserver(dnsPort);
+else client();
@@ -0,0 +1,111 @@
+import { Ringbuffer } from 'net.so';
+import { eq, tests } from './tinytest.js';
+
+tests({
+  'SPSC insert/take'() {
+    const rb = new Ringbuffer(4, 8, Ringbuffer.SPSC);
+
+    eq(rb.mode, Ringbuffer.SPSC);
+    eq(rb.size, 8);
+    eq(rb.insert(new Uint32Array([1, 2, 3]).buffer), 3);
+    eq(rb.length, 3);
+
+    const out = new Uint32Array(2);
+    eq(rb.take(out), 2);
+    eq(out[0], 1);
+    eq(out[1], 2);
+    eq(new Uint32Array(rb.take())[0], 3);
+    eq(rb.length, 0);
+  },
+  'SPSC wrap-around'() {
+    const rb = new Ringbuffer(4, 4, Ringbuffer.SPSC);
+
+    eq(rb.insert(new Uint32Array([1, 2, 3]).buffer), 3);
+    eq(rb.take(2).byteLength, 8);
+    eq(rb.insert(new Uint32Array([4, 5, 6, 7]).buffer), 3);
+
+    const out = new Uint32Array(rb.take());
+    eq(out.join(','), '3,4,5,6');
+  },
+  'MPSC full'() {
+    const rb = new Ringbuffer(4, 4, Ringbuffer.MPSC);
+
+    eq(rb.insert(new Uint32Array([1, 2, 3, 4, 5]).buffer), 4);
+    eq(rb.avail, 0);
+    eq(new Uint32Array(rb.take()).join(','), '1,2,3,4');
+    eq(rb.avail, 4);
+  },
+  'unknown mode throws'() {
+    let error;
+
+    try {
+      new Ringbuffer(4, 8, 3);
+    } catch(e) {
+      error = e;
+    }
+
+    eq(error instanceof RangeError, true);
+  },
+  'count above 2^31 throws'() {
+    let error;
+
+    try {
+      new Ringbuffer(1, 2 ** 31 + 1, Ringbuffer.SPSC);
+    } catch(e) {
+      error = e;
+    }
+
+    eq(error instanceof RangeError, true);
+  },
+  'attach to shared buffer'() {
+    const producer = new Ringbuffer(8, 16, Ringbuffer.SPSC);
+    const consumer = new Ringbuffer(producer.buffer);
+
+    eq(consumer.elementLength, 8);
+    producer.insert(new Float64Array([Math.PI]).buffer);
+    eq(new Float64Array(consumer.take(1))[0], Math.PI);
+    eq(producer.length, 0);
+  },
+  'insertMany/consumeMany'() {
+    const rb = new Ringbuffer(4, 8);
+
+    eq(rb.insertMany(new Uint32Array([1, 2, 3]), new Uint32Array([4, 5]).subarray(1)), 4);
+
+    const views = rb.consumeMany(null, 3);
+    eq(views.length, 1);
+    eq(views[0].byteLength, 12);
+    eq(new Uint32Array(views[0].buffer, views[0].byteOffset, 3).join(','), '1,2,3');
+    eq(rb.length, 1);
+  },
+  'consumeMany wrap-around'() {
+    const rb = new Ringbuffer(4, 4);
+
+    rb.insertMany(new Uint32Array([1, 2, 3]));
+    rb.consumeMany(null, 2);
+    rb.insertMany(new Uint32Array([4, 5]));
+
+    const views = rb.consumeMany();
+    eq(views.length, 2);
+    eq(views.reduce((n, v) => n + v.byteLength, 0), 12);
+  },
+  'consumeMany shared'() {
+    const rb = new Ringbuffer(4, 8, Ringbuffer.MPSC);
+
+    rb.insertMany(new Uint32Array([7, 8, 9]));
+
+    const [view] = rb.consumeMany(null, 2);
+    eq(new Uint32Array(view.buffer).join(','), '7,8');
+    eq(rb.length, 1);
+
+    let error;
+
+    try {
+      rb.consumeMany(new Uint32Array(1), 1);
+    } catch(e) {
+      error = e;
+    }
+
+    eq(error instanceof TypeError, true);
+    eq(rb.length, 1);
+  }
+});
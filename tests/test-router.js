@@ -0,0 +1,84 @@
+import { createServer, fetch } from 'net.so';
+import { exit } from 'std';
+import { kill, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * Mounts with ':param' and '*' segments and per-method mounts, next to a
+ * file mount on '/' which lws would otherwise pick for the parameter paths.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30088;
+
+function server(port) {
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    mounts: {
+      '/': ['.', 'index.html'],
+      *'/users/:id'(req, resp) {
+        yield `user ${req.params.id}`;
+      },
+      *'/users/:id/posts/:post'(req, resp) {
+        const { id, post } = req.params;
+        yield `post ${post} of ${id}`;
+      },
+      *'/users/:name/friends'(req, resp) {
+        yield `friends of ${req.params.name} ${req.params.id}`;
+      },
+      *'/users/me'(req, resp) {
+        yield 'me';
+      },
+      *'/files/*'(req, resp) {
+        yield `file ${req.params['*']}`;
+      },
+      *'GET /items'(req, resp) {
+        yield 'list';
+      },
+      *'POST /items'(req, resp) {
+        yield 'created';
+      }
+    }
+  });
+}
+
+const text = async (path, options) => (await fetch(`http://localhost:${port}${path}`, options)).text();
+
+async function client() {
+  const pid = spawn('test-router.js', ['server']);
+
+  sleep(250);
+
+  await tests({
+    async 'parameters are captured'() {
+      eq(await text('/users/42'), 'user 42');
+      eq(await text('/users/42/posts/7'), 'post 7 of 42');
+    },
+    async 'each route names its own parameters'() {
+      eq(await text('/users/ann/friends'), 'friends of ann undefined');
+      eq(await text('/users/ann'), 'user ann');
+    },
+    async 'static segments win over parameters'() {
+      eq(await text('/users/me'), 'me');
+    },
+    async 'a wildcard takes the rest of the path'() {
+      eq(await text('/files/a/b/c.txt'), 'file a/b/c.txt');
+    },
+    async 'the query string is not part of the route'() {
+      eq(await text('/users/42?tab=posts'), 'user 42');
+    },
+    async 'mounts match by method'() {
+      eq(await text('/items'), 'list');
+      eq(await text('/items', { method: 'POST', body: '' }), 'created');
+    }
+  });
+
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else client();
@@ -0,0 +1,140 @@
+import { createServer, fetch, Hash } from 'net.so';
+import { exit, open } from 'std';
+import { kill, remove, setTimeout, sleep, stat, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * Downloads written to disk with saveTo and a digest. A body that breaks off
+ * leaves neither the file nor its '.part' behind.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30094;
+const dropPort = 30095;
+const path = '/tmp/test-save.bin';
+const size = 1024 * 1024 + 17;
+
+const delay = ms => new Promise(resolve => setTimeout(resolve, ms));
+
+function data(n) {
+  const bytes = new Uint8Array(n);
+
+  for(let i = 0; i < n; i++) bytes[i] = (i * 31 + (i >> 8)) & 0xff;
+
+  return bytes;
+}
+
+function server(port) {
+  const bytes = data(size);
+
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    compression: false,
+    mounts: {
+      *'/blob'(req, resp) {
+        resp.set('Content-Type', 'application/octet-stream');
+
+        for(let i = 0; i < size; i += 65536) yield bytes.slice(i, i + 65536).buffer;
+      },
+      *'/missing'(req, resp) {
+        resp.status = 404;
+        yield 'not here';
+      },
+      async *'/partial'(req, resp) {
+        resp.set('Content-Type', 'application/octet-stream');
+        resp.set('Content-Length', `${size}`);
+
+        yield bytes.slice(0, 262144).buffer;
+        await delay(200);
+
+        /* the connection goes away in the middle of the body */
+        exit(0);
+      }
+    }
+  });
+}
+
+function exists(file) {
+  const [st, err] = stat(file);
+
+  return err == 0;
+}
+
+function load(file) {
+  const [st] = stat(file);
+  const buf = new ArrayBuffer(st.size);
+  const f = open(file, 'rb');
+
+  f.read(buf, 0, st.size);
+  f.close();
+
+  return new Uint8Array(buf);
+}
+
+async function client() {
+  const pids = [spawn('test-save.js', ['server']), spawn('test-save.js', ['drop'])];
+
+  sleep(250);
+
+  await tests({
+    async 'saveTo writes the body and updates the digest'() {
+      const digest = new Hash(Hash.TYPE_SHA256);
+      const expected = new Hash(Hash.TYPE_SHA256);
+      const response = await fetch(`http://localhost:${port}/blob`, { saveTo: path, digest });
+
+      eq(response.status, 200);
+      eq(exists(path + '.part'), false);
+
+      const saved = load(path);
+
+      eq(saved.length, size);
+
+      expected.update(data(size).buffer);
+      expected.finalize();
+
+      const written = new Hash(Hash.TYPE_SHA256);
+
+      written.update(saved.buffer);
+      written.finalize();
+
+      eq(digest.finalized, true);
+      eq(digest.toString(), expected.toString());
+      eq(written.toString(), expected.toString());
+
+      remove(path);
+    },
+    async 'a failed response is not saved'() {
+      const response = await fetch(`http://localhost:${port}/missing`, { saveTo: path });
+
+      eq(response.status, 404);
+      eq(exists(path), false);
+      eq(exists(path + '.part'), false);
+    },
+    async 'an interrupted body leaves no file behind'() {
+      let error;
+
+      try {
+        await fetch(`http://localhost:${dropPort}/partial`, { saveTo: path, digest: new Hash(Hash.TYPE_SHA256) });
+      } catch(e) {
+        error = e;
+      }
+
+      eq(error instanceof Error, true);
+      eq(exists(path), false);
+      eq(exists(path + '.part'), false);
+    }
+  });
+
+  for(let pid of pids) {
+    kill(pid, SIGTERM);
+    wait4(pid, [], WNOHANG);
+  }
+
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else if(mode == 'drop') server(dropPort);
+else client();
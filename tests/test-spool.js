@@ -0,0 +1,108 @@
+import { createServer, fetch } from 'net.so';
+import { exit } from 'std';
+import { kill, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * Request bodies above memoryThreshold go to a temporary file. The handlers
+ * answer with what they read back, mapped as a whole or iterated in chunks.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30089;
+const threshold = 4096;
+
+function server(port) {
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    memoryThreshold: threshold,
+    mounts: {
+      async *'/buffer'(req, resp) {
+        const buf = await req.arrayBuffer();
+        const bytes = new Uint8Array(buf);
+        let sum = 0;
+
+        for(let i = 0; i < bytes.length; i++) sum = (sum + bytes[i]) % 65521;
+
+        yield `${buf.byteLength} ${sum}`;
+      },
+      async *'/text'(req, resp) {
+        const text = await req.text();
+
+        yield `${text.length} ${text.slice(0, 4)} ${text.slice(-4)}`;
+      },
+      async *'/iterate'(req, resp) {
+        let chunks = 0,
+          size = 0,
+          largest = 0;
+
+        for await(let chunk of req.body) {
+          chunks++;
+          size += chunk.byteLength;
+          largest = Math.max(largest, chunk.byteLength);
+        }
+
+        yield `${size} ${chunks} ${largest}`;
+      },
+      async *'/json'(req, resp) {
+        const obj = await req.json();
+
+        yield `${obj.items.length} ${obj.items[obj.items.length - 1]}`;
+      }
+    }
+  });
+}
+
+function body(size) {
+  const bytes = new Uint8Array(size);
+  let sum = 0;
+
+  for(let i = 0; i < size; i++) sum = (sum + (bytes[i] = (i * 7) & 0xff)) % 65521;
+
+  return { bytes, sum };
+}
+
+const post = async (path, body) => (await fetch(`http://localhost:${port}${path}`, { method: 'POST', body })).text();
+
+async function client() {
+  const pid = spawn('test-spool.js', ['server']);
+
+  sleep(250);
+
+  await tests({
+    async 'arrayBuffer() below and above the threshold'() {
+      for(let size of [threshold / 2, threshold * 64]) {
+        const { bytes, sum } = body(size);
+
+        eq(await post('/buffer', bytes.buffer), `${size} ${sum}`);
+      }
+    },
+    async 'text() of a spooled body'() {
+      const text = 'head' + 'x'.repeat(threshold * 8) + 'tail';
+
+      eq(await post('/text', text), `${text.length} head tail`);
+    },
+    async 'iterating a spooled body reads it in chunks'() {
+      const size = 65536 * 3 + 100;
+      const [total, chunks, largest] = (await post('/iterate', body(size).bytes.buffer)).split(' ').map(Number);
+
+      eq(total, size);
+      eq(chunks >= 4, true);
+      eq(largest <= 65536, true);
+    },
+    async 'json() of a spooled body'() {
+      const items = [...Array(4096).keys()];
+
+      eq(await post('/json', JSON.stringify({ items })), `4096 4095`);
+    }
+  });
+
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else client();
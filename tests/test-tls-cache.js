@@ -0,0 +1,61 @@
+import { createServer, fetch, setTLSCache } from 'net.so';
+import { exit } from 'std';
+import { kill, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * An HTTPS server with the test certificate, fetched repeatedly with the
+ * same sslCA so it is parsed only once and the first session is resumed.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30085;
+
+function server(port) {
+  createServer({
+    host: 'localhost',
+    port,
+    tls: true,
+    sslCert: 'localhost.crt',
+    sslPrivateKey: 'localhost.key',
+    mounts: {
+      *'/'(req, resp) {
+        yield 'secure';
+      }
+    }
+  });
+}
+
+async function client() {
+  const pid = spawn('test-tls-cache.js', ['server']);
+
+  sleep(250);
+  setTLSCache({ maxSessions: 8, lifetime: 60 });
+
+  await tests({
+    async 'credentials are parsed once and sessions resumed'() {
+      for(let i = 0; i < 3; i++) eq(await (await fetch(`https://localhost:${port}/`, { sslCA: 'localhost.crt' })).text(), 'secure');
+
+      const { credentials, handshakes, resumed, stores, maxSessions, lifetime } = setTLSCache();
+
+      eq(credentials, 1);
+      eq(handshakes, 3);
+      eq(stores > 0, true);
+      eq(resumed, 2);
+      eq(maxSessions, 8);
+      eq(lifetime, 60);
+    },
+    'the cache can be turned off'() {
+      eq(setTLSCache(false), null);
+      eq(setTLSCache(), null);
+      eq(setTLSCache(true).credentials, 0);
+    }
+  });
+
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else client();
@@ -0,0 +1,143 @@
+import { createServer, fetch, setResolver, setTLSCache } from 'net.so';
+import { exit, open as fopen } from 'std';
+import { close, exec, kill, open, remove, sleep, O_RDWR, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * A TLS server with a certificate for each of two server names, replaced
+ * by reloadCertificates() with only 'sni' given. A certificate is told
+ * apart by whether the client verifies it with that certificate as sslCA.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30097;
+const dir = '/tmp/test-tls-reload';
+const hosts = `${dir}.hosts`;
+
+const cert = name => ({ sslCert: `${dir}-${name}.crt`, sslPrivateKey: `${dir}-${name}.key` });
+
+function makeCert(name, host) {
+  const stderr = open('/dev/null', O_RDWR);
+  const { sslCert, sslPrivateKey } = cert(name);
+  const args = ['-newkey', 'rsa:2048', '-nodes', '-sha256', '-days', '1', '-subj', `/CN=${host}`, '-addext', `subjectAltName=DNS:${host}`];
+  const ret = exec(['openssl', 'req', '-x509', '-out', sslCert, '-keyout', sslPrivateKey, ...args], { stderr, stdout: stderr });
+
+  close(stderr);
+  return ret;
+}
+
+function server(port) {
+  const server = createServer({
+    host: 'localhost',
+    port,
+    tls: true,
+    sslCert: 'localhost.crt',
+    sslPrivateKey: 'localhost.key',
+    sni: { 'a.tls.test': cert('a1'), 'b.tls.test': cert('b1') },
+    mounts: {
+      *'/'(req, resp) {
+        yield 'secure';
+      },
+      *'/reload'(req, resp) {
+        server.reloadCertificates({ sni: { 'a.tls.test': cert('a2'), 'b.tls.test': cert('b1') } });
+
+        yield `${server.tls.reloads}`;
+      },
+      *'/stats'(req, resp) {
+        yield JSON.stringify(server.tls);
+      }
+    }
+  });
+}
+
+const get = async (host, path, name) => (await fetch(`https://${host}:${port}${path}`, { sslCA: name == 'localhost' ? 'localhost.crt' : cert(name).sslCert })).text();
+
+async function verifies(host, name) {
+  try {
+    return (await get(host, '/', name)) == 'secure';
+  } catch(e) {
+    return false;
+  }
+}
+
+const stats = async () => JSON.parse(await get('localhost', '/stats', 'localhost'));
+
+async function client() {
+  for(let [name, host] of [
+    ['a1', 'a.tls.test'],
+    ['a2', 'a.tls.test'],
+    ['b1', 'b.tls.test']
+  ])
+    eq(makeCert(name, host), 0);
+
+  const file = fopen(hosts, 'w');
+
+  file.puts('127.0.0.1 localhost a.tls.test b.tls.test\n');
+  file.close();
+
+  const pid = spawn('test-tls-reload.js', ['server']);
+
+  sleep(500);
+  setResolver({ hosts });
+
+  /* full handshakes only, a resumed session would not show the certificate */
+  setTLSCache(false);
+
+  await tests({
+    'a certificate that does not load fails createServer'() {
+      let error;
+
+      try {
+        createServer({ host: 'localhost', port: port + 1, tls: true, sslCert: 'localhost.crt', sslPrivateKey: 'localhost.key', sni: { 'c.tls.test': cert('missing') } });
+      } catch(e) {
+        error = e;
+      }
+
+      eq(error instanceof TypeError, true);
+    },
+    async 'each name gets its certificate'() {
+      eq(await verifies('a.tls.test', 'a1'), true);
+      eq(await verifies('a.tls.test', 'b1'), false);
+      eq(await verifies('b.tls.test', 'b1'), true);
+      eq(await verifies('localhost', 'localhost'), true);
+    },
+    async 'reloading sni keeps the other certificates'() {
+      eq(await get('localhost', '/reload', 'localhost'), '1');
+
+      eq(await verifies('a.tls.test', 'a2'), true);
+      eq(await verifies('a.tls.test', 'a1'), false);
+      eq(await verifies('b.tls.test', 'b1'), true);
+      eq(await verifies('localhost', 'localhost'), true);
+
+      const { names, reloads } = await stats();
+
+      eq(names, 2);
+      eq(reloads, 1);
+    },
+    async 'sessions are resumed after a reload'() {
+      setTLSCache(true);
+
+      const before = await stats();
+
+      for(let i = 0; i < 3; i++) eq(await verifies('b.tls.test', 'b1'), true);
+
+      const after = await stats();
+
+      eq(after.resumed - before.resumed >= 2, true);
+      eq(after.handshakes > before.handshakes, true);
+    }
+  });
+
+  setResolver(false);
+  setTLSCache(false);
+
+  for(let name of ['a1', 'a2', 'b1']) for(let path of Object.values(cert(name))) remove(path);
+
+  remove(hosts);
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else client();
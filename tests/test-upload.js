@@ -0,0 +1,118 @@
+import { createServer, fetch } from 'net.so';
+import { exit, open } from 'std';
+import { kill, remove, sleep, SIGTERM, WNOHANG } from 'os';
+import { spawn, wait4 } from './spawn.js';
+import { eq, tests } from './tinytest.js';
+
+/*
+ * Request bodies from strings, buffers, files and (async) iterators, for
+ * every method that carries one. The server answers with the framing it
+ * received and a checksum of the body.
+ */
+const [mode, ...args] = scriptArgs.slice(1);
+const port = 30093;
+const file = '/tmp/test-upload.bin';
+const size = 200 * 1024;
+
+function checksum(bytes) {
+  let sum = 0;
+
+  for(let i = 0; i < bytes.length; i++) sum = (sum + bytes[i] * ((i % 31) + 1)) % 65521;
+
+  return sum;
+}
+
+function server(port) {
+  createServer({
+    host: 'localhost',
+    port,
+    tls: false,
+    mounts: {
+      async *'/echo'(req, resp) {
+        const bytes = new Uint8Array(await req.arrayBuffer());
+
+        yield [req.method, req.get('transfer-encoding') ?? '-', req.get('content-length') ?? '-', bytes.length, checksum(bytes)].join(' ');
+      }
+    }
+  });
+}
+
+function data(n, offset = 0) {
+  const bytes = new Uint8Array(n);
+
+  for(let i = 0; i < n; i++) bytes[i] = ((i + offset) * 13) & 0xff;
+
+  return bytes;
+}
+
+const upload = async (body, method = 'POST') => (await fetch(`http://localhost:${port}/echo`, { method, body })).text();
+
+async function client() {
+  const pid = spawn('test-upload.js', ['server']);
+  const bytes = data(size);
+  const f = open(file, 'wb');
+
+  f.write(bytes.buffer, 0, size);
+  f.close();
+
+  sleep(250);
+
+  await tests({
+    async 'strings and buffers are sent with a Content-Length'() {
+      eq(await upload('hello'), `POST - 5 5 ${checksum([...'hello'].map(c => c.charCodeAt(0)))}`);
+      eq(await upload(bytes.buffer), `POST - ${size} ${size} ${checksum(bytes)}`);
+
+      const view = bytes.subarray(1000, 5000);
+
+      eq(await upload(view), `POST - 4000 4000 ${checksum(view)}`);
+    },
+    async 'files are sent with a Content-Length'() {
+      eq(await upload({ file }), `POST - ${size} ${size} ${checksum(bytes)}`);
+
+      const range = bytes.subarray(70000, 70000 + 65536 + 10);
+
+      eq(await upload({ file, offset: 70000, length: range.length }), `POST - ${range.length} ${range.length} ${checksum(range)}`);
+    },
+    async 'iterators are sent chunked'() {
+      const parts = [data(100), data(70000, 100), data(1, 70100)];
+      const whole = data(70101);
+
+      eq(await upload(parts.values()), `POST chunked - ${whole.length} ${checksum(whole)}`);
+
+      eq(
+        await upload(
+          (function* () {
+            yield* parts;
+          })()
+        ),
+        `POST chunked - ${whole.length} ${checksum(whole)}`
+      );
+
+      eq(
+        await upload(
+          (async function* () {
+            for(let part of parts) yield await Promise.resolve(part);
+          })()
+        ),
+        `POST chunked - ${whole.length} ${checksum(whole)}`
+      );
+    },
+    async 'an empty iterator sends the terminating chunk only'() {
+      eq(await upload([].values()), `POST chunked - 0 0`);
+    },
+    async 'every method with a body uploads'() {
+      for(let method of ['PUT', 'PATCH', 'DELETE']) {
+        eq(await upload({ file }, method), `${method} - ${size} ${size} ${checksum(bytes)}`);
+        eq(await upload([bytes].values(), method), `${method} chunked - ${size} ${checksum(bytes)}`);
+      }
+    }
+  });
+
+  remove(file);
+  kill(pid, SIGTERM);
+  wait4(pid, [], WNOHANG);
+  exit(0);
+}
+
+if(mode == 'server') server(port);
+else client();